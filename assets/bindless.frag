@@ -0,0 +1,19 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+// partially bound. only the allocated indices are valid
+layout(set = 0, binding = 0) uniform sampler2D textures[];
+
+layout(push_constant) uniform constants_t {
+    vec4 rect;
+    uint texture_index; // same for the whole draw. no nonuniformEXT
+}
+constants;
+
+layout(location = 0) in vec2 v2f_uv;
+
+layout(location = 0) out vec4 out_color;
+
+void main() {
+    out_color = texture(textures[constants.texture_index], v2f_uv);
+}
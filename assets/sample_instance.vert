@@ -0,0 +1,14 @@
+#version 450
+
+layout(location = 0) in vec2 i_position;
+layout(location = 1) in vec3 i_color;
+// binding 1, per instance. mat4 takes 4 locations
+layout(location = 2) in mat4 i_transform;
+layout(location = 6) in vec4 i_instance_color;
+
+layout(location = 0) out vec3 v2f_color;
+
+void main() {
+    gl_Position = i_transform * vec4(i_position, 0.0, 1.0);
+    v2f_color = i_color * i_instance_color.rgb;
+}
@@ -0,0 +1,17 @@
+#version 450
+
+layout(push_constant) uniform constants_t {
+    vec4 rect; // offset(xy), scale(zw)
+    uint texture_index;
+}
+constants;
+
+layout(location = 0) in vec2 i_position;
+layout(location = 1) in vec2 i_uv;
+
+layout(location = 0) out vec2 v2f_uv;
+
+void main() {
+    gl_Position = vec4(i_position * constants.rect.zw + constants.rect.xy, 0.0, 1.0);
+    v2f_uv = i_uv;
+}
@@ -20,11 +20,17 @@
 #   error "unexpected linking configuration"
 #endif
 // clang-format on
+#include <cstdint>
+#include <cstdio>
 #include <filesystem>
 #include <gsl/gsl>
+#include <initializer_list>
+#include <memory>
 #include <memory_resource>
+#include <string>
 #include <string_view>
 #include <system_error>
+#include <vector>
 // clang-format off
 #if __has_include(<d3d11.h>) // Windows, DirectX 11
 //#include <winrt/base.h>
@@ -66,6 +72,8 @@
 _INTERFACE_ std::error_category& get_opengl_category() noexcept;
 _INTERFACE_ void get_extensions(EGLDisplay display, std::vector<std::string_view>& names) noexcept;
 _INTERFACE_ bool has_extension(EGLDisplay display, std::string_view name) noexcept;
+/// @brief Search `GL_EXTENSIONS` of the current context with `glGetStringi`
+_INTERFACE_ bool has_gl_extension(std::string_view name) noexcept;
 
 /**
  * @brief `EGLSurface` owner.
@@ -120,7 +128,8 @@ class _INTERFACE_ egl_context_t final {
 
     /**
      * @brief Destroy all EGL bindings and resources
-     * @note This functions in invoked in the destructor
+     * @note This functions in invoked in the destructor.
+     *       `eglMakeCurrent` is used only when the context is current in the calling thread
      * @post is_valid() == false
      * 
      * @see eglMakeCurrent
@@ -278,6 +287,892 @@ class _INTERFACE_ pbo_writer_t final {
     GLenum map_and_invoke(uint16_t idx, writer_callback_t callback, void* user_data) noexcept;
 };
 
+/**
+ * @brief GPU time of a named region. Both `begin` and `end` are nanoseconds in the device's timeline
+ * @note  `name` is not copied. Use string literals or names that outlive the exported result
+ */
+struct gpu_time_region_t final {
+    gsl::czstring<> name;
+    uint64_t begin;
+    uint64_t end;
+};
+
+/**
+ * @brief Write regions as `{"regions":[{"name":"draw","begin":...,"ms":0.25}, ...]}`
+ * @return uint32_t 0 if successful. Else, redirected from `ferror`
+ */
+_INTERFACE_ uint32_t write_gpu_time_json(FILE* stream, gsl::span<const gpu_time_region_t> regions) noexcept;
+
+/**
+ * @brief Write regions as complete('X') events of Chrome trace format. Open the file in `chrome://tracing` or Perfetto
+ * @param tid   track(thread) id for the regions. Use different value for each queue/context
+ * @return uint32_t 0 if successful. Else, redirected from `ferror`
+ * @see https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU
+ */
+_INTERFACE_ uint32_t write_gpu_time_chrome_trace(FILE* stream, gsl::span<const gpu_time_region_t> regions,
+                                                 uint32_t tid = 0) noexcept;
+
+/**
+ * @brief Move the recorded CPU events(`TRACE_SCOPE`) of all threads to the stream in Chrome trace format
+ * @note  The library records the events only when it is built with `GRAPHICS_USE_TRACE`.
+ *        Otherwise, the `traceEvents` is always empty
+ * @return uint32_t 0 if successful. Else, redirected from `ferror`
+ */
+_INTERFACE_ uint32_t flush_trace(FILE* stream) noexcept;
+
+/**
+ * @brief GPU timer for OpenGL ES with `GL_EXT_disjoint_timer_query`.
+ * @details The queries are grouped by frame slot. `next_frame` moves to the next slot and 
+ *          `collect` gathers the finished slots without waiting for the GPU.
+ *          If the GPU is too far behind, the oldest slot is dropped instead of being waited.
+ * 
+ * @note  Uses `GL_TIMESTAMP_EXT` counters if `GL_QUERY_COUNTER_BITS_EXT` is not zero, then the regions can be nested.
+ *        Otherwise `GL_TIME_ELAPSED_EXT` is used and the regions in a frame must not overlap.
+ * @see https://www.khronos.org/registry/OpenGL/extensions/EXT/EXT_disjoint_timer_query.txt
+ */
+class _INTERFACE_ timer_query_t final {
+    static constexpr uint16_t capacity = 3;    // frame slots
+    static constexpr uint16_t max_region = 32; // regions in 1 frame slot
+
+  private:
+    GLuint queries[capacity][max_region * 2]{}; // begin, end for each region
+    gsl::czstring<> names[capacity][max_region]{};
+    uint16_t counts[capacity]{}; // number of regions recorded in the slot
+    bool pending[capacity]{};    // the slot is recorded but not collected
+    uint16_t frame = 0;          // current slot
+    uint32_t dropped = 0;        // count of the slots which were reused before collect
+    uint64_t elapsed = 0;        // accumulated `GL_TIME_ELAPSED_EXT` when the counter is not available
+    bool use_counter = false;
+    GLenum ec = GL_NO_ERROR;
+
+  public:
+    /**
+     * @note requires current EGLContext
+     * @see glGenQueries
+     */
+    timer_query_t() noexcept;
+    ~timer_query_t() noexcept;
+    timer_query_t(timer_query_t const&) = delete;
+    timer_query_t& operator=(timer_query_t const&) = delete;
+    timer_query_t(timer_query_t&&) = delete;
+    timer_query_t& operator=(timer_query_t&&) = delete;
+
+    /**
+     * @brief check whether the construction was successful
+     * @return GLenum   cached `ec` from the constructor. 
+     *                  `GL_INVALID_OPERATION` if the extension is not available
+     */
+    GLenum is_valid() const noexcept;
+
+    /**
+     * @brief Move to the next frame slot. If the slot is not collected yet, its results are dropped
+     */
+    void next_frame() noexcept;
+
+    /**
+     * @return uint16_t index of the region. `UINT16_MAX` if the frame slot is full
+     * @see glQueryCounterEXT
+     * @see glBeginQuery
+     */
+    uint16_t begin(gsl::czstring<> name) noexcept;
+
+    /// @see glEndQuery
+    void end(uint16_t region) noexcept;
+
+    /**
+     * @brief Append the regions of finished frame slots. Never waits for the GPU
+     * @return GLenum   redirected from `glGetError`
+     * @see GL_QUERY_RESULT_AVAILABLE
+     * @see GL_GPU_DISJOINT_EXT
+     */
+    GLenum collect(std::vector<gpu_time_region_t>& regions) noexcept;
+
+    /// @brief number of frame slots dropped since the construction
+    uint32_t get_dropped() const noexcept;
+};
+
+/**
+ * @brief Read-only view of a whole file. `mmap`/`MapViewOfFile` if possible, else a buffered read.
+ * @details The bytes are valid until the destruction. Consumers can use them without another copy.
+ *          If the file can't be mapped(pipe, network share, ...), the constructor reads it into a heap buffer.
+ *
+ * @see https://man7.org/linux/man-pages/man2/mmap.2.html
+ * @see https://man7.org/linux/man-pages/man2/madvise.2.html
+ * @see MapViewOfFile https://docs.microsoft.com/en-us/windows/win32/api/memoryapi/nf-memoryapi-mapviewoffile
+ */
+class _INTERFACE_ mapped_file_t final {
+  public:
+    /// @see MADV_SEQUENTIAL, MADV_RANDOM, MADV_WILLNEED
+    enum class access_hint_t : uint8_t {
+        sequential, // read once from the beginning. shaders, images
+        random,     // seek by offsets. glTF buffers
+        willneed,   // prefetch the whole file now
+    };
+
+  private:
+    gsl::owner<void*> mapping = nullptr;
+    std::unique_ptr<std::byte[]> buffer{}; // buffered fallback
+    size_t length = 0;
+    uint32_t ec = 0;
+
+  public:
+    explicit mapped_file_t(const std::filesystem::path& p,
+                           access_hint_t hint = access_hint_t::sequential) noexcept;
+    ~mapped_file_t() noexcept;
+    mapped_file_t(mapped_file_t const&) = delete;
+    mapped_file_t& operator=(mapped_file_t const&) = delete;
+    mapped_file_t(mapped_file_t&&) = delete;
+    mapped_file_t& operator=(mapped_file_t&&) = delete;
+
+    /**
+     * @brief check whether the construction was successful
+     * @return uint32_t cached `errno`(or `GetLastError`) from the constructor
+     */
+    uint32_t is_valid() const noexcept;
+
+    /// @return false if the bytes are from the buffered fallback
+    bool is_mapped() const noexcept;
+
+    /// @note empty if the file is empty or the construction failed
+    gsl::span<const std::byte> bytes() const noexcept;
+};
+
+/**
+ * @param bytes valid only in the callback. The buffer goes back to the pool when the callback returns
+ * @param ec    0 if successful. Else, `errno`(or `GetLastError`) of the failed operation
+ */
+using file_callback_t = void (*)(void* user_data, gsl::span<const std::byte> bytes, uint32_t ec);
+
+/**
+ * @brief Asynchronous whole-file reader. `io_uring` on Linux, worker threads for the others.
+ * @details `submit` only queues the request. `flush` sends the queued requests in one batch.
+ *          The callbacks are invoked in the loader's thread as soon as each file is read,
+ *          so the decoding/staging of a file can start while the others are still being read.
+ *          The buffers are page-aligned and reused by their size class.
+ *
+ * @note  `io_uring` is used if `io_uring_setup` is allowed(no privilege is required).
+ *        If the kernel/seccomp rejects it, the loader falls back to the worker threads.
+ * @see   https://kernel.dk/io_uring.pdf
+ */
+class _INTERFACE_ file_loader_t final {
+  public:
+    struct impl_t;
+
+  private:
+    std::unique_ptr<impl_t> impl;
+    uint32_t ec = 0;
+
+  public:
+    /**
+     * @param queue_depth   max number of the reads in flight
+     * @param use_io_uring  false to use the worker threads always
+     */
+    explicit file_loader_t(uint32_t queue_depth = 64, bool use_io_uring = true) noexcept;
+    /// @note waits for all submitted requests
+    ~file_loader_t() noexcept;
+    file_loader_t(file_loader_t const&) = delete;
+    file_loader_t& operator=(file_loader_t const&) = delete;
+    file_loader_t(file_loader_t&&) = delete;
+    file_loader_t& operator=(file_loader_t&&) = delete;
+
+    /**
+     * @brief check whether the construction was successful
+     * @return uint32_t cached `errno` from the constructor
+     */
+    uint32_t is_valid() const noexcept;
+
+    /// @return true if the reads are done by `io_uring`
+    bool is_async_io() const noexcept;
+
+    /**
+     * @brief Queue a read request. It is not started until `flush`
+     * @return uint32_t `EINVAL` if `callback` is null. `is_valid()` if the construction failed
+     */
+    uint32_t submit(const std::filesystem::path& p, file_callback_t callback, void* user_data) noexcept;
+
+    /**
+     * @brief Start the queued requests in a batch
+     * @details If `io_uring_enter` failed here or in the loader's thread, all flushed requests are completed with
+     *          its error and the later `flush` fails with it
+     * @return uint32_t redirected from `io_uring_enter`. `is_valid()` if the construction failed
+     */
+    uint32_t flush() noexcept;
+
+    /// @brief `flush` and block until all callbacks are returned
+    void wait() noexcept;
+};
+
+/**
+ * @brief Encoded image -> RGBA8 pixels. The library doesn't have its own decoder.
+ *        The functions may be invoked in the worker threads
+ * @see   stbi_info_from_memory
+ * @see   stbi_load_from_memory
+ */
+struct image_codec_t final {
+    /// @return uint32_t 0 if successful
+    uint32_t (*get_info)(gsl::span<const std::byte> encoded, uint32_t& width, uint32_t& height);
+    /**
+     * @param pixels  `width * height * 4` bytes. Can be a mapped staging memory
+     * @return uint32_t 0 if successful
+     */
+    uint32_t (*decode)(gsl::span<const std::byte> encoded, gsl::span<std::byte> pixels);
+};
+
+/// @brief Number of the levels in the full mip chain. `floor(log2(max(width, height))) + 1`
+_INTERFACE_ uint32_t count_mip_levels(uint32_t width, uint32_t height) noexcept;
+
+/**
+ * @brief Allocate immutable storage of the GL_TEXTURE_2D
+ * @param mipmap    allocate the full mip chain and use the trilinear filter for minification.
+ *                  Fill the level 0, then use `generate_mipmap`
+ * @see glTexStorage2D
+ */
+_INTERFACE_ GLenum make_texture_storage(GLuint tex2d, GLenum internal_format, GLsizei width, GLsizei height,
+                                        bool mipmap) noexcept;
+
+/**
+ * @brief Generate the levels 1+ of the GL_TEXTURE_2D from its level 0
+ * @see glGenerateMipmap
+ */
+_INTERFACE_ GLenum generate_mipmap(GLuint tex2d) noexcept;
+
+/**
+ * @brief Texel formats for `encode_blocks`. The compressed ones use 16 bytes for each 4x4 block
+ * @see https://www.khronos.org/registry/DataFormat/specs/1.3/dataformat.1.3.html
+ */
+enum class block_format_t : uint32_t {
+    rgba8 = 0,      ///< not compressed. 4 bytes for each texel
+    etc2_rgba8 = 1, ///< ETC2 color + EAC alpha. Required by OpenGL ES 3.0
+    bc3 = 2,        ///< BC1 color + BC4 alpha. a.k.a. DXT5
+};
+
+/// @return size_t bytes of the `width * height` image in the format. The partial blocks are counted
+_INTERFACE_ size_t get_block_size(block_format_t format, uint32_t width, uint32_t height) noexcept;
+
+/**
+ * @brief Compress RGBA pixels on CPU.
+ * @details The ETC2 encoder only uses the ETC1 modes(individual/differential) with an exhaustive table search.
+ *          The BC1 encoder uses the principal axis of each block for the endpoints.
+ *          The edge of the image is repeated to fill the partial blocks
+ * @param pixels    `width * height * 4` bytes
+ * @param blocks    `get_block_size` bytes
+ * @return uint32_t `EINVAL` if the spans are too small
+ */
+_INTERFACE_ uint32_t encode_blocks(block_format_t format, gsl::span<const std::byte> pixels, //
+                                   uint32_t width, uint32_t height, gsl::span<std::byte> blocks) noexcept;
+
+/**
+ * @brief Restore RGBA pixels from the blocks. For the quality check, or the devices without the format
+ * @return uint32_t `EINVAL` if the spans are too small. `EBADMSG` for the modes `encode_blocks` doesn't use
+ */
+_INTERFACE_ uint32_t decode_blocks(block_format_t format, gsl::span<const std::byte> blocks, //
+                                   uint32_t width, uint32_t height, gsl::span<std::byte> pixels) noexcept;
+
+/// @brief 64 bit FNV-1a of the bytes
+_INTERFACE_ uint64_t hash_content(gsl::span<const std::byte> bytes, uint64_t seed = 0xcbf2'9ce4'8422'2325) noexcept;
+
+/**
+ * @brief Write the parts to `{dst}.tmp` and rename it to the `dst`. The readers of the `dst` never see a partial file
+ * @note  The `.tmp` is removed if the write or the rename failed
+ * @return uint32_t `errno` of the `fopen`/`fwrite`/`fclose`, or the error of the rename
+ */
+_INTERFACE_ uint32_t write_and_rename(const std::filesystem::path& dst,
+                                      std::initializer_list<gsl::span<const std::byte>> parts) noexcept;
+
+/**
+ * @brief Disk cache of the `encode_blocks` results. The key is the hash of the image file's content
+ * @details Each entry is a file with `header_t` and the blocks. The entries are written to a temporary file and
+ *          renamed, so a reader never sees a partial entry. Entries with other `version` are ignored
+ */
+class _INTERFACE_ block_cache_t final {
+  public:
+    static constexpr uint32_t version = 1;
+
+    struct header_t final {
+        uint32_t version;
+        block_format_t format;
+        uint32_t width;
+        uint32_t height;
+    };
+
+  private:
+    std::filesystem::path directory;
+    uint32_t ec = 0;
+
+  public:
+    uint32_t hit = 0;
+    uint32_t miss = 0;
+
+  public:
+    /// @param directory    created if not exists
+    explicit block_cache_t(const std::filesystem::path& directory) noexcept;
+    block_cache_t(block_cache_t const&) = delete;
+    block_cache_t& operator=(block_cache_t const&) = delete;
+    block_cache_t(block_cache_t&&) = delete;
+    block_cache_t& operator=(block_cache_t&&) = delete;
+
+    /**
+     * @brief check whether the construction was successful
+     * @return uint32_t cached `errno` from the constructor
+     */
+    uint32_t is_valid() const noexcept;
+
+    std::filesystem::path get_path(uint64_t key, block_format_t format) const noexcept(false);
+
+    /**
+     * @param blocks    mapping of the entry. The blocks start at `sizeof(header_t)`
+     * @return uint32_t `ENOENT` if there is no entry. `EBADMSG` if the entry is broken or from other version
+     */
+    uint32_t load(uint64_t key, block_format_t format, //
+                  header_t& header, std::unique_ptr<mapped_file_t>& blocks) noexcept;
+
+    /// @return uint32_t 0 if successful. Else, redirected from the file I/O
+    uint32_t store(uint64_t key, const header_t& header, gsl::span<const std::byte> blocks) noexcept;
+
+    /**
+     * @brief `load` the entry of the image file. If missing, decode/encode the image then `store` it
+     * @return uint32_t 0 if successful. Else, from the `codec` or the file I/O
+     */
+    uint32_t load_or_encode(const std::filesystem::path& image, block_format_t format, const image_codec_t& codec,
+                            header_t& header, std::unique_ptr<mapped_file_t>& blocks) noexcept;
+};
+
+/// @return GLenum internal format for `glTexStorage2D`. `GL_RGBA8` for `block_format_t::rgba8`
+_INTERFACE_ GLenum get_gl_format(block_format_t format) noexcept;
+
+/**
+ * @brief The block format for the current context. BC3 is preferred because ETC2 is emulated by the most desktop drivers
+ * @see GL_EXT_texture_compression_s3tc
+ */
+_INTERFACE_ block_format_t select_block_format() noexcept;
+
+/**
+ * @brief Fill the level 0 of the texture from `make_texture_storage(tex2d, get_gl_format(format), ...)`
+ * @note  `glGenerateMipmap` doesn't work with the compressed formats
+ * @see glCompressedTexSubImage2D
+ */
+_INTERFACE_ GLenum upload_blocks(GLuint tex2d, block_format_t format, GLsizei width, GLsizei height,
+                                 gsl::span<const std::byte> blocks) noexcept;
+
+/**
+ * @brief Disk cache of the linked program binaries. The key is the hash of the shader sources and the driver identity
+ * @details The driver identity is the hash of `GL_VENDOR`, `GL_RENDERER` and `GL_VERSION`.
+ *          If `glProgramBinary` rejects an entry(driver update, other binary format), the program is compiled again
+ *          and the entry is replaced. The entries are written to a temporary file and renamed like `block_cache_t`
+ * @note    Use the cache in the context which was current for the constructor, or in its share group
+ * @see     glGetProgramBinary
+ * @see     GL_OES_get_program_binary
+ */
+class _INTERFACE_ program_cache_t final {
+  public:
+    static constexpr uint32_t version = 1;
+
+    struct header_t final {
+        uint32_t version;
+        GLenum format; // from `glGetProgramBinary`
+        uint64_t driver;
+    };
+
+  private:
+    std::filesystem::path directory;
+    uint64_t driver = 0;
+    uint32_t ec = 0;
+
+  public:
+    uint32_t hit = 0;
+    uint32_t miss = 0;
+
+  public:
+    /// @param directory    created if not exists
+    explicit program_cache_t(const std::filesystem::path& directory) noexcept;
+    program_cache_t(program_cache_t const&) = delete;
+    program_cache_t& operator=(program_cache_t const&) = delete;
+    program_cache_t(program_cache_t&&) = delete;
+    program_cache_t& operator=(program_cache_t&&) = delete;
+
+    /**
+     * @brief check whether the construction was successful
+     * @return uint32_t cached `errno` from the constructor. `ENOTSUP` if the context has no program binary format
+     */
+    uint32_t is_valid() const noexcept;
+
+    /// @return uint64_t hash of the vertex/fragment shader sources and the driver identity
+    uint64_t make_key(std::string_view vs, std::string_view fs) const noexcept;
+
+    std::filesystem::path get_path(uint64_t key) const noexcept(false);
+
+    /**
+     * @param program   `glProgramBinary` target. It is linked if successful
+     * @return uint32_t `ENOENT` if there is no entry. `EBADMSG` if the entry is broken or from other version/driver.
+     *                  `EINVAL` if the driver rejected the binary
+     */
+    uint32_t load(uint64_t key, GLuint program) noexcept;
+
+    /// @param program  linked with `GL_PROGRAM_BINARY_RETRIEVABLE_HINT`
+    /// @return uint32_t 0 if successful. `EINVAL` if `glGetProgramBinary` failed. Else, from the file I/O
+    uint32_t store(uint64_t key, GLuint program) noexcept;
+
+    /**
+     * @brief `load` the program. If missing or rejected, compile/link the sources then `store` it
+     * @param message   info log of the shader or the program if the build failed
+     * @return uint32_t 0 if successful. `EINVAL` if the build failed
+     */
+    uint32_t load_or_build(GLuint program, std::string_view vs, std::string_view fs, std::string& message) noexcept;
+};
+
+/**
+ * @brief Compile/link many programs without waiting for each of them. The link status is queried on the first use
+ * @details With `GL_KHR_parallel_shader_compile`, `glCompileShader`/`glLinkProgram` return right away and
+ *          `GL_COMPLETION_STATUS_KHR` is polled without blocking.
+ *          Without the extension, the worker threads build the programs with the contexts shared with
+ *          the current one. Each worker signals a fence after the link, and `is_completed` polls it.
+ * @note    Use the builder in the thread which was current for the constructor.
+ *          The programs are not deleted by the builder
+ * @see     https://registry.khronos.org/OpenGL/extensions/KHR/KHR_parallel_shader_compile.txt
+ */
+class _INTERFACE_ program_builder_t final {
+  public:
+    struct impl_t;
+
+  private:
+    std::unique_ptr<impl_t> impl;
+    uint32_t ec = 0;
+
+  public:
+    /**
+     * @param display       for the shared contexts. The context of the current thread is shared
+     * @param num_workers   number of the shared contexts. `std::thread::hardware_concurrency` if 0
+     * @param use_extension false to use the shared contexts always
+     */
+    explicit program_builder_t(EGLDisplay display, uint32_t num_workers = 0, bool use_extension = true) noexcept;
+    /// @note waits for the workers. The programs which are not completed may remain unlinked
+    ~program_builder_t() noexcept;
+    program_builder_t(program_builder_t const&) = delete;
+    program_builder_t& operator=(program_builder_t const&) = delete;
+    program_builder_t(program_builder_t&&) = delete;
+    program_builder_t& operator=(program_builder_t&&) = delete;
+
+    /**
+     * @brief check whether the construction was successful
+     * @return uint32_t cached error from the constructor. `EGL_BAD_CONTEXT` if no context is current
+     */
+    uint32_t is_valid() const noexcept;
+
+    /// @return true if `GL_KHR_parallel_shader_compile` is used instead of the shared contexts
+    bool is_parallel_compile() const noexcept;
+
+    /**
+     * @brief Create a program and start to compile/link the sources. The sources are copied
+     * @return uint32_t `ENOMEM` if the sources can't be copied
+     */
+    uint32_t submit(std::string_view vs, std::string_view fs, GLuint& program) noexcept;
+
+    /// @return true if the compile/link of the program is done. Never blocks
+    bool is_completed(GLuint program) noexcept;
+
+    /**
+     * @brief The link status. It blocks if the program is not completed, and is cached after the first query
+     * @param message   info log of the shader or the program if the build failed
+     * @return uint32_t 0 if linked. `EINVAL` if the build failed. `ENOENT` if the program is not from `submit`
+     */
+    uint32_t get_status(GLuint program, std::string& message) noexcept;
+};
+
+/**
+ * @brief Strided view of a glTF accessor. The memory is owned by the loader
+ * @see https://github.com/KhronosGroup/glTF/tree/main/specification/2.0#accessors
+ */
+struct _INTERFACE_ accessor_view_t final {
+    const std::byte* data = nullptr;
+    uint32_t count = 0;        ///< number of the elements
+    uint32_t stride = 0;       ///< bytes between the elements. 0 if tightly packed
+    GLenum component_type = 0; ///< `GL_FLOAT`, `GL_UNSIGNED_BYTE`, `GL_UNSIGNED_SHORT`, `GL_UNSIGNED_INT` ...
+    uint32_t components = 0;   ///< 1 for SCALAR, 3 for VEC3 ...
+    bool normalized = false;
+
+    /// @return float the component. The integers are normalized if `normalized`
+    float get(uint32_t index, uint32_t component) const noexcept;
+    /// @return uint32_t the component of the integer accessor. (ex: indices)
+    uint32_t get_index(uint32_t index) const noexcept;
+};
+
+/**
+ * @brief Meshes packed into 1 interleaved vertex buffer and 1 index buffer
+ * @details The vertex is `float position[3]`, `int16_t normal[4]`(SNORM, w is 0) and the UV in `uv_format`.
+ *          The indices of each range are relative to its `vertex_offset`, so 16 bit is enough
+ *          unless a primitive has more than 65535 vertices
+ */
+struct _INTERFACE_ packed_scene_t final {
+    enum class uv_format_t : uint32_t {
+        unorm16 = 0, ///< all UVs are in [0, 1]
+        float16 = 1, ///< half float is close enough. (ex: tiled UVs)
+        float32 = 2,
+    };
+    struct draw_range_t final {
+        uint32_t first_index;
+        uint32_t index_count;
+        int32_t vertex_offset;
+        uint32_t vertex_count;
+        uint32_t mesh;
+        int32_t material; ///< -1 if the primitive has no material
+    };
+    /// @brief A node which uses the mesh
+    struct instance_t final {
+        uint32_t mesh;
+        float transform[16]; ///< column major, world space
+    };
+
+    std::vector<std::byte> vertices{};
+    std::vector<std::byte> indices{};
+    uint32_t stride = 0;     ///< bytes of a vertex
+    uint32_t uv_offset = 20; ///< bytes from the start of a vertex
+    uv_format_t uv_format = uv_format_t::unorm16;
+    uint32_t index_size = 2; ///< 2 or 4
+    std::vector<draw_range_t> ranges{};
+    std::vector<instance_t> instances{};
+
+    /// @return size_t bytes of the vertices in the `ranges`
+    size_t get_vertex_bytes() const noexcept;
+    /// @return size_t bytes of the indices in the `ranges`
+    size_t get_index_bytes() const noexcept;
+};
+
+/**
+ * @brief Collect the primitives then `pack` them. The views are read only in `pack`
+ * @code
+ *  mesh_packer_t packer{};
+ *  packer.add(mesh, material, positions, normals, uvs, indices);
+ *  packed_scene_t scene{};
+ *  packer.pack(scene);
+ * @endcode
+ */
+class _INTERFACE_ mesh_packer_t final {
+    struct primitive_t final {
+        uint32_t mesh;
+        int32_t material;
+        accessor_view_t positions, normals, uvs, indices;
+    };
+    std::vector<primitive_t> primitives{};
+
+  public:
+    /**
+     * @param normals   empty `count` if missing. (0, 0, 1) is used
+     * @param uvs       empty `count` if missing. (0, 0) is used
+     * @param indices   empty `count` for the non-indexed primitive
+     * @return uint32_t `EINVAL` if the positions are not VEC3 or the counts are not matching
+     */
+    uint32_t add(uint32_t mesh, int32_t material, const accessor_view_t& positions, const accessor_view_t& normals,
+                 const accessor_view_t& uvs, const accessor_view_t& indices) noexcept(false);
+
+    /**
+     * @brief The formats and the `ranges` of the `scene`. Its `vertices`/`indices` are not touched
+     * @param uv_tolerance  `uv_format_t::float16` is used if the error of all UVs is less than this
+     * @return uint32_t `EINVAL` if the counts are too large. `ENOMEM` from the allocation
+     */
+    uint32_t layout(packed_scene_t& scene, float uv_tolerance = 1.0f / 8192) const noexcept;
+
+    /**
+     * @brief Write the vertices/indices of the `layout` result. (ex: into the mapped staging memory)
+     * @return uint32_t `EINVAL` if the spans are too small or there is an index out of the vertex range
+     */
+    uint32_t write(const packed_scene_t& scene, gsl::span<std::byte> vertices,
+                   gsl::span<std::byte> indices) const noexcept;
+
+    /// @brief `layout` + `write` into the `scene`
+    uint32_t pack(packed_scene_t& scene, float uv_tolerance = 1.0f / 8192) const noexcept;
+};
+
+/**
+ * @brief glTF 2.0 document with the buffers in `mapped_file_t`
+ * @details For .glb, the file is mapped and only the JSON chunk is parsed. The buffers are spans into the BIN chunk
+ *          of the mapping, so the binary is never copied to the heap. The external buffers(.bin) are mapped too.
+ *          Only the `data:` URIs are decoded into the memory
+ * @note    The views from the getters are valid while the object is alive
+ * @see https://github.com/KhronosGroup/glTF/tree/main/specification/2.0#glb-file-format-specification
+ */
+class _INTERFACE_ gltf_file_t final {
+  public:
+    struct impl_t;
+
+  private:
+    std::unique_ptr<impl_t> impl;
+    uint32_t ec = 0;
+
+  public:
+    explicit gltf_file_t(const std::filesystem::path& fpath) noexcept;
+    ~gltf_file_t() noexcept;
+    gltf_file_t(gltf_file_t const&) = delete;
+    gltf_file_t& operator=(gltf_file_t const&) = delete;
+    gltf_file_t(gltf_file_t&&) = delete;
+    gltf_file_t& operator=(gltf_file_t&&) = delete;
+
+    /**
+     * @brief check whether the construction was successful
+     * @return uint32_t cached `errno` from the constructor. `EBADMSG` if the file is not glTF 2.0
+     */
+    uint32_t is_valid() const noexcept;
+
+    /// @return uint32_t `EINVAL` if the index is out of range
+    uint32_t get_buffer(uint32_t index, gsl::span<const std::byte>& bytes) const noexcept;
+    /// @return uint32_t `EINVAL` if the index or the range is out of the buffer
+    uint32_t get_buffer_view(uint32_t index, gsl::span<const std::byte>& bytes) const noexcept;
+    /// @return uint32_t `EINVAL` if the index or the range is out of the buffer view. `ENOTSUP` for sparse accessor
+    uint32_t get_accessor(uint32_t index, accessor_view_t& view) const noexcept;
+
+    /// @brief `mesh_packer_t::add` the triangle primitives of all meshes. The broken ones are skipped
+    /// @return uint32_t number of the skipped primitives
+    uint32_t add_meshes(mesh_packer_t& packer) const noexcept(false);
+    /// @brief The nodes of the default scene which have a mesh. If there is no default, the first scene
+    void get_instances(std::vector<packed_scene_t::instance_t>& instances) const noexcept(false);
+};
+
+/**
+ * @brief Load the meshes and the node transforms of the default scene from .glb/.gltf file
+ * @details Only the triangle primitives are used. The images are not decoded
+ * @return uint32_t `ENOENT` if the file is missing. `EBADMSG` if the parser failed. See `message`
+ * @see gltf_file_t
+ */
+_INTERFACE_ uint32_t load_gltf(const std::filesystem::path& fpath, packed_scene_t& scene,
+                               std::string& message) noexcept;
+
+/**
+ * @brief Simulation of the post-transform vertex cache. FIFO like the most GPUs
+ * @see https://tomforsyth1000.github.io/papers/fast_vert_cache_opt.html
+ */
+struct _INTERFACE_ vertex_cache_stats_t final {
+    uint32_t transformed = 0; ///< simulated cache misses. Not the measured vertex shader invocations
+    uint32_t triangles = 0;
+    uint32_t vertices = 0; ///< unique vertices in the indices
+    float acmr = 0;        ///< average cache miss ratio. `transformed` / `triangles`. 0.5 ~ 3.0
+    float atvr = 0;        ///< average transform to vertex ratio. `transformed` / `vertices`. 1.0 is the best
+};
+
+/// @note The indices out of `vertex_count` are ignored
+_INTERFACE_ vertex_cache_stats_t get_vertex_cache_stats(gsl::span<const uint32_t> indices, uint32_t vertex_count,
+                                                        uint32_t cache_size = 16) noexcept(false);
+
+/**
+ * @brief Reorder the triangles for the post-transform vertex cache. Tipsify
+ * @details Fan around the vertex which will stay longest in the cache. At the dead-end, continue from the recently
+ *          used vertices, then from the input order. The winding of each triangle is kept
+ * @return uint32_t `EINVAL` if the size is not multiple of 3 or an index is out of `vertex_count`
+ * @see Sander et al. "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw", SIGGRAPH 2007
+ */
+_INTERFACE_ uint32_t optimize_vertex_cache(gsl::span<uint32_t> indices, uint32_t vertex_count,
+                                           uint32_t cache_size = 16) noexcept(false);
+
+/**
+ * @brief Reorder the clusters of the triangles so the outer, front-facing ones are drawn first
+ * @details Use after `optimize_vertex_cache`. The clusters start where the cache is flushed(3 misses),
+ *          and are split further while their ACMR stays under `threshold` x the cluster's ACMR.
+ *          Then they are sorted by `dot(cluster centroid - mesh centroid, cluster normal)`
+ * @param positions  float3 of the vertices
+ * @return uint32_t `EINVAL` if an index is out of `positions`
+ */
+_INTERFACE_ uint32_t optimize_overdraw(gsl::span<uint32_t> indices, const accessor_view_t& positions,
+                                       float threshold = 1.05f, uint32_t cache_size = 16) noexcept(false);
+
+/**
+ * @brief Renumber the vertices in the order of the first use, so the vertex fetch is sequential
+ * @param remap  `remap[old] == new`. The unused vertices are `UINT32_MAX`
+ * @param used   number of the vertices in the indices
+ * @return uint32_t `EINVAL` if an index is out of `vertex_count`
+ */
+_INTERFACE_ uint32_t optimize_vertex_fetch(gsl::span<uint32_t> indices, uint32_t vertex_count,
+                                           std::vector<uint32_t>& remap, uint32_t& used) noexcept(false);
+
+/**
+ * @brief `optimize_vertex_cache`, `optimize_overdraw`, `optimize_vertex_fetch` for each range of the scene
+ * @details The vertices are moved only in their range, so the `ranges` are not changed.
+ *          The unused vertices go to the end of the range
+ * @param before    stats of the input. Sum of the ranges
+ * @param after     stats of the output
+ * @return uint32_t `EINVAL` if the scene is broken
+ */
+_INTERFACE_ uint32_t optimize_scene(packed_scene_t& scene, vertex_cache_stats_t& before, vertex_cache_stats_t& after,
+                                    uint32_t cache_size = 16) noexcept(false);
+
+/**
+ * @brief Disk cache of the `optimize_scene` results. The key is the hash of the input scene
+ * @details Each entry is a file with `header_t`, the ranges, the vertices and the indices.
+ *          The entries are written to a temporary file and renamed like `block_cache_t`
+ */
+class _INTERFACE_ mesh_cache_t final {
+  public:
+    static constexpr uint32_t version = 1;
+
+    struct header_t final {
+        uint32_t version;
+        uint32_t cache_size;
+        uint32_t stride;
+        uint32_t index_size;
+        uint64_t range_count;
+        uint64_t vertex_bytes;
+        uint64_t index_bytes;
+        vertex_cache_stats_t before;
+        vertex_cache_stats_t after;
+    };
+
+  private:
+    std::filesystem::path directory;
+    uint32_t ec = 0;
+
+  public:
+    uint32_t hit = 0;
+    uint32_t miss = 0;
+
+  public:
+    /// @param directory    created if not exists
+    explicit mesh_cache_t(const std::filesystem::path& directory) noexcept;
+    mesh_cache_t(mesh_cache_t const&) = delete;
+    mesh_cache_t& operator=(mesh_cache_t const&) = delete;
+    mesh_cache_t(mesh_cache_t&&) = delete;
+    mesh_cache_t& operator=(mesh_cache_t&&) = delete;
+
+    /**
+     * @brief check whether the construction was successful
+     * @return uint32_t cached `errno` from the constructor
+     */
+    uint32_t is_valid() const noexcept;
+
+    std::filesystem::path get_path(uint64_t key) const noexcept(false);
+
+    /// @return uint64_t hash of the vertices, the indices, the ranges and the `cache_size`
+    static uint64_t make_key(const packed_scene_t& scene, uint32_t cache_size) noexcept;
+
+    /**
+     * @brief Replace the ranges, the vertices and the indices of the `scene` with the entry
+     * @return uint32_t `ENOENT` if there is no entry. `EBADMSG` if the entry is broken or doesn't fit to the `scene`
+     */
+    uint32_t load(uint64_t key, header_t& header, packed_scene_t& scene) noexcept;
+
+    /// @return uint32_t 0 if successful. Else, redirected from the file I/O
+    uint32_t store(uint64_t key, const header_t& header, const packed_scene_t& scene) noexcept;
+
+    /**
+     * @brief `load` the entry of the scene. If missing, `optimize_scene` then `store` it
+     * @param header    `before` and `after` are the report of the optimization
+     */
+    uint32_t load_or_optimize(packed_scene_t& scene, header_t& header, uint32_t cache_size = 16) noexcept;
+};
+
+/**
+ * @brief Cluster of the triangles in a draw range with the bounds for the culling
+ * @see https://gpuopen.com/learn/mesh_shaders/mesh_shaders-optimization_and_best_practices/
+ */
+struct _INTERFACE_ meshlet_t final {
+    uint32_t first_index;  ///< in the `packed_scene_t::indices`
+    uint32_t index_count;  ///< 3 x triangles
+    int32_t vertex_offset; ///< same with the range's
+    uint32_t range;        ///< index of the `packed_scene_t::ranges`
+    float center[3];       ///< bounding sphere in the mesh space
+    float radius;
+    float cone_axis[3]; ///< average normal of the triangles
+    float cone_cutoff;  ///< sin of the normal spread. 1 if the normals are too spread to cull
+};
+
+/**
+ * @brief Split the ranges into the meshlets. The triangles are taken in the index order, so the index buffer is
+ *        not changed and a meshlet is a sub-range of its draw range. Use after `optimize_scene` for the locality
+ * @param max_vertices  unique vertices in a meshlet
+ * @return uint32_t `EINVAL` if the scene is broken or the limits are too small
+ */
+_INTERFACE_ uint32_t build_meshlets(const packed_scene_t& scene, std::vector<meshlet_t>& meshlets,
+                                    uint32_t max_vertices = 64, uint32_t max_triangles = 124) noexcept(false);
+
+/// @brief Same layout with `VkDrawIndexedIndirectCommand` and `DrawElementsIndirectCommand`
+struct _INTERFACE_ draw_indexed_command_t final {
+    uint32_t index_count;
+    uint32_t instance_count;
+    uint32_t first_index;
+    int32_t vertex_offset;
+    uint32_t first_instance;
+};
+
+/// @brief The world space planes of the view volume and the camera position
+struct _INTERFACE_ frustum_t final {
+    float planes[6][4]; ///< (a, b, c, d). Inside if `a * x + b * y + c * z + d >= 0`
+    float camera[3];
+};
+
+/**
+ * @brief Gribb/Hartmann planes from the column major view-projection matrix
+ * @note  The near plane is `z >= -w`. For the [0, 1] depth range(Vulkan, D3D), it is a bit conservative
+ */
+_INTERFACE_ void make_frustum(const float (&view_projection)[16], const float (&camera)[3],
+                              frustum_t& frustum) noexcept;
+
+/**
+ * @brief Per-frame frustum/backface culling of the meshlets for all `packed_scene_t::instances`
+ * @details The instances are split into chunks and the worker threads take them. Each chunk writes its own
+ *          commands, then they are joined in the instance order. The adjacent visible meshlets of an instance are
+ *          merged into 1 command. The caller's thread works together while it waits for the workers.
+ *          The instance is tested with the sphere of the whole range first, then with each meshlet
+ * @note    Use `cull` from 1 thread at a time
+ */
+class _INTERFACE_ meshlet_culler_t final {
+  public:
+    struct impl_t;
+
+  private:
+    std::unique_ptr<impl_t> impl;
+    uint32_t ec = 0;
+
+  public:
+    uint32_t tested = 0;  ///< meshlets x instances in the last `cull`
+    uint32_t visible = 0; ///< meshlets passed the last `cull`
+
+  public:
+    /// @param num_threads  with the caller's thread. `std::thread::hardware_concurrency` if 0
+    explicit meshlet_culler_t(uint32_t num_threads = 0) noexcept;
+    ~meshlet_culler_t() noexcept;
+    meshlet_culler_t(meshlet_culler_t const&) = delete;
+    meshlet_culler_t& operator=(meshlet_culler_t const&) = delete;
+    meshlet_culler_t(meshlet_culler_t&&) = delete;
+    meshlet_culler_t& operator=(meshlet_culler_t&&) = delete;
+
+    /**
+     * @brief check whether the construction was successful
+     * @return uint32_t cached `errno` from the constructor
+     */
+    uint32_t is_valid() const noexcept;
+
+    /**
+     * @param meshlets  from `build_meshlets` of the `scene`
+     * @param commands  `first_instance` is the index of the `scene.instances`
+     * @return uint32_t `EINVAL` if a meshlet is out of the `scene.ranges`
+     */
+    uint32_t cull(const packed_scene_t& scene, gsl::span<const meshlet_t> meshlets, const frustum_t& frustum,
+                  std::vector<draw_indexed_command_t>& commands) noexcept(false);
+};
+
+/**
+ * @brief A range of an instance for the GPU culling. The storage buffer element of `vulkan_indirect_culler_t`
+ * @note  std430 layout. 32 bytes
+ */
+struct _INTERFACE_ draw_object_t final {
+    float center[3]; ///< bounding sphere in the world space
+    float radius;
+    uint32_t index_count;
+    uint32_t first_index;
+    int32_t vertex_offset;
+    uint32_t instance; ///< index of the `packed_scene_t::instances`. `first_instance` of the command
+};
+
+/**
+ * @brief 1 object for each range of each instance. The sphere is from the box of the range's vertices
+ * @return uint32_t `EINVAL` if the scene is broken
+ */
+_INTERFACE_ uint32_t make_draw_objects(const packed_scene_t& scene,
+                                       std::vector<draw_object_t>& objects) noexcept(false);
+
+/**
+ * @brief The CPU reference of the GPU culling. The visible objects in their order
+ * @note  `vulkan_indirect_culler_t` writes the same commands, but the order depends on the GPU
+ */
+_INTERFACE_ void cull_draw_objects(gsl::span<const draw_object_t> objects, const frustum_t& frustum,
+                                   std::vector<draw_indexed_command_t>& commands) noexcept(false);
+
 #if __has_include(<d3d11.h>)
 
 /**
@@ -3,10 +3,11 @@
  */
 #include <graphics.h>
 #include <spdlog/spdlog.h>
+
+#include "trace.h"
 #if __has_include(<EGL/eglext_angle.h>)
 #include <EGL/eglext_angle.h>
 #endif
-#include <winrt/base.h>
 
 #define report_error_code(fname, ec) spdlog::error("{}: {:#x}", fname, ec);
 
@@ -36,8 +37,15 @@ EGLint get_configs(EGLDisplay display, EGLConfig* configs, EGLint& count, const
                           EGL_DEPTH_SIZE,      depth_size,         EGL_NONE};
     if (attrs == nullptr)
         attrs = backup_attrs;
-    if (eglChooseConfig(display, attrs, configs, count, &count) == EGL_FALSE)
+    const auto capacity = count;
+    if (eglChooseConfig(display, attrs, configs, capacity, &count) == EGL_FALSE)
         return eglGetError();
+    // headless platforms (e.g. EGL_PLATFORM=surfaceless) don't have EGL_WINDOW_BIT
+    if (count == 0 && attrs == backup_attrs) {
+        backup_attrs[3] = EGL_PBUFFER_BIT;
+        if (eglChooseConfig(display, attrs, configs, capacity, &count) == EGL_FALSE)
+            return eglGetError();
+    }
     return 0;
 }
 
@@ -67,13 +75,13 @@ EGLSurface egl_surface_owner_t::handle() const noexcept {
 }
 
 egl_context_t::egl_context_t(EGLDisplay display, EGLContext share_context) noexcept : display{display} {
-    spdlog::debug(__FUNCTION__);
+    SPDLOG_DEBUG(__FUNCTION__);
     if (eglInitialize(display, versions + 0, versions + 1) == false) {
         auto ec = eglGetError();
         report_error_code("eglInitialize", ec);
         return;
     }
-    spdlog::debug("EGLDisplay {} {}.{}", display, versions[0], versions[1]);
+    SPDLOG_DEBUG("EGLDisplay {} {}.{}", display, versions[0], versions[1]);
 
     // acquire EGLConfigs
     EGLint num_config = 1;
@@ -85,21 +93,22 @@ egl_context_t::egl_context_t(EGLDisplay display, EGLContext share_context) noexc
     // create context for OpenGL ES 3.0+
     EGLint attrs[]{EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 0, EGL_NONE};
     if (context = eglCreateContext(display, configs[0], share_context, attrs); context != EGL_NO_CONTEXT)
-        spdlog::debug("EGL create: context {} {}", context, share_context);
+        SPDLOG_DEBUG("EGL create: context {} {}", context, share_context);
 }
 
 egl_context_t::~egl_context_t() noexcept {
-    spdlog::debug(__FUNCTION__);
+    SPDLOG_DEBUG(__FUNCTION__);
     destroy();
 }
 
 EGLint egl_context_t::resume(EGLSurface es_surface, EGLConfig) noexcept {
+    TRACE_SCOPE("egl_context_t::resume");
     if (context == EGL_NO_CONTEXT)
         return EGL_NOT_INITIALIZED;
     if (es_surface == EGL_NO_SURFACE)
         return GL_INVALID_VALUE;
     surface = es_surface;
-    spdlog::debug("EGL current: {}/{} {}", surface, surface, context);
+    SPDLOG_DEBUG("EGL current: {}/{} {}", surface, surface, context);
     if (eglMakeCurrent(display, surface, surface, context) == EGL_FALSE) {
         auto ec = eglGetError();
         spdlog::error("{}: {:#x}", "eglMakeCurrent", ec);
@@ -116,7 +125,7 @@ EGLint egl_context_t::resume(gsl::not_null<EGLNativeWindowType> window) noexcept
         return eglGetError(); /// @todo the value can be EGL_SUCCESS. Check the available cases
 
     // bind surface and context
-    spdlog::debug("EGL current: {}/{} {}", surface, surface, context);
+    SPDLOG_DEBUG("EGL current: {}/{} {}", surface, surface, context);
     if (eglMakeCurrent(display, surface, surface, context) == EGL_FALSE) {
         auto ec = eglGetError();
         report_error_code("eglMakeCurrent", ec);
@@ -126,12 +135,12 @@ EGLint egl_context_t::resume(gsl::not_null<EGLNativeWindowType> window) noexcept
 }
 
 EGLint egl_context_t::suspend() noexcept {
-    spdlog::trace(__FUNCTION__);
+    SPDLOG_TRACE(__FUNCTION__);
     if (context == EGL_NO_CONTEXT)
         return EGL_NOT_INITIALIZED;
 
     // unbind surface. OpenGL ES 3.1 will return true
-    spdlog::debug("EGL current: EGL_NO_SURFACE/EGL_NO_SURFACE {}", context);
+    SPDLOG_DEBUG("EGL current: EGL_NO_SURFACE/EGL_NO_SURFACE {}", context);
     if (eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context) == EGL_FALSE) {
         // OpenGL ES 3.0 will report error. consume it
         // then unbind both surface and context.
@@ -144,16 +153,18 @@ EGLint egl_context_t::suspend() noexcept {
 }
 
 void egl_context_t::destroy() noexcept {
-    spdlog::trace(__FUNCTION__);
+    SPDLOG_TRACE(__FUNCTION__);
     if (display == EGL_NO_DISPLAY) // already terminated
         return;
 
-    // unbind surface and context
-    spdlog::debug("EGL current: EGL_NO_SURFACE/EGL_NO_SURFACE EGL_NO_CONTEXT");
-    if (eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT) == EGL_FALSE) {
-        auto ec = eglGetError();
-        report_error_code("eglMakeCurrent", ec);
-        return;
+    // unbind surface and context. the other context of this thread is not touched
+    if (context != EGL_NO_CONTEXT && eglGetCurrentContext() == context) {
+        SPDLOG_DEBUG("EGL current: EGL_NO_SURFACE/EGL_NO_SURFACE EGL_NO_CONTEXT");
+        if (eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT) == EGL_FALSE) {
+            auto ec = eglGetError();
+            report_error_code("eglMakeCurrent", ec);
+            return;
+        }
     }
     // destroy known context
     if (context != EGL_NO_CONTEXT) {
@@ -177,6 +188,7 @@ void egl_context_t::destroy() noexcept {
 }
 
 EGLint egl_context_t::swap() noexcept {
+    TRACE_SCOPE("egl_context_t::swap");
     if (eglSwapBuffers(display, surface))
         return 0;
     switch (const auto ec = eglGetError()) {
@@ -233,47 +245,13 @@ bool has_extension(EGLDisplay display, std::string_view name) noexcept {
         &name);
 }
 
-uint32_t make_egl_attributes(gsl::not_null<ID3D11Texture2D*> texture, std::vector<EGLint>& attrs) noexcept {
-    D3D11_TEXTURE2D_DESC desc{};
-    texture->GetDesc(&desc);
-    attrs.emplace_back(EGL_TEXTURE_TARGET);
-    attrs.emplace_back(EGL_TEXTURE_2D);
-    switch (desc.Format) {
-    case DXGI_FORMAT_B8G8R8A8_UNORM:
-        attrs.emplace_back(EGL_TEXTURE_FORMAT);
-        attrs.emplace_back(EGL_TEXTURE_RGBA);
-        break;
-    default:
-        return ENOTSUP;
-    }
-    attrs.emplace_back(EGL_WIDTH);
-    attrs.emplace_back(gsl::narrow_cast<EGLint>(desc.Width));
-    attrs.emplace_back(EGL_HEIGHT);
-    attrs.emplace_back(gsl::narrow_cast<EGLint>(desc.Height));
-    attrs.emplace_back(EGL_NONE);
-    return 0;
-}
-
-uint32_t make_egl_client_surface(EGLDisplay display, EGLConfig config, ID3D11Texture2D* texture,
-                                 EGLSurface& surface) noexcept {
-    if (texture == nullptr)
-        return EINVAL;
-    if (has_extension(display, "EGL_ANGLE_surface_d3d_texture_2d_share_handle") == false)
-        return ENOTSUP;
-    std::vector<EGLint> attrs{};
-    if (auto ec = make_egl_attributes(texture, attrs))
-        return ec;
-
-    winrt::com_ptr<IDXGIResource> resource{};
-    if (auto hr = texture->QueryInterface(resource.put()); FAILED(hr))
-        return hr;
-    HANDLE handle{};
-    if (auto hr = resource->GetSharedHandle(&handle); FAILED(hr))
-        return hr;
-
-    surface = eglCreatePbufferFromClientBuffer(display, EGL_D3D_TEXTURE_2D_SHARE_HANDLE_ANGLE, handle, //
-                                               config, attrs.data());
-    if (surface == EGL_NO_SURFACE)
-        return eglGetError();
-    return EXIT_SUCCESS;
+bool has_gl_extension(std::string_view name) noexcept {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    if (glGetError() != GL_NO_ERROR)
+        return false;
+    for (auto i = 0; i < count; ++i)
+        if (const auto txt = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i)); txt && name == txt)
+            return true;
+    return false;
 }
@@ -0,0 +1,398 @@
+/**
+ * @author Park DongHa (luncliff@gmail.com)
+ * @see https://github.com/KhronosGroup/glTF/tree/main/specification/2.0
+ */
+#include <graphics.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cstring>
+#include <nlohmann/json.hpp>
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+constexpr uint32_t glb_magic = 0x4654'6C67;      // "glTF"
+constexpr uint32_t glb_chunk_json = 0x4E4F'534A; // "JSON"
+constexpr uint32_t glb_chunk_bin = 0x004E'4942;  // "BIN\0"
+
+template <typename T>
+static T read_unaligned(const std::byte* ptr) noexcept {
+    T value{};
+    std::memcpy(&value, ptr, sizeof(T));
+    return value;
+}
+
+/// @return uint32_t `EBADMSG` if the text is not base64
+static uint32_t decode_base64(std::string_view text, std::vector<std::byte>& bytes) noexcept(false) {
+    auto get_sextet = [](char c) -> int {
+        if (c >= 'A' && c <= 'Z')
+            return c - 'A';
+        if (c >= 'a' && c <= 'z')
+            return c - 'a' + 26;
+        if (c >= '0' && c <= '9')
+            return c - '0' + 52;
+        if (c == '+')
+            return 62;
+        if (c == '/')
+            return 63;
+        return -1;
+    };
+    bytes.clear();
+    bytes.reserve(text.size() / 4 * 3);
+    uint32_t bits = 0, count = 0;
+    for (auto c : text) {
+        if (c == '=')
+            break;
+        const auto sextet = get_sextet(c);
+        if (sextet < 0)
+            return EBADMSG;
+        bits = (bits << 6) | static_cast<uint32_t>(sextet);
+        if (++count == 4) {
+            bytes.emplace_back(static_cast<std::byte>(bits >> 16));
+            bytes.emplace_back(static_cast<std::byte>(bits >> 8));
+            bytes.emplace_back(static_cast<std::byte>(bits));
+            bits = count = 0;
+        }
+    }
+    if (count == 2) {
+        bytes.emplace_back(static_cast<std::byte>(bits >> 4));
+    } else if (count == 3) {
+        bytes.emplace_back(static_cast<std::byte>(bits >> 10));
+        bytes.emplace_back(static_cast<std::byte>(bits >> 2));
+    }
+    return 0;
+}
+
+static uint32_t get_components(const std::string& type) noexcept {
+    if (type == "SCALAR")
+        return 1;
+    if (type == "VEC2")
+        return 2;
+    if (type == "VEC3")
+        return 3;
+    if (type == "VEC4" || type == "MAT2")
+        return 4;
+    if (type == "MAT3")
+        return 9;
+    if (type == "MAT4")
+        return 16;
+    return 0;
+}
+
+static uint32_t get_component_size(GLenum type) noexcept {
+    switch (type) {
+    case GL_BYTE:
+    case GL_UNSIGNED_BYTE:
+        return 1;
+    case GL_SHORT:
+    case GL_UNSIGNED_SHORT:
+        return 2;
+    case GL_UNSIGNED_INT:
+    case GL_FLOAT:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+/// @brief column major. `out` can't be `lhs` or `rhs`
+static void multiply(const float (&lhs)[16], const float (&rhs)[16], float (&out)[16]) noexcept {
+    for (auto c = 0; c < 4; ++c)
+        for (auto r = 0; r < 4; ++r) {
+            float sum = 0;
+            for (auto k = 0; k < 4; ++k)
+                sum += lhs[k * 4 + r] * rhs[c * 4 + k];
+            out[c * 4 + r] = sum;
+        }
+}
+
+/// @brief `matrix` or T * R * S of the node
+static void get_local_transform(const json& node, float (&out)[16]) noexcept(false) {
+    if (auto it = node.find("matrix"); it != node.end() && it->size() == 16) {
+        for (auto i = 0u; i < 16; ++i)
+            out[i] = (*it)[i].get<float>();
+        return;
+    }
+    double t[3]{0, 0, 0}, q[4]{0, 0, 0, 1}, s[3]{1, 1, 1};
+    if (auto it = node.find("translation"); it != node.end() && it->size() == 3)
+        for (auto i = 0u; i < 3; ++i)
+            t[i] = (*it)[i].get<double>();
+    if (auto it = node.find("rotation"); it != node.end() && it->size() == 4)
+        for (auto i = 0u; i < 4; ++i)
+            q[i] = (*it)[i].get<double>();
+    if (auto it = node.find("scale"); it != node.end() && it->size() == 3)
+        for (auto i = 0u; i < 3; ++i)
+            s[i] = (*it)[i].get<double>();
+    const double x = q[0], y = q[1], z = q[2], w = q[3];
+    const double rotation[9]{1 - 2 * (y * y + z * z), 2 * (x * y + w * z),     2 * (x * z - w * y),
+                             2 * (x * y - w * z),     1 - 2 * (x * x + z * z), 2 * (y * z + w * x),
+                             2 * (x * z + w * y),     2 * (y * z - w * x),     1 - 2 * (x * x + y * y)};
+    for (auto c = 0; c < 3; ++c) {
+        for (auto r = 0; r < 3; ++r)
+            out[c * 4 + r] = static_cast<float>(rotation[c * 3 + r] * s[c]);
+        out[c * 4 + 3] = 0;
+    }
+    for (auto r = 0; r < 3; ++r)
+        out[12 + r] = static_cast<float>(t[r]);
+    out[15] = 1;
+}
+
+struct gltf_file_t::impl_t final {
+    std::unique_ptr<mapped_file_t> file{};
+    json document{};
+    std::vector<std::unique_ptr<mapped_file_t>> externals{}; // .bin files
+    std::vector<std::vector<std::byte>> decoded{};           // data URIs
+    std::vector<gsl::span<const std::byte>> buffers{};
+
+  public:
+    /// @return uint32_t `EBADMSG` if the header or the chunks are broken
+    static uint32_t split_glb(gsl::span<const std::byte> bytes, gsl::span<const std::byte>& text,
+                              gsl::span<const std::byte>& binary) noexcept {
+        // header(12) + JSON chunk header(8)
+        if (bytes.size() < 20 || read_unaligned<uint32_t>(bytes.data()) != glb_magic ||
+            read_unaligned<uint32_t>(bytes.data() + 4) != 2)
+            return EBADMSG;
+        const auto length = std::min<size_t>(read_unaligned<uint32_t>(bytes.data() + 8), bytes.size());
+        const size_t json_length = read_unaligned<uint32_t>(bytes.data() + 12);
+        if (read_unaligned<uint32_t>(bytes.data() + 16) != glb_chunk_json || 20 + json_length > length)
+            return EBADMSG;
+        text = bytes.subspan(20, json_length);
+        // the chunks are 4 byte aligned. BIN chunk is optional
+        const size_t offset = 20 + (json_length + 3) / 4 * 4;
+        if (offset + 8 > length)
+            return 0;
+        const size_t bin_length = read_unaligned<uint32_t>(bytes.data() + offset);
+        if (read_unaligned<uint32_t>(bytes.data() + offset + 4) != glb_chunk_bin || offset + 8 + bin_length > length)
+            return EBADMSG;
+        binary = bytes.subspan(offset + 8, bin_length);
+        return 0;
+    }
+
+    uint32_t open_buffers(const fs::path& directory, gsl::span<const std::byte> binary) noexcept(false) {
+        const auto it = document.find("buffers");
+        if (it == document.end())
+            return 0;
+        for (const auto& buffer : *it) {
+            const auto length = buffer.value("byteLength", size_t{0});
+            const auto uri = buffer.value("uri", std::string{});
+            gsl::span<const std::byte> bytes{};
+            if (uri.empty()) {
+                // GLB-stored buffer must be the first one
+                if (buffers.empty() == false)
+                    return EBADMSG;
+                bytes = binary;
+            } else if (uri.rfind("data:", 0) == 0) {
+                const auto pos = uri.find(";base64,");
+                if (pos == std::string::npos)
+                    return EBADMSG;
+                auto& storage = decoded.emplace_back();
+                if (auto ec = decode_base64(std::string_view{uri}.substr(pos + 8), storage))
+                    return ec;
+                bytes = storage;
+            } else {
+                auto& external = externals.emplace_back(std::make_unique<mapped_file_t>(
+                    directory / fs::u8path(uri), mapped_file_t::access_hint_t::random));
+                if (auto ec = external->is_valid())
+                    return ec;
+                bytes = external->bytes();
+            }
+            if (bytes.size() < length)
+                return EBADMSG;
+            buffers.emplace_back(bytes.first(length));
+        }
+        return 0;
+    }
+
+    void visit(const json& nodes, size_t index, const float (&parent)[16],
+               std::vector<packed_scene_t::instance_t>& instances, size_t depth) const noexcept(false) {
+        // the node hierarchy must be a forest. stop at the broken file's cycle
+        if (index >= nodes.size() || depth > nodes.size())
+            return;
+        const auto& node = nodes[index];
+        float local[16]{}, world[16]{};
+        get_local_transform(node, local);
+        multiply(parent, local, world);
+        if (auto it = node.find("mesh"); it != node.end()) {
+            auto& instance = instances.emplace_back();
+            instance.mesh = it->get<uint32_t>();
+            std::copy(world, world + 16, instance.transform);
+        }
+        if (auto it = node.find("children"); it != node.end())
+            for (const auto& child : *it)
+                visit(nodes, child.get<size_t>(), world, instances, depth + 1);
+    }
+};
+
+gltf_file_t::gltf_file_t(const fs::path& fpath) noexcept {
+    try {
+        impl = std::make_unique<impl_t>();
+        impl->file = std::make_unique<mapped_file_t>(fpath, mapped_file_t::access_hint_t::random);
+        if (ec = impl->file->is_valid(); ec)
+            return;
+        gsl::span<const std::byte> text = impl->file->bytes(), binary{};
+        if (fpath.extension() == ".glb")
+            if (ec = impl_t::split_glb(impl->file->bytes(), text, binary); ec)
+                return;
+        const auto begin = reinterpret_cast<const char*>(text.data());
+        impl->document = json::parse(begin, begin + text.size(), nullptr, false);
+        if (impl->document.is_object() == false) { // also for `is_discarded`
+            ec = EBADMSG;
+            return;
+        }
+        if (impl->document.value("asset", json::object()).value("version", std::string{}) != "2.0") {
+            ec = EBADMSG;
+            return;
+        }
+        ec = impl->open_buffers(fpath.parent_path(), binary);
+    } catch (const std::system_error& ex) {
+        ec = static_cast<uint32_t>(ex.code().value());
+    } catch (const json::exception&) {
+        ec = EBADMSG; // type mismatch in the document
+    } catch (const std::bad_alloc&) {
+        ec = ENOMEM;
+    }
+}
+
+gltf_file_t::~gltf_file_t() noexcept = default;
+
+uint32_t gltf_file_t::is_valid() const noexcept {
+    return ec;
+}
+
+uint32_t gltf_file_t::get_buffer(uint32_t index, gsl::span<const std::byte>& bytes) const noexcept {
+    if (ec || index >= impl->buffers.size())
+        return EINVAL;
+    bytes = impl->buffers[index];
+    return 0;
+}
+
+uint32_t gltf_file_t::get_buffer_view(uint32_t index, gsl::span<const std::byte>& bytes) const noexcept {
+    if (ec)
+        return EINVAL;
+    try {
+        const auto& views = impl->document.at("bufferViews");
+        if (index >= views.size())
+            return EINVAL;
+        const auto& view = views[index];
+        gsl::span<const std::byte> buffer{};
+        if (get_buffer(view.at("buffer").get<uint32_t>(), buffer))
+            return EINVAL;
+        const auto offset = view.value("byteOffset", size_t{0});
+        const auto length = view.at("byteLength").get<size_t>();
+        if (offset + length > buffer.size())
+            return EINVAL;
+        bytes = buffer.subspan(offset, length);
+        return 0;
+    } catch (const json::exception&) {
+        return EINVAL;
+    }
+}
+
+uint32_t gltf_file_t::get_accessor(uint32_t index, accessor_view_t& view) const noexcept {
+    if (ec)
+        return EINVAL;
+    try {
+        const auto& accessors = impl->document.at("accessors");
+        if (index >= accessors.size())
+            return EINVAL;
+        const auto& accessor = accessors[index];
+        if (accessor.contains("sparse"))
+            return ENOTSUP;
+        const auto buffer_view = accessor.value("bufferView", UINT32_MAX);
+        gsl::span<const std::byte> bytes{};
+        if (auto ec = get_buffer_view(buffer_view, bytes))
+            return ec;
+        const auto component_type = accessor.at("componentType").get<GLenum>();
+        const auto components = get_components(accessor.at("type").get<std::string>());
+        const auto count = accessor.at("count").get<uint32_t>();
+        const auto offset = accessor.value("byteOffset", size_t{0});
+        const auto element_size = components * get_component_size(component_type);
+        const auto stride = impl->document["bufferViews"][buffer_view].value("byteStride", element_size);
+        if (element_size == 0 || stride < element_size)
+            return EINVAL;
+        // the last element may be shorter than the stride
+        if (count && offset + size_t{count - 1} * stride + element_size > bytes.size())
+            return EINVAL;
+        view.data = bytes.data() + offset;
+        view.count = count;
+        view.stride = stride;
+        view.component_type = component_type;
+        view.components = components;
+        view.normalized = accessor.value("normalized", false);
+        return 0;
+    } catch (const json::exception&) {
+        return EINVAL;
+    }
+}
+
+uint32_t gltf_file_t::add_meshes(mesh_packer_t& packer) const noexcept(false) {
+    uint32_t skipped = 0;
+    if (ec || impl->document.contains("meshes") == false)
+        return skipped;
+    const auto& meshes = impl->document["meshes"];
+    for (auto m = 0u; m < meshes.size(); ++m) {
+        for (const auto& primitive : meshes[m].value("primitives", json::array())) {
+            if (primitive.value("mode", 4) != 4) // TRIANGLES
+                continue;
+            const auto attributes = primitive.value("attributes", json::object());
+            const char* names[3]{"POSITION", "NORMAL", "TEXCOORD_0"};
+            accessor_view_t views[4]{}; // + indices
+            uint32_t failed = 0;
+            for (auto i = 0u; i < 3; ++i)
+                if (auto it = attributes.find(names[i]); it != attributes.end())
+                    failed |= get_accessor(it->get<uint32_t>(), views[i]);
+            if (auto it = primitive.find("indices"); it != primitive.end())
+                failed |= get_accessor(it->get<uint32_t>(), views[3]);
+            if (failed == 0)
+                failed = packer.add(m, primitive.value("material", -1), views[0], views[1], views[2], views[3]);
+            if (failed) {
+                spdlog::warn("{}: mesh {} primitive {:#x}", "gltf_file_t", m, failed);
+                ++skipped;
+            }
+        }
+    }
+    return skipped;
+}
+
+void gltf_file_t::get_instances(std::vector<packed_scene_t::instance_t>& instances) const noexcept(false) {
+    instances.clear();
+    if (ec || impl->document.contains("scenes") == false || impl->document.contains("nodes") == false)
+        return;
+    // the default scene. if missing, the first one
+    const auto& scenes = impl->document["scenes"];
+    const auto scene = impl->document.value("scene", size_t{0});
+    if (scene >= scenes.size())
+        return;
+    constexpr float identity[16]{1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+    for (const auto& root : scenes[scene].value("nodes", json::array()))
+        impl->visit(impl->document["nodes"], root.get<size_t>(), identity, instances, 0);
+}
+
+uint32_t load_gltf(const fs::path& fpath, packed_scene_t& scene, std::string& message) noexcept {
+    std::error_code fec{};
+    if (fs::exists(fpath, fec) == false)
+        return ENOENT;
+    try {
+        const gltf_file_t file{fpath};
+        if (auto ec = file.is_valid()) {
+            message = std::system_category().message(static_cast<int>(ec));
+            return ec;
+        }
+        mesh_packer_t packer{};
+        if (auto skipped = file.add_meshes(packer))
+            spdlog::warn("{}: {} primitives are skipped", "load_gltf", skipped);
+        if (auto ec = packer.pack(scene))
+            return ec;
+        file.get_instances(scene.instances);
+        return 0;
+    } catch (const std::system_error& ex) {
+        message = ex.what();
+        return static_cast<uint32_t>(ex.code().value());
+    } catch (const nlohmann::json::exception& ex) {
+        message = ex.what();
+        return EBADMSG;
+    } catch (const std::bad_alloc&) {
+        return ENOMEM;
+    }
+}
@@ -0,0 +1,591 @@
+/**
+ * @author Park DongHa (luncliff@gmail.com)
+ * @see https://kernel.dk/io_uring.pdf
+ * @see https://unixism.net/loti/low_level.html
+ */
+#include <graphics.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <new>
+#include <thread>
+
+#include "trace.h"
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#define USE_IO_URING
+#endif
+
+namespace fs = std::filesystem;
+
+auto open(const fs::path& p) -> std::unique_ptr<FILE, int (*)(FILE*)>;
+uint32_t get_size(FILE* stream, size_t& sz) noexcept;
+uint32_t fill(FILE* stream, size_t& rsz, std::byte* buf, size_t buflen) noexcept;
+
+/**
+ * @brief Page-aligned buffers grouped by power-of-2 size class. 64KB for the smallest class
+ * @note  Keeps the released buffers up to `max_cached` bytes. The others are freed
+ */
+class buffer_pool_t final {
+    static constexpr size_t page_size = 4096;
+    static constexpr uint32_t min_class = 16;
+    static constexpr uint32_t max_class = 48;
+    static constexpr size_t max_cached = size_t{64} << 20;
+
+  private:
+    std::mutex mtx{};
+    std::vector<std::byte*> free_lists[max_class]{};
+    size_t cached = 0; // bytes in the free lists
+
+  public:
+    buffer_pool_t() noexcept = default;
+    ~buffer_pool_t() noexcept {
+        for (auto c = 0u; c < max_class; ++c)
+            for (auto ptr : free_lists[c])
+                ::operator delete(ptr, std::align_val_t{page_size});
+    }
+    buffer_pool_t(buffer_pool_t const&) = delete;
+    buffer_pool_t& operator=(buffer_pool_t const&) = delete;
+    buffer_pool_t(buffer_pool_t&&) = delete;
+    buffer_pool_t& operator=(buffer_pool_t&&) = delete;
+
+    static uint32_t get_class(size_t length) noexcept {
+        uint32_t c = min_class;
+        while ((size_t{1} << c) < length)
+            ++c;
+        return c;
+    }
+
+    /// @return nullptr if `c` is too large or out of memory
+    std::byte* acquire(uint32_t c) noexcept {
+        if (c >= max_class)
+            return nullptr;
+        {
+            std::lock_guard lck{mtx};
+            if (auto& list = free_lists[c]; list.empty() == false) {
+                auto ptr = list.back();
+                list.pop_back();
+                cached -= size_t{1} << c;
+                return ptr;
+            }
+        }
+        return static_cast<std::byte*>(::operator new(size_t{1} << c, std::align_val_t{page_size}, std::nothrow));
+    }
+
+    void release(uint32_t c, std::byte* ptr) noexcept {
+        if (ptr == nullptr)
+            return;
+        {
+            std::lock_guard lck{mtx};
+            if (cached + (size_t{1} << c) <= max_cached) {
+                cached += size_t{1} << c;
+                return free_lists[c].push_back(ptr);
+            }
+        }
+        ::operator delete(ptr, std::align_val_t{page_size});
+    }
+};
+
+struct request_t final {
+    fs::path fpath;
+    file_callback_t callback;
+    void* user_data;
+    std::byte* buffer = nullptr;
+    uint32_t size_class = 0;
+    size_t length = 0; // file size
+    size_t offset = 0; // read bytes
+    uint32_t ec = 0;
+#if defined(USE_IO_URING)
+    int fd = -1;
+    iovec vec{};
+#endif
+};
+
+#if defined(USE_IO_URING)
+/**
+ * @brief Minimal `io_uring` without liburing. Only the owner of `file_loader_t::impl_t::mtx` can touch the SQ.
+ *        Only the completion thread touches the CQ
+ */
+class io_uring_t final {
+  public:
+    int fd = -1;
+    io_uring_params params{};
+
+  private:
+    void* sq_ptr = MAP_FAILED;
+    size_t sq_len = 0;
+    void* cq_ptr = MAP_FAILED;
+    size_t cq_len = 0;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t sqes_len = 0;
+    unsigned *sq_head{}, *sq_tail{}, *sq_mask{}, *sq_array{};
+    unsigned *cq_head{}, *cq_tail{}, *cq_mask{};
+    io_uring_cqe* cqes{};
+
+  public:
+    io_uring_t() noexcept = default;
+    ~io_uring_t() noexcept {
+        if (sqes != MAP_FAILED)
+            munmap(sqes, sqes_len);
+        if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr)
+            munmap(cq_ptr, cq_len);
+        if (sq_ptr != MAP_FAILED)
+            munmap(sq_ptr, sq_len);
+        if (fd >= 0)
+            close(fd);
+    }
+    io_uring_t(io_uring_t const&) = delete;
+    io_uring_t& operator=(io_uring_t const&) = delete;
+    io_uring_t(io_uring_t&&) = delete;
+    io_uring_t& operator=(io_uring_t&&) = delete;
+
+    /// @return uint32_t `errno` of `io_uring_setup` or `mmap`
+    uint32_t setup(uint32_t entries) noexcept {
+        fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (fd < 0)
+            return errno;
+        sq_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_len = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP)
+            sq_len = cq_len = std::max(sq_len, cq_len);
+        sq_ptr = mmap(nullptr, sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (sq_ptr == MAP_FAILED)
+            return errno;
+        cq_ptr = sq_ptr;
+        if ((params.features & IORING_FEAT_SINGLE_MMAP) == 0) {
+            cq_ptr = mmap(nullptr, cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+            if (cq_ptr == MAP_FAILED)
+                return errno;
+        }
+        sqes_len = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe*>(
+            mmap(nullptr, sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+        if (sqes == MAP_FAILED)
+            return errno;
+        auto sq = static_cast<std::byte*>(sq_ptr);
+        sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        auto cq = static_cast<std::byte*>(cq_ptr);
+        cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return 0;
+    }
+
+    /**
+     * @return nullptr if the SQ is full
+     * @note   The kernel reads the SQEs only in `io_uring_enter`, so the tail is moved before the caller fills it
+     */
+    io_uring_sqe* push() noexcept {
+        const auto tail = *sq_tail; // only we write the tail
+        if (tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= params.sq_entries)
+            return nullptr;
+        const auto idx = tail & *sq_mask;
+        sq_array[idx] = idx;
+        auto sqe = sqes + idx;
+        *sqe = io_uring_sqe{};
+        __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+        return sqe;
+    }
+
+    /// @return nullptr if the CQ is empty
+    io_uring_cqe* peek() noexcept {
+        const auto head = *cq_head; // only we write the head
+        if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE))
+            return nullptr;
+        return cqes + (head & *cq_mask);
+    }
+
+    void pop() noexcept {
+        __atomic_store_n(cq_head, *cq_head + 1, __ATOMIC_RELEASE);
+    }
+
+    /// @brief Drop the SQEs which were not consumed by `io_uring_enter`. They will never be submitted
+    void discard() noexcept {
+        __atomic_store_n(sq_tail, __atomic_load_n(sq_head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+    }
+
+    /// @return int `errno` of `io_uring_enter`
+    int enter(unsigned to_submit, unsigned min_complete) noexcept {
+        const unsigned flags = min_complete ? IORING_ENTER_GETEVENTS : 0;
+        while (syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0) < 0) {
+            if (errno != EINTR)
+                return errno;
+        }
+        return 0;
+    }
+};
+#endif
+
+struct file_loader_t::impl_t final {
+    buffer_pool_t buffers{};
+    std::mutex mtx{};
+    std::condition_variable cv{};
+    std::deque<request_t*> queued{};  // submitted, not flushed
+    std::deque<request_t*> pending{}; // flushed, not started
+    uint32_t outstanding = 0;         // flushed, callback not returned
+    uint32_t inflight = 0;            // started by io_uring
+    uint32_t queue_depth = 0;
+    bool stopping = false;
+    std::vector<std::thread> threads{};
+#if defined(USE_IO_URING)
+    std::unique_ptr<io_uring_t> ring{};
+    std::vector<request_t*> reading{}; // started by io_uring. `queue_depth` is reserved
+    uint32_t failure = 0;              // `io_uring_enter` error of the completion thread
+#endif
+
+    ~impl_t() noexcept {
+        for (auto req : queued)
+            delete req;
+    }
+
+    /// @note invoke without `mtx`
+    void complete(request_t* req) noexcept {
+        req->callback(req->user_data, {req->buffer, req->offset}, req->ec);
+        buffers.release(req->size_class, req->buffer);
+#if defined(USE_IO_URING)
+        if (req->fd >= 0)
+            close(req->fd);
+#endif
+        delete req;
+        std::lock_guard lck{mtx};
+        if (--outstanding == 0)
+            cv.notify_all();
+    }
+
+    /// @brief read in the worker thread
+    void read(request_t* req) noexcept {
+        TRACE_SCOPE("file_loader_t::read");
+        try {
+            auto stream = open(req->fpath);
+            if (req->ec = get_size(stream.get(), req->length); req->ec)
+                return;
+            req->size_class = buffer_pool_t::get_class(req->length);
+            if (req->buffer = buffers.acquire(req->size_class); req->buffer == nullptr) {
+                req->ec = ENOMEM;
+                return;
+            }
+            req->ec = fill(stream.get(), req->offset, req->buffer, req->length);
+        } catch (const std::system_error& ex) {
+            req->ec = static_cast<uint32_t>(ex.code().value());
+        }
+    }
+
+    void run_worker() noexcept {
+        std::unique_lock lck{mtx};
+        while (true) {
+            cv.wait(lck, [this]() { return stopping || pending.empty() == false; });
+            if (pending.empty()) // stopping
+                return;
+            auto req = pending.front();
+            pending.pop_front();
+            lck.unlock();
+            read(req);
+            complete(req);
+            lck.lock();
+        }
+    }
+
+#if defined(USE_IO_URING)
+    /**
+     * @brief move `pending` requests to the SQ while the queue depth allows
+     * @note  invoke with `mtx`
+     * @param failed    the requests which couldn't be started. `complete` them without `mtx`
+     * @return unsigned number of the SQEs to submit
+     */
+    unsigned start_pending(std::vector<request_t*>& failed) noexcept {
+        unsigned count = 0;
+        while (inflight < queue_depth && pending.empty() == false) {
+            auto req = pending.front();
+            pending.pop_front();
+            if (req->fd = ::open(req->fpath.c_str(), O_RDONLY | O_CLOEXEC); req->fd < 0) {
+                req->ec = errno;
+                failed.emplace_back(req);
+                continue;
+            }
+            struct stat info {};
+            if (fstat(req->fd, &info) != 0) {
+                req->ec = errno;
+                failed.emplace_back(req);
+                continue;
+            }
+            req->length = static_cast<size_t>(info.st_size);
+            req->size_class = buffer_pool_t::get_class(req->length);
+            if (req->buffer = buffers.acquire(req->size_class); req->buffer == nullptr) {
+                req->ec = ENOMEM;
+                failed.emplace_back(req);
+                continue;
+            }
+            if (req->length == 0) {
+                failed.emplace_back(req); // nothing to read. not a failure
+                continue;
+            }
+            reading.emplace_back(req);
+            prepare_read(req);
+            ++count;
+        }
+        return count;
+    }
+
+    /// @note invoke with `mtx`. SQ can't be full because `inflight` <= `queue_depth` <= `sq_entries`
+    void prepare_read(request_t* req) noexcept {
+        req->vec.iov_base = req->buffer + req->offset;
+        req->vec.iov_len = req->length - req->offset;
+        auto sqe = ring->push();
+        sqe->opcode = IORING_OP_READV;
+        sqe->fd = req->fd;
+        sqe->addr = reinterpret_cast<uint64_t>(&req->vec);
+        sqe->len = 1;
+        sqe->off = req->offset;
+        sqe->user_data = reinterpret_cast<uint64_t>(req);
+        ++inflight;
+    }
+
+    /// @note invoke with `mtx`
+    void stop_reading(request_t* req, std::vector<request_t*>& done) noexcept {
+        auto it = std::find(reading.begin(), reading.end(), req);
+        *it = reading.back();
+        reading.pop_back();
+        done.emplace_back(req);
+    }
+
+    /**
+     * @brief Complete all flushed requests with the `ec`. The later `flush` fails with it
+     * @note  invoke without `mtx`. The kernel may still write the buffers of the started reads, so they are not reused
+     */
+    void fail(uint32_t ec) noexcept {
+        std::deque<request_t*> failed{};
+        std::vector<request_t*> started{};
+        {
+            std::lock_guard lck{mtx};
+            failure = ec;
+            failed.swap(pending);
+            started.swap(reading);
+        }
+        for (auto req : failed) {
+            req->ec = ec;
+            complete(req);
+        }
+        for (auto req : started) {
+            req->ec = ec;
+            req->buffer = nullptr; // leaked
+            req->offset = 0;
+            complete(req);
+        }
+    }
+
+    void run_completion() noexcept {
+        std::vector<request_t*> done{};
+        while (true) {
+            // `enter` retries on EINTR. EBUSY/EAGAIN if the CQ must be reaped first
+            if (auto ec = ring->enter(0, 1); ec && ec != EBUSY && ec != EAGAIN) {
+                spdlog::error("{}: {:#x}", "io_uring_enter", ec);
+                return fail(ec);
+            }
+            bool stop = false;
+            uint32_t failed = 0;
+            unsigned resubmit = 0;
+            std::unique_lock lck{mtx};
+            if (failure) // `fail` in the `flush`. the requests of the remaining CQEs are already completed
+                return;
+            while (auto cqe = ring->peek()) {
+                auto req = reinterpret_cast<request_t*>(cqe->user_data);
+                const auto res = cqe->res;
+                ring->pop();
+                if (req == nullptr) { // IORING_OP_NOP from the destructor
+                    stop = true;
+                    continue;
+                }
+                --inflight;
+                if (res == -EINTR || res == -EAGAIN) {
+                    prepare_read(req);
+                    ++resubmit;
+                    continue;
+                }
+                if (res < 0) {
+                    req->ec = static_cast<uint32_t>(-res);
+                    stop_reading(req, done);
+                    continue;
+                }
+                req->offset += static_cast<size_t>(res);
+                if (res == 0 || req->offset == req->length) { // 0 if truncated while reading
+                    stop_reading(req, done);
+                    continue;
+                }
+                prepare_read(req); // short read. continue from the offset
+                ++resubmit;
+            }
+            resubmit += start_pending(done);
+            if (resubmit)
+                if (failed = ring->enter(resubmit, 0); failed)
+                    spdlog::error("{}: {:#x}", "io_uring_enter", failed);
+            lck.unlock();
+            for (auto req : done)
+                complete(req);
+            done.clear();
+            if (failed)
+                return fail(failed);
+            if (stop)
+                return;
+        }
+    }
+#endif
+};
+
+file_loader_t::file_loader_t(uint32_t queue_depth, bool use_io_uring) noexcept {
+    try {
+        impl = std::make_unique<impl_t>();
+    } catch (const std::bad_alloc&) {
+        ec = ENOMEM;
+        return;
+    }
+    impl->queue_depth = std::max(queue_depth, 1u);
+#if defined(USE_IO_URING)
+    if (use_io_uring) {
+        auto ring = std::make_unique<io_uring_t>();
+        if (auto ec = ring->setup(impl->queue_depth)) {
+            // ENOSYS for old kernels, EPERM for io_uring_disabled/seccomp...
+            spdlog::warn("{}: {:#x}", "io_uring_setup", ec);
+        } else {
+            impl->queue_depth = std::min(impl->queue_depth, ring->params.sq_entries);
+            impl->ring = std::move(ring);
+            try {
+                impl->reading.reserve(impl->queue_depth);
+            } catch (const std::bad_alloc&) {
+                ec = ENOMEM;
+                return;
+            }
+        }
+    }
+    if (impl->ring) {
+        try {
+            impl->threads.emplace_back(&impl_t::run_completion, impl.get());
+        } catch (const std::system_error& ex) {
+            ec = static_cast<uint32_t>(ex.code().value());
+        }
+        return;
+    }
+#endif
+    const auto concurrency = std::clamp(std::thread::hardware_concurrency(), 2u, 8u);
+    try {
+        for (auto i = 0u; i < std::min(impl->queue_depth, concurrency); ++i)
+            impl->threads.emplace_back(&impl_t::run_worker, impl.get());
+    } catch (const std::system_error& ex) {
+        ec = static_cast<uint32_t>(ex.code().value());
+    }
+}
+
+file_loader_t::~file_loader_t() noexcept {
+    if (impl == nullptr)
+        return;
+    if (impl->threads.empty() == false)
+        wait();
+    {
+        std::lock_guard lck{impl->mtx};
+        impl->stopping = true;
+#if defined(USE_IO_URING)
+        if (impl->ring && impl->threads.empty() == false) {
+            auto sqe = impl->ring->push();
+            sqe->opcode = IORING_OP_NOP;
+            sqe->user_data = 0;
+            impl->ring->enter(1, 0);
+        }
+#endif
+    }
+    impl->cv.notify_all();
+    for (auto& t : impl->threads)
+        t.join();
+}
+
+uint32_t file_loader_t::is_valid() const noexcept {
+    return ec;
+}
+
+bool file_loader_t::is_async_io() const noexcept {
+#if defined(USE_IO_URING)
+    return impl && impl->ring;
+#else
+    return false;
+#endif
+}
+
+uint32_t file_loader_t::submit(const fs::path& p, file_callback_t callback, void* user_data) noexcept {
+    if (ec)
+        return ec;
+    if (callback == nullptr)
+        return EINVAL;
+    try {
+        auto req = std::make_unique<request_t>(request_t{p, callback, user_data});
+        std::lock_guard lck{impl->mtx};
+        impl->queued.emplace_back(req.get());
+        req.release();
+    } catch (const std::bad_alloc&) {
+        return ENOMEM;
+    }
+    return 0;
+}
+
+uint32_t file_loader_t::flush() noexcept {
+    TRACE_SCOPE("file_loader_t::flush");
+    if (ec)
+        return ec;
+    std::vector<request_t*> failed{};
+    uint32_t result = 0;
+#if defined(USE_IO_URING)
+    bool broken = false; // the started requests must be failed
+#endif
+    {
+        std::lock_guard lck{impl->mtx};
+        if (impl->queued.empty())
+            return 0;
+        impl->outstanding += static_cast<uint32_t>(impl->queued.size());
+        impl->pending.insert(impl->pending.end(), impl->queued.begin(), impl->queued.end());
+        impl->queued.clear();
+#if defined(USE_IO_URING)
+        if (impl->failure) { // no completion thread
+            for (auto req : impl->pending)
+                req->ec = impl->failure;
+            failed.assign(impl->pending.begin(), impl->pending.end());
+            impl->pending.clear();
+            result = impl->failure;
+        } else if (impl->ring) {
+            if (auto count = impl->start_pending(failed))
+                if (result = impl->ring->enter(count, 0); result) {
+                    impl->ring->discard();
+                    broken = true;
+                }
+        }
+#endif
+    }
+    impl->cv.notify_all();
+    for (auto req : failed)
+        impl->complete(req);
+#if defined(USE_IO_URING)
+    if (broken) {
+        spdlog::error("{}: {:#x}", "io_uring_enter", result);
+        impl->fail(result); // also stops the completion thread
+    }
+#endif
+    return result;
+}
+
+void file_loader_t::wait() noexcept {
+    if (ec) // nothing was submitted
+        return;
+    if (auto ec = flush())
+        spdlog::error("{}: {:#x}", "io_uring_enter", ec);
+    std::unique_lock lck{impl->mtx};
+    impl->cv.wait(lck, [this]() { return impl->outstanding == 0; });
+}
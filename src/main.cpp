@@ -2,11 +2,25 @@
  * @author Park DongHa (luncliff@gmail.com)
  */
 #include <graphics.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <memory>
+#include <sys/stat.h>
+#include <sys/types.h>
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 namespace fs = std::filesystem;
 
 using namespace std;
 
+#if defined(_WIN32)
 auto create(const fs::path& p) -> std::unique_ptr<FILE, int (*)(FILE*)> {
     auto fpath = p.generic_wstring();
     FILE* fp{};
@@ -30,17 +44,184 @@ uint32_t get_size(FILE* stream, size_t& sz) noexcept {
     sz = gsl::narrow_cast<size_t>(info.st_size);
     return 0;
 }
+#else
+auto create(const fs::path& p) -> std::unique_ptr<FILE, int (*)(FILE*)> {
+    FILE* fp = fopen(p.c_str(), "w+b");
+    if (fp == nullptr)
+        throw system_error{errno, system_category(), "fopen"};
+    return {fp, &fclose};
+}
+
+auto open(const fs::path& p) -> std::unique_ptr<FILE, int (*)(FILE*)> {
+    FILE* fp = fopen(p.c_str(), "rb");
+    if (fp == nullptr)
+        throw system_error{errno, system_category(), "fopen"};
+    return {fp, &fclose};
+}
+
+uint32_t get_size(FILE* stream, size_t& sz) noexcept {
+    struct stat info {};
+    if (fstat(fileno(stream), &info) != 0)
+        return errno; // throw system_error{errno, system_category(), "fstat"};
+    sz = gsl::narrow_cast<size_t>(info.st_size);
+    return 0;
+}
+#endif
 
 uint32_t fill(FILE* stream, size_t& rsz, std::byte* buf, size_t buflen) noexcept {
     rsz = 0;
     while (!feof(stream)) {
         void* b = buf + rsz;
         const auto sz = buflen - rsz;
-        rsz += fread_s(b, sz, sizeof(std::byte), sz, stream);
+        rsz += fread(b, sizeof(std::byte), sz, stream);
         if (auto ec = ferror(stream))
-            return ec; // throw system_error{ec, system_category(), "fread_s"};
+            return ec; // throw system_error{ec, system_category(), "fread"};
         if (rsz == buflen)
             break;
     }
     return 0;
 }
+
+auto read(FILE* stream, size_t& rsz) -> std::unique_ptr<std::byte[]> {
+    size_t buflen = 0;
+    if (auto ec = get_size(stream, buflen))
+        throw system_error{static_cast<int>(ec), system_category(), "fstat"};
+    auto buf = make_unique<std::byte[]>(buflen);
+    if (auto ec = fill(stream, rsz, buf.get(), buflen))
+        throw system_error{static_cast<int>(ec), system_category(), "fread"};
+    return buf;
+}
+
+auto read_all(const fs::path& p, size_t& fsize) -> std::unique_ptr<std::byte[]> {
+    auto stream = open(p);
+    return read(stream.get(), fsize);
+}
+
+#if defined(_WIN32)
+mapped_file_t::mapped_file_t(const fs::path& p, access_hint_t hint) noexcept {
+    DWORD flags = FILE_ATTRIBUTE_NORMAL;
+    if (hint == access_hint_t::sequential)
+        flags |= FILE_FLAG_SEQUENTIAL_SCAN;
+    else if (hint == access_hint_t::random)
+        flags |= FILE_FLAG_RANDOM_ACCESS;
+    HANDLE file = CreateFileW(p.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        ec = GetLastError();
+        return;
+    }
+    auto on_return = gsl::finally([file]() { CloseHandle(file); });
+    LARGE_INTEGER size{};
+    if (GetFileSizeEx(file, &size) == FALSE) {
+        ec = GetLastError();
+        return;
+    }
+    length = gsl::narrow_cast<size_t>(size.QuadPart);
+    if (length == 0) // CreateFileMapping rejects the empty file
+        return;
+    // the view keeps the mapping object alive. we don't need the handles after this
+    if (HANDLE view = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr)) {
+        mapping = MapViewOfFile(view, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(view);
+    }
+    if (mapping) {
+        if (hint == access_hint_t::willneed) {
+            WIN32_MEMORY_RANGE_ENTRY entry{mapping, length};
+            PrefetchVirtualMemory(GetCurrentProcess(), 1, &entry, 0);
+        }
+        return;
+    }
+    spdlog::warn("{}: {:#x}", "MapViewOfFile", GetLastError());
+    buffer = std::unique_ptr<std::byte[]>{new (std::nothrow) std::byte[length]};
+    if (buffer == nullptr) {
+        ec = ERROR_NOT_ENOUGH_MEMORY;
+        return;
+    }
+    size_t offset = 0;
+    while (offset < length) {
+        const auto request = static_cast<DWORD>(std::min<size_t>(length - offset, UINT32_MAX));
+        DWORD rsz = 0;
+        if (ReadFile(file, buffer.get() + offset, request, &rsz, nullptr) == FALSE) {
+            ec = GetLastError();
+            return;
+        }
+        if (rsz == 0) // truncated while reading
+            break;
+        offset += rsz;
+    }
+    length = offset;
+}
+
+mapped_file_t::~mapped_file_t() noexcept {
+    if (mapping)
+        UnmapViewOfFile(mapping);
+}
+#else
+mapped_file_t::mapped_file_t(const fs::path& p, access_hint_t hint) noexcept {
+    const int fd = ::open(p.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        ec = errno;
+        return;
+    }
+    auto on_return = gsl::finally([fd]() { close(fd); });
+    struct stat info {};
+    if (fstat(fd, &info) != 0) {
+        ec = errno;
+        return;
+    }
+    length = gsl::narrow_cast<size_t>(info.st_size);
+    if (length == 0) // mmap rejects the empty file
+        return;
+    if (void* ptr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0); ptr != MAP_FAILED) {
+        mapping = ptr;
+        int advice = MADV_SEQUENTIAL;
+        if (hint == access_hint_t::random)
+            advice = MADV_RANDOM;
+        else if (hint == access_hint_t::willneed)
+            advice = MADV_WILLNEED;
+        if (madvise(mapping, length, advice) != 0)
+            spdlog::warn("{}: {:#x}", "madvise", errno); // just a hint. keep the mapping
+        return;
+    }
+    spdlog::warn("{}: {:#x}", "mmap", errno);
+    buffer = std::unique_ptr<std::byte[]>{new (std::nothrow) std::byte[length]};
+    if (buffer == nullptr) {
+        ec = ENOMEM;
+        return;
+    }
+    size_t offset = 0;
+    while (offset < length) {
+        const auto rsz = pread(fd, buffer.get() + offset, length - offset, static_cast<off_t>(offset));
+        if (rsz < 0) {
+            if (errno == EINTR)
+                continue;
+            ec = errno;
+            return;
+        }
+        if (rsz == 0) // truncated while reading
+            break;
+        offset += static_cast<size_t>(rsz);
+    }
+    length = offset;
+}
+
+mapped_file_t::~mapped_file_t() noexcept {
+    if (mapping)
+        munmap(mapping, length);
+}
+#endif
+
+uint32_t mapped_file_t::is_valid() const noexcept {
+    return ec;
+}
+
+bool mapped_file_t::is_mapped() const noexcept {
+    return mapping != nullptr;
+}
+
+gsl::span<const std::byte> mapped_file_t::bytes() const noexcept {
+    if (ec)
+        return {};
+    if (mapping)
+        return {reinterpret_cast<const std::byte*>(mapping), length};
+    return {buffer.get(), buffer ? length : 0};
+}
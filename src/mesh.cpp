@@ -0,0 +1,257 @@
+/**
+ * @author Park DongHa (luncliff@gmail.com)
+ * @see https://github.com/KhronosGroup/glTF/tree/main/specification/2.0#meshes
+ */
+#include <graphics.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+static uint32_t get_component_size(GLenum type) noexcept {
+    switch (type) {
+    case GL_BYTE:
+    case GL_UNSIGNED_BYTE:
+        return 1;
+    case GL_SHORT:
+    case GL_UNSIGNED_SHORT:
+        return 2;
+    case GL_UNSIGNED_INT:
+    case GL_FLOAT:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+template <typename T>
+static T read_unaligned(const std::byte* ptr) noexcept {
+    T value{};
+    std::memcpy(&value, ptr, sizeof(T));
+    return value;
+}
+
+static const std::byte* get_element(const accessor_view_t& view, uint32_t index) noexcept {
+    const auto stride = view.stride ? view.stride : view.components * get_component_size(view.component_type);
+    return view.data + size_t{stride} * index;
+}
+
+float accessor_view_t::get(uint32_t index, uint32_t component) const noexcept {
+    const auto ptr = get_element(*this, index) + component * get_component_size(component_type);
+    switch (component_type) {
+    case GL_FLOAT:
+        return read_unaligned<float>(ptr);
+    case GL_UNSIGNED_BYTE: {
+        const auto value = read_unaligned<uint8_t>(ptr);
+        return normalized ? value / 255.0f : value;
+    }
+    case GL_BYTE: {
+        const auto value = read_unaligned<int8_t>(ptr);
+        return normalized ? std::max(value / 127.0f, -1.0f) : value;
+    }
+    case GL_UNSIGNED_SHORT: {
+        const auto value = read_unaligned<uint16_t>(ptr);
+        return normalized ? value / 65535.0f : value;
+    }
+    case GL_SHORT: {
+        const auto value = read_unaligned<int16_t>(ptr);
+        return normalized ? std::max(value / 32767.0f, -1.0f) : value;
+    }
+    case GL_UNSIGNED_INT:
+        return static_cast<float>(read_unaligned<uint32_t>(ptr));
+    default:
+        return 0;
+    }
+}
+
+uint32_t accessor_view_t::get_index(uint32_t index) const noexcept {
+    const auto ptr = get_element(*this, index);
+    switch (component_type) {
+    case GL_UNSIGNED_BYTE:
+        return read_unaligned<uint8_t>(ptr);
+    case GL_UNSIGNED_SHORT:
+        return read_unaligned<uint16_t>(ptr);
+    case GL_UNSIGNED_INT:
+        return read_unaligned<uint32_t>(ptr);
+    default:
+        return UINT32_MAX;
+    }
+}
+
+/// @note round to nearest. The overflow becomes infinity
+static uint16_t to_half(float value) noexcept {
+    const auto bits = read_unaligned<uint32_t>(reinterpret_cast<const std::byte*>(&value));
+    const uint32_t sign = (bits >> 16) & 0x8000;
+    const int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7F'FFFF;
+    if (((bits >> 23) & 0xFF) == 0xFF) // infinity, NaN
+        return static_cast<uint16_t>(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+    if (exponent >= 31)
+        return static_cast<uint16_t>(sign | 0x7C00);
+    if (exponent <= 0) { // subnormal
+        if (exponent < -10)
+            return static_cast<uint16_t>(sign);
+        mantissa |= 0x80'0000;
+        const uint32_t shift = 14 - exponent;
+        return static_cast<uint16_t>(sign | ((mantissa >> shift) + ((mantissa >> (shift - 1)) & 1)));
+    }
+    // the carry of the rounding goes to the exponent
+    return static_cast<uint16_t>((sign | (exponent << 10) | (mantissa >> 13)) + ((mantissa >> 12) & 1));
+}
+
+static float from_half(uint16_t bits) noexcept {
+    const uint32_t exponent = (bits >> 10) & 0x1F;
+    const uint32_t mantissa = bits & 0x3FF;
+    float value = 0;
+    if (exponent == 0)
+        value = std::ldexp(static_cast<float>(mantissa), -24);
+    else if (exponent == 31)
+        value = mantissa ? NAN : INFINITY;
+    else
+        value = std::ldexp(static_cast<float>(mantissa | 0x400), static_cast<int>(exponent) - 25);
+    return (bits & 0x8000) ? -value : value;
+}
+
+static int16_t to_snorm16(float value) noexcept {
+    return static_cast<int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+
+uint32_t mesh_packer_t::add(uint32_t mesh, int32_t material, const accessor_view_t& positions,
+                            const accessor_view_t& normals, const accessor_view_t& uvs,
+                            const accessor_view_t& indices) noexcept(false) {
+    if (positions.data == nullptr || positions.components != 3 || positions.count == 0)
+        return EINVAL;
+    if (normals.count && (normals.components != 3 || normals.count != positions.count))
+        return EINVAL;
+    if (uvs.count && (uvs.components != 2 || uvs.count != positions.count))
+        return EINVAL;
+    if (indices.count && (indices.components != 1 || indices.count % 3))
+        return EINVAL;
+    primitives.emplace_back(primitive_t{mesh, material, positions, normals, uvs, indices});
+    return 0;
+}
+
+size_t packed_scene_t::get_vertex_bytes() const noexcept {
+    size_t count = 0;
+    for (const auto& range : ranges)
+        count += range.vertex_count;
+    return count * stride;
+}
+
+size_t packed_scene_t::get_index_bytes() const noexcept {
+    size_t count = 0;
+    for (const auto& range : ranges)
+        count += range.index_count;
+    return count * index_size;
+}
+
+uint32_t mesh_packer_t::layout(packed_scene_t& scene, float uv_tolerance) const noexcept {
+    size_t vertex_count = 0, index_count = 0;
+    bool wide = false;
+    bool uv_unit = true;
+    float uv_error = 0;
+    for (const auto& p : primitives) {
+        vertex_count += p.positions.count;
+        index_count += p.indices.count ? p.indices.count : p.positions.count;
+        // 0xFFFF is reserved for the primitive restart
+        wide |= p.positions.count > 0xFFFF;
+        for (auto i = 0u; i < p.uvs.count; ++i)
+            for (auto c : {0u, 1u}) {
+                const auto value = p.uvs.get(i, c);
+                uv_unit &= value >= 0.0f && value <= 1.0f;
+                uv_error = std::max(uv_error, std::abs(from_half(to_half(value)) - value));
+            }
+    }
+    if (vertex_count > INT32_MAX || index_count > UINT32_MAX)
+        return EINVAL;
+    scene.uv_format = uv_unit                    ? packed_scene_t::uv_format_t::unorm16
+                      : uv_error < uv_tolerance ? packed_scene_t::uv_format_t::float16
+                                                : packed_scene_t::uv_format_t::float32;
+    scene.uv_offset = 20;
+    scene.stride = scene.uv_offset + (scene.uv_format == packed_scene_t::uv_format_t::float32 ? 8 : 4);
+    scene.index_size = wide ? 4 : 2;
+    try {
+        scene.ranges.clear();
+        scene.ranges.reserve(primitives.size());
+    } catch (const std::bad_alloc&) {
+        return ENOMEM;
+    }
+    uint32_t first_vertex = 0, first_index = 0;
+    for (const auto& p : primitives) {
+        auto& range = scene.ranges.emplace_back();
+        range.first_index = first_index;
+        range.index_count = p.indices.count ? p.indices.count : p.positions.count;
+        range.vertex_offset = static_cast<int32_t>(first_vertex);
+        range.vertex_count = p.positions.count;
+        range.mesh = p.mesh;
+        range.material = p.material;
+        first_vertex += range.vertex_count;
+        first_index += range.index_count;
+    }
+    return 0;
+}
+
+uint32_t mesh_packer_t::write(const packed_scene_t& scene, gsl::span<std::byte> vertices,
+                              gsl::span<std::byte> indices) const noexcept {
+    if (scene.ranges.size() != primitives.size() || vertices.size() < scene.get_vertex_bytes() ||
+        indices.size() < scene.get_index_bytes())
+        return EINVAL;
+    for (auto r = 0u; r < primitives.size(); ++r) {
+        const auto& p = primitives[r];
+        const auto& range = scene.ranges[r];
+        // interleave
+        auto vertex = vertices.data() + size_t(range.vertex_offset) * scene.stride;
+        for (auto i = 0u; i < p.positions.count; ++i, vertex += scene.stride) {
+            const float position[3]{p.positions.get(i, 0), p.positions.get(i, 1), p.positions.get(i, 2)};
+            int16_t normal[4]{0, 0, 32767, 0};
+            if (p.normals.count)
+                for (auto c : {0u, 1u, 2u})
+                    normal[c] = to_snorm16(p.normals.get(i, c));
+            std::memcpy(vertex, position, sizeof(position));
+            std::memcpy(vertex + 12, normal, sizeof(normal));
+            const float uv[2]{p.uvs.count ? p.uvs.get(i, 0) : 0.0f, p.uvs.count ? p.uvs.get(i, 1) : 0.0f};
+            switch (scene.uv_format) {
+            case packed_scene_t::uv_format_t::unorm16: {
+                const uint16_t q[2]{static_cast<uint16_t>(std::lround(uv[0] * 65535.0f)),
+                                    static_cast<uint16_t>(std::lround(uv[1] * 65535.0f))};
+                std::memcpy(vertex + scene.uv_offset, q, sizeof(q));
+                break;
+            }
+            case packed_scene_t::uv_format_t::float16: {
+                const uint16_t q[2]{to_half(uv[0]), to_half(uv[1])};
+                std::memcpy(vertex + scene.uv_offset, q, sizeof(q));
+                break;
+            }
+            default:
+                std::memcpy(vertex + scene.uv_offset, uv, sizeof(uv));
+                break;
+            }
+        }
+        // indices relative to the `vertex_offset`
+        auto dst = indices.data() + size_t{range.first_index} * scene.index_size;
+        for (auto i = 0u; i < range.index_count; ++i, dst += scene.index_size) {
+            const auto index = p.indices.count ? p.indices.get_index(i) : i;
+            if (index >= p.positions.count)
+                return EINVAL;
+            if (scene.index_size == 2) {
+                const auto narrow = static_cast<uint16_t>(index);
+                std::memcpy(dst, &narrow, sizeof(narrow));
+            } else {
+                std::memcpy(dst, &index, sizeof(index));
+            }
+        }
+    }
+    return 0;
+}
+
+uint32_t mesh_packer_t::pack(packed_scene_t& scene, float uv_tolerance) const noexcept {
+    if (auto ec = layout(scene, uv_tolerance))
+        return ec;
+    try {
+        scene.vertices.resize(scene.get_vertex_bytes());
+        scene.indices.resize(scene.get_index_bytes());
+    } catch (const std::bad_alloc&) {
+        return ENOMEM;
+    }
+    return write(scene, scene.vertices, scene.indices);
+}
@@ -0,0 +1,411 @@
+/**
+ * @author Park DongHa (luncliff@gmail.com)
+ * @see https://gfx.cs.princeton.edu/pubs/Sander_2007_%3ETR/tipsy.pdf
+ * @see https://tomforsyth1000.github.io/papers/fast_vert_cache_opt.html
+ */
+#include <graphics.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+#include "trace.h"
+
+namespace fs = std::filesystem;
+
+using namespace std;
+
+/// @brief FIFO cache with the timestamps. A vertex is in the cache if it was inserted in the last `size` misses
+struct fifo_cache_t final {
+    std::vector<uint32_t> timestamps;
+    uint32_t size;
+    uint32_t time;
+
+  public:
+    fifo_cache_t(uint32_t vertex_count, uint32_t cache_size) noexcept(false)
+        : timestamps(vertex_count, 0), size{cache_size}, time{cache_size + 1} {
+    }
+
+    bool contains(uint32_t v) const noexcept {
+        return time - timestamps[v] <= size;
+    }
+    /// @return uint32_t 1 if miss
+    uint32_t access(uint32_t v) noexcept {
+        if (contains(v))
+            return 0;
+        timestamps[v] = time++;
+        return 1;
+    }
+    /// @brief all vertices become older than the cache
+    void flush() noexcept {
+        time += size + 1;
+    }
+};
+
+static bool has_invalid_index(gsl::span<const uint32_t> indices, uint32_t vertex_count) noexcept {
+    return indices.size() % 3 ||
+           std::any_of(indices.begin(), indices.end(), [vertex_count](uint32_t i) { return i >= vertex_count; });
+}
+
+static void finish(vertex_cache_stats_t& stats) noexcept {
+    stats.acmr = stats.triangles ? static_cast<float>(stats.transformed) / stats.triangles : 0;
+    stats.atvr = stats.vertices ? static_cast<float>(stats.transformed) / stats.vertices : 0;
+}
+
+vertex_cache_stats_t get_vertex_cache_stats(gsl::span<const uint32_t> indices, uint32_t vertex_count,
+                                            uint32_t cache_size) noexcept(false) {
+    vertex_cache_stats_t stats{};
+    fifo_cache_t cache{vertex_count, cache_size};
+    std::vector<bool> used(vertex_count, false);
+    for (auto index : indices) {
+        if (index >= vertex_count)
+            continue;
+        stats.transformed += cache.access(index);
+        if (used[index] == false)
+            ++stats.vertices;
+        used[index] = true;
+    }
+    stats.triangles = static_cast<uint32_t>(indices.size() / 3);
+    finish(stats);
+    return stats;
+}
+
+uint32_t optimize_vertex_cache(gsl::span<uint32_t> indices, uint32_t vertex_count,
+                               uint32_t cache_size) noexcept(false) {
+    if (has_invalid_index(indices, vertex_count))
+        return EINVAL;
+    const auto triangle_count = static_cast<uint32_t>(indices.size() / 3);
+    // vertex -> triangles. `offsets[v]` ~ `offsets[v + 1]` in the `adjacency`
+    std::vector<uint32_t> live(vertex_count, 0);
+    for (auto index : indices)
+        ++live[index];
+    std::vector<uint32_t> offsets(vertex_count + 1, 0);
+    std::partial_sum(live.begin(), live.end(), offsets.begin() + 1);
+    std::vector<uint32_t> adjacency(indices.size());
+    {
+        auto cursors = offsets;
+        for (auto i = 0u; i < indices.size(); ++i)
+            adjacency[cursors[indices[i]]++] = i / 3;
+    }
+    fifo_cache_t cache{vertex_count, cache_size};
+    std::vector<bool> emitted(triangle_count, false);
+    std::vector<uint32_t> dead_ends{}, candidates{};
+    std::vector<uint32_t> output{};
+    output.reserve(indices.size());
+    uint32_t cursor = 0; // next vertex in the input order
+    auto fanning = vertex_count ? 0u : UINT32_MAX;
+    while (fanning != UINT32_MAX) {
+        candidates.clear();
+        for (auto k = offsets[fanning]; k < offsets[fanning + 1]; ++k) {
+            const auto t = adjacency[k];
+            if (emitted[t])
+                continue;
+            for (auto c = 0u; c < 3; ++c) {
+                const auto v = indices[t * 3 + c];
+                output.emplace_back(v);
+                dead_ends.emplace_back(v);
+                candidates.emplace_back(v);
+                --live[v];
+                cache.access(v);
+            }
+            emitted[t] = true;
+        }
+        // the candidate which will be in the cache after its remaining triangles are emitted
+        fanning = UINT32_MAX;
+        int64_t best = -1;
+        for (auto v : candidates) {
+            if (live[v] == 0)
+                continue;
+            int64_t priority = 0;
+            const auto age = cache.time - cache.timestamps[v];
+            if (age + 2 * live[v] <= cache_size)
+                priority = age;
+            if (priority > best) {
+                best = priority;
+                fanning = v;
+            }
+        }
+        if (fanning != UINT32_MAX)
+            continue;
+        // dead-end. the recently used vertices, then the input order
+        while (dead_ends.empty() == false && fanning == UINT32_MAX) {
+            const auto v = dead_ends.back();
+            dead_ends.pop_back();
+            if (live[v])
+                fanning = v;
+        }
+        while (cursor < vertex_count && fanning == UINT32_MAX) {
+            if (live[cursor])
+                fanning = cursor;
+            ++cursor;
+        }
+    }
+    std::copy(output.begin(), output.end(), indices.begin());
+    return 0;
+}
+
+uint32_t optimize_overdraw(gsl::span<uint32_t> indices, const accessor_view_t& positions, float threshold,
+                           uint32_t cache_size) noexcept(false) {
+    if (positions.components != 3 || has_invalid_index(indices, positions.count))
+        return EINVAL;
+    const auto triangle_count = static_cast<uint32_t>(indices.size() / 3);
+    if (triangle_count < 2)
+        return 0;
+    fifo_cache_t cache{positions.count, cache_size};
+    auto get_misses = [&cache, &indices](uint32_t t) {
+        return cache.access(indices[t * 3]) + cache.access(indices[t * 3 + 1]) + cache.access(indices[t * 3 + 2]);
+    };
+    // hard boundaries. the triangles which miss all vertices
+    std::vector<uint32_t> hard{};
+    for (auto t = 0u; t < triangle_count; ++t)
+        if (get_misses(t) == 3 || t == 0)
+            hard.emplace_back(t);
+    hard.emplace_back(triangle_count);
+    // soft boundaries. split while the ACMR of the part is under the cluster's
+    std::vector<uint32_t> clusters{};
+    for (auto h = 0u; h + 1 < hard.size(); ++h) {
+        const auto begin = hard[h], end = hard[h + 1];
+        cache.flush();
+        uint32_t misses = 0;
+        for (auto t = begin; t < end; ++t)
+            misses += get_misses(t);
+        const auto limit = threshold * misses / (end - begin);
+        cache.flush();
+        clusters.emplace_back(begin);
+        misses = 0;
+        for (auto t = begin; t < end; ++t) {
+            misses += get_misses(t);
+            if (t + 1 < end && misses <= limit * (t + 1 - clusters.back())) {
+                clusters.emplace_back(t + 1);
+                cache.flush();
+                misses = 0;
+            }
+        }
+    }
+    clusters.emplace_back(triangle_count);
+
+    // area weighted centroids and normals
+    auto load = [&positions](uint32_t v, double (&p)[3]) {
+        for (auto c = 0u; c < 3; ++c)
+            p[c] = positions.get(v, c);
+    };
+    struct cluster_t final {
+        double centroid[3];
+        double normal[3];
+        double area;
+        double key;
+        uint32_t begin, end;
+    };
+    std::vector<cluster_t> sorted(clusters.size() - 1);
+    double center[3]{}, total = 0;
+    for (auto i = 0u; i < sorted.size(); ++i) {
+        auto& cluster = sorted[i];
+        cluster = cluster_t{{0, 0, 0}, {0, 0, 0}, 0, 0, clusters[i], clusters[i + 1]};
+        for (auto t = cluster.begin; t < cluster.end; ++t) {
+            double p0[3]{}, p1[3]{}, p2[3]{};
+            load(indices[t * 3], p0);
+            load(indices[t * 3 + 1], p1);
+            load(indices[t * 3 + 2], p2);
+            const double e1[3]{p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+            const double e2[3]{p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+            const double n[3]{e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2],
+                              e1[0] * e2[1] - e1[1] * e2[0]};
+            const auto area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            for (auto c = 0u; c < 3; ++c) {
+                cluster.centroid[c] += (p0[c] + p1[c] + p2[c]) / 3 * area;
+                cluster.normal[c] += n[c];
+            }
+            cluster.area += area;
+        }
+        for (auto c = 0u; c < 3; ++c)
+            center[c] += cluster.centroid[c];
+        total += cluster.area;
+        if (cluster.area > 0)
+            for (auto& value : cluster.centroid)
+                value /= cluster.area;
+    }
+    if (total > 0)
+        for (auto& value : center)
+            value /= total;
+    for (auto& cluster : sorted) {
+        const auto length = std::sqrt(cluster.normal[0] * cluster.normal[0] + cluster.normal[1] * cluster.normal[1] +
+                                      cluster.normal[2] * cluster.normal[2]);
+        if (length == 0)
+            continue;
+        for (auto c = 0u; c < 3; ++c)
+            cluster.key += (cluster.centroid[c] - center[c]) * cluster.normal[c] / length;
+    }
+    // the outer clusters occlude the others. draw them first
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     [](const cluster_t& lhs, const cluster_t& rhs) { return lhs.key > rhs.key; });
+    std::vector<uint32_t> output{};
+    output.reserve(indices.size());
+    for (const auto& cluster : sorted)
+        output.insert(output.end(), indices.begin() + cluster.begin * 3, indices.begin() + cluster.end * 3);
+    std::copy(output.begin(), output.end(), indices.begin());
+    return 0;
+}
+
+uint32_t optimize_vertex_fetch(gsl::span<uint32_t> indices, uint32_t vertex_count, std::vector<uint32_t>& remap,
+                               uint32_t& used) noexcept(false) {
+    if (has_invalid_index(indices, vertex_count))
+        return EINVAL;
+    remap.assign(vertex_count, UINT32_MAX);
+    used = 0;
+    for (auto& index : indices) {
+        if (remap[index] == UINT32_MAX)
+            remap[index] = used++;
+        index = remap[index];
+    }
+    return 0;
+}
+
+static void accumulate(vertex_cache_stats_t& total, const vertex_cache_stats_t& stats) noexcept {
+    total.transformed += stats.transformed;
+    total.triangles += stats.triangles;
+    total.vertices += stats.vertices;
+}
+
+uint32_t optimize_scene(packed_scene_t& scene, vertex_cache_stats_t& before, vertex_cache_stats_t& after,
+                        uint32_t cache_size) noexcept(false) {
+    TRACE_SCOPE("optimize_scene");
+    before = after = vertex_cache_stats_t{};
+    if ((scene.index_size != 2 && scene.index_size != 4) || scene.stride < 12 ||
+        scene.vertices.size() < scene.get_vertex_bytes() || scene.indices.size() < scene.get_index_bytes())
+        return EINVAL;
+    std::vector<uint32_t> indices{}, remap{};
+    std::vector<std::byte> vertices{};
+    for (const auto& range : scene.ranges) {
+        if (range.index_count % 3)
+            return EINVAL;
+        auto src = scene.indices.data() + size_t{range.first_index} * scene.index_size;
+        indices.resize(range.index_count);
+        for (auto& index : indices) {
+            if (scene.index_size == 2) {
+                uint16_t narrow = 0;
+                std::memcpy(&narrow, src, sizeof(narrow));
+                index = narrow;
+            } else {
+                std::memcpy(&index, src, sizeof(index));
+            }
+            src += scene.index_size;
+        }
+        auto range_vertices = scene.vertices.data() + size_t(range.vertex_offset) * scene.stride;
+        accessor_view_t positions{range_vertices, range.vertex_count, scene.stride, GL_FLOAT, 3};
+        accumulate(before, get_vertex_cache_stats(indices, range.vertex_count, cache_size));
+
+        if (auto ec = optimize_vertex_cache(indices, range.vertex_count, cache_size))
+            return ec;
+        if (auto ec = optimize_overdraw(indices, positions, 1.05f, cache_size))
+            return ec;
+        uint32_t used = 0;
+        if (auto ec = optimize_vertex_fetch(indices, range.vertex_count, remap, used))
+            return ec;
+        // move the vertices in the range. the unused ones go to the end
+        const auto range_bytes = size_t{range.vertex_count} * scene.stride;
+        vertices.assign(range_vertices, range_vertices + range_bytes);
+        for (auto v = 0u; v < range.vertex_count; ++v) {
+            if (remap[v] == UINT32_MAX)
+                remap[v] = used++;
+            std::memcpy(range_vertices + size_t{remap[v]} * scene.stride, vertices.data() + size_t{v} * scene.stride,
+                        scene.stride);
+        }
+        auto dst = scene.indices.data() + size_t{range.first_index} * scene.index_size;
+        for (auto index : indices) {
+            if (scene.index_size == 2) {
+                const auto narrow = static_cast<uint16_t>(index);
+                std::memcpy(dst, &narrow, sizeof(narrow));
+            } else {
+                std::memcpy(dst, &index, sizeof(index));
+            }
+            dst += scene.index_size;
+        }
+        accumulate(after, get_vertex_cache_stats(indices, range.vertex_count, cache_size));
+    }
+    finish(before);
+    finish(after);
+    return 0;
+}
+
+mesh_cache_t::mesh_cache_t(const fs::path& _directory) noexcept : directory{_directory} {
+    std::error_code fec{};
+    fs::create_directories(directory, fec);
+    ec = fec.value();
+}
+
+uint32_t mesh_cache_t::is_valid() const noexcept {
+    return ec;
+}
+
+fs::path mesh_cache_t::get_path(uint64_t key) const noexcept(false) {
+    char name[32]{};
+    snprintf(name, sizeof(name), "%016llx.mesh", static_cast<unsigned long long>(key));
+    return directory / name;
+}
+
+uint64_t mesh_cache_t::make_key(const packed_scene_t& scene, uint32_t cache_size) noexcept {
+    auto key = hash_content(gsl::as_bytes(gsl::make_span(&cache_size, 1)));
+    key = hash_content(gsl::as_bytes(gsl::make_span(scene.ranges.data(), scene.ranges.size())), key);
+    key = hash_content(scene.vertices, key);
+    return hash_content(scene.indices, key);
+}
+
+uint32_t mesh_cache_t::load(uint64_t key, header_t& header, packed_scene_t& scene) noexcept {
+    try {
+        mapped_file_t file{get_path(key)};
+        if (auto ec = file.is_valid()) {
+            ++miss;
+            return ec;
+        }
+        const auto bytes = file.bytes();
+        if (bytes.size() >= sizeof(header_t))
+            memcpy(&header, bytes.data(), sizeof(header_t));
+        const auto range_bytes = header.range_count * sizeof(packed_scene_t::draw_range_t);
+        if (bytes.size() < sizeof(header_t) || header.version != version || header.stride != scene.stride ||
+            header.index_size != scene.index_size ||
+            bytes.size() != sizeof(header_t) + range_bytes + header.vertex_bytes + header.index_bytes) {
+            ++miss;
+            return EBADMSG;
+        }
+        auto src = bytes.data() + sizeof(header_t);
+        scene.ranges.resize(header.range_count);
+        memcpy(scene.ranges.data(), src, range_bytes);
+        src += range_bytes;
+        scene.vertices.assign(src, src + header.vertex_bytes);
+        src += header.vertex_bytes;
+        scene.indices.assign(src, src + header.index_bytes);
+        ++hit;
+        return 0;
+    } catch (const std::bad_alloc&) {
+        return ENOMEM;
+    }
+}
+
+uint32_t mesh_cache_t::store(uint64_t key, const header_t& header, const packed_scene_t& scene) noexcept {
+    try {
+        const auto ranges = gsl::as_bytes(gsl::make_span(scene.ranges.data(), scene.ranges.size()));
+        const auto vertices = gsl::make_span(scene.vertices.data(), scene.vertices.size());
+        const auto indices = gsl::make_span(scene.indices.data(), scene.indices.size());
+        return write_and_rename(get_path(key), {gsl::as_bytes(gsl::make_span(&header, 1)), ranges, vertices, indices});
+    } catch (const std::bad_alloc&) {
+        return ENOMEM;
+    }
+}
+
+uint32_t mesh_cache_t::load_or_optimize(packed_scene_t& scene, header_t& header, uint32_t cache_size) noexcept {
+    TRACE_SCOPE("mesh_cache_t::load_or_optimize");
+    const auto key = make_key(scene, cache_size);
+    if (load(key, header, scene) == 0)
+        return 0;
+    try {
+        header = header_t{version, cache_size, scene.stride, scene.index_size, scene.ranges.size(),
+                          scene.vertices.size(), scene.indices.size()};
+        if (auto ec = optimize_scene(scene, header.before, header.after, cache_size))
+            return ec;
+        return store(key, header, scene);
+    } catch (const std::bad_alloc&) {
+        return ENOMEM;
+    }
+}
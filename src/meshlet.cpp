@@ -0,0 +1,459 @@
+/**
+ * @author Park DongHa (luncliff@gmail.com)
+ * @see https://zeux.io/2023/01/16/meshlet-size-tradeoffs/
+ * @see https://www.gamedevs.org/uploads/fast-extraction-viewing-frustum-planes-from-world-view-projection-matrix.pdf
+ */
+#include <graphics.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#include "trace.h"
+
+static void load_position(const packed_scene_t& scene, size_t vertex, float (&p)[3]) noexcept {
+    std::memcpy(p, scene.vertices.data() + vertex * scene.stride, sizeof(p));
+}
+
+static uint32_t load_index(const packed_scene_t& scene, size_t i) noexcept {
+    if (scene.index_size == 2) {
+        uint16_t narrow = 0;
+        std::memcpy(&narrow, scene.indices.data() + i * 2, sizeof(narrow));
+        return narrow;
+    }
+    uint32_t index = 0;
+    std::memcpy(&index, scene.indices.data() + i * 4, sizeof(index));
+    return index;
+}
+
+static float dot(const float* lhs, const float* rhs) noexcept {
+    return lhs[0] * rhs[0] + lhs[1] * rhs[1] + lhs[2] * rhs[2];
+}
+
+static void transform(const float (&m)[16], const float (&local)[3], float (&world)[3]) noexcept {
+    for (auto r = 0u; r < 3; ++r)
+        world[r] = m[r] * local[0] + m[4 + r] * local[1] + m[8 + r] * local[2] + m[12 + r];
+}
+
+/// @brief the largest scale of the axes for the radius
+static float get_max_scale(const float (&m)[16]) noexcept {
+    float scale = 0;
+    for (auto c = 0u; c < 3; ++c)
+        scale = std::max(scale, std::sqrt(dot(m + c * 4, m + c * 4)));
+    return scale;
+}
+
+/// @brief sphere of the AABB center, and the cone of the triangle normals
+static void make_bounds(const packed_scene_t& scene, meshlet_t& meshlet) noexcept {
+    const auto& range = scene.ranges[meshlet.range];
+    float lower[3]{INFINITY, INFINITY, INFINITY}, upper[3]{-INFINITY, -INFINITY, -INFINITY};
+    float axis[3]{};
+    const auto triangle_count = meshlet.index_count / 3;
+    auto get_vertex = [&](uint32_t i) {
+        return size_t(range.vertex_offset) + load_index(scene, size_t{meshlet.first_index} + i);
+    };
+    auto get_normal = [&](uint32_t t, float (&n)[3]) {
+        float p[3][3]{};
+        for (auto c = 0u; c < 3; ++c)
+            load_position(scene, get_vertex(t * 3 + c), p[c]);
+        const float e1[3]{p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2]};
+        const float e2[3]{p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2]};
+        n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+        n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+        n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+        const auto length = std::sqrt(dot(n, n));
+        for (auto& value : n)
+            value = length > 0 ? value / length : 0;
+        return length > 0;
+    };
+    for (auto i = 0u; i < meshlet.index_count; ++i) {
+        float p[3]{};
+        load_position(scene, get_vertex(i), p);
+        for (auto c = 0u; c < 3; ++c) {
+            lower[c] = std::min(lower[c], p[c]);
+            upper[c] = std::max(upper[c], p[c]);
+        }
+    }
+    for (auto t = 0u; t < triangle_count; ++t) {
+        float n[3]{};
+        if (get_normal(t, n))
+            for (auto c = 0u; c < 3; ++c)
+                axis[c] += n[c];
+    }
+    meshlet.radius = 0;
+    for (auto c = 0u; c < 3; ++c)
+        meshlet.center[c] = (lower[c] + upper[c]) / 2;
+    for (auto i = 0u; i < meshlet.index_count; ++i) {
+        float p[3]{};
+        load_position(scene, get_vertex(i), p);
+        const float d[3]{p[0] - meshlet.center[0], p[1] - meshlet.center[1], p[2] - meshlet.center[2]};
+        meshlet.radius = std::max(meshlet.radius, std::sqrt(dot(d, d)));
+    }
+    const auto length = std::sqrt(dot(axis, axis));
+    for (auto c = 0u; c < 3; ++c)
+        meshlet.cone_axis[c] = length > 0 ? axis[c] / length : 0;
+    // the spread is the largest angle between the axis and the normals
+    float min_dot = length > 0 ? 1.0f : -1.0f;
+    for (auto t = 0u; t < triangle_count; ++t) {
+        float n[3]{};
+        if (get_normal(t, n))
+            min_dot = std::min(min_dot, dot(n, meshlet.cone_axis));
+    }
+    meshlet.cone_cutoff = min_dot <= 0 ? 1.0f : std::sqrt(1 - min_dot * min_dot);
+}
+
+uint32_t build_meshlets(const packed_scene_t& scene, std::vector<meshlet_t>& meshlets, uint32_t max_vertices,
+                        uint32_t max_triangles) noexcept(false) {
+    TRACE_SCOPE("build_meshlets");
+    meshlets.clear();
+    if (max_vertices < 3 || max_triangles < 1 || scene.stride < 12 || (scene.index_size != 2 && scene.index_size != 4))
+        return EINVAL;
+    if (scene.vertices.size() < scene.get_vertex_bytes() || scene.indices.size() < scene.get_index_bytes())
+        return EINVAL;
+    // the last meshlet which used the vertex
+    std::vector<uint32_t> owners{};
+    for (auto r = 0u; r < scene.ranges.size(); ++r) {
+        const auto& range = scene.ranges[r];
+        if (range.index_count % 3)
+            return EINVAL;
+        owners.assign(range.vertex_count, UINT32_MAX);
+        meshlet_t meshlet{range.first_index, 0, range.vertex_offset, r};
+        uint32_t vertex_count = 0;
+        for (auto i = 0u; i < range.index_count; i += 3) {
+            const auto current = static_cast<uint32_t>(meshlets.size());
+            uint32_t vertices[3]{};
+            uint32_t unique = 0, added = 0;
+            for (auto c = 0u; c < 3; ++c) {
+                vertices[c] = load_index(scene, size_t{range.first_index} + i + c);
+                if (vertices[c] >= range.vertex_count)
+                    return EINVAL;
+                // count the duplicated vertex of the degenerate triangle only once
+                if (std::find(vertices, vertices + c, vertices[c]) != vertices + c)
+                    continue;
+                ++unique;
+                if (owners[vertices[c]] != current)
+                    ++added;
+            }
+            if (meshlet.index_count / 3 == max_triangles || vertex_count + added > max_vertices) {
+                make_bounds(scene, meshlets.emplace_back(meshlet));
+                meshlet.first_index += meshlet.index_count;
+                meshlet.index_count = 0;
+                vertex_count = 0;
+                added = unique;
+            }
+            for (auto v : vertices)
+                owners[v] = static_cast<uint32_t>(meshlets.size());
+            vertex_count += added;
+            meshlet.index_count += 3;
+        }
+        if (meshlet.index_count)
+            make_bounds(scene, meshlets.emplace_back(meshlet));
+    }
+    return 0;
+}
+
+void make_frustum(const float (&m)[16], const float (&camera)[3], frustum_t& frustum) noexcept {
+    // row i of the column major matrix
+    auto row = [&m](uint32_t i, uint32_t c) { return m[c * 4 + i]; };
+    for (auto c = 0u; c < 4; ++c) {
+        frustum.planes[0][c] = row(3, c) + row(0, c); // left
+        frustum.planes[1][c] = row(3, c) - row(0, c); // right
+        frustum.planes[2][c] = row(3, c) + row(1, c); // bottom
+        frustum.planes[3][c] = row(3, c) - row(1, c); // top
+        frustum.planes[4][c] = row(3, c) + row(2, c); // near
+        frustum.planes[5][c] = row(3, c) - row(2, c); // far
+    }
+    for (auto& plane : frustum.planes) {
+        const auto length = std::sqrt(dot(plane, plane));
+        if (length > 0)
+            for (auto& value : plane)
+                value /= length;
+    }
+    std::copy(camera, camera + 3, frustum.camera);
+}
+
+struct meshlet_culler_t::impl_t final {
+    static constexpr uint32_t instances_per_chunk = 64;
+
+    /// @brief meshlets of each range. `[begin, end)` in the `meshlets` and the sphere of them
+    struct span_t final {
+        uint32_t mesh;
+        uint32_t begin;
+        uint32_t end;
+        float center[3];
+        float radius;
+    };
+
+    std::mutex mtx{};
+    std::condition_variable jobs_cv{};
+    std::condition_variable done_cv{};
+    std::vector<std::thread> workers{};
+    uint64_t generation = 0;
+    uint32_t running = 0; // workers in the current generation
+    bool stop = false;
+
+    // the current job
+    const packed_scene_t* scene = nullptr;
+    gsl::span<const meshlet_t> meshlets{};
+    const frustum_t* frustum = nullptr;
+    std::vector<span_t> spans{};
+    std::atomic<uint32_t> next{};
+    uint32_t chunk_count = 0;
+    std::vector<std::vector<draw_indexed_command_t>> outputs{};
+    std::atomic<uint32_t> visible{};
+
+  public:
+    void run() noexcept {
+        uint64_t seen = 0;
+        for (;;) {
+            {
+                std::unique_lock lck{mtx};
+                jobs_cv.wait(lck, [this, seen]() { return stop || generation != seen; });
+                if (stop)
+                    return;
+                seen = generation;
+            }
+            work();
+            {
+                std::lock_guard lck{mtx};
+                --running;
+            }
+            done_cv.notify_all();
+        }
+    }
+
+    void work() noexcept {
+        for (auto chunk = next.fetch_add(1); chunk < chunk_count; chunk = next.fetch_add(1))
+            cull_chunk(chunk);
+    }
+
+    void cull_chunk(uint32_t chunk) noexcept {
+        auto& commands = outputs[chunk];
+        commands.clear();
+        const auto begin = chunk * instances_per_chunk;
+        const auto end = std::min<size_t>(begin + instances_per_chunk, scene->instances.size());
+        uint32_t count = 0;
+        for (auto i = begin; i < end; ++i) {
+            const auto& instance = scene->instances[i];
+            const auto& m = instance.transform;
+            const auto scale = get_max_scale(m);
+            for (const auto& span : spans) {
+                if (span.mesh != instance.mesh || is_inside(span.center, span.radius, m, scale) == false)
+                    continue;
+                for (auto k = span.begin; k < span.end; ++k) {
+                    const auto& meshlet = meshlets[k];
+                    if (is_visible(meshlet, m, scale) == false)
+                        continue;
+                    ++count;
+                    if (commands.empty() == false) {
+                        auto& last = commands.back();
+                        if (last.first_instance == i && last.vertex_offset == meshlet.vertex_offset &&
+                            last.first_index + last.index_count == meshlet.first_index) {
+                            last.index_count += meshlet.index_count;
+                            continue;
+                        }
+                    }
+                    commands.emplace_back(draw_indexed_command_t{meshlet.index_count, 1, meshlet.first_index,
+                                                                 meshlet.vertex_offset, static_cast<uint32_t>(i)});
+                }
+            }
+        }
+        visible += count;
+    }
+
+    bool is_inside(const float (&local)[3], float radius, const float (&m)[16], float scale) const noexcept {
+        float center[3]{};
+        transform(m, local, center);
+        for (const auto& plane : frustum->planes)
+            if (dot(plane, center) + plane[3] < -radius * scale)
+                return false;
+        return true;
+    }
+
+    bool is_visible(const meshlet_t& meshlet, const float (&m)[16], float scale) const noexcept {
+        if (is_inside(meshlet.center, meshlet.radius, m, scale) == false)
+            return false;
+        float center[3]{};
+        transform(m, meshlet.center, center);
+        const auto radius = meshlet.radius * scale;
+        if (meshlet.cone_cutoff >= 1)
+            return true;
+        // the normals are not transformed with the inverse transpose. fine for the uniform scale
+        float axis[3]{};
+        for (auto r = 0u; r < 3; ++r)
+            axis[r] = m[r] * meshlet.cone_axis[0] + m[4 + r] * meshlet.cone_axis[1] + m[8 + r] * meshlet.cone_axis[2];
+        const auto length = std::sqrt(dot(axis, axis));
+        if (length == 0)
+            return true;
+        const float view[3]{center[0] - frustum->camera[0], center[1] - frustum->camera[1],
+                            center[2] - frustum->camera[2]};
+        // all triangles are facing away from any point in the sphere
+        return dot(view, axis) / length < meshlet.cone_cutoff * std::sqrt(dot(view, view)) + radius;
+    }
+};
+
+meshlet_culler_t::meshlet_culler_t(uint32_t num_threads) noexcept {
+    try {
+        impl = std::make_unique<impl_t>();
+        if (num_threads == 0)
+            num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+        for (auto i = 1u; i < num_threads; ++i)
+            impl->workers.emplace_back(&impl_t::run, impl.get());
+    } catch (const std::system_error& ex) {
+        ec = ex.code().value();
+    } catch (const std::bad_alloc&) {
+        ec = ENOMEM;
+    }
+}
+
+meshlet_culler_t::~meshlet_culler_t() noexcept {
+    if (impl == nullptr)
+        return;
+    {
+        std::lock_guard lck{impl->mtx};
+        impl->stop = true;
+    }
+    impl->jobs_cv.notify_all();
+    for (auto& worker : impl->workers)
+        worker.join();
+}
+
+uint32_t meshlet_culler_t::is_valid() const noexcept {
+    return ec;
+}
+
+uint32_t meshlet_culler_t::cull(const packed_scene_t& scene, gsl::span<const meshlet_t> meshlets, //
+                                const frustum_t& frustum,
+                                std::vector<draw_indexed_command_t>& commands) noexcept(false) {
+    TRACE_SCOPE("meshlet_culler_t::cull");
+    commands.clear();
+    tested = visible = 0;
+    if (ec)
+        return ec;
+    // the meshlets of a range are contiguous
+    impl->spans.clear();
+    for (auto k = 0u; k < meshlets.size(); ++k) {
+        const auto range = meshlets[k].range;
+        if (range >= scene.ranges.size())
+            return EINVAL;
+        if (k && meshlets[k - 1].range == range) {
+            impl->spans.back().end = k + 1;
+            continue;
+        }
+        impl->spans.emplace_back(impl_t::span_t{scene.ranges[range].mesh, k, k + 1});
+    }
+    for (auto& span : impl->spans) {
+        // the box of the meshlet spheres, then the sphere which contains them
+        float lower[3]{INFINITY, INFINITY, INFINITY}, upper[3]{-INFINITY, -INFINITY, -INFINITY};
+        for (auto k = span.begin; k < span.end; ++k)
+            for (auto c = 0u; c < 3; ++c) {
+                lower[c] = std::min(lower[c], meshlets[k].center[c] - meshlets[k].radius);
+                upper[c] = std::max(upper[c], meshlets[k].center[c] + meshlets[k].radius);
+            }
+        span.radius = 0;
+        for (auto c = 0u; c < 3; ++c)
+            span.center[c] = (lower[c] + upper[c]) / 2;
+        for (auto k = span.begin; k < span.end; ++k) {
+            const float d[3]{meshlets[k].center[0] - span.center[0], meshlets[k].center[1] - span.center[1],
+                             meshlets[k].center[2] - span.center[2]};
+            span.radius = std::max(span.radius, std::sqrt(dot(d, d)) + meshlets[k].radius);
+        }
+    }
+    for (const auto& instance : scene.instances)
+        for (const auto& span : impl->spans)
+            if (span.mesh == instance.mesh)
+                tested += span.end - span.begin;
+
+    impl->scene = &scene;
+    impl->meshlets = meshlets;
+    impl->frustum = &frustum;
+    impl->chunk_count = static_cast<uint32_t>((scene.instances.size() + impl_t::instances_per_chunk - 1) /
+                                              impl_t::instances_per_chunk);
+    impl->outputs.resize(std::max<size_t>(impl->outputs.size(), impl->chunk_count));
+    impl->next = 0;
+    impl->visible = 0;
+    if (impl->workers.empty() == false) {
+        {
+            std::lock_guard lck{impl->mtx};
+            impl->running = static_cast<uint32_t>(impl->workers.size());
+            ++impl->generation;
+        }
+        impl->jobs_cv.notify_all();
+    }
+    impl->work();
+    {
+        std::unique_lock lck{impl->mtx};
+        impl->done_cv.wait(lck, [this]() { return impl->running == 0; });
+    }
+    for (auto chunk = 0u; chunk < impl->chunk_count; ++chunk)
+        commands.insert(commands.end(), impl->outputs[chunk].begin(), impl->outputs[chunk].end());
+    visible = impl->visible;
+    return 0;
+}
+
+uint32_t make_draw_objects(const packed_scene_t& scene, std::vector<draw_object_t>& objects) noexcept(false) {
+    TRACE_SCOPE("make_draw_objects");
+    objects.clear();
+    if (scene.stride < 12 || scene.vertices.size() < scene.get_vertex_bytes())
+        return EINVAL;
+    // the spheres of the ranges in the mesh space
+    std::vector<draw_object_t> locals(scene.ranges.size());
+    for (auto r = 0u; r < scene.ranges.size(); ++r) {
+        const auto& range = scene.ranges[r];
+        if (range.vertex_offset < 0)
+            return EINVAL;
+        const auto first = size_t(range.vertex_offset);
+        float lower[3]{INFINITY, INFINITY, INFINITY}, upper[3]{-INFINITY, -INFINITY, -INFINITY};
+        for (auto v = first; v < first + range.vertex_count; ++v) {
+            float p[3]{};
+            load_position(scene, v, p);
+            for (auto c = 0u; c < 3; ++c) {
+                lower[c] = std::min(lower[c], p[c]);
+                upper[c] = std::max(upper[c], p[c]);
+            }
+        }
+        auto& local = locals[r];
+        for (auto c = 0u; c < 3; ++c)
+            local.center[c] = range.vertex_count ? (lower[c] + upper[c]) / 2 : 0;
+        for (auto v = first; v < first + range.vertex_count; ++v) {
+            float p[3]{};
+            load_position(scene, v, p);
+            const float d[3]{p[0] - local.center[0], p[1] - local.center[1], p[2] - local.center[2]};
+            local.radius = std::max(local.radius, std::sqrt(dot(d, d)));
+        }
+    }
+    for (auto i = 0u; i < scene.instances.size(); ++i) {
+        const auto& instance = scene.instances[i];
+        const auto scale = get_max_scale(instance.transform);
+        for (auto r = 0u; r < scene.ranges.size(); ++r) {
+            const auto& range = scene.ranges[r];
+            if (range.mesh != instance.mesh || range.index_count == 0)
+                continue;
+            auto& object = objects.emplace_back();
+            transform(instance.transform, locals[r].center, object.center);
+            object.radius = locals[r].radius * scale;
+            object.index_count = range.index_count;
+            object.first_index = range.first_index;
+            object.vertex_offset = range.vertex_offset;
+            object.instance = i;
+        }
+    }
+    return 0;
+}
+
+void cull_draw_objects(gsl::span<const draw_object_t> objects, const frustum_t& frustum,
+                       std::vector<draw_indexed_command_t>& commands) noexcept(false) {
+    commands.clear();
+    for (const auto& object : objects) {
+        bool inside = true;
+        for (const auto& plane : frustum.planes)
+            inside = inside && dot(plane, object.center) + plane[3] >= -object.radius;
+        if (inside)
+            commands.emplace_back(draw_indexed_command_t{object.index_count, 1, object.first_index,
+                                                         object.vertex_offset, object.instance});
+    }
+}
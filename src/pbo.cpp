@@ -1,16 +1,15 @@
 #include <graphics.h>
 #include <spdlog/spdlog.h>
 
+#include "trace.h"
+
 pbo_reader_t::pbo_reader_t(GLuint length) noexcept : pbos{}, length{length}, offset{}, ec{GL_NO_ERROR} {
-    spdlog::trace(__FUNCTION__);
+    SPDLOG_TRACE(__FUNCTION__);
     glGenBuffers(capacity, pbos);
     if (ec = glGetError())
         return;
     for (auto i = 0u; i < capacity; ++i) {
-        spdlog::debug("- pbo:");
-        spdlog::debug("  id: {}", pbos[i]);
-        spdlog::debug("  length: {}", length);
-        spdlog::debug("  usage: GL_STREAM_READ");
+        SPDLOG_DEBUG("pbo: {} length: {} usage: GL_STREAM_READ", pbos[i], length);
         glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[i]);
         glBufferData(GL_PIXEL_PACK_BUFFER, length, nullptr, GL_STREAM_READ);
     }
@@ -22,26 +21,24 @@ GLenum pbo_reader_t::is_valid() const noexcept {
 }
 
 pbo_reader_t::~pbo_reader_t() noexcept {
-    spdlog::trace(__FUNCTION__);
+    SPDLOG_TRACE(__FUNCTION__);
     for (auto i = 0u; i < capacity; ++i)
-        spdlog::debug("- pbo: {}", pbos[i]);
+        SPDLOG_DEBUG("pbo: {}", pbos[i]);
     // delete and report if error generated
     glDeleteBuffers(capacity, pbos);
     if (auto ec = glGetError())
-        spdlog::error("{} {}", __FUNCTION__, get_opengl_category().message(ec));
+        spdlog::error("{}: {:#x}", "glDeleteBuffers", ec);
 }
 
 GLenum pbo_reader_t::pack(uint16_t idx, GLuint fbo, const GLint frame[4], GLenum format, GLenum type) noexcept {
-    spdlog::trace(__FUNCTION__);
+    SPDLOG_TRACE(__FUNCTION__);
+    TRACE_SCOPE("pbo_reader_t::pack");
     if (idx >= capacity)
         return GL_INVALID_VALUE;
     //if (length < (frame[2] - frame[0]) * (frame[3] - frame[1]) * 4)
     //    return GL_OUT_OF_MEMORY;
-    spdlog::debug("- pack:");
-    spdlog::debug("  pbo: {}", pbos[idx]);
-    spdlog::debug("  format: {:#x}", format);
-    spdlog::debug("  type: {:#x}", type);
-    spdlog::debug("  frame: '{} {} {} {}'", frame[0], frame[1], frame[2], frame[3]);
+    SPDLOG_DEBUG("pack: pbo {} format {:#x} type {:#x} frame '{} {} {} {}'", pbos[idx], format, type, //
+                 frame[0], frame[1], frame[2], frame[3]);
     glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[idx]);
     glReadPixels(frame[0], frame[1], frame[2], frame[3], format, type, reinterpret_cast<void*>(offset));
     if (auto ec = glGetError())
@@ -51,30 +48,28 @@ GLenum pbo_reader_t::pack(uint16_t idx, GLuint fbo, const GLint frame[4], GLenum
 }
 
 GLenum pbo_reader_t::map_and_invoke(uint16_t idx, reader_callback_t callback, void* user_data) noexcept {
-    spdlog::trace(__FUNCTION__);
+    SPDLOG_TRACE(__FUNCTION__);
+    TRACE_SCOPE("pbo_reader_t::map_and_invoke");
     if (idx >= capacity)
         return GL_INVALID_VALUE;
     glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[idx]);
     if (const void* ptr = glMapBufferRange(GL_PIXEL_PACK_BUFFER, offset, length, GL_MAP_READ_BIT)) {
-        spdlog::debug("- mapping:");
-        spdlog::debug("  pbo: {}", pbos[idx]);
-        spdlog::debug("  offset: {}", offset);
+        SPDLOG_DEBUG("mapping: pbo {} offset {}", pbos[idx], offset);
         callback(user_data, ptr, length);
         glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
     }
-    return glGetError();
+    const auto ec = glGetError();
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0); // the following glReadPixels may use client memory
+    return ec;
 }
 
 pbo_writer_t::pbo_writer_t(GLuint length) noexcept : pbos{}, length{length}, ec{GL_NO_ERROR} {
-    spdlog::trace(__FUNCTION__);
+    SPDLOG_TRACE(__FUNCTION__);
     glGenBuffers(capacity, pbos);
     if (ec = glGetError())
         return;
     for (auto i = 0u; i < capacity; ++i) {
-        spdlog::debug("- pbo:");
-        spdlog::debug("  id: {}", pbos[i]);
-        spdlog::debug("  length: {}", length);
-        spdlog::debug("  usage: GL_STREAM_DRAW");
+        SPDLOG_DEBUG("pbo: {} length: {} usage: GL_STREAM_DRAW", pbos[i], length);
         glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbos[i]);
         glBufferData(GL_PIXEL_UNPACK_BUFFER, length, nullptr, GL_STREAM_DRAW);
     }
@@ -86,18 +81,19 @@ GLenum pbo_writer_t::is_valid() const noexcept {
 }
 
 pbo_writer_t::~pbo_writer_t() noexcept {
-    spdlog::trace(__FUNCTION__);
+    SPDLOG_TRACE(__FUNCTION__);
     for (auto i = 0u; i < capacity; ++i)
-        spdlog::debug("- pbo: {}", pbos[i]);
+        SPDLOG_DEBUG("pbo: {}", pbos[i]);
     // delete and report if error generated
     glDeleteBuffers(capacity, pbos);
     if (auto ec = glGetError())
-        spdlog::error("{} {}", __FUNCTION__, get_opengl_category().message(ec));
+        spdlog::error("{}: {:#x}", "glDeleteBuffers", ec);
 }
 
 /// @todo GL_MAP_UNSYNCHRONIZED_BIT?
 GLenum pbo_writer_t::map_and_invoke(uint16_t idx, writer_callback_t callback, void* user_data) noexcept {
-    spdlog::trace(__FUNCTION__);
+    SPDLOG_TRACE(__FUNCTION__);
+    TRACE_SCOPE("pbo_writer_t::map_and_invoke");
     if (idx >= capacity)
         return GL_INVALID_VALUE;
     // 1 is for write (upload)
@@ -112,7 +108,8 @@ GLenum pbo_writer_t::map_and_invoke(uint16_t idx, writer_callback_t callback, vo
 
 GLenum pbo_writer_t::unpack(uint16_t idx, GLuint tex2d, const GLint frame[4], //
                             GLenum format, GLenum type) noexcept {
-    spdlog::trace(__FUNCTION__);
+    SPDLOG_TRACE(__FUNCTION__);
+    TRACE_SCOPE("pbo_writer_t::unpack");
     if (idx >= capacity)
         return GL_INVALID_VALUE;
     GLenum ec = GL_NO_ERROR;
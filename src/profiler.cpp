@@ -0,0 +1,204 @@
+/**
+ * @author Park DongHa (luncliff@gmail.com)
+ * @see https://www.khronos.org/registry/OpenGL/extensions/EXT/EXT_disjoint_timer_query.txt
+ */
+#include <graphics.h>
+#include <spdlog/spdlog.h>
+
+#include <cinttypes>
+
+#include "trace.h"
+
+// clang-format off
+#if !defined(GL_EXT_disjoint_timer_query)
+#   define GL_QUERY_COUNTER_BITS_EXT 0x8864
+#   define GL_TIME_ELAPSED_EXT 0x88BF
+#   define GL_TIMESTAMP_EXT 0x8E28
+#   define GL_GPU_DISJOINT_EXT 0x8FBB
+#endif
+// clang-format on
+
+using query_counter_t = void(GL_APIENTRY*)(GLuint id, GLenum target);
+using get_query_object_ui64v_t = void(GL_APIENTRY*)(GLuint id, GLenum pname, GLuint64* params);
+
+/// @note the functions are not in the ES 3.0 core. They must be acquired with `eglGetProcAddress`
+struct timer_query_procs_t final {
+    query_counter_t query_counter = nullptr;
+    get_query_object_ui64v_t get_query_object_ui64v = nullptr;
+
+  public:
+    timer_query_procs_t() noexcept
+        : query_counter{reinterpret_cast<query_counter_t>(eglGetProcAddress("glQueryCounterEXT"))},
+          get_query_object_ui64v{
+              reinterpret_cast<get_query_object_ui64v_t>(eglGetProcAddress("glGetQueryObjectui64vEXT"))} {
+    }
+};
+
+const timer_query_procs_t& get_timer_query_procs() noexcept {
+    static timer_query_procs_t procs{};
+    return procs;
+}
+
+timer_query_t::timer_query_t() noexcept {
+    const auto& procs = get_timer_query_procs();
+    if (has_gl_extension("GL_EXT_disjoint_timer_query") == false || procs.get_query_object_ui64v == nullptr) {
+        ec = GL_INVALID_OPERATION;
+        return;
+    }
+    GLint bits = 0;
+    glGetQueryiv(GL_TIMESTAMP_EXT, GL_QUERY_COUNTER_BITS_EXT, &bits);
+    if (glGetError() != GL_NO_ERROR) // some drivers reject GL_TIMESTAMP_EXT here. consume it
+        bits = 0;
+    use_counter = bits > 0 && procs.query_counter != nullptr;
+    SPDLOG_DEBUG("timer query: {}", use_counter ? "GL_TIMESTAMP_EXT" : "GL_TIME_ELAPSED_EXT");
+    glGenQueries(capacity * max_region * 2, &queries[0][0]);
+    if (ec = glGetError(); ec != GL_NO_ERROR)
+        return;
+    // the first read clears the disjoint state
+    GLint disjoint = 0;
+    glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+    ec = glGetError();
+}
+
+timer_query_t::~timer_query_t() noexcept {
+    if (queries[0][0] == 0)
+        return;
+    glDeleteQueries(capacity * max_region * 2, &queries[0][0]);
+    if (auto ec = glGetError())
+        spdlog::error("{}: {:#x}", "glDeleteQueries", ec);
+}
+
+GLenum timer_query_t::is_valid() const noexcept {
+    return ec;
+}
+
+uint32_t timer_query_t::get_dropped() const noexcept {
+    return dropped;
+}
+
+void timer_query_t::next_frame() noexcept {
+    frame = (frame + 1) % capacity;
+    if (pending[frame]) // GPU is too far behind. don't wait for it
+        ++dropped;
+    pending[frame] = false;
+    counts[frame] = 0;
+}
+
+uint16_t timer_query_t::begin(gsl::czstring<> name) noexcept {
+    auto& count = counts[frame];
+    if (ec != GL_NO_ERROR || count >= max_region)
+        return UINT16_MAX;
+    const uint16_t region = count++;
+    names[frame][region] = name;
+    pending[frame] = true;
+    const GLuint query = queries[frame][region * 2];
+    if (use_counter)
+        get_timer_query_procs().query_counter(query, GL_TIMESTAMP_EXT);
+    else
+        glBeginQuery(GL_TIME_ELAPSED_EXT, query);
+    return region;
+}
+
+void timer_query_t::end(uint16_t region) noexcept {
+    if (region >= counts[frame])
+        return;
+    if (use_counter)
+        get_timer_query_procs().query_counter(queries[frame][region * 2 + 1], GL_TIMESTAMP_EXT);
+    else
+        glEndQuery(GL_TIME_ELAPSED_EXT);
+}
+
+GLenum timer_query_t::collect(std::vector<gpu_time_region_t>& regions) noexcept {
+    if (ec != GL_NO_ERROR)
+        return ec;
+    const auto get_query_object_ui64v = get_timer_query_procs().get_query_object_ui64v;
+    // visit from the oldest slot. the current slot is still recording
+    for (uint16_t i = 1; i < capacity; ++i) {
+        const uint16_t slot = (frame + i) % capacity;
+        const auto count = counts[slot];
+        if (pending[slot] == false || count == 0)
+            continue;
+        // the queries are finished in order. checking the last one is enough
+        const GLuint last = use_counter ? queries[slot][count * 2 - 1] : queries[slot][(count - 1) * 2];
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(last, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available == GL_FALSE)
+            break; // the newer slots are not ready either
+        pending[slot] = false;
+        GLint disjoint = 0;
+        glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+        if (disjoint) { // the results are not reliable (e.g. power or clock change)
+            ++dropped;
+            continue;
+        }
+        for (auto r = 0u; r < count; ++r) {
+            gpu_time_region_t region{names[slot][r], 0, 0};
+            if (use_counter) {
+                get_query_object_ui64v(queries[slot][r * 2], GL_QUERY_RESULT, &region.begin);
+                get_query_object_ui64v(queries[slot][r * 2 + 1], GL_QUERY_RESULT, &region.end);
+            } else {
+                GLuint64 duration = 0;
+                get_query_object_ui64v(queries[slot][r * 2], GL_QUERY_RESULT, &duration);
+                region.begin = elapsed;
+                region.end = elapsed += duration;
+            }
+            regions.emplace_back(region);
+        }
+    }
+    return glGetError();
+}
+
+void write_json_string(FILE* stream, gsl::czstring<> txt) noexcept {
+    fputc('"', stream);
+    for (; txt && *txt; ++txt) {
+        switch (const char c = *txt) {
+        case '"':
+        case '\\':
+            fputc('\\', stream);
+            fputc(c, stream);
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20)
+                fprintf(stream, "\\u%04x", c);
+            else
+                fputc(c, stream);
+        }
+    }
+    fputc('"', stream);
+}
+
+uint64_t get_duration(const gpu_time_region_t& region) noexcept {
+    return region.end > region.begin ? region.end - region.begin : 0;
+}
+
+uint32_t write_gpu_time_json(FILE* stream, gsl::span<const gpu_time_region_t> regions) noexcept {
+    fputs("{\"regions\":[", stream);
+    for (auto i = 0u; i < regions.size(); ++i) {
+        const auto& region = regions[i];
+        if (i > 0)
+            fputc(',', stream);
+        fputs("{\"name\":", stream);
+        write_json_string(stream, region.name);
+        fprintf(stream, ",\"begin\":%" PRIu64 ",\"end\":%" PRIu64 ",\"ms\":%.6f}", //
+                region.begin, region.end, static_cast<double>(get_duration(region)) / 1'000'000);
+    }
+    fputs("]}\n", stream);
+    return ferror(stream);
+}
+
+uint32_t write_gpu_time_chrome_trace(FILE* stream, gsl::span<const gpu_time_region_t> regions,
+                                     uint32_t tid) noexcept {
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", stream);
+    for (auto i = 0u; i < regions.size(); ++i) {
+        const auto& region = regions[i];
+        if (i > 0)
+            fputc(',', stream);
+        fputs("\n{\"name\":", stream);
+        write_json_string(stream, region.name);
+        // the unit of 'ts' and 'dur' is microsecond
+        fprintf(stream, ",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", tid,
+                static_cast<double>(region.begin) / 1'000, static_cast<double>(get_duration(region)) / 1'000);
+    }
+    fputs("\n]}\n", stream);
+    return ferror(stream);
+}
@@ -2,6 +2,25 @@
  * @author Park DongHa (luncliff@gmail.com)
  */
 #include <graphics.h>
+#include <spdlog/spdlog.h>
+
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "trace.h"
+
+// clang-format off
+#if !defined(GL_KHR_parallel_shader_compile)
+#   define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#   define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+// clang-format on
+
+namespace fs = std::filesystem;
 
 GLuint create_compile_attach(GLuint program, GLenum shader_type, std::string_view code) noexcept(false);
 bool get_shader_info(std::string& message, GLuint shader, GLenum status_name = GL_COMPILE_STATUS) noexcept;
@@ -43,3 +62,387 @@ GLuint create_compile_attach(GLuint program, GLenum shader_type, std::string_vie
     glAttachShader(program, shader);
     return shader;
 }
+
+/// @brief compile/link with `GL_PROGRAM_BINARY_RETRIEVABLE_HINT`. The shaders are deleted after the link
+static uint32_t build_program(GLuint program, std::string_view vs, std::string_view fs, //
+                              std::string& message) noexcept {
+    GLuint shaders[2]{};
+    auto on_return = gsl::finally([program, &shaders]() {
+        for (auto shader : shaders) {
+            if (shader == 0)
+                continue;
+            glDetachShader(program, shader);
+            glDeleteShader(shader);
+        }
+    });
+    const std::pair<GLenum, std::string_view> sources[2]{{GL_VERTEX_SHADER, vs}, {GL_FRAGMENT_SHADER, fs}};
+    for (auto i = 0u; i < 2; ++i) {
+        const auto [type, code] = sources[i];
+        shaders[i] = glCreateShader(type);
+        const GLchar* begin = code.data();
+        const GLint len = static_cast<GLint>(code.length());
+        glShaderSource(shaders[i], 1, &begin, &len);
+        glCompileShader(shaders[i]);
+        if (get_shader_info(message, shaders[i], GL_COMPILE_STATUS) == false)
+            return EINVAL;
+        glAttachShader(program, shaders[i]);
+    }
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(program);
+    if (get_program_info(message, program, GL_LINK_STATUS) == false)
+        return EINVAL;
+    return 0;
+}
+
+static uint64_t hash_string(std::string_view text, uint64_t seed) noexcept {
+    return hash_content(gsl::as_bytes(gsl::make_span(text.data(), text.size())), seed);
+}
+
+program_cache_t::program_cache_t(const fs::path& _directory) noexcept : directory{_directory} {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &count);
+    if (count <= 0) {
+        ec = ENOTSUP;
+        return;
+    }
+    driver = hash_content({});
+    for (auto name : {GL_VENDOR, GL_RENDERER, GL_VERSION})
+        if (auto text = reinterpret_cast<const char*>(glGetString(name)))
+            driver = hash_string(text, driver);
+    std::error_code fec{};
+    fs::create_directories(directory, fec);
+    ec = fec.value();
+}
+
+uint32_t program_cache_t::is_valid() const noexcept {
+    return ec;
+}
+
+uint64_t program_cache_t::make_key(std::string_view vs, std::string_view fs) const noexcept {
+    // the length separates "ab"+"c" from "a"+"bc"
+    const uint64_t lengths[2]{vs.length(), fs.length()};
+    auto key = hash_content(gsl::as_bytes(gsl::make_span(lengths, 2)), driver);
+    return hash_string(fs, hash_string(vs, key));
+}
+
+fs::path program_cache_t::get_path(uint64_t key) const noexcept(false) {
+    char name[32]{};
+    snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+    return directory / name;
+}
+
+uint32_t program_cache_t::load(uint64_t key, GLuint program) noexcept {
+    TRACE_SCOPE("program_cache_t::load");
+    try {
+        const mapped_file_t file{get_path(key)};
+        if (auto ec = file.is_valid()) {
+            ++miss;
+            return ec;
+        }
+        const auto bytes = file.bytes();
+        header_t header{};
+        if (bytes.size() > sizeof(header_t))
+            memcpy(&header, bytes.data(), sizeof(header_t));
+        if (bytes.size() <= sizeof(header_t) || header.version != version || header.driver != driver) {
+            ++miss;
+            return EBADMSG;
+        }
+        const auto binary = bytes.subspan(sizeof(header_t));
+        glProgramBinary(program, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        // not linked if the format is not supported anymore. the caller will build the program again
+        if (linked == GL_FALSE) {
+            // the rejected binary may leave GL_INVALID_ENUM/GL_INVALID_VALUE. don't let the build report it
+            glGetError();
+            ++miss;
+            return EINVAL;
+        }
+        ++hit;
+        return 0;
+    } catch (const std::bad_alloc&) {
+        return ENOMEM;
+    }
+}
+
+uint32_t program_cache_t::store(uint64_t key, GLuint program) noexcept {
+    TRACE_SCOPE("program_cache_t::store");
+    try {
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return EINVAL;
+        std::vector<std::byte> binary(static_cast<size_t>(length));
+        header_t header{version, GL_NONE, driver};
+        // nothing is written on the error. glGetError may have the error of the others
+        glGetProgramBinary(program, length, &length, &header.format, binary.data());
+        if (header.format == GL_NONE || length <= 0)
+            return EINVAL;
+        binary.resize(static_cast<size_t>(length));
+        return write_and_rename(get_path(key), {gsl::as_bytes(gsl::make_span(&header, 1)), binary});
+    } catch (const std::bad_alloc&) {
+        return ENOMEM;
+    }
+}
+
+uint32_t program_cache_t::load_or_build(GLuint program, std::string_view vs, std::string_view fs,
+                                        std::string& message) noexcept {
+    TRACE_SCOPE("program_cache_t::load_or_build");
+    if (ec) // no binary format. just build
+        return build_program(program, vs, fs, message);
+    const auto key = make_key(vs, fs);
+    if (load(key, program) == 0)
+        return 0;
+    if (auto ec = build_program(program, vs, fs, message))
+        return ec;
+    if (auto ec = store(key, program))
+        spdlog::warn("{}: {}", "program_cache_t::store", ec);
+    return 0;
+}
+
+using max_shader_compiler_threads_t = void(GL_APIENTRY*)(GLuint count);
+
+/// @brief Create shaders and start the compile/link. Nothing is queried, so the calls don't wait for the compiler
+static void compile_and_link(GLuint program, std::string_view vs, std::string_view fs, GLuint (&shaders)[2]) noexcept {
+    const std::pair<GLenum, std::string_view> sources[2]{{GL_VERTEX_SHADER, vs}, {GL_FRAGMENT_SHADER, fs}};
+    for (auto i = 0u; i < 2; ++i) {
+        const auto [type, code] = sources[i];
+        shaders[i] = glCreateShader(type);
+        const GLchar* begin = code.data();
+        const GLint len = static_cast<GLint>(code.length());
+        glShaderSource(shaders[i], 1, &begin, &len);
+        glCompileShader(shaders[i]);
+        glAttachShader(program, shaders[i]);
+    }
+    glLinkProgram(program);
+}
+
+struct program_builder_t::impl_t final {
+    struct entry_t final {
+        GLuint shaders[2]{};
+        GLsync sync = nullptr; // signaled after the worker's link
+        bool done = false;     // the worker has flushed the commands
+        uint32_t status = UINT32_MAX;
+        std::string message{};
+    };
+    struct job_t final {
+        GLuint program;
+        std::string vs;
+        std::string fs;
+    };
+
+    EGLDisplay display;
+    EGLContext share;
+    bool parallel = false;
+    std::mutex mtx{};
+    std::condition_variable jobs_cv{};
+    std::condition_variable done_cv{};
+    std::deque<job_t> jobs{};
+    std::unordered_map<GLuint, entry_t> entries{};
+    std::vector<std::unique_ptr<egl_context_t>> contexts{};
+    std::vector<std::thread> workers{};
+    uint32_t alive = 0; // workers which can take the jobs
+    bool stop = false;
+
+  public:
+    impl_t(EGLDisplay _display, EGLContext _share) noexcept : display{_display}, share{_share} {
+    }
+
+    /// @brief Build the programs in the shared context until `stop`. The remaining jobs are done before the return
+    void run(egl_context_t& context, EGLSurface surface) noexcept {
+        auto on_return = gsl::finally([this, &context]() {
+            context.destroy();
+            {
+                std::lock_guard lck{mtx};
+                --alive;
+            }
+            done_cv.notify_all();
+        });
+        if (context.resume(surface, context.config()) != 0)
+            return;
+        for (;;) {
+            job_t job{};
+            {
+                std::unique_lock lck{mtx};
+                jobs_cv.wait(lck, [this]() { return stop || jobs.empty() == false; });
+                if (jobs.empty())
+                    break;
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            GLuint shaders[2]{};
+            compile_and_link(job.program, job.vs, job.fs, shaders);
+            const auto sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            glFlush();
+            {
+                std::lock_guard lck{mtx};
+                auto& entry = entries[job.program];
+                entry.shaders[0] = shaders[0], entry.shaders[1] = shaders[1];
+                entry.sync = sync;
+                entry.done = true;
+            }
+            done_cv.notify_all();
+        }
+    }
+};
+
+program_builder_t::program_builder_t(EGLDisplay display, uint32_t num_workers, bool use_extension) noexcept {
+    const auto share = eglGetCurrentContext();
+    if (share == EGL_NO_CONTEXT) {
+        ec = EGL_BAD_CONTEXT;
+        return;
+    }
+    try {
+        impl = std::make_unique<impl_t>(display, share);
+        if (use_extension && has_gl_extension("GL_KHR_parallel_shader_compile")) {
+            impl->parallel = true;
+            // let the driver use as many threads as it can
+            if (auto fn = reinterpret_cast<max_shader_compiler_threads_t>(
+                    eglGetProcAddress("glMaxShaderCompilerThreadsKHR")))
+                fn(0xFFFFFFFF);
+            return;
+        }
+        if (num_workers == 0)
+            num_workers = std::max(std::thread::hardware_concurrency(), 1u);
+        EGLint attrs[]{EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+        for (auto i = 0u; i < num_workers; ++i) {
+            // the unused context is released in this thread. it is not current, so the `share` remains current
+            auto& context = impl->contexts.emplace_back(std::make_unique<egl_context_t>(display, share));
+            if (context->handle() == EGL_NO_CONTEXT) {
+                ec = eglGetError();
+                impl->contexts.pop_back();
+                break;
+            }
+            const auto surface = eglCreatePbufferSurface(display, context->config(), attrs);
+            if (surface == EGL_NO_SURFACE) {
+                ec = eglGetError();
+                impl->contexts.pop_back();
+                break;
+            }
+            try {
+                // the worker can't decrement before the increment
+                std::lock_guard lck{impl->mtx};
+                impl->workers.emplace_back(&impl_t::run, impl.get(), std::ref(*context), surface);
+                ++impl->alive;
+            } catch (...) {
+                eglDestroySurface(display, surface);
+                impl->contexts.pop_back();
+                throw;
+            }
+        }
+    } catch (const std::system_error& ex) {
+        ec = ex.code().value();
+    } catch (const std::bad_alloc&) {
+        ec = ENOMEM;
+    }
+}
+
+program_builder_t::~program_builder_t() noexcept {
+    if (impl == nullptr)
+        return;
+    {
+        std::lock_guard lck{impl->mtx};
+        impl->stop = true;
+    }
+    impl->jobs_cv.notify_all();
+    for (auto& worker : impl->workers)
+        worker.join();
+    for (auto& [program, entry] : impl->entries) {
+        if (entry.sync)
+            glDeleteSync(entry.sync);
+        for (auto shader : entry.shaders) {
+            if (shader == 0)
+                continue;
+            glDetachShader(program, shader);
+            glDeleteShader(shader);
+        }
+    }
+}
+
+uint32_t program_builder_t::is_valid() const noexcept {
+    return ec;
+}
+
+bool program_builder_t::is_parallel_compile() const noexcept {
+    return impl && impl->parallel;
+}
+
+uint32_t program_builder_t::submit(std::string_view vs, std::string_view fs, GLuint& program) noexcept {
+    TRACE_SCOPE("program_builder_t::submit");
+    if (ec)
+        return ec;
+    try {
+        program = glCreateProgram();
+        if (impl->parallel) {
+            auto& entry = impl->entries[program];
+            compile_and_link(program, vs, fs, entry.shaders);
+            return 0;
+        }
+        {
+            std::lock_guard lck{impl->mtx};
+            impl->entries[program] = impl_t::entry_t{};
+            impl->jobs.emplace_back(impl_t::job_t{program, std::string{vs}, std::string{fs}});
+        }
+        impl->jobs_cv.notify_one();
+        return 0;
+    } catch (const std::bad_alloc&) {
+        return ENOMEM;
+    }
+}
+
+bool program_builder_t::is_completed(GLuint program) noexcept {
+    if (impl == nullptr)
+        return false;
+    std::lock_guard lck{impl->mtx};
+    const auto it = impl->entries.find(program);
+    if (it == impl->entries.end())
+        return false;
+    const auto& entry = it->second;
+    if (entry.status != UINT32_MAX)
+        return true;
+    if (impl->parallel) {
+        GLint completed = GL_FALSE;
+        glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &completed);
+        return completed == GL_TRUE;
+    }
+    if (entry.done == false)
+        return false;
+    const auto result = glClientWaitSync(entry.sync, 0, 0);
+    return result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED;
+}
+
+uint32_t program_builder_t::get_status(GLuint program, std::string& message) noexcept {
+    TRACE_SCOPE("program_builder_t::get_status");
+    if (impl == nullptr)
+        return ENOENT;
+    std::unique_lock lck{impl->mtx};
+    const auto it = impl->entries.find(program);
+    if (it == impl->entries.end())
+        return ENOENT;
+    auto& entry = it->second;
+    if (entry.status == UINT32_MAX) {
+        if (impl->parallel == false) {
+            impl->done_cv.wait(lck, [this, &entry]() { return entry.done || impl->alive == 0; });
+            if (entry.done == false) { // all workers failed to make their context current
+                message = "no worker for the program";
+                return EINVAL;
+            }
+            glClientWaitSync(entry.sync, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+            glDeleteSync(entry.sync);
+            entry.sync = nullptr;
+        }
+        // blocks if the driver is still compiling
+        entry.status = get_program_info(entry.message, program, GL_LINK_STATUS) ? 0 : EINVAL;
+        std::string log{};
+        for (auto& shader : entry.shaders) {
+            // the compile error is more helpful than the link error
+            if (entry.status && log.empty() && get_shader_info(log, shader, GL_COMPILE_STATUS) == false)
+                entry.message = log;
+            glDetachShader(program, shader);
+            glDeleteShader(shader);
+            shader = 0;
+        }
+    }
+    message = entry.message;
+    return entry.status;
+}
@@ -0,0 +1,642 @@
+/**
+ * @author Park DongHa (luncliff@gmail.com)
+ * @see https://www.khronos.org/registry/DataFormat/specs/1.3/dataformat.1.3.html#ETC2
+ * @see https://www.khronos.org/registry/DataFormat/specs/1.3/dataformat.1.3.html#S3TC
+ */
+#include <graphics.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "trace.h"
+
+#if !defined(GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+namespace fs = std::filesystem;
+
+using namespace std;
+
+auto create(const fs::path& p) -> std::unique_ptr<FILE, int (*)(FILE*)>;
+
+/// @brief 4x4 texels of a block in row-major order. [y * 4 + x]
+using block_texels_t = uint8_t[16][4];
+
+static void load_block(const uint8_t* pixels, uint32_t width, uint32_t height, //
+                       uint32_t bx, uint32_t by, block_texels_t& texels) noexcept {
+    for (auto y = 0u; y < 4; ++y) {
+        const auto sy = min(by * 4 + y, height - 1);
+        for (auto x = 0u; x < 4; ++x) {
+            const auto sx = min(bx * 4 + x, width - 1);
+            memcpy(texels[y * 4 + x], pixels + (size_t{sy} * width + sx) * 4, 4);
+        }
+    }
+}
+
+static void store_block(const block_texels_t& texels, uint32_t width, uint32_t height, //
+                        uint32_t bx, uint32_t by, uint8_t* pixels) noexcept {
+    for (auto y = 0u; y < 4 && by * 4 + y < height; ++y)
+        for (auto x = 0u; x < 4 && bx * 4 + x < width; ++x)
+            memcpy(pixels + (size_t{by * 4 + y} * width + bx * 4 + x) * 4, texels[y * 4 + x], 4);
+}
+
+static int clamp255(int value) noexcept {
+    return clamp(value, 0, 255);
+}
+
+static uint32_t square(int value) noexcept {
+    return static_cast<uint32_t>(value * value);
+}
+
+namespace etc {
+
+constexpr int modifiers[8][2]{{2, 8}, {5, 17}, {9, 29}, {13, 42}, {18, 60}, {24, 80}, {33, 106}, {47, 183}};
+
+constexpr int alpha_modifiers[16][8]{
+    {-3, -6, -9, -15, 2, 5, 8, 14}, {-3, -7, -10, -13, 2, 6, 9, 12}, {-2, -5, -8, -13, 1, 4, 7, 12},
+    {-2, -4, -6, -13, 1, 3, 5, 12}, {-3, -6, -8, -12, 2, 5, 7, 11}, {-3, -7, -9, -11, 2, 6, 8, 10},
+    {-4, -7, -8, -11, 3, 6, 7, 10}, {-3, -5, -8, -11, 2, 4, 7, 10}, {-2, -6, -8, -10, 1, 5, 7, 9},
+    {-2, -5, -8, -10, 1, 4, 7, 9},  {-2, -4, -8, -10, 1, 3, 7, 9},  {-2, -5, -7, -10, 1, 4, 6, 9},
+    {-3, -4, -7, -10, 2, 3, 6, 9},  {-1, -2, -3, -10, 0, 1, 2, 9},  {-4, -6, -8, -9, 3, 5, 7, 8},
+    {-3, -5, -7, -9, 2, 4, 6, 8}};
+
+/// @brief selector(msb << 1 | lsb) -> modifier. 0: +a, 1: +b, 2: -a, 3: -b
+int get_modifier(uint32_t table, uint32_t selector) noexcept {
+    const auto value = modifiers[table][selector & 1];
+    return selector & 2 ? -value : value;
+}
+
+/// @brief texel indices(row-major) of the sub-block
+void get_members(uint32_t flip, uint32_t sub, uint8_t (&members)[8]) noexcept {
+    auto i = 0;
+    for (auto y = 0u; y < 4; ++y)
+        for (auto x = 0u; x < 4; ++x)
+            if ((flip ? y / 2 : x / 2) == sub)
+                members[i++] = static_cast<uint8_t>(y * 4 + x);
+}
+
+/// @return uint32_t squared error of the best table for the base color
+/// @note  The modifier is same for all channels. Without the clamp, the error is `3*m*m - 2*m*delta` + constant
+uint32_t fit_table(const block_texels_t& texels, const uint8_t (&members)[8], const int (&base)[3], //
+                   uint32_t& table, uint8_t (&selectors)[16]) noexcept {
+    int deltas[8]{};
+    for (auto i = 0u; i < 8; ++i) {
+        const auto& texel = texels[members[i]];
+        deltas[i] = texel[0] - base[0] + texel[1] - base[1] + texel[2] - base[2];
+    }
+    uint32_t best = UINT32_MAX;
+    for (auto t = 0u; t < 8; ++t) {
+        uint32_t error = 0;
+        uint8_t candidates[8]{};
+        for (auto i = 0u; i < 8; ++i) {
+            auto selected = 0u;
+            auto score = INT32_MAX;
+            for (auto s = 0u; s < 4; ++s) {
+                const auto modifier = get_modifier(t, s);
+                if (const auto e = modifier * (3 * modifier - 2 * deltas[i]); e < score)
+                    score = e, selected = s;
+            }
+            const auto modifier = get_modifier(t, selected);
+            const auto& texel = texels[members[i]];
+            error += square(clamp255(base[0] + modifier) - texel[0]) + square(clamp255(base[1] + modifier) - texel[1]) +
+                     square(clamp255(base[2] + modifier) - texel[2]);
+            candidates[i] = static_cast<uint8_t>(selected);
+        }
+        if (error < best) {
+            best = error, table = t;
+            for (auto i = 0u; i < 8; ++i)
+                selectors[members[i]] = candidates[i];
+        }
+    }
+    return best;
+}
+
+/// @brief ETC1 individual/differential modes. They are also valid in ETC2
+void encode_color(const block_texels_t& texels, uint8_t* block) noexcept {
+    uint32_t best = UINT32_MAX;
+    for (auto flip = 0u; flip < 2; ++flip) {
+        uint8_t members[2][8]{};
+        int average[2][3]{};
+        for (auto sub = 0u; sub < 2; ++sub) {
+            get_members(flip, sub, members[sub]);
+            for (auto c = 0u; c < 3; ++c) {
+                auto sum = 0;
+                for (auto m : members[sub])
+                    sum += texels[m][c];
+                average[sub][c] = (sum + 4) / 8;
+            }
+        }
+        for (auto diff = 0u; diff < 2; ++diff) {
+            int codes[2][3]{};
+            int bases[2][3]{};
+            for (auto sub = 0u; sub < 2; ++sub)
+                for (auto c = 0u; c < 3; ++c) {
+                    if (diff) {
+                        codes[sub][c] = (average[sub][c] * 31 + 127) / 255;
+                        bases[sub][c] = (codes[sub][c] << 3) | (codes[sub][c] >> 2);
+                    } else {
+                        codes[sub][c] = (average[sub][c] + 8) / 17;
+                        bases[sub][c] = codes[sub][c] * 17;
+                    }
+                }
+            auto fits = true; // 3 bit delta of the differential mode
+            for (auto c = 0u; diff && c < 3; ++c)
+                fits &= codes[1][c] - codes[0][c] >= -4 && codes[1][c] - codes[0][c] <= 3;
+            if (fits == false)
+                continue;
+            uint32_t tables[2]{};
+            uint8_t selectors[16]{};
+            const auto error = fit_table(texels, members[0], bases[0], tables[0], selectors) +
+                               fit_table(texels, members[1], bases[1], tables[1], selectors);
+            if (error >= best)
+                continue;
+            best = error;
+            for (auto c = 0u; c < 3; ++c)
+                block[c] = diff ? static_cast<uint8_t>(codes[0][c] << 3 | ((codes[1][c] - codes[0][c]) & 7))
+                                : static_cast<uint8_t>(codes[0][c] << 4 | codes[1][c]);
+            block[3] = static_cast<uint8_t>(tables[0] << 5 | tables[1] << 2 | diff << 1 | flip);
+            // the pixels are in column-major order. 'a' is (0,0), 'b' is (0,1)
+            uint32_t msb = 0, lsb = 0;
+            for (auto y = 0u; y < 4; ++y)
+                for (auto x = 0u; x < 4; ++x) {
+                    const auto s = selectors[y * 4 + x];
+                    msb |= ((s >> 1) & 1u) << (x * 4 + y);
+                    lsb |= (s & 1u) << (x * 4 + y);
+                }
+            block[4] = static_cast<uint8_t>(msb >> 8), block[5] = static_cast<uint8_t>(msb);
+            block[6] = static_cast<uint8_t>(lsb >> 8), block[7] = static_cast<uint8_t>(lsb);
+        }
+    }
+}
+
+uint32_t decode_color(const uint8_t* block, block_texels_t& texels) noexcept {
+    const auto diff = (block[3] >> 1) & 1;
+    const auto flip = block[3] & 1;
+    int bases[2][3]{};
+    for (auto c = 0u; c < 3; ++c) {
+        if (diff) {
+            const auto code0 = block[c] >> 3;
+            const auto code1 = code0 + (static_cast<int8_t>(block[c] << 5) >> 5);
+            if (code1 < 0 || code1 > 31) // T, H, planar modes of ETC2
+                return EBADMSG;
+            bases[0][c] = (code0 << 3) | (code0 >> 2);
+            bases[1][c] = (code1 << 3) | (code1 >> 2);
+        } else {
+            bases[0][c] = (block[c] >> 4) * 17;
+            bases[1][c] = (block[c] & 0xF) * 17;
+        }
+    }
+    const uint32_t tables[2]{static_cast<uint32_t>(block[3] >> 5), static_cast<uint32_t>((block[3] >> 2) & 7)};
+    const uint32_t msb = block[4] << 8 | block[5];
+    const uint32_t lsb = block[6] << 8 | block[7];
+    for (auto y = 0u; y < 4; ++y)
+        for (auto x = 0u; x < 4; ++x) {
+            const auto sub = flip ? y / 2 : x / 2;
+            const auto i = x * 4 + y;
+            const auto modifier = get_modifier(tables[sub], ((msb >> i) & 1) << 1 | ((lsb >> i) & 1));
+            for (auto c = 0u; c < 3; ++c)
+                texels[y * 4 + x][c] = static_cast<uint8_t>(clamp255(bases[sub][c] + modifier));
+        }
+    return 0;
+}
+
+/// @return uint32_t squared error of the alpha with the table, multiplier, and base
+uint32_t fit_alpha(const block_texels_t& texels, uint32_t table, int multiplier, int base,
+                   uint64_t& indices) noexcept {
+    const auto& mods = alpha_modifiers[table];
+    uint32_t error = 0;
+    indices = 0;
+    for (auto x = 0u; x < 4; ++x)
+        for (auto y = 0u; y < 4; ++y) {
+            const int alpha = texels[y * 4 + x][3];
+            uint32_t texel_error = UINT32_MAX, index = 0;
+            for (auto s = 0u; s < 8; ++s)
+                if (const auto e = square(clamp255(base + mods[s] * multiplier) - alpha); e < texel_error)
+                    texel_error = e, index = s;
+            error += texel_error;
+            indices |= uint64_t{index} << (45 - 3 * (x * 4 + y));
+        }
+    return error;
+}
+
+/// @brief Search the tables with the estimated multiplier/base, then refine the best one with their neighbors
+void encode_alpha(const block_texels_t& texels, uint8_t* block) noexcept {
+    auto lo = 255, hi = 0;
+    for (const auto& texel : texels)
+        lo = min<int>(lo, texel[3]), hi = max<int>(hi, texel[3]);
+    // the table 13 has 0 modifier
+    uint32_t best_table = 13;
+    int best_base = hi, best_multiplier = 1;
+    uint64_t best_indices = 0;
+    for (auto i = 0u; i < 16; ++i)
+        best_indices |= uint64_t{4} << (45 - 3 * i);
+    if (lo != hi) {
+        uint32_t best = UINT32_MAX;
+        for (auto t = 0u; t < 16 && best; ++t) {
+            const auto& mods = alpha_modifiers[t];
+            const auto range = mods[7] - mods[3];
+            const auto multiplier = clamp((hi - lo + range / 2) / range, 1, 15);
+            const auto base = clamp255(lo - mods[3] * multiplier);
+            uint64_t indices = 0;
+            if (const auto error = fit_alpha(texels, t, multiplier, base, indices); error < best)
+                best = error, best_base = base, best_multiplier = multiplier, best_table = t, best_indices = indices;
+        }
+        const auto multiplier = best_multiplier, base = best_base;
+        for (auto m = max(multiplier - 1, 1); m <= min(multiplier + 1, 15) && best; ++m)
+            for (auto b = max(base - 2, 0); b <= min(base + 2, 255) && best; ++b) {
+                uint64_t indices = 0;
+                if (const auto error = fit_alpha(texels, best_table, m, b, indices); error < best)
+                    best = error, best_base = b, best_multiplier = m, best_indices = indices;
+            }
+    }
+    block[0] = static_cast<uint8_t>(best_base);
+    block[1] = static_cast<uint8_t>(best_multiplier << 4 | best_table);
+    for (auto i = 0u; i < 6; ++i)
+        block[2 + i] = static_cast<uint8_t>(best_indices >> (40 - 8 * i));
+}
+
+void decode_alpha(const uint8_t* block, block_texels_t& texels) noexcept {
+    const int base = block[0];
+    const int multiplier = block[1] >> 4;
+    const auto& mods = alpha_modifiers[block[1] & 0xF];
+    uint64_t indices = 0;
+    for (auto i = 0u; i < 6; ++i)
+        indices = indices << 8 | block[2 + i];
+    for (auto x = 0u; x < 4; ++x)
+        for (auto y = 0u; y < 4; ++y) {
+            const auto index = (indices >> (45 - 3 * (x * 4 + y))) & 7;
+            texels[y * 4 + x][3] = static_cast<uint8_t>(clamp255(base + mods[index] * multiplier));
+        }
+}
+
+} // namespace etc
+
+namespace bc {
+
+uint16_t to_565(const float (&color)[3]) noexcept {
+    const auto r = static_cast<uint32_t>(clamp(color[0], 0.0f, 255.0f) * 31 / 255 + 0.5f);
+    const auto g = static_cast<uint32_t>(clamp(color[1], 0.0f, 255.0f) * 63 / 255 + 0.5f);
+    const auto b = static_cast<uint32_t>(clamp(color[2], 0.0f, 255.0f) * 31 / 255 + 0.5f);
+    return static_cast<uint16_t>(r << 11 | g << 5 | b);
+}
+
+void from_565(uint16_t value, int (&color)[3]) noexcept {
+    const auto r = (value >> 11) & 31, g = (value >> 5) & 63, b = value & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+/// @brief 4 color mode. BC2/BC3 don't have the 3 color mode
+void make_palette(uint16_t c0, uint16_t c1, int (&palette)[4][3]) noexcept {
+    from_565(c0, palette[0]);
+    from_565(c1, palette[1]);
+    for (auto c = 0u; c < 3; ++c) {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+}
+
+/// @brief endpoints from the extremes along the principal axis of the colors
+void encode_color(const block_texels_t& texels, uint8_t* block) noexcept {
+    float mean[3]{};
+    for (const auto& texel : texels)
+        for (auto c = 0u; c < 3; ++c)
+            mean[c] += texel[c] / 16.0f;
+    float cov[6]{}; // rr, rg, rb, gg, gb, bb
+    for (const auto& texel : texels) {
+        const float d[3]{texel[0] - mean[0], texel[1] - mean[1], texel[2] - mean[2]};
+        cov[0] += d[0] * d[0], cov[1] += d[0] * d[1], cov[2] += d[0] * d[2];
+        cov[3] += d[1] * d[1], cov[4] += d[1] * d[2], cov[5] += d[2] * d[2];
+    }
+    float axis[3]{1, 1, 1};
+    for (auto i = 0; i < 8; ++i) { // power iteration
+        const float next[3]{cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+                            cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+                            cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2]};
+        const auto length = max({fabs(next[0]), fabs(next[1]), fabs(next[2])});
+        if (length < 1e-6f)
+            break;
+        for (auto c = 0u; c < 3; ++c)
+            axis[c] = next[c] / length;
+    }
+    const auto norm = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+    float lo = 0, hi = 0;
+    for (const auto& texel : texels) {
+        const auto t = ((texel[0] - mean[0]) * axis[0] + (texel[1] - mean[1]) * axis[1] +
+                        (texel[2] - mean[2]) * axis[2]) /
+                       norm;
+        lo = min(lo, t), hi = max(hi, t);
+    }
+    const float e0[3]{mean[0] + axis[0] * hi, mean[1] + axis[1] * hi, mean[2] + axis[2] * hi};
+    const float e1[3]{mean[0] + axis[0] * lo, mean[1] + axis[1] * lo, mean[2] + axis[2] * lo};
+    auto c0 = to_565(e0), c1 = to_565(e1);
+    if (c0 < c1) // some decoders use the 3 color mode for BC3 if c0 <= c1
+        swap(c0, c1);
+    int palette[4][3]{};
+    make_palette(c0, c1, palette);
+    uint32_t indices = 0;
+    for (auto i = 0u; i < 16; ++i) {
+        uint32_t best = UINT32_MAX, index = 0;
+        for (auto p = 0u; p < 4; ++p) {
+            const auto e = square(palette[p][0] - texels[i][0]) + square(palette[p][1] - texels[i][1]) +
+                           square(palette[p][2] - texels[i][2]);
+            if (e < best)
+                best = e, index = p;
+        }
+        indices |= index << (2 * i);
+    }
+    if (c0 == c1)
+        indices = 0;
+    block[0] = static_cast<uint8_t>(c0), block[1] = static_cast<uint8_t>(c0 >> 8);
+    block[2] = static_cast<uint8_t>(c1), block[3] = static_cast<uint8_t>(c1 >> 8);
+    for (auto i = 0u; i < 4; ++i)
+        block[4 + i] = static_cast<uint8_t>(indices >> (8 * i));
+}
+
+void decode_color(const uint8_t* block, block_texels_t& texels) noexcept {
+    int palette[4][3]{};
+    make_palette(static_cast<uint16_t>(block[0] | block[1] << 8), static_cast<uint16_t>(block[2] | block[3] << 8),
+                 palette);
+    const uint32_t indices = block[4] | block[5] << 8 | block[6] << 16 | static_cast<uint32_t>(block[7]) << 24;
+    for (auto i = 0u; i < 16; ++i)
+        for (auto c = 0u; c < 3; ++c)
+            texels[i][c] = static_cast<uint8_t>(palette[(indices >> (2 * i)) & 3][c]);
+}
+
+void make_alpha_palette(int a0, int a1, int (&palette)[8]) noexcept {
+    palette[0] = a0, palette[1] = a1;
+    if (a0 > a1) {
+        for (auto i = 2; i < 8; ++i)
+            palette[i] = ((8 - i) * a0 + (i - 1) * a1) / 7;
+    } else {
+        for (auto i = 2; i < 6; ++i)
+            palette[i] = ((6 - i) * a0 + (i - 1) * a1) / 5;
+        palette[6] = 0, palette[7] = 255;
+    }
+}
+
+/// @brief BC4 with the 8 value mode(a0 > a1)
+void encode_alpha(const block_texels_t& texels, uint8_t* block) noexcept {
+    auto lo = 255, hi = 0;
+    for (const auto& texel : texels)
+        lo = min<int>(lo, texel[3]), hi = max<int>(hi, texel[3]);
+    int palette[8]{};
+    make_alpha_palette(hi, lo, palette);
+    uint64_t indices = 0;
+    if (hi != lo)
+        for (auto i = 0u; i < 16; ++i) {
+            uint32_t best = UINT32_MAX, index = 0;
+            for (auto p = 0u; p < 8; ++p)
+                if (const auto e = square(palette[p] - texels[i][3]); e < best)
+                    best = e, index = p;
+            indices |= uint64_t{index} << (3 * i);
+        }
+    block[0] = static_cast<uint8_t>(hi), block[1] = static_cast<uint8_t>(lo);
+    for (auto i = 0u; i < 6; ++i)
+        block[2 + i] = static_cast<uint8_t>(indices >> (8 * i));
+}
+
+void decode_alpha(const uint8_t* block, block_texels_t& texels) noexcept {
+    int palette[8]{};
+    make_alpha_palette(block[0], block[1], palette);
+    uint64_t indices = 0;
+    for (auto i = 0u; i < 6; ++i)
+        indices |= uint64_t{block[2 + i]} << (8 * i);
+    for (auto i = 0u; i < 16; ++i)
+        texels[i][3] = static_cast<uint8_t>(palette[(indices >> (3 * i)) & 7]);
+}
+
+} // namespace bc
+
+size_t get_block_size(block_format_t format, uint32_t width, uint32_t height) noexcept {
+    if (format == block_format_t::rgba8)
+        return size_t{width} * height * 4;
+    return size_t{(width + 3) / 4} * ((height + 3) / 4) * 16;
+}
+
+uint32_t encode_blocks(block_format_t format, gsl::span<const std::byte> pixels, //
+                       uint32_t width, uint32_t height, gsl::span<std::byte> blocks) noexcept {
+    TRACE_SCOPE("encode_blocks");
+    if (pixels.size() < size_t{width} * height * 4 || blocks.size() < get_block_size(format, width, height))
+        return EINVAL;
+    if (format == block_format_t::rgba8) {
+        memcpy(blocks.data(), pixels.data(), get_block_size(format, width, height));
+        return 0;
+    }
+    const auto src = reinterpret_cast<const uint8_t*>(pixels.data());
+    auto dst = reinterpret_cast<uint8_t*>(blocks.data());
+    block_texels_t texels{};
+    for (auto by = 0u; by < (height + 3) / 4; ++by)
+        for (auto bx = 0u; bx < (width + 3) / 4; ++bx, dst += 16) {
+            load_block(src, width, height, bx, by, texels);
+            if (format == block_format_t::etc2_rgba8) {
+                etc::encode_alpha(texels, dst);
+                etc::encode_color(texels, dst + 8);
+            } else {
+                bc::encode_alpha(texels, dst);
+                bc::encode_color(texels, dst + 8);
+            }
+        }
+    return 0;
+}
+
+uint32_t decode_blocks(block_format_t format, gsl::span<const std::byte> blocks, //
+                       uint32_t width, uint32_t height, gsl::span<std::byte> pixels) noexcept {
+    if (pixels.size() < size_t{width} * height * 4 || blocks.size() < get_block_size(format, width, height))
+        return EINVAL;
+    if (format == block_format_t::rgba8) {
+        memcpy(pixels.data(), blocks.data(), get_block_size(format, width, height));
+        return 0;
+    }
+    auto src = reinterpret_cast<const uint8_t*>(blocks.data());
+    const auto dst = reinterpret_cast<uint8_t*>(pixels.data());
+    block_texels_t texels{};
+    for (auto by = 0u; by < (height + 3) / 4; ++by)
+        for (auto bx = 0u; bx < (width + 3) / 4; ++bx, src += 16) {
+            if (format == block_format_t::etc2_rgba8) {
+                etc::decode_alpha(src, texels);
+                if (auto ec = etc::decode_color(src + 8, texels))
+                    return ec;
+            } else {
+                bc::decode_alpha(src, texels);
+                bc::decode_color(src + 8, texels);
+            }
+            store_block(texels, width, height, bx, by, dst);
+        }
+    return 0;
+}
+
+uint64_t hash_content(gsl::span<const std::byte> bytes, uint64_t seed) noexcept {
+    for (auto b : bytes)
+        seed = (seed ^ static_cast<uint64_t>(b)) * 0x100'0000'01b3;
+    return seed;
+}
+
+uint32_t write_and_rename(const fs::path& dst, std::initializer_list<gsl::span<const std::byte>> parts) noexcept {
+    try {
+        auto tmp = dst;
+        tmp += ".tmp";
+        auto stream = create(tmp);
+        errno = 0;
+        uint32_t ec = 0;
+        for (auto part : parts) {
+            if (fwrite(part.data(), 1, part.size(), stream.get()) != part.size()) {
+                ec = errno ? errno : EIO;
+                break;
+            }
+        }
+        // the buffered bytes are written here. (ex: ENOSPC)
+        if (fclose(stream.release()) != 0 && ec == 0)
+            ec = errno ? errno : EIO;
+        std::error_code fec{};
+        if (ec == 0) {
+            fs::rename(tmp, dst, fec);
+            ec = fec.value();
+        }
+        if (ec)
+            fs::remove(tmp, fec);
+        return ec;
+    } catch (const std::system_error& ex) {
+        return ex.code().value();
+    } catch (const std::bad_alloc&) {
+        return ENOMEM;
+    }
+}
+
+block_cache_t::block_cache_t(const fs::path& _directory) noexcept : directory{_directory} {
+    std::error_code fec{};
+    fs::create_directories(directory, fec);
+    ec = fec.value();
+}
+
+uint32_t block_cache_t::is_valid() const noexcept {
+    return ec;
+}
+
+fs::path block_cache_t::get_path(uint64_t key, block_format_t format) const noexcept(false) {
+    char name[32]{};
+    snprintf(name, sizeof(name), "%016llx.%u", static_cast<unsigned long long>(key), static_cast<uint32_t>(format));
+    return directory / name;
+}
+
+uint32_t block_cache_t::load(uint64_t key, block_format_t format, //
+                             header_t& header, std::unique_ptr<mapped_file_t>& blocks) noexcept {
+    try {
+        auto file = make_unique<mapped_file_t>(get_path(key, format));
+        if (auto ec = file->is_valid()) {
+            ++miss;
+            return ec;
+        }
+        const auto bytes = file->bytes();
+        if (bytes.size() >= sizeof(header_t))
+            memcpy(&header, bytes.data(), sizeof(header_t));
+        if (bytes.size() < sizeof(header_t) || header.version != version || header.format != format ||
+            bytes.size() != sizeof(header_t) + get_block_size(format, header.width, header.height)) {
+            ++miss;
+            return EBADMSG;
+        }
+        blocks = move(file);
+        ++hit;
+        return 0;
+    } catch (const std::bad_alloc&) {
+        return ENOMEM;
+    }
+}
+
+uint32_t block_cache_t::store(uint64_t key, const header_t& header, gsl::span<const std::byte> blocks) noexcept {
+    try {
+        return write_and_rename(get_path(key, header.format), {gsl::as_bytes(gsl::make_span(&header, 1)), blocks});
+    } catch (const std::bad_alloc&) {
+        return ENOMEM;
+    }
+}
+
+uint32_t block_cache_t::load_or_encode(const fs::path& image, block_format_t format, const image_codec_t& codec,
+                                       header_t& header, std::unique_ptr<mapped_file_t>& blocks) noexcept {
+    TRACE_SCOPE("block_cache_t::load_or_encode");
+    mapped_file_t encoded{image};
+    if (auto ec = encoded.is_valid())
+        return ec;
+    const auto key = hash_content(encoded.bytes());
+    if (load(key, format, header, blocks) == 0)
+        return 0;
+    try {
+        header = header_t{version, format, 0, 0};
+        if (auto ec = codec.get_info(encoded.bytes(), header.width, header.height))
+            return ec;
+        std::vector<std::byte> pixels(size_t{header.width} * header.height * 4);
+        if (auto ec = codec.decode(encoded.bytes(), pixels))
+            return ec;
+        std::vector<std::byte> output(get_block_size(format, header.width, header.height));
+        if (auto ec = encode_blocks(format, pixels, header.width, header.height, output))
+            return ec;
+        if (auto ec = store(key, header, output))
+            return ec;
+    } catch (const std::bad_alloc&) {
+        return ENOMEM;
+    }
+    // the entry is just created. it is not a hit
+    auto ec = load(key, format, header, blocks);
+    if (ec == 0)
+        --hit;
+    return ec;
+}
+
+uint32_t count_mip_levels(uint32_t width, uint32_t height) noexcept {
+    uint32_t levels = 1;
+    for (auto size = std::max(width, height); size > 1; size >>= 1)
+        ++levels;
+    return levels;
+}
+
+GLenum make_texture_storage(GLuint tex2d, GLenum internal_format, GLsizei width, GLsizei height,
+                            bool mipmap) noexcept {
+    const auto levels = mipmap ? count_mip_levels(width, height) : 1;
+    glBindTexture(GL_TEXTURE_2D, tex2d);
+    glTexStorage2D(GL_TEXTURE_2D, static_cast<GLsizei>(levels), internal_format, width, height);
+    if (auto ec = glGetError())
+        return ec;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mipmap ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    return glGetError();
+}
+
+GLenum generate_mipmap(GLuint tex2d) noexcept {
+    TRACE_SCOPE("generate_mipmap");
+    glBindTexture(GL_TEXTURE_2D, tex2d);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    return glGetError();
+}
+
+GLenum get_gl_format(block_format_t format) noexcept {
+    switch (format) {
+    case block_format_t::etc2_rgba8:
+        return GL_COMPRESSED_RGBA8_ETC2_EAC;
+    case block_format_t::bc3:
+        return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    default:
+        return GL_RGBA8;
+    }
+}
+
+block_format_t select_block_format() noexcept {
+    if (has_gl_extension("GL_EXT_texture_compression_s3tc"))
+        return block_format_t::bc3;
+    return block_format_t::etc2_rgba8;
+}
+
+GLenum upload_blocks(GLuint tex2d, block_format_t format, GLsizei width, GLsizei height,
+                     gsl::span<const std::byte> blocks) noexcept {
+    TRACE_SCOPE("upload_blocks");
+    glBindTexture(GL_TEXTURE_2D, tex2d);
+    if (format == block_format_t::rgba8)
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, blocks.data());
+    else
+        glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, get_gl_format(format),
+                                  static_cast<GLsizei>(blocks.size()), blocks.data());
+    return glGetError();
+}
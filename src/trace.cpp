@@ -0,0 +1,115 @@
+/**
+ * @author Park DongHa (luncliff@gmail.com)
+ * @see https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU
+ */
+#include "trace.h"
+
+#include <graphics.h>
+#include <spdlog/spdlog.h>
+
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <mutex>
+
+using namespace std;
+
+struct trace_event_t final {
+    gsl::czstring<> name;
+    uint64_t begin;
+    uint64_t end;
+};
+
+/**
+ * @brief   Single producer(owner thread), single consumer(`flush_trace`) ring buffer
+ * @note    The producer doesn't overwrite. The events are dropped until the consumer catches up
+ */
+class trace_ring_t final {
+  public:
+    static constexpr uint32_t capacity = 1 << 12;
+
+    const uint32_t tid;
+    atomic<uint32_t> head{}; // stored by the owner thread
+    atomic<uint32_t> tail{}; // stored by the consumer
+    atomic<uint32_t> dropped{};
+    trace_event_t events[capacity]{};
+
+  public:
+    explicit trace_ring_t(uint32_t _tid) noexcept : tid{_tid} {
+    }
+
+    void push(const trace_event_t& e) noexcept {
+        const auto h = head.load(memory_order_relaxed);
+        if (h - tail.load(memory_order_acquire) >= capacity) {
+            dropped.fetch_add(1, memory_order_relaxed);
+            return;
+        }
+        events[h % capacity] = e;
+        head.store(h + 1, memory_order_release);
+    }
+};
+
+/// @note The rings outlive their threads so the last events can be flushed
+struct trace_registry_t final {
+    mutex lock{};
+    vector<shared_ptr<trace_ring_t>> rings{};
+};
+
+trace_registry_t& get_trace_registry() noexcept {
+    static trace_registry_t registry{};
+    return registry;
+}
+
+/// @note The registry is locked only once for each thread
+trace_ring_t* get_trace_ring() noexcept {
+    thread_local shared_ptr<trace_ring_t> ring = []() -> shared_ptr<trace_ring_t> {
+        auto& registry = get_trace_registry();
+        try {
+            unique_lock lck{registry.lock};
+            auto ring = make_shared<trace_ring_t>(static_cast<uint32_t>(registry.rings.size()));
+            registry.rings.emplace_back(ring);
+            return ring;
+        } catch (const std::exception& ex) {
+            spdlog::error("{}: {}", "trace", ex.what());
+            return nullptr;
+        }
+    }();
+    return ring.get();
+}
+
+const chrono::steady_clock::time_point trace_origin = chrono::steady_clock::now();
+
+uint64_t get_trace_time() noexcept {
+    const auto elapsed = chrono::steady_clock::now() - trace_origin;
+    return static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(elapsed).count());
+}
+
+void record_trace(gsl::czstring<> name, uint64_t begin, uint64_t end) noexcept {
+    if (auto ring = get_trace_ring())
+        ring->push(trace_event_t{name, begin, end});
+}
+
+uint32_t flush_trace(FILE* stream) noexcept {
+    auto& registry = get_trace_registry();
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", stream);
+    unique_lock lck{registry.lock};
+    bool first = true;
+    for (auto& ring : registry.rings) {
+        const auto h = ring->head.load(memory_order_acquire);
+        auto t = ring->tail.load(memory_order_relaxed);
+        for (; t != h; ++t) {
+            const auto& e = ring->events[t % trace_ring_t::capacity];
+            fputs(first ? "\n{\"name\":" : ",\n{\"name\":", stream);
+            first = false;
+            write_json_string(stream, e.name);
+            // the unit of 'ts' and 'dur' is microsecond
+            fprintf(stream, ",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", ring->tid,
+                    static_cast<double>(e.begin) / 1'000, static_cast<double>(e.end - e.begin) / 1'000);
+        }
+        ring->tail.store(h, memory_order_release);
+        if (const auto count = ring->dropped.exchange(0, memory_order_relaxed))
+            spdlog::warn("trace: thread {} dropped {} events", ring->tid, count);
+    }
+    fputs("\n]}\n", stream);
+    return ferror(stream);
+}
@@ -0,0 +1,48 @@
+/**
+ * @brief   Scoped CPU events for Chrome trace (chrome://tracing, https://ui.perfetto.dev)
+ * @note    `TRACE_SCOPE` is removed unless `GRAPHICS_USE_TRACE` is defined. See `flush_trace`
+ */
+#pragma once
+#include <gsl/gsl>
+
+#include <cstdint>
+#include <cstdio>
+
+/// @brief Nanoseconds from the start of the process. `std::chrono::steady_clock`
+uint64_t get_trace_time() noexcept;
+
+/// @brief Append a complete event to the ring buffer of the calling thread. Dropped if the ring is full
+void record_trace(gsl::czstring<> name, uint64_t begin, uint64_t end) noexcept;
+
+/// @brief Quoted and escaped string for JSON
+void write_json_string(FILE* stream, gsl::czstring<> txt) noexcept;
+
+/**
+ * @brief   Record [construction, destruction) of the object
+ * @note    The `name` is not copied. Use string literals
+ */
+class trace_scope_t final {
+    gsl::czstring<> name;
+    uint64_t begin;
+
+  public:
+    explicit trace_scope_t(gsl::czstring<> _name) noexcept : name{_name}, begin{get_trace_time()} {
+    }
+    ~trace_scope_t() noexcept {
+        record_trace(name, begin, get_trace_time());
+    }
+    trace_scope_t(trace_scope_t const&) = delete;
+    trace_scope_t& operator=(trace_scope_t const&) = delete;
+    trace_scope_t(trace_scope_t&&) = delete;
+    trace_scope_t& operator=(trace_scope_t&&) = delete;
+};
+
+// clang-format off
+#if defined(GRAPHICS_USE_TRACE)
+#   define TRACE_CONCAT_IMPL(lhs, rhs) lhs##rhs
+#   define TRACE_CONCAT(lhs, rhs) TRACE_CONCAT_IMPL(lhs, rhs)
+#   define TRACE_SCOPE(name) trace_scope_t TRACE_CONCAT(trace_scope_, __LINE__){name}
+#else
+#   define TRACE_SCOPE(name) ((void)0)
+#endif
+// clang-format on
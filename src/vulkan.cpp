@@ -1,5 +1,8 @@
 #include "vulkan_1.h"
+#include "trace.h"
 
+#include <algorithm>
+#include <cstring>
 #include <vector>
 
 using namespace std;
@@ -63,6 +66,20 @@ uint32_t get_graphics_queue_available(VkQueueFamilyProperties* properties, uint3
     return static_cast<uint32_t>(-1);
 }
 
+uint32_t get_transfer_queue_available(VkQueueFamilyProperties* properties, uint32_t count) noexcept {
+    auto candidate = UINT32_MAX;
+    for (auto i = 0u; i < count; ++i) {
+        const auto flags = properties[i].queueFlags;
+        if ((flags & VK_QUEUE_TRANSFER_BIT) == 0 || (flags & VK_QUEUE_GRAPHICS_BIT))
+            continue;
+        if ((flags & VK_QUEUE_COMPUTE_BIT) == 0) // DMA engine
+            return i;
+        if (candidate == UINT32_MAX)
+            candidate = i;
+    }
+    return candidate;
+}
+
 const float global_queue_priority = 0;
 
 VkResult create_device(VkPhysicalDevice physical_device, //
@@ -90,6 +107,150 @@ VkResult create_device(VkPhysicalDevice physical_device, //
     return vkCreateDevice(physical_device, &info, nullptr, &device);
 }
 
+VkResult create_device(VkPhysicalDevice physical_device, //
+                       VkDevice& device, VkDeviceQueueCreateInfo (&queues)[2]) noexcept {
+    VkPhysicalDeviceProperties props{};
+    vkGetPhysicalDeviceProperties(physical_device, &props);
+    // the semaphore functions are in the core since 1.2. the KHR entry points are not loaded
+    if (VK_VERSION_MAJOR(props.apiVersion) == 1 && VK_VERSION_MINOR(props.apiVersion) < 2)
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+    VkPhysicalDeviceTimelineSemaphoreFeatures timeline{};
+    timeline.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    VkPhysicalDeviceFeatures2 features{};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &timeline;
+    vkGetPhysicalDeviceFeatures2(physical_device, &features);
+    if (timeline.timelineSemaphore == VK_FALSE)
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+
+    uint32_t count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &count, nullptr);
+    auto properties = make_unique<VkQueueFamilyProperties[]>(count);
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &count, properties.get());
+    // 2 queue (gfx, transfer)
+    queues[0].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queues[0].pQueuePriorities = &global_queue_priority;
+    queues[0].queueFamilyIndex = get_graphics_queue_available(properties.get(), count);
+    queues[0].queueCount = 1;
+    if (queues[0].queueFamilyIndex >= count)
+        return VK_ERROR_UNKNOWN;
+    queues[1] = queues[0];
+    queues[1].queueFamilyIndex = get_transfer_queue_available(properties.get(), count);
+    const auto dedicated = queues[1].queueFamilyIndex < count;
+    if (dedicated == false) // share the graphics queue
+        queues[1] = queues[0];
+
+    // only the timeline semaphore
+    VkPhysicalDeviceTimelineSemaphoreFeatures enabled{};
+    enabled.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    enabled.timelineSemaphore = VK_TRUE;
+    VkDeviceCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    info.pNext = &enabled;
+    info.queueCreateInfoCount = dedicated ? 2 : 1;
+    info.pQueueCreateInfos = queues;
+    return vkCreateDevice(physical_device, &info, nullptr, &device);
+}
+
+VkResult create_device(VkPhysicalDevice physical_device, //
+                       VkDevice& device, VkDeviceQueueCreateInfo& queue_info, bool& draw_indirect_count) noexcept {
+    VkPhysicalDeviceProperties props{};
+    vkGetPhysicalDeviceProperties(physical_device, &props);
+    VkPhysicalDeviceVulkan12Features features12{};
+    features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    VkPhysicalDeviceFeatures2 features{};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    // the 1.2 features struct can't be used before 1.2
+    const auto version12 = VK_VERSION_MAJOR(props.apiVersion) > 1 || VK_VERSION_MINOR(props.apiVersion) >= 2;
+    if (version12)
+        features.pNext = &features12;
+    vkGetPhysicalDeviceFeatures2(physical_device, &features);
+    if (features.features.multiDrawIndirect == VK_FALSE || features.features.drawIndirectFirstInstance == VK_FALSE)
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+    draw_indirect_count = features12.drawIndirectCount == VK_TRUE;
+
+    uint32_t count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &count, nullptr);
+    auto properties = make_unique<VkQueueFamilyProperties[]>(count);
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &count, properties.get());
+
+    queue_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queue_info.pQueuePriorities = &global_queue_priority;
+    queue_info.queueFamilyIndex = get_graphics_queue_available(properties.get(), count);
+    if (queue_info.queueFamilyIndex > count)
+        return VK_ERROR_UNKNOWN;
+    queue_info.queueCount = 1;
+    // only the features for the indirect draws
+    VkPhysicalDeviceVulkan12Features enabled12{};
+    enabled12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    enabled12.drawIndirectCount = features12.drawIndirectCount;
+    VkPhysicalDeviceFeatures enabled{};
+    enabled.multiDrawIndirect = VK_TRUE;
+    enabled.drawIndirectFirstInstance = VK_TRUE;
+    VkDeviceCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    if (version12)
+        info.pNext = &enabled12;
+    info.pEnabledFeatures = &enabled;
+    info.queueCreateInfoCount = 1;
+    info.pQueueCreateInfos = &queue_info;
+    return vkCreateDevice(physical_device, &info, nullptr, &device);
+}
+
+VkResult create_device(VkPhysicalDevice physical_device, //
+                       VkDevice& device, VkDeviceQueueCreateInfo& queue_info,
+                       VkPhysicalDeviceDescriptorIndexingFeatures& enabled) noexcept {
+    VkPhysicalDeviceDescriptorIndexingFeatures indexing{};
+    indexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+    VkPhysicalDeviceFeatures2 features{};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &indexing;
+    vkGetPhysicalDeviceFeatures2(physical_device, &features);
+    if (indexing.runtimeDescriptorArray == VK_FALSE || indexing.descriptorBindingPartiallyBound == VK_FALSE ||
+        indexing.descriptorBindingSampledImageUpdateAfterBind == VK_FALSE ||
+        indexing.descriptorBindingUpdateUnusedWhilePending == VK_FALSE)
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+
+    uint32_t count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &count, nullptr);
+    auto properties = make_unique<VkQueueFamilyProperties[]>(count);
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &count, properties.get());
+
+    queue_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queue_info.pQueuePriorities = &global_queue_priority;
+    queue_info.queueFamilyIndex = get_graphics_queue_available(properties.get(), count);
+    if (queue_info.queueFamilyIndex >= count)
+        return VK_ERROR_UNKNOWN;
+    queue_info.queueCount = 1;
+    // only the features for the sampled image array
+    enabled = VkPhysicalDeviceDescriptorIndexingFeatures{};
+    enabled.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+    enabled.runtimeDescriptorArray = VK_TRUE;
+    enabled.descriptorBindingPartiallyBound = VK_TRUE;
+    enabled.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    enabled.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    enabled.shaderSampledImageArrayNonUniformIndexing = indexing.shaderSampledImageArrayNonUniformIndexing;
+    VkPhysicalDeviceFeatures2 enabled_features{};
+    enabled_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    enabled_features.pNext = &enabled;
+    // the extension is in the core since 1.2
+    VkPhysicalDeviceProperties props{};
+    vkGetPhysicalDeviceProperties(physical_device, &props);
+    const char* extension_names[1]{VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME};
+    VkDeviceCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    info.pNext = &enabled_features;
+    if (VK_VERSION_MAJOR(props.apiVersion) == 1 && VK_VERSION_MINOR(props.apiVersion) < 2) {
+        info.ppEnabledExtensionNames = extension_names;
+        info.enabledExtensionCount = 1;
+    }
+    info.queueCreateInfoCount = 1;
+    info.pQueueCreateInfos = &queue_info;
+    const auto ec = vkCreateDevice(physical_device, &info, nullptr, &device);
+    enabled.pNext = nullptr;
+    return ec;
+}
+
 uint32_t get_surface_support(VkPhysicalDevice device, VkSurfaceKHR surface, uint32_t count,
                              uint32_t exclude_index) noexcept {
     for (auto i = 0u; i < count; ++i) {
@@ -386,8 +547,25 @@ vulkan_shader_module_t::vulkan_shader_module_t(VkDevice _device, const fs::path
         throw system_error{ENOENT, system_category()};
     VkShaderModuleCreateInfo info{};
     info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    const auto blob = read_all(fpath, info.codeSize);
-    info.pCode = reinterpret_cast<const uint32_t*>(blob.get());
+    // the mapping is page aligned. `pCode` requires 4 byte alignment
+    const mapped_file_t blob{fpath};
+    if (auto ec = blob.is_valid())
+        throw system_error{static_cast<int>(ec), system_category(), "mapped_file_t"};
+    const auto code = blob.bytes();
+    info.codeSize = code.size();
+    info.pCode = reinterpret_cast<const uint32_t*>(code.data());
+    if (auto ec = vkCreateShaderModule(device, &info, nullptr, &handle))
+        throw vulkan_exception_t{ec, "vkCreateShaderModule"};
+}
+
+vulkan_shader_module_t::vulkan_shader_module_t(VkDevice _device, gsl::span<const uint32_t> code) noexcept(false)
+    : device{_device} {
+    if (code.empty())
+        throw system_error{EINVAL, system_category(), "empty SPIR-V"};
+    VkShaderModuleCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    info.codeSize = code.size_bytes();
+    info.pCode = code.data();
     if (auto ec = vkCreateShaderModule(device, &info, nullptr, &handle))
         throw vulkan_exception_t{ec, "vkCreateShaderModule"};
 }
@@ -396,6 +574,53 @@ vulkan_shader_module_t::~vulkan_shader_module_t() noexcept {
     vkDestroyShaderModule(device, handle, nullptr);
 }
 
+void vulkan_specialization_t::set_bits(uint32_t constant_id, uint32_t bits) noexcept(false) {
+    for (auto i = 0u; i < entries.size(); ++i) {
+        if (entries[i].constantID != constant_id)
+            continue;
+        values[i] = bits;
+        return;
+    }
+    VkSpecializationMapEntry entry{};
+    entry.constantID = constant_id;
+    entry.offset = static_cast<uint32_t>(values.size() * sizeof(uint32_t));
+    entry.size = sizeof(uint32_t);
+    entries.emplace_back(entry);
+    values.emplace_back(bits);
+}
+
+void vulkan_specialization_t::set(uint32_t constant_id, uint32_t value) noexcept(false) {
+    set_bits(constant_id, value);
+}
+
+void vulkan_specialization_t::set(uint32_t constant_id, int32_t value) noexcept(false) {
+    set_bits(constant_id, static_cast<uint32_t>(value));
+}
+
+void vulkan_specialization_t::set(uint32_t constant_id, float value) noexcept(false) {
+    uint32_t bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+    set_bits(constant_id, bits);
+}
+
+uint64_t vulkan_specialization_t::make_key(uint64_t seed) const noexcept {
+    for (auto i = 0u; i < entries.size(); ++i) {
+        const uint32_t pair[2]{entries[i].constantID, values[i]};
+        seed = hash_content(gsl::as_bytes(gsl::make_span(pair, 2)), seed);
+    }
+    return seed;
+}
+
+const VkSpecializationInfo* vulkan_specialization_t::get() noexcept {
+    if (entries.empty())
+        return nullptr;
+    info.mapEntryCount = static_cast<uint32_t>(entries.size());
+    info.pMapEntries = entries.data();
+    info.dataSize = values.size() * sizeof(uint32_t);
+    info.pData = values.data();
+    return &info;
+}
+
 vulkan_swapchain_t::vulkan_swapchain_t(VkDevice _device, VkSurfaceKHR surface,
                                        const VkSurfaceCapabilitiesKHR& capabilities, VkFormat surface_format,
                                        VkColorSpaceKHR surface_color_space, VkPresentModeKHR present_mode)
@@ -526,6 +751,112 @@ vulkan_fence_t::~vulkan_fence_t() noexcept {
     vkDestroyFence(device, handle, nullptr);
 }
 
+vulkan_transfer_queue_t::vulkan_transfer_queue_t(VkDevice _device,
+                                                 const VkDeviceQueueCreateInfo& queue_info) noexcept(false)
+    : device{_device}, family_index{queue_info.queueFamilyIndex} {
+    vkGetDeviceQueue(device, family_index, 0, &queue);
+    {
+        VkSemaphoreTypeCreateInfo type_info{};
+        type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        type_info.initialValue = last;
+        VkSemaphoreCreateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        info.pNext = &type_info;
+        if (auto ec = vkCreateSemaphore(device, &info, nullptr, &timeline))
+            throw vulkan_exception_t{ec, "vkCreateSemaphore"};
+    }
+    VkCommandPoolCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    info.queueFamilyIndex = family_index;
+    if (auto ec = vkCreateCommandPool(device, &info, nullptr, &pool)) {
+        vkDestroySemaphore(device, timeline, nullptr);
+        throw vulkan_exception_t{ec, "vkCreateCommandPool"};
+    }
+}
+
+vulkan_transfer_queue_t::~vulkan_transfer_queue_t() noexcept {
+    wait(last);
+    for (const auto& slot : slots)
+        vkFreeCommandBuffers(device, pool, 1, &slot.commands);
+    vkDestroyCommandPool(device, pool, nullptr);
+    vkDestroySemaphore(device, timeline, nullptr);
+}
+
+VkResult vulkan_transfer_queue_t::begin(VkCommandBuffer& commands) noexcept {
+    uint64_t completed = 0;
+    if (auto ec = get_completed(completed))
+        return ec;
+    slot_t* free_slot = nullptr;
+    for (auto& slot : slots)
+        if (slot.value <= completed) {
+            free_slot = &slot;
+            break;
+        }
+    if (free_slot == nullptr) {
+        VkCommandBufferAllocateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        info.commandPool = pool;
+        info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        info.commandBufferCount = 1;
+        VkCommandBuffer handle = VK_NULL_HANDLE;
+        if (auto ec = vkAllocateCommandBuffers(device, &info, &handle))
+            return ec;
+        free_slot = &slots.emplace_back(slot_t{handle, 0});
+    } else if (auto ec = vkResetCommandBuffer(free_slot->commands, 0)) {
+        return ec;
+    }
+    VkCommandBufferBeginInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (auto ec = vkBeginCommandBuffer(free_slot->commands, &info))
+        return ec;
+    free_slot->value = UINT64_MAX;
+    commands = free_slot->commands;
+    return VK_SUCCESS;
+}
+
+VkResult vulkan_transfer_queue_t::submit(VkCommandBuffer commands, uint64_t& value) noexcept {
+    TRACE_SCOPE("vulkan_transfer_queue_t::submit");
+    auto it = find_if(slots.begin(), slots.end(), [commands](const slot_t& slot) { return slot.commands == commands; });
+    if (it == slots.end() || it->value != UINT64_MAX)
+        return VK_ERROR_UNKNOWN;
+    // the command buffer can be reused when the submit failed
+    it->value = 0;
+    if (auto ec = vkEndCommandBuffer(commands))
+        return ec;
+    const auto signal = last + 1;
+    VkTimelineSemaphoreSubmitInfo values{};
+    values.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    values.signalSemaphoreValueCount = 1;
+    values.pSignalSemaphoreValues = &signal;
+    VkSubmitInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    info.pNext = &values;
+    info.commandBufferCount = 1;
+    info.pCommandBuffers = &commands;
+    info.signalSemaphoreCount = 1;
+    info.pSignalSemaphores = &timeline;
+    if (auto ec = vkQueueSubmit(queue, 1, &info, VK_NULL_HANDLE))
+        return ec;
+    it->value = value = last = signal;
+    return VK_SUCCESS;
+}
+
+VkResult vulkan_transfer_queue_t::get_completed(uint64_t& value) const noexcept {
+    return vkGetSemaphoreCounterValue(device, timeline, &value);
+}
+
+VkResult vulkan_transfer_queue_t::wait(uint64_t value, uint64_t timeout) const noexcept {
+    VkSemaphoreWaitInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    info.semaphoreCount = 1;
+    info.pSemaphores = &timeline;
+    info.pValues = &value;
+    return vkWaitSemaphores(device, &info, timeout);
+}
+
 VkResult create_uniform_buffer(VkDevice device, VkBuffer& buffer, VkBufferCreateInfo& info,
                                VkDeviceSize length) noexcept {
     info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -598,9 +929,53 @@ VkResult write_memory(VkDevice device, VkBuffer buffer, VkDeviceMemory memory, c
     return VK_SUCCESS;
 }
 
+vulkan_ring_buffer_t::vulkan_ring_buffer_t(VkDevice _device, const VkPhysicalDeviceMemoryProperties& props,
+                                           VkBufferUsageFlags usage, VkDeviceSize size, uint32_t _num_frames,
+                                           VkDeviceSize alignment) noexcept(false)
+    : device{_device}, num_frames{_num_frames}, slot_size{(size + alignment - 1) / alignment * alignment} {
+    if (num_frames == 0 || slot_size == 0)
+        throw vulkan_exception_t{VK_ERROR_INITIALIZATION_FAILED, "vulkan_ring_buffer_t"};
+    VkBufferCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    info.size = slot_size * num_frames;
+    info.usage = usage;
+    info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (auto ec = vkCreateBuffer(device, &info, nullptr, &handle))
+        throw vulkan_exception_t{ec, "vkCreateBuffer"};
+    if (auto ec = allocate_memory(device, handle, memory, info,
+                                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, props)) {
+        vkDestroyBuffer(device, handle, nullptr);
+        throw vulkan_exception_t{ec, "vkAllocateMemory"};
+    }
+    void* ptr = nullptr;
+    VkResult ec = vkBindBufferMemory(device, handle, memory, 0);
+    if (ec == VK_SUCCESS)
+        ec = vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &ptr);
+    if (ec != VK_SUCCESS) {
+        vkFreeMemory(device, memory, nullptr);
+        vkDestroyBuffer(device, handle, nullptr);
+        throw vulkan_exception_t{ec, "vkBindBufferMemory || vkMapMemory"};
+    }
+    mapping = static_cast<std::byte*>(ptr);
+}
+
+vulkan_ring_buffer_t::~vulkan_ring_buffer_t() noexcept {
+    vkDestroyBuffer(device, handle, nullptr);
+    vkFreeMemory(device, memory, nullptr); // implicitly unmapped
+}
+
+VkDeviceSize vulkan_ring_buffer_t::get_offset(uint32_t frame) const noexcept {
+    return slot_size * (frame % num_frames);
+}
+
+gsl::span<std::byte> vulkan_ring_buffer_t::get_slot(uint32_t frame) const noexcept {
+    return gsl::make_span(mapping + get_offset(frame), static_cast<size_t>(slot_size));
+}
+
 VkResult render_submit(VkQueue queue,                       //
                        gsl::span<VkCommandBuffer> commands, //
                        VkFence fence, VkSemaphore wait, VkSemaphore signal) noexcept {
+    TRACE_SCOPE("render_submit");
     VkSubmitInfo info{};
     info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
     info.pCommandBuffers = commands.data();
@@ -618,9 +993,29 @@ VkResult render_submit(VkQueue queue,                       //
     return vkQueueSubmit(queue, 1, &info, fence);
 }
 
+VkResult render_submit(VkQueue queue,                       //
+                       gsl::span<VkCommandBuffer> commands, //
+                       VkFence fence, VkSemaphore timeline, uint64_t value, VkPipelineStageFlags stage) noexcept {
+    TRACE_SCOPE("render_submit");
+    VkTimelineSemaphoreSubmitInfo values{};
+    values.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    values.waitSemaphoreValueCount = 1;
+    values.pWaitSemaphoreValues = &value;
+    VkSubmitInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    info.pNext = &values;
+    info.pCommandBuffers = commands.data();
+    info.commandBufferCount = static_cast<uint32_t>(commands.size());
+    info.waitSemaphoreCount = 1;
+    info.pWaitSemaphores = &timeline;
+    info.pWaitDstStageMask = &stage;
+    return vkQueueSubmit(queue, 1, &info, fence);
+}
+
 VkResult present_submit(VkQueue queue,                                  //
                         uint32_t image_index, VkSwapchainKHR swapchain, //
                         VkSemaphore wait) noexcept {
+    TRACE_SCOPE("present_submit");
     VkPresentInfoKHR info{};
     info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
     VkSemaphore wait_group[] = {wait};
@@ -633,14 +1028,15 @@ VkResult present_submit(VkQueue queue,                                  //
     return vkQueuePresentKHR(queue, &info);
 }
 
-vulkan_command_recorder_t::vulkan_command_recorder_t(VkCommandBuffer command_buffer, //
-                                                     VkRenderPass renderpass, VkFramebuffer framebuffer,
-                                                     VkExtent2D extent) noexcept(false)
-    : commands{command_buffer}, clear{} {
+void vulkan_command_recorder_t::begin_commands() noexcept(false) {
     VkCommandBufferBeginInfo begin{};
     begin.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     if (auto ec = vkBeginCommandBuffer(commands, &begin))
         throw vulkan_exception_t{ec, "vkBeginCommandBuffer"};
+}
+
+void vulkan_command_recorder_t::begin_renderpass(VkRenderPass renderpass, VkFramebuffer framebuffer,
+                                                 VkExtent2D extent) noexcept {
     VkRenderPassBeginInfo render{};
     render.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
     render.renderPass = renderpass;
@@ -656,8 +1052,127 @@ vulkan_command_recorder_t::vulkan_command_recorder_t(VkCommandBuffer command_buf
     vkCmdBeginRenderPass(commands, &render, VK_SUBPASS_CONTENTS_INLINE);
 }
 
+vulkan_command_recorder_t::vulkan_command_recorder_t(VkCommandBuffer command_buffer, //
+                                                     VkRenderPass renderpass, VkFramebuffer framebuffer,
+                                                     VkExtent2D extent) noexcept(false)
+    : commands{command_buffer}, clear{} {
+    begin_commands();
+    begin_renderpass(renderpass, framebuffer, extent);
+}
+
+vulkan_command_recorder_t::vulkan_command_recorder_t(VkCommandBuffer command_buffer, //
+                                                     VkRenderPass renderpass, VkFramebuffer framebuffer,
+                                                     VkExtent2D extent, vulkan_timestamp_pool_t& _timestamps,
+                                                     uint32_t _frame) noexcept(false)
+    : commands{command_buffer}, clear{}, timestamps{&_timestamps}, frame{_frame} {
+    begin_commands();
+    timestamps->reset(commands, frame);
+    region = timestamps->begin(commands, frame, "renderpass");
+    begin_renderpass(renderpass, framebuffer, extent);
+}
+
 vulkan_command_recorder_t::~vulkan_command_recorder_t() noexcept(false) {
     vkCmdEndRenderPass(commands);
+    if (timestamps)
+        timestamps->end(commands, frame, region);
     if (auto ec = vkEndCommandBuffer(commands))
         throw vulkan_exception_t{ec, "vkEndCommandBuffer"};
 }
+
+vulkan_timestamp_scope_t::vulkan_timestamp_scope_t(vulkan_command_recorder_t& _recorder, gsl::czstring<> name) noexcept
+    : recorder{_recorder} {
+    if (recorder.timestamps)
+        region = recorder.timestamps->begin(recorder.commands, recorder.frame, name);
+}
+
+vulkan_timestamp_scope_t::~vulkan_timestamp_scope_t() noexcept {
+    if (recorder.timestamps)
+        recorder.timestamps->end(recorder.commands, recorder.frame, region);
+}
+
+vulkan_timestamp_pool_t::vulkan_timestamp_pool_t(VkDevice _device, VkPhysicalDevice physical_device,
+                                                 uint32_t queue_index, //
+                                                 uint32_t _num_frames, uint32_t _num_regions) noexcept(false)
+    : device{_device}, num_frames{_num_frames}, num_regions{_num_regions} {
+    uint32_t count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &count, nullptr);
+    auto properties = make_unique<VkQueueFamilyProperties[]>(count);
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &count, properties.get());
+    if (queue_index >= count || properties[queue_index].timestampValidBits == 0)
+        throw vulkan_exception_t{VK_ERROR_FEATURE_NOT_PRESENT, "timestampValidBits"};
+    if (const auto bits = properties[queue_index].timestampValidBits; bits < 64)
+        mask = (uint64_t{1} << bits) - 1;
+    VkPhysicalDeviceProperties props{};
+    vkGetPhysicalDeviceProperties(physical_device, &props);
+    period = props.limits.timestampPeriod;
+
+    VkQueryPoolCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    info.queryCount = num_frames * num_regions * 2;
+    if (auto ec = vkCreateQueryPool(device, &info, nullptr, &handle))
+        throw vulkan_exception_t{ec, "vkCreateQueryPool"};
+    names = make_unique<gsl::czstring<>[]>(num_frames * num_regions);
+    counts = make_unique<uint32_t[]>(num_frames);
+    pending = make_unique<bool[]>(num_frames);
+    results = make_unique<uint64_t[]>(num_regions * 2 * 2);
+}
+
+vulkan_timestamp_pool_t::~vulkan_timestamp_pool_t() noexcept {
+    vkDestroyQueryPool(device, handle, nullptr);
+}
+
+void vulkan_timestamp_pool_t::reset(VkCommandBuffer commands, uint32_t frame) noexcept {
+    if (frame >= num_frames)
+        return;
+    if (pending[frame])
+        ++dropped;
+    pending[frame] = false;
+    counts[frame] = 0;
+    vkCmdResetQueryPool(commands, handle, frame * num_regions * 2, num_regions * 2);
+}
+
+uint32_t vulkan_timestamp_pool_t::begin(VkCommandBuffer commands, uint32_t frame, gsl::czstring<> name) noexcept {
+    if (frame >= num_frames || counts[frame] >= num_regions)
+        return UINT32_MAX;
+    const auto region = counts[frame]++;
+    const auto index = frame * num_regions + region;
+    names[index] = name;
+    pending[frame] = true;
+    vkCmdWriteTimestamp(commands, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, handle, index * 2);
+    return region;
+}
+
+void vulkan_timestamp_pool_t::end(VkCommandBuffer commands, uint32_t frame, uint32_t region) noexcept {
+    if (frame >= num_frames || region >= counts[frame])
+        return;
+    vkCmdWriteTimestamp(commands, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, handle, (frame * num_regions + region) * 2 + 1);
+}
+
+VkResult vulkan_timestamp_pool_t::collect(uint32_t frame, std::vector<gpu_time_region_t>& regions) noexcept {
+    if (frame >= num_frames)
+        return VK_ERROR_UNKNOWN;
+    const auto count = counts[frame];
+    if (pending[frame] == false || count == 0)
+        return VK_SUCCESS;
+    constexpr auto stride = sizeof(uint64_t) * 2;
+    if (auto ec = vkGetQueryPoolResults(device, handle, frame * num_regions * 2, count * 2, stride * count * 2,
+                                        results.get(), stride,
+                                        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT))
+        return ec; // VK_NOT_READY
+    const auto to_nanoseconds = [this](uint64_t tick) -> uint64_t {
+        return static_cast<uint64_t>(static_cast<double>(tick & mask) * period);
+    };
+    for (auto i = 0u; i < count; ++i) {
+        const uint64_t* pair = results.get() + i * 4; // begin, availability, end, availability
+        if (pair[1] == 0 || pair[3] == 0)
+            return VK_NOT_READY;
+    }
+    for (auto i = 0u; i < count; ++i) {
+        const uint64_t* pair = results.get() + i * 4;
+        regions.emplace_back(gpu_time_region_t{names[frame * num_regions + i], //
+                                               to_nanoseconds(pair[0]), to_nanoseconds(pair[2])});
+    }
+    pending[frame] = false;
+    return VK_SUCCESS;
+}
@@ -1,5 +1,6 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <cstring>
 #include <memory>
 #include <vector>
 
@@ -39,6 +40,24 @@ VkResult create_pipeline_layout(VkDevice device, VkPipelineLayout& layout) noexc
     return vkCreatePipelineLayout(device, &info, nullptr, &layout);
 }
 
+VkResult create_pipeline_layout(VkDevice device, VkPipelineLayout& layout,
+                                gsl::span<const VkDescriptorSetLayout> set_layouts,
+                                gsl::span<const VkPushConstantRange> ranges) noexcept {
+    VkPipelineLayoutCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    info.setLayoutCount = static_cast<uint32_t>(set_layouts.size());
+    info.pSetLayouts = set_layouts.data();
+    info.pushConstantRangeCount = static_cast<uint32_t>(ranges.size());
+    info.pPushConstantRanges = ranges.data();
+    return vkCreatePipelineLayout(device, &info, nullptr, &layout);
+}
+
+void vulkan_push_constant_input_t::push(VkCommandBuffer command_buffer, VkPipelineLayout pipeline_layout,
+                                    const push_constant_t& constants) noexcept {
+    vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(push_constant_t),
+                       &constants);
+}
+
 struct input1_t : vulkan_pipeline_input_t {
     struct input_unit_t final {
         glm::vec2 position{};
@@ -293,22 +312,23 @@ auto make_pipeline_input_2(VkDevice device, const VkPhysicalDeviceMemoryProperti
     return impl;
 }
 
-struct input3_t : vulkan_pipeline_input_t {
+struct input3_t : vulkan_push_constant_input_t {
     struct input_unit_t final {
         glm::vec2 position{};
         glm::vec3 color{};
     };
     struct uniform_t final {
-        glm::mat4 model;
         glm::mat4 view;
         glm::mat4 projection;
     };
+    static_assert(sizeof(glm::mat4) == sizeof(push_constant_t));
 
   public:
     const VkDevice device{};
 
-    VkDescriptorSetLayout descriptor_layout{};
-    VkDescriptorPool descriptor_pool{};
+    unique_ptr<vulkan_descriptor_allocator_t> owned{}; // when the allocator is not shared
+    vulkan_descriptor_allocator_t& descriptor_allocator;
+    VkDescriptorSetLayout descriptor_layout{}; // owned by the `descriptor_allocator`
     VkDescriptorSet descriptors[1]{};
 
     VkVertexInputBindingDescription desc{};
@@ -318,55 +338,31 @@ struct input3_t : vulkan_pipeline_input_t {
     VkDeviceMemory memories[3]{};
     VkDeviceSize offsets[1]{}; // offset - vertex buffer 0
     vulkan_shader_module_t vert, frag;
+    glm::mat4 model{1}; // for `record`
 
   public:
-    input3_t(VkDevice _device, const fs::path& shader_dir) noexcept(false)
-        : device{_device},                                      //
-          vert{device, shader_dir / "sample_uniform_vert.spv"}, //
+    input3_t(VkDevice _device, const fs::path& shader_dir, vulkan_descriptor_allocator_t* shared) noexcept(false)
+        : device{_device},                                                                      //
+          owned{shared ? nullptr : make_unique<vulkan_descriptor_allocator_t>(_device, 1, 1)}, //
+          descriptor_allocator{shared ? *shared : *owned},                                      //
+          vert{device, shader_dir / "sample_uniform_vert.spv"},                                 //
           frag{device, shader_dir / "bypass_frag.spv"} {
-        {
-            VkDescriptorSetLayoutBinding binding{};
-            binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-            binding.descriptorCount = 1;
-            binding.binding = 0;
-            binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-            VkDescriptorSetLayoutCreateInfo info{};
-            info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-            info.bindingCount = 1;
-            info.pBindings = &binding;
-            if (auto ec = vkCreateDescriptorSetLayout(device, &info, nullptr, &descriptor_layout))
-                throw vulkan_exception_t{ec, "vkCreateDescriptorSetLayout"};
-        }
-        {
-            VkDescriptorPoolSize requirement{};
-            requirement.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-            requirement.descriptorCount = 1;
-            VkDescriptorPoolCreateInfo info{};
-            info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-            info.poolSizeCount = 1;
-            info.pPoolSizes = &requirement;
-            info.maxSets = 1; // use only 1
-            if (auto ec = vkCreateDescriptorPool(device, &info, nullptr, &descriptor_pool)) {
-                vkDestroyDescriptorSetLayout(device, descriptor_layout, nullptr);
-                throw vulkan_exception_t{ec, "vkCreateDescriptorPool"};
-            }
-        }
-        {
-            VkDescriptorSetAllocateInfo info{};
-            info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-            info.descriptorPool = descriptor_pool;
-            info.descriptorSetCount = 1;
-            info.pSetLayouts = &descriptor_layout;
-            if (auto ec = vkAllocateDescriptorSets(device, &info, descriptors + 0)) {
-                vkDestroyDescriptorPool(device, descriptor_pool, nullptr);
-                vkDestroyDescriptorSetLayout(device, descriptor_layout, nullptr);
-                throw vulkan_exception_t{ec, "vkAllocateDescriptorSets"};
-            }
-        }
+        VkDescriptorSetLayoutBinding binding{};
+        binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        binding.descriptorCount = 1;
+        binding.binding = 0;
+        binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        VkDescriptorSetLayoutCreateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        info.bindingCount = 1;
+        info.pBindings = &binding;
+        if (auto ec = descriptor_allocator.get_layout(info, descriptor_layout))
+            throw vulkan_exception_t{ec, "vkCreateDescriptorSetLayout"};
     }
     ~input3_t() noexcept {
-        vkDestroyDescriptorPool(device, descriptor_pool, nullptr);
-        vkDestroyDescriptorSetLayout(device, descriptor_layout, nullptr);
+        // the set refers the uniform buffer below. the shared allocator must not return it again
+        if (descriptors[0])
+            descriptor_allocator.release(descriptors[0]);
         for (auto i : {2, 1, 0}) {
             if (memories[i])
                 vkFreeMemory(device, memories[i], nullptr);
@@ -382,7 +378,7 @@ struct input3_t : vulkan_pipeline_input_t {
         // uniform
         {
             uniform_t ubo{};
-            ubo.model = ubo.view = ubo.projection = glm::mat4{1};
+            ubo.view = ubo.projection = glm::mat4{1};
             ubo.projection[1][1] *= -1; // GL -> Vulkan
             if (auto ec = create_uniform_buffer(device, buffers[0], buffer_info, sizeof(uniform_t)))
                 throw vulkan_exception_t{ec, "vkCreateBuffer"};
@@ -393,20 +389,20 @@ struct input3_t : vulkan_pipeline_input_t {
             vkGetBufferMemoryRequirements(device, buffers[0], &requirements);
             if (auto ec = update_memory(device, memories[0], requirements, &ubo, 0))
                 throw vulkan_exception_t{ec, "vkMapMemory"};
-            // descriptor set must be updated (before being used with Command Buffer)
+            // the set only refers the buffer. `update` changes the memory, not the set
             VkDescriptorBufferInfo change{};
             change.buffer = buffers[0];
             change.offset = 0;
             change.range = sizeof(uniform_t);
             VkWriteDescriptorSet write{};
             write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            write.dstSet = descriptors[0];
             write.dstBinding = 0;
             write.dstArrayElement = 0; // descriptors can be array
             write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
             write.descriptorCount = 1;
             write.pBufferInfo = &change;
-            vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+            if (auto ec = descriptor_allocator.get(descriptor_layout, {&write, 1}, descriptors[0]))
+                throw vulkan_exception_t{ec, "vkAllocateDescriptorSets"};
         }
         // vertices
         {
@@ -477,47 +473,28 @@ struct input3_t : vulkan_pipeline_input_t {
     }
 
     VkResult make_pipeline_layout(VkDevice device, VkPipelineLayout& layout) noexcept override {
-        VkPipelineLayoutCreateInfo info{};
-        info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        info.setLayoutCount = 1;
-        info.pSetLayouts = &descriptor_layout;
-        info.pushConstantRangeCount = 0;
-        info.pPushConstantRanges = nullptr;
-        return vkCreatePipelineLayout(device, &info, nullptr, &layout);
+        // layout(push_constant) uniform constants_t { mat4 model; }
+        const VkPushConstantRange range{VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(push_constant_t)};
+        return ::create_pipeline_layout(device, layout, {&descriptor_layout, 1}, {&range, 1});
     }
 
     VkResult update() noexcept override {
-        uniform_t ubo{};
         const float time = static_cast<float>(clock()) / 1900;
         const auto Z = glm::vec3(0, 0, 1);
-        ubo.model = glm::rotate(glm::mat4(1), glm::radians(time), Z);
+        model = glm::rotate(glm::mat4(1), glm::radians(time), Z);
+        uniform_t ubo{};
         ubo.view = glm::lookAt(glm::vec3(2, 2, 2), glm::vec3(0), Z);
         ubo.projection = glm::perspective(glm::radians(45.0f), 1.0f / 1, 0.1f, 10.0f);
         // ubo.projection[1][1] *= -1; // GL -> Vulkan
 
+        // the descriptor set is not changed
         VkMemoryRequirements requirements{};
         vkGetBufferMemoryRequirements(device, buffers[0], &requirements);
-        if (auto ec = update_memory(device, memories[0], requirements, &ubo, 0))
-            return ec;
-
-        VkDescriptorBufferInfo change{};
-        change.buffer = buffers[0];
-        change.offset = 0;
-        change.range = sizeof(uniform_t);
-        VkWriteDescriptorSet write{};
-        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        write.dstSet = descriptors[0];
-        write.dstBinding = 0;
-        write.dstArrayElement = 0; // descriptors can be array
-        write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        write.descriptorCount = 1;
-        write.pBufferInfo = &change;
-        vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
-        return VK_SUCCESS;
+        requirements.size = sizeof(uniform_t);
+        return update_memory(device, memories[0], requirements, &ubo, 0);
     }
 
-    void record(VkCommandBuffer command_buffer, VkPipeline pipeline,
-                VkPipelineLayout pipeline_layout) noexcept override {
+    void bind(VkCommandBuffer command_buffer, VkPipeline pipeline, VkPipelineLayout pipeline_layout) noexcept {
         vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
         auto binding = 0u;
         vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
@@ -531,24 +508,357 @@ struct input3_t : vulkan_pipeline_input_t {
         constexpr auto index_offset = 0;
         vkCmdBindIndexBuffer(command_buffer, //
                              buffers[2], index_offset, VK_INDEX_TYPE_UINT16);
+    }
+
+    void record(VkCommandBuffer command_buffer, VkPipeline pipeline,
+                VkPipelineLayout pipeline_layout) noexcept override {
+        push_constant_t constants{};
+        std::memcpy(constants.model, &model, sizeof(push_constant_t));
+        record_each(command_buffer, pipeline, pipeline_layout, {&constants, 1});
+    }
+
+    void record_each(VkCommandBuffer command_buffer, VkPipeline pipeline, VkPipelineLayout pipeline_layout,
+                     gsl::span<const push_constant_t> objects) noexcept override {
+        bind(command_buffer, pipeline, pipeline_layout);
         constexpr auto num_instance = 1;
         constexpr auto first_index = 0;
         constexpr auto vertex_offset = 0;
         constexpr auto first_instance = 0;
         constexpr auto indices_size = 6u;
-        vkCmdDrawIndexed(command_buffer, indices_size, num_instance, first_index, vertex_offset, first_instance);
+        // no memory mapping for the objects. the constants are in the command buffer
+        for (const auto& constants : objects) {
+            push(command_buffer, pipeline_layout, constants);
+            vkCmdDrawIndexed(command_buffer, indices_size, num_instance, first_index, vertex_offset, first_instance);
+        }
     }
 };
 
 auto make_pipeline_input_3(VkDevice device, const VkPhysicalDeviceMemoryProperties& props,
-                           const fs::path& shader_dir) noexcept(false) -> unique_ptr<vulkan_pipeline_input_t> {
-    auto impl = make_unique<input3_t>(device, shader_dir);
+                           const fs::path& shader_dir) noexcept(false) -> unique_ptr<vulkan_push_constant_input_t> {
+    auto impl = make_unique<input3_t>(device, shader_dir, nullptr);
     impl->allocate(props);
     return impl;
 }
 
+auto make_pipeline_input_3(VkDevice device, const VkPhysicalDeviceMemoryProperties& props, const fs::path& shader_dir,
+                           vulkan_descriptor_allocator_t& descriptors) noexcept(false)
+    -> unique_ptr<vulkan_push_constant_input_t> {
+    auto impl = make_unique<input3_t>(device, shader_dir, &descriptors);
+    impl->allocate(props);
+    return impl;
+}
+
+struct input4_t : vulkan_pipeline_input2_t {
+    struct input_unit_t final {
+        glm::vec2 position{};
+        glm::vec2 uv{};
+    };
+    struct constants_t final {
+        glm::vec4 rect; // offset(xy), scale(zw)
+        uint32_t texture_index;
+    };
+    static constexpr uint32_t capacity = 4096;
+
+  public:
+    const VkDevice device{};
+    vulkan_bindless_heap_t heap; // 1 frame. the textures are never released
+    vector<uint32_t> textures{}; // indices in the `heap`
+
+    VkVertexInputBindingDescription desc{};
+    VkVertexInputAttributeDescription attrs[2]{};
+
+    VkBuffer buffers[2]{}; // vertices, indices
+    VkDeviceMemory memories[2]{};
+    VkDeviceSize offsets[1]{}; // offset - vertex buffer 0
+    vulkan_shader_module_t vert, frag;
+
+  public:
+    input4_t(VkDevice _device, const fs::path& shader_dir) noexcept(false)
+        : device{_device}, heap{device, capacity, 1, VK_SHADER_STAGE_FRAGMENT_BIT},
+          vert{device, shader_dir / "sample_texture_vert.spv"}, //
+          frag{device, shader_dir / "bindless_frag.spv"} {
+    }
+    ~input4_t() noexcept {
+        for (auto i : {1, 0}) {
+            if (memories[i])
+                vkFreeMemory(device, memories[i], nullptr);
+            if (buffers[i])
+                vkDestroyBuffer(device, buffers[i], nullptr);
+        }
+    }
+
+    void allocate(const VkPhysicalDeviceMemoryProperties& props) noexcept(false) {
+        const auto desired = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        VkBufferCreateInfo buffer_info{};
+        VkMemoryRequirements requirements{};
+        // vertices. unit quad, moved by the push constant
+        {
+            const vector<input_unit_t> vertices{{{0, 0}, {0, 0}}, {{1, 0}, {1, 0}}, {{1, 1}, {1, 1}}, {{0, 1}, {0, 1}}};
+            if (auto ec = create_vertex_buffer(device, buffers[0], //
+                                               buffer_info, sizeof(input_unit_t) * vertices.size()))
+                throw vulkan_exception_t{ec, "vkCreateBuffer"};
+            if (auto ec = allocate_memory(device, buffers[0], memories[0], buffer_info, desired, props))
+                throw vulkan_exception_t{ec, "vkAllocateMemory"};
+            if (auto ec = vkBindBufferMemory(device, buffers[0], memories[0], 0))
+                throw vulkan_exception_t{ec, "vkBindBufferMemory"};
+            vkGetBufferMemoryRequirements(device, buffers[0], &requirements);
+            requirements.size = sizeof(input_unit_t) * vertices.size(); // the rest is padding
+            if (auto ec = update_memory(device, memories[0], requirements, vertices.data(), 0))
+                throw vulkan_exception_t{ec, "vkMapMemory"};
+        }
+        // indices
+        {
+            const vector<uint16_t> indices{0, 1, 2, 2, 3, 0};
+            if (auto ec = create_index_buffer(device, buffers[1], //
+                                              buffer_info, sizeof(uint16_t) * indices.size()))
+                throw vulkan_exception_t{ec, "vkCreateBuffer"};
+            if (auto ec = allocate_memory(device, buffers[1], memories[1], buffer_info, desired, props))
+                throw vulkan_exception_t{ec, "vkAllocateMemory"};
+            if (auto ec = vkBindBufferMemory(device, buffers[1], memories[1], 0))
+                throw vulkan_exception_t{ec, "vkBindBufferMemory"};
+            vkGetBufferMemoryRequirements(device, buffers[1], &requirements);
+            requirements.size = sizeof(uint16_t) * indices.size();
+            if (auto ec = update_memory(device, memories[1], requirements, indices.data(), 0))
+                throw vulkan_exception_t{ec, "vkMapMemory"};
+        }
+    }
+
+    void setup_shader_stage(VkPipelineShaderStageCreateInfo (&stage)[2]) noexcept(false) override {
+        ::setup_shader_stage(stage, vert.handle, frag.handle);
+    }
+
+    void setup_vertex_input_state(VkPipelineVertexInputStateCreateInfo& info) noexcept override {
+        desc.binding = 0;
+        desc.stride = sizeof(input_unit_t);
+        desc.inputRate = VK_VERTEX_INPUT_RATE_VERTEX; // per vertex input
+        // layout(location = 0) in vec2 i_position;
+        attrs[0].binding = 0;
+        attrs[0].location = 0;
+        attrs[0].format = VK_FORMAT_R32G32_SFLOAT; // vec2
+        attrs[0].offset = 0;
+        // layout(location = 1) in vec2 i_uv;
+        attrs[1].binding = 0;
+        attrs[1].location = 1;
+        attrs[1].format = VK_FORMAT_R32G32_SFLOAT; // vec2
+        attrs[1].offset = sizeof(input_unit_t::position);
+        info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+        info.vertexBindingDescriptionCount = 1;
+        info.pVertexBindingDescriptions = &desc;
+        info.vertexAttributeDescriptionCount = 2;
+        info.pVertexAttributeDescriptions = attrs;
+    }
+
+    VkResult make_pipeline_layout(VkDevice device, VkPipelineLayout& layout) noexcept override {
+        const VkPushConstantRange range{VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0,
+                                        sizeof(constants_t)};
+        return ::create_pipeline_layout(device, layout, {&heap.layout, 1}, {&range, 1});
+    }
+
+    /// @brief Add the texture to the heap. `record` draws all textures in a grid
+    VkResult update(VkImageView view, VkSampler sampler) noexcept override {
+        try {
+            const auto index = heap.allocate(view, sampler);
+            if (index == UINT32_MAX)
+                return VK_ERROR_OUT_OF_POOL_MEMORY;
+            textures.emplace_back(index);
+            return VK_SUCCESS;
+        } catch (const std::bad_alloc&) {
+            return VK_ERROR_OUT_OF_HOST_MEMORY;
+        }
+    }
+
+    void record(VkCommandBuffer command_buffer, VkPipeline pipeline,
+                VkPipelineLayout pipeline_layout) noexcept override {
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+        // 1 bind for all textures
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, 1, &heap.set, 0,
+                                nullptr);
+        vkCmdBindVertexBuffers(command_buffer, 0, 1, buffers, offsets);
+        vkCmdBindIndexBuffer(command_buffer, buffers[1], 0, VK_INDEX_TYPE_UINT16);
+        auto columns = 1u;
+        while (columns * columns < textures.size())
+            ++columns;
+        const float scale = 2.0f / columns;
+        for (auto i = 0u; i < textures.size(); ++i) {
+            constants_t constants{};
+            constants.rect = glm::vec4{(i % columns) * scale - 1, (i / columns) * scale - 1, scale, scale};
+            constants.texture_index = textures[i];
+            vkCmdPushConstants(command_buffer, pipeline_layout, //
+                               VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(constants),
+                               &constants);
+            vkCmdDrawIndexed(command_buffer, 6u, 1, 0, 0, 0);
+        }
+    }
+};
+
 auto make_pipeline_input_4(VkDevice device, const VkPhysicalDeviceMemoryProperties& props,
                            const fs::path& shader_dir) noexcept(false) -> std::unique_ptr<vulkan_pipeline_input2_t> {
-    throw std::runtime_error{"not implemented"};
-    return nullptr;
+    auto impl = make_unique<input4_t>(device, shader_dir);
+    impl->allocate(props);
+    return impl;
+}
+
+struct input5_t : vulkan_instanced_input_t {
+    struct input_unit_t final {
+        glm::vec2 position{};
+        glm::vec3 color{};
+    };
+
+  public:
+    const VkDevice device{};
+    const uint32_t capacity;
+    uint32_t frame = 0; // of the last `update`
+    uint32_t count = 0; // instances in the `frame`
+
+    VkVertexInputBindingDescription descs[2]{}; // per vertex, per instance
+    VkVertexInputAttributeDescription attrs[7]{};
+
+    VkBuffer buffers[2]{}; // vertices, indices
+    VkDeviceMemory memories[2]{};
+    vulkan_ring_buffer_t instances;
+    vulkan_shader_module_t vert, frag;
+
+  public:
+    input5_t(VkDevice _device, const VkPhysicalDeviceMemoryProperties& props, const fs::path& shader_dir,
+             uint32_t num_frames, uint32_t _capacity) noexcept(false)
+        : device{_device}, capacity{_capacity},
+          instances{device, props, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, sizeof(instance_t) * _capacity, num_frames},
+          vert{device, shader_dir / "sample_instance_vert.spv"}, //
+          frag{device, shader_dir / "bypass_frag.spv"} {
+    }
+    ~input5_t() noexcept {
+        for (auto i : {1, 0}) {
+            if (memories[i])
+                vkFreeMemory(device, memories[i], nullptr);
+            if (buffers[i])
+                vkDestroyBuffer(device, buffers[i], nullptr);
+        }
+    }
+
+    void allocate(const VkPhysicalDeviceMemoryProperties& props) noexcept(false) {
+        const auto desired = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        VkBufferCreateInfo buffer_info{};
+        VkMemoryRequirements requirements{};
+        // vertices. a small quad for many copies
+        {
+            const vector<input_unit_t> vertices{{{-0.01f, -0.01f}, {1, 0, 0}},
+                                                {{0.01f, -0.01f}, {0, 1, 0}},
+                                                {{0.01f, 0.01f}, {0, 0, 1}},
+                                                {{-0.01f, 0.01f}, {1, 1, 1}}};
+            if (auto ec = create_vertex_buffer(device, buffers[0], //
+                                               buffer_info, sizeof(input_unit_t) * vertices.size()))
+                throw vulkan_exception_t{ec, "vkCreateBuffer"};
+            if (auto ec = allocate_memory(device, buffers[0], memories[0], buffer_info, desired, props))
+                throw vulkan_exception_t{ec, "vkAllocateMemory"};
+            if (auto ec = vkBindBufferMemory(device, buffers[0], memories[0], 0))
+                throw vulkan_exception_t{ec, "vkBindBufferMemory"};
+            vkGetBufferMemoryRequirements(device, buffers[0], &requirements);
+            requirements.size = sizeof(input_unit_t) * vertices.size(); // the rest is padding
+            if (auto ec = update_memory(device, memories[0], requirements, vertices.data(), 0))
+                throw vulkan_exception_t{ec, "vkMapMemory"};
+        }
+        // indices
+        {
+            const vector<uint16_t> indices{0, 1, 2, 2, 3, 0};
+            if (auto ec = create_index_buffer(device, buffers[1], //
+                                              buffer_info, sizeof(uint16_t) * indices.size()))
+                throw vulkan_exception_t{ec, "vkCreateBuffer"};
+            if (auto ec = allocate_memory(device, buffers[1], memories[1], buffer_info, desired, props))
+                throw vulkan_exception_t{ec, "vkAllocateMemory"};
+            if (auto ec = vkBindBufferMemory(device, buffers[1], memories[1], 0))
+                throw vulkan_exception_t{ec, "vkBindBufferMemory"};
+            vkGetBufferMemoryRequirements(device, buffers[1], &requirements);
+            requirements.size = sizeof(uint16_t) * indices.size();
+            if (auto ec = update_memory(device, memories[1], requirements, indices.data(), 0))
+                throw vulkan_exception_t{ec, "vkMapMemory"};
+        }
+    }
+
+    void setup_shader_stage(VkPipelineShaderStageCreateInfo (&stage)[2]) noexcept(false) override {
+        ::setup_shader_stage(stage, vert.handle, frag.handle);
+    }
+
+    void setup_vertex_input_state(VkPipelineVertexInputStateCreateInfo& info) noexcept override {
+        descs[0].binding = 0;
+        descs[0].stride = sizeof(input_unit_t);
+        descs[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX; // per vertex input
+        descs[1].binding = 1;
+        descs[1].stride = sizeof(instance_t);
+        descs[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE; // per instance input
+        // layout(location = 0) in vec2 i_position;
+        attrs[0].binding = 0;
+        attrs[0].location = 0;
+        attrs[0].format = VK_FORMAT_R32G32_SFLOAT; // vec2
+        attrs[0].offset = 0;
+        // layout(location = 1) in vec3 i_color;
+        attrs[1].binding = 0;
+        attrs[1].location = 1;
+        attrs[1].format = VK_FORMAT_R32G32B32_SFLOAT; // vec3
+        attrs[1].offset = sizeof(input_unit_t::position);
+        // layout(location = 2) in mat4 i_transform; 1 location for each column
+        for (auto c = 0u; c < 4; ++c) {
+            attrs[2 + c].binding = 1;
+            attrs[2 + c].location = 2 + c;
+            attrs[2 + c].format = VK_FORMAT_R32G32B32A32_SFLOAT; // vec4
+            attrs[2 + c].offset = sizeof(float) * 4 * c;
+        }
+        // layout(location = 6) in vec4 i_instance_color;
+        attrs[6].binding = 1;
+        attrs[6].location = 6;
+        attrs[6].format = VK_FORMAT_R32G32B32A32_SFLOAT; // vec4
+        attrs[6].offset = sizeof(instance_t::transform);
+        info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+        info.vertexBindingDescriptionCount = 2;
+        info.pVertexBindingDescriptions = descs;
+        info.vertexAttributeDescriptionCount = 7;
+        info.pVertexAttributeDescriptions = attrs;
+    }
+
+    VkResult make_pipeline_layout(VkDevice device, VkPipelineLayout& layout) noexcept override {
+        return ::create_pipeline_layout(device, layout);
+    }
+
+    VkResult update(uint32_t _frame, gsl::span<const instance_t> items) noexcept override {
+        if (items.size() > capacity)
+            return VK_ERROR_TOO_MANY_OBJECTS;
+        frame = _frame % instances.num_frames;
+        memcpy(instances.get_slot(frame).data(), items.data(), items.size_bytes());
+        count = static_cast<uint32_t>(items.size());
+        return VK_SUCCESS;
+    }
+
+    void bind(VkCommandBuffer command_buffer, VkPipeline pipeline) const noexcept {
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+        const VkBuffer bindings[2]{buffers[0], instances.handle};
+        const VkDeviceSize offsets[2]{0, instances.get_offset(frame)};
+        vkCmdBindVertexBuffers(command_buffer, 0, 2, bindings, offsets);
+        vkCmdBindIndexBuffer(command_buffer, buffers[1], 0, VK_INDEX_TYPE_UINT16);
+    }
+
+    void record(VkCommandBuffer command_buffer, VkPipeline pipeline, VkPipelineLayout) noexcept override {
+        bind(command_buffer, pipeline);
+        constexpr auto first_index = 0;
+        constexpr auto vertex_offset = 0;
+        constexpr auto first_instance = 0;
+        constexpr auto indices_size = 6u;
+        vkCmdDrawIndexed(command_buffer, indices_size, count, first_index, vertex_offset, first_instance);
+    }
+
+    void record_each(VkCommandBuffer command_buffer, VkPipeline pipeline, VkPipelineLayout) noexcept override {
+        bind(command_buffer, pipeline);
+        // as if each object had its own buffer
+        for (auto i = 0u; i < count; ++i) {
+            const VkDeviceSize offset = instances.get_offset(frame) + sizeof(instance_t) * i;
+            vkCmdBindVertexBuffers(command_buffer, 1, 1, &instances.handle, &offset);
+            vkCmdDrawIndexed(command_buffer, 6u, 1, 0, 0, 0);
+        }
+    }
+};
+
+auto make_pipeline_input_5(VkDevice device, const VkPhysicalDeviceMemoryProperties& props,
+                           const fs::path& shader_dir, uint32_t num_frames,
+                           uint32_t capacity) noexcept(false) -> std::unique_ptr<vulkan_instanced_input_t> {
+    auto impl = make_unique<input5_t>(device, props, shader_dir, num_frames, capacity);
+    impl->allocate(props);
+    return impl;
 }
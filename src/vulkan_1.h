@@ -3,10 +3,14 @@
  * @see     https://gpuopen.com/learn/understanding-vulkan-objects/
  */
 #pragma once
+#include <graphics.h>
+
 #include <filesystem>
+#include <functional>
 #include <gsl/gsl>
 #include <memory>
 #include <thread>
+#include <unordered_map>
 #include <vulkan/vulkan.h>
 
 namespace fs = std::filesystem;
@@ -71,6 +75,9 @@ VkResult get_physical_device(VkInstance instance, VkPhysicalDevice& physical_dev
 
 uint32_t get_graphics_queue_available(VkQueueFamilyProperties* properties, uint32_t count) noexcept;
 
+/// @return UINT32_MAX if no family has TRANSFER without GRAPHICS. The family without COMPUTE is preferred
+uint32_t get_transfer_queue_available(VkQueueFamilyProperties* properties, uint32_t count) noexcept;
+
 uint32_t get_surface_support(VkPhysicalDevice device, VkSurfaceKHR surface, uint32_t count,
                              uint32_t exclude_index) noexcept;
 
@@ -108,8 +115,39 @@ VkResult check_support(VkPhysicalDevice device, VkSurfaceKHR surface, //
                        VkPresentModeKHR present_mode) noexcept;
 
 /**
- * @todo Create a new `VkDevice` with GFX, Present, Transfer queue
+ * @brief create 1 device with 2 queue(GFX, Transfer) information. The timeline semaphore is enabled
+ * 
+ * @param queues queue information. 0 is for graphics, 1 is for transfer.
+ *               If there is no dedicated transfer family, 1 is same with 0 and the device has only 1 queue
+ * @return VkResult `VK_ERROR_FEATURE_NOT_PRESENT` if the device doesn't support the timeline semaphore
+ *                  or its `apiVersion` is less than 1.2
  */
+VkResult create_device(VkPhysicalDevice physical_device, //
+                       VkDevice& device, VkDeviceQueueCreateInfo (&queues)[2]) noexcept;
+
+/**
+ * @brief create 1 device with 1 queue(GFX) for `vulkan_indirect_culler_t`.
+ *        `multiDrawIndirect`, `drawIndirectFirstInstance` and `drawIndirectCount`(if supported) are enabled
+ * 
+ * @param draw_indirect_count  `true` if `vkCmdDrawIndexedIndirectCount` can be used
+ * @return VkResult `VK_ERROR_FEATURE_NOT_PRESENT` if the device doesn't support the multi draw indirect
+ */
+VkResult create_device(VkPhysicalDevice physical_device, //
+                       VkDevice& device, VkDeviceQueueCreateInfo& queue, bool& draw_indirect_count) noexcept;
+
+/**
+ * @brief create 1 device with 1 queue(GFX) for `vulkan_bindless_heap_t`.
+ *        The descriptor indexing features for the sampled image arrays are enabled
+ * 
+ * @param enabled  the descriptor indexing features given to `vkCreateDevice`.
+ *                 `shaderSampledImageArrayNonUniformIndexing` is `VK_TRUE` only if the device supports it
+ * @return VkResult `VK_ERROR_FEATURE_NOT_PRESENT` if the device doesn't support the partially bound,
+ *                  update-after-bind runtime array of the sampled images
+ * @see https://www.khronos.org/registry/vulkan/specs/1.2-extensions/man/html/VK_EXT_descriptor_indexing.html
+ */
+VkResult create_device(VkPhysicalDevice physical_device, //
+                       VkDevice& device, VkDeviceQueueCreateInfo& queue,
+                       VkPhysicalDeviceDescriptorIndexingFeatures& enabled) noexcept;
 
 VkResult create_uniform_buffer(VkDevice device, VkBuffer& buffer, VkBufferCreateInfo& info,
                                VkDeviceSize buflen) noexcept;
@@ -117,6 +155,10 @@ VkResult create_vertex_buffer(VkDevice device, VkBuffer& buffer, VkBufferCreateI
                               VkDeviceSize buflen) noexcept;
 VkResult create_index_buffer(VkDevice device, VkBuffer& buffer, VkBufferCreateInfo& info, VkDeviceSize buflen) noexcept;
 
+/// @return UINT32_MAX if no memory type in `type_bits` has all `desired` flags
+uint32_t get_memory_type(const VkPhysicalDeviceMemoryProperties& props, uint32_t type_bits,
+                         VkMemoryPropertyFlags desired) noexcept;
+
 VkResult allocate_memory(VkDevice device, VkBuffer buffer, VkDeviceMemory& memory,
                          const VkBufferCreateInfo& buffer_info, VkFlags desired,
                          const VkPhysicalDeviceMemoryProperties& props) noexcept;
@@ -174,19 +216,97 @@ auto make_pipeline_input_1(VkDevice device,
 auto make_pipeline_input_2(VkDevice device,
                            const VkPhysicalDeviceMemoryProperties& props, //
                            const fs::path& folder) noexcept(false) -> std::unique_ptr<vulkan_pipeline_input_t>;
+
+/**
+ * @brief `VkPipelineLayout` for `make_pipeline_layout`. Empty spans for no descriptor set and no push constant
+ * @note  The ranges must fit in `maxPushConstantsSize`. Only 128 bytes are guaranteed
+ */
+VkResult create_pipeline_layout(VkDevice device, VkPipelineLayout& layout,
+                                gsl::span<const VkDescriptorSetLayout> set_layouts,
+                                gsl::span<const VkPushConstantRange> ranges) noexcept;
+
+/**
+ * @brief The model matrix is a push constant for each draw. The view/projection are in the uniform for each frame
+ * @details `update` writes the uniform. `record` draws 1 object, `record_each` draws the objects with 1 bind
+ */
+class vulkan_push_constant_input_t : public vulkan_pipeline_input_t {
+  public:
+    struct push_constant_t final {
+        float model[16]; // column major
+    };
+
+  public:
+    /// @brief `vkCmdPushConstants` of the `VK_SHADER_STAGE_VERTEX_BIT` range
+    static void push(VkCommandBuffer command_buffer, VkPipelineLayout pipeline_layout,
+                     const push_constant_t& constants) noexcept;
+    /// @brief Bind the pipeline and the resources once, then push and draw for each object
+    virtual void record_each(VkCommandBuffer command_buffer, VkPipeline pipeline, VkPipelineLayout pipeline_layout,
+                             gsl::span<const push_constant_t> objects) noexcept = 0;
+};
+
 auto make_pipeline_input_3(VkDevice device,
                            const VkPhysicalDeviceMemoryProperties& props, //
-                           const fs::path& shader_dir) noexcept(false) -> std::unique_ptr<vulkan_pipeline_input_t>;
+                           const fs::path& shader_dir) noexcept(false) -> std::unique_ptr<vulkan_push_constant_input_t>;
+
+class vulkan_descriptor_allocator_t;
+/**
+ * @brief `make_pipeline_input_3` with a shared allocator. The descriptor layout and set are cached in it
+ * @note  The `descriptors` must outlive the input and the pipelines from it
+ */
+auto make_pipeline_input_3(VkDevice device,
+                           const VkPhysicalDeviceMemoryProperties& props, //
+                           const fs::path& shader_dir,
+                           vulkan_descriptor_allocator_t& descriptors) noexcept(false)
+    -> std::unique_ptr<vulkan_push_constant_input_t>;
 
 class vulkan_pipeline_input2_t : public vulkan_pipeline_input_t {
   public:
     virtual VkResult update(VkImageView view, VkSampler sampler) noexcept = 0;
 };
 
+/**
+ * @brief Textured quads. All textures live in 1 `vulkan_bindless_heap_t` and the index is a push constant
+ * @details `update` adds a texture. `record` binds the heap once and draws each texture in a grid
+ * @note    `device` must be created with the `VkPhysicalDeviceDescriptorIndexingFeatures` overload of `create_device`
+ * @see     vulkan_bindless_heap_t
+ */
 auto make_pipeline_input_4(VkDevice device,
                            const VkPhysicalDeviceMemoryProperties& props, //
                            const fs::path& shader_dir) noexcept(false) -> std::unique_ptr<vulkan_pipeline_input2_t>;
 
+/**
+ * @brief Per-instance attributes in binding 1 with `VK_VERTEX_INPUT_RATE_INSTANCE`
+ * @details location 2-5: `mat4` transform, location 6: `vec4` color. `record` draws all instances with 1 call
+ */
+class vulkan_instanced_input_t : public vulkan_pipeline_input_t {
+  public:
+    struct instance_t final {
+        float transform[16]; // column major
+        float color[4];
+    };
+
+  public:
+    /**
+     * @brief Write the instances into the `frame`'s slot of the ring buffer. `record` draws from the slot
+     * @param frame  the caller's frame index. The slot is `frame % num_frames`
+     * @note  The GPU must be done with the slot. Wait the fence of the frame before this
+     * @return VkResult `VK_ERROR_TOO_MANY_OBJECTS` if the instances are more than the capacity
+     */
+    virtual VkResult update(uint32_t frame, gsl::span<const instance_t> instances) noexcept = 0;
+    /// @brief 1 draw for each instance with its own binding offset. The comparison of the instanced `record`
+    virtual void record_each(VkCommandBuffer command_buffer, //
+                             VkPipeline pipeline, VkPipelineLayout pipeline_layout) noexcept = 0;
+};
+
+/**
+ * @param num_frames  slots of the instance ring buffer
+ * @param capacity    max instances in a frame
+ */
+auto make_pipeline_input_5(VkDevice device,
+                           const VkPhysicalDeviceMemoryProperties& props, //
+                           const fs::path& shader_dir, uint32_t num_frames,
+                           uint32_t capacity) noexcept(false) -> std::unique_ptr<vulkan_instanced_input_t>;
+
 /**
  * @brief VkPipeline + VkPipelineLayout + RAII
  * @todo  setup_color_blend_state
@@ -234,9 +354,93 @@ class vulkan_shader_module_t final {
 
   public:
     vulkan_shader_module_t(VkDevice _device, const fs::path fpath) noexcept(false);
+    /// @param code SPIR-V words. (ex: from `vulkan_shader_compiler_t`)
+    vulkan_shader_module_t(VkDevice _device, gsl::span<const uint32_t> code) noexcept(false);
     ~vulkan_shader_module_t() noexcept;
 };
 
+/**
+ * @brief Specialization constants of a shader stage
+ * @details The variants share one SPIR-V module. Only the pipelines are created for each of them
+ * @note    All constants are 4 byte. Use `VkBool32` for `bool`
+ * @see https://www.khronos.org/registry/vulkan/specs/1.2-extensions/man/html/VkSpecializationInfo.html
+ */
+class vulkan_specialization_t final {
+    std::vector<VkSpecializationMapEntry> entries{};
+    std::vector<uint32_t> values{};
+    VkSpecializationInfo info{};
+
+  private:
+    void set_bits(uint32_t constant_id, uint32_t bits) noexcept(false);
+
+  public:
+    void set(uint32_t constant_id, uint32_t value) noexcept(false);
+    void set(uint32_t constant_id, int32_t value) noexcept(false);
+    void set(uint32_t constant_id, float value) noexcept(false);
+
+    /// @brief Key for the pipeline variant. Same constants make same key
+    uint64_t make_key(uint64_t seed) const noexcept;
+    /// @return `nullptr` if there is no constant. For `VkPipelineShaderStageCreateInfo::pSpecializationInfo`
+    const VkSpecializationInfo* get() noexcept;
+};
+
+/**
+ * @brief GLSL to SPIR-V compiler with worker threads and content-addressed cache
+ * @details The key is a hash of the stage, options, macro definitions and the source. The target environment and
+ *          the shaderc library build (SHA1 of the linked library) are in the key too, so the files from the other build
+ *          are not loaded.
+ *          The results are kept in memory and, if `directory` is not empty, in `{key}.spv` files.
+ *          An edited source makes a new key, so the stale result is never used.
+ * @note    Requires shaderc. https://github.com/google/shaderc
+ * @note    The member functions are thread-safe. `hit` and `miss` are updated in `submit`
+ */
+class vulkan_shader_compiler_t final {
+  public:
+    struct request_t final {
+        VkShaderStageFlagBits stage = VK_SHADER_STAGE_VERTEX_BIT;
+        std::string source{};
+        std::string name = "shader.glsl"; // for the messages
+        std::vector<std::pair<std::string, std::string>> defines{};
+        bool optimize = false;
+    };
+    struct impl_t;
+
+  private:
+    std::unique_ptr<impl_t> impl;
+
+  public:
+    const fs::path directory;
+    uint32_t hit = 0;  // found in memory or disk
+    uint32_t miss = 0; // sent to the workers
+
+  public:
+    /**
+     * @param num_workers `std::thread::hardware_concurrency` if 0
+     * @throw std::system_error if a worker can't be started. The started ones are joined
+     */
+    explicit vulkan_shader_compiler_t(const fs::path& directory = {}, uint32_t num_workers = 0) noexcept(false);
+    ~vulkan_shader_compiler_t() noexcept;
+    vulkan_shader_compiler_t(const vulkan_shader_compiler_t&) = delete;
+    vulkan_shader_compiler_t(vulkan_shader_compiler_t&&) = delete;
+    vulkan_shader_compiler_t& operator=(const vulkan_shader_compiler_t&) = delete;
+    vulkan_shader_compiler_t& operator=(vulkan_shader_compiler_t&&) = delete;
+
+    static uint64_t make_key(const request_t& request) noexcept;
+    fs::path get_path(uint64_t key) const noexcept(false);
+
+    /// @brief Start the compile if the key is not in the cache
+    void submit(const request_t& request, uint64_t& key) noexcept(false);
+    /// @brief Non-blocking check of the submitted key
+    bool is_completed(uint64_t key) const noexcept;
+    /**
+     * @brief Wait for the compile of the key
+     * @return 0, EINVAL(compile error), ENOENT(not submitted)
+     */
+    uint32_t get(uint64_t key, std::vector<uint32_t>& code, std::string& message) noexcept(false);
+    /// @brief `submit` + `get`
+    uint32_t compile(const request_t& request, std::vector<uint32_t>& code, std::string& message) noexcept(false);
+};
+
 /**
  * @brief VkSwapchainKHR + RAII
  * @note  must update swapchain if resized
@@ -302,21 +506,751 @@ class vulkan_fence_t final {
     ~vulkan_fence_t() noexcept;
 };
 
+/**
+ * @brief Host visible buffer with `num_frames` slots. The CPU writes the slot of a frame while the GPU reads the others
+ * @details The memory is mapped for the lifetime. Each slot starts at the multiple of the `alignment`
+ * @note    The caller must wait the fence of the frame before writing its slot again
+ */
+class vulkan_ring_buffer_t final {
+  public:
+    const VkDevice device{};
+    const uint32_t num_frames{};
+    const VkDeviceSize slot_size{}; // aligned bytes of a slot
+    VkBuffer handle{};
+    VkDeviceMemory memory{};
+
+  private:
+    std::byte* mapping = nullptr;
+
+  public:
+    /// @throw vulkan_exception_t
+    vulkan_ring_buffer_t(VkDevice _device, const VkPhysicalDeviceMemoryProperties& props, VkBufferUsageFlags usage,
+                         VkDeviceSize size, uint32_t _num_frames, VkDeviceSize alignment = 256) noexcept(false);
+    ~vulkan_ring_buffer_t() noexcept;
+    vulkan_ring_buffer_t(const vulkan_ring_buffer_t&) = delete;
+    vulkan_ring_buffer_t(vulkan_ring_buffer_t&&) = delete;
+    vulkan_ring_buffer_t& operator=(const vulkan_ring_buffer_t&) = delete;
+    vulkan_ring_buffer_t& operator=(vulkan_ring_buffer_t&&) = delete;
+
+    /// @return VkDeviceSize offset of the slot in the `handle`. For the bind/descriptor
+    VkDeviceSize get_offset(uint32_t frame) const noexcept;
+    /// @return mapped memory of the slot
+    gsl::span<std::byte> get_slot(uint32_t frame) const noexcept;
+};
+
+/**
+ * @brief Submits the uploads to the transfer queue. Each submit signals the next value of the `timeline` semaphore
+ * @details The render queue waits for the value with `render_submit` instead of `vkQueueWaitIdle`,
+ *          so the CPU keeps recording while the copies are running.
+ *          The command buffers are reused after their values are completed.
+ * @note    If the transfer family is not the graphics family, the resources must be created with
+ *          `VK_SHARING_MODE_CONCURRENT` or their ownership must be transferred with the barriers
+ * @see     https://www.khronos.org/blog/vulkan-timeline-semaphores
+ */
+class vulkan_transfer_queue_t final {
+  public:
+    const VkDevice device{};
+    const uint32_t family_index{};
+    VkQueue queue{};
+    VkSemaphore timeline{};
+    VkCommandPool pool{};
+
+  private:
+    struct slot_t final {
+        VkCommandBuffer commands{};
+        uint64_t value = 0; // signaled when the commands are completed. UINT64_MAX while recording
+    };
+    std::vector<slot_t> slots{};
+    uint64_t last = 0; // the value of the recent submit
+
+  public:
+    /// @param queue_info  used for the `VkDevice`. The queue 0 of the family is used
+    vulkan_transfer_queue_t(VkDevice _device, const VkDeviceQueueCreateInfo& queue_info) noexcept(false);
+    /// @brief Wait for all submitted commands
+    ~vulkan_transfer_queue_t() noexcept;
+    vulkan_transfer_queue_t(const vulkan_transfer_queue_t&) = delete;
+    vulkan_transfer_queue_t(vulkan_transfer_queue_t&&) = delete;
+    vulkan_transfer_queue_t& operator=(const vulkan_transfer_queue_t&) = delete;
+    vulkan_transfer_queue_t& operator=(vulkan_transfer_queue_t&&) = delete;
+
+    /// @brief Begin a command buffer whose previous submit is completed. A new one is allocated if there is none
+    VkResult begin(VkCommandBuffer& commands) noexcept;
+    /**
+     * @brief End the `commands` from `begin` and submit it
+     * @param value  the timeline value which will be signaled after the `commands` are completed
+     */
+    VkResult submit(VkCommandBuffer commands, uint64_t& value) noexcept;
+
+    /// @see vkGetSemaphoreCounterValue
+    VkResult get_completed(uint64_t& value) const noexcept;
+    /// @see vkWaitSemaphores
+    VkResult wait(uint64_t value, uint64_t timeout = UINT64_MAX) const noexcept;
+};
+
 VkResult render_submit(VkQueue queue,                       //
                        gsl::span<VkCommandBuffer> commands, //
                        VkFence fence, VkSemaphore wait, VkSemaphore signal) noexcept;
 
+/**
+ * @brief Wait until the `timeline` reaches the `value` before the `stage`. The earlier stages don't wait for it
+ * @see   vulkan_transfer_queue_t
+ */
+VkResult render_submit(VkQueue queue,                       //
+                       gsl::span<VkCommandBuffer> commands, //
+                       VkFence fence, VkSemaphore timeline, uint64_t value, VkPipelineStageFlags stage) noexcept;
+
 VkResult present_submit(VkQueue queue,                                  //
                         uint32_t image_index, VkSwapchainKHR swapchain, //
                         VkSemaphore wait) noexcept;
 
+/**
+ * @brief   `VK_QUERY_TYPE_TIMESTAMP` pool with `num_frames` slots of `num_regions` begin/end pairs
+ * @note    The results are collected without `VK_QUERY_RESULT_WAIT_BIT`. Use the slot after its fence is signaled
+ * @see     https://www.khronos.org/registry/vulkan/specs/1.2-extensions/html/vkspec.html#queries-timestamps
+ */
+class vulkan_timestamp_pool_t final {
+  public:
+    const VkDevice device{};
+    VkQueryPool handle{};
+    const uint32_t num_frames{};
+    const uint32_t num_regions{};
+    float period = 1;         // nanoseconds per tick. `VkPhysicalDeviceLimits::timestampPeriod`
+    uint64_t mask = UINT64_MAX; // `VkQueueFamilyProperties::timestampValidBits`
+    uint32_t dropped = 0;     // count of the slots which were reset before collect
+    std::unique_ptr<gsl::czstring<>[]> names{};
+    std::unique_ptr<uint32_t[]> counts{};
+    std::unique_ptr<bool[]> pending{};
+    std::unique_ptr<uint64_t[]> results{}; // (value, availability) pairs
+
+  public:
+    /// @throw vulkan_exception_t `timestampValidBits` of the queue family is 0
+    vulkan_timestamp_pool_t(VkDevice _device, VkPhysicalDevice physical_device, uint32_t queue_index, //
+                            uint32_t _num_frames, uint32_t _num_regions) noexcept(false);
+    ~vulkan_timestamp_pool_t() noexcept;
+
+    /// @note must be recorded outside of the render pass
+    void reset(VkCommandBuffer commands, uint32_t frame) noexcept;
+    /// @return UINT32_MAX if the slot is full
+    uint32_t begin(VkCommandBuffer commands, uint32_t frame, gsl::czstring<> name) noexcept;
+    void end(VkCommandBuffer commands, uint32_t frame, uint32_t region) noexcept;
+
+    /**
+     * @brief   Append the regions of the `frame` in nanoseconds
+     * @return  VK_NOT_READY if GPU didn't finish the slot yet
+     */
+    VkResult collect(uint32_t frame, std::vector<gpu_time_region_t>& regions) noexcept;
+};
+
 class vulkan_command_recorder_t final {
   public:
     VkCommandBuffer commands;
     VkClearValue clear;
+    vulkan_timestamp_pool_t* timestamps = nullptr;
+    uint32_t frame = 0;
+    uint32_t region = UINT32_MAX;
+
+  private:
+    void begin_commands() noexcept(false);
+    void begin_renderpass(VkRenderPass renderpass, VkFramebuffer framebuffer, VkExtent2D extent) noexcept;
 
   public:
     vulkan_command_recorder_t(VkCommandBuffer command_buffer, //
                               VkRenderPass renderpass, VkFramebuffer framebuffer, VkExtent2D extent) noexcept(false);
+    /// @brief Reset the `frame` slot of the `timestamps` and measure the render pass
+    vulkan_command_recorder_t(VkCommandBuffer command_buffer, //
+                              VkRenderPass renderpass, VkFramebuffer framebuffer, VkExtent2D extent,
+                              vulkan_timestamp_pool_t& _timestamps, uint32_t _frame) noexcept(false);
     ~vulkan_command_recorder_t() noexcept(false);
 };
+
+/**
+ * @brief   Timestamp region in the recorder's frame slot. No-op if the recorder has no timestamp pool
+ */
+class vulkan_timestamp_scope_t final {
+    vulkan_command_recorder_t& recorder;
+    uint32_t region = UINT32_MAX;
+
+  public:
+    vulkan_timestamp_scope_t(vulkan_command_recorder_t& _recorder, gsl::czstring<> name) noexcept;
+    ~vulkan_timestamp_scope_t() noexcept;
+};
+
+/// @return VkFormat `VK_FORMAT_R8G8B8A8_UNORM` for `block_format_t::rgba8`
+VkFormat get_vulkan_format(block_format_t format) noexcept;
+
+/**
+ * @brief The first block format that the device can sample, copy into and copy from with the optimal tiling.
+ *        BC3 is tested before ETC2. `block_format_t::rgba8` if none of them is supported
+ * @see vkGetPhysicalDeviceFormatProperties
+ */
+block_format_t select_block_format(VkPhysicalDevice physical_device) noexcept;
+
+/// @brief The accesses which must be available before the other accesses
+constexpr VkAccessFlags vulkan_write_access_mask =
+    VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+/// @brief Layout and the accesses of an image subresource or a buffer since its last barrier
+struct vulkan_access_state_t final {
+    VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkAccessFlags access = 0;
+    VkPipelineStageFlags stage = 0;       // stages which accessed the subresource with the layout
+    VkAccessFlags write_access = 0;       // the last write
+    VkPipelineStageFlags write_stage = 0; // the last write or layout transition. 0 if there was none
+};
+
+/**
+ * @brief The state after the access, and whether a barrier from `current` is needed before it
+ * @details Read after read with the same layout is folded into `current` if nothing was written, or the stage and
+ *          the access are already in `current`. A reader in the other stage needs a barrier, because the last one
+ *          made the write visible only to the stages in `current`.
+ *          The barrier waits for `current.stage` and makes `current.write_access` available
+ * @return bool true if a barrier is needed
+ */
+bool next_access_state(const vulkan_access_state_t& current, VkImageLayout layout, VkAccessFlags access,
+                       VkPipelineStageFlags stage, vulkan_access_state_t& next) noexcept;
+
+/**
+ * @brief Current layout/access of each image subresource and the transitions to them in 1 `vkCmdPipelineBarrier`
+ * @details `transition` only updates the states with `next_access_state`. The subresources which have no hazard are
+ *          skipped and the transitions of a subresource before `flush` are folded into 1 barrier.
+ *          `flush` merges the consecutive mip levels with the same transition and uses the union of the stages
+ *          that actually accessed them instead of `VK_PIPELINE_STAGE_ALL_COMMANDS_BIT`.
+ * @note    The recorded commands must not touch the transitioned subresources before `flush`
+ * @see     vkCmdPipelineBarrier
+ */
+class vulkan_barrier_builder_t final {
+  public:
+    using state_t = vulkan_access_state_t;
+
+  private:
+    struct image_t final {
+        VkImageAspectFlags aspect{};
+        uint32_t levels = 1;
+        uint32_t layers = 1;
+        std::vector<state_t> states{};   // [layer * levels + level]
+        std::vector<state_t> previous{}; // before the pending transitions
+        std::vector<bool> pending{};
+    };
+
+    std::unordered_map<VkImage, image_t> images{};
+    std::vector<VkImageMemoryBarrier> barriers{};
+
+  public:
+    /// @brief Start tracking the image. All subresources will be in the `layout`
+    void track(VkImage image, VkImageAspectFlags aspect, uint32_t levels, uint32_t layers = 1,
+               VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED) noexcept(false);
+    /// @brief Stop tracking the image. Its pending transitions are discarded
+    void forget(VkImage image) noexcept;
+
+    /**
+     * @param range  `VK_REMAINING_MIP_LEVELS` and `VK_REMAINING_ARRAY_LAYERS` are allowed
+     * @param stage  stages that will access the subresources with the `layout`
+     * @return uint32_t EINVAL if the image is not tracked or the range is out of the image
+     */
+    uint32_t transition(VkImage image, const VkImageSubresourceRange& range, //
+                        VkImageLayout layout, VkAccessFlags access, VkPipelineStageFlags stage) noexcept;
+
+    /// @return uint32_t EINVAL if the image is not tracked or the subresource is out of the image
+    uint32_t get_state(VkImage image, uint32_t level, uint32_t layer, state_t& state) const noexcept;
+
+    /**
+     * @brief Record all pending transitions with 1 `vkCmdPipelineBarrier`
+     * @return uint32_t number of `VkImageMemoryBarrier` in the command. 0 if nothing was recorded
+     */
+    uint32_t flush(VkCommandBuffer commands) noexcept(false);
+};
+
+/**
+ * @brief 1 descriptor set with a large `VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER` array. The textures are indices
+ * @details The binding is partially bound and update-after-bind, so `allocate` can write a new slot while the
+ *          command buffers which use the other slots are pending. Bind the `set` once, then select the texture with
+ *          the push constant. The free indices are reused in LIFO order. A released index is reused after the next
+ *          `reset` of the current frame (the frame of the last `reset`), so the in-flight frames can still sample it.
+ *          GLSL: `layout(set = 0, binding = 0) uniform sampler2D textures[];` with `GL_EXT_nonuniform_qualifier`
+ * @note    The device needs the features from `create_device` with `VkPhysicalDeviceDescriptorIndexingFeatures`.
+ *          The `capacity` must be in `maxDescriptorSetUpdateAfterBindSampledImages`
+ */
+class vulkan_bindless_heap_t final {
+  public:
+    const VkDevice device{};
+    const uint32_t capacity{};
+    VkDescriptorSetLayout layout{};
+    VkDescriptorPool pool{};
+    VkDescriptorSet set{};
+
+  private:
+    std::vector<uint32_t> free_indices{};
+    std::vector<bool> used{};
+    std::vector<std::vector<uint32_t>> retired{}; // released in each frame
+    uint32_t current = 0;                         // frame of the last `reset`
+
+  public:
+    /**
+     * @param num_frames  number of the frames which can be in flight
+     * @param stages      the shader stages which access the array
+     * @throw vulkan_exception_t
+     */
+    vulkan_bindless_heap_t(VkDevice _device, uint32_t _capacity, uint32_t num_frames,
+                           VkShaderStageFlags stages = VK_SHADER_STAGE_FRAGMENT_BIT) noexcept(false);
+    ~vulkan_bindless_heap_t() noexcept;
+    vulkan_bindless_heap_t(const vulkan_bindless_heap_t&) = delete;
+    vulkan_bindless_heap_t(vulkan_bindless_heap_t&&) = delete;
+    vulkan_bindless_heap_t& operator=(const vulkan_bindless_heap_t&) = delete;
+    vulkan_bindless_heap_t& operator=(vulkan_bindless_heap_t&&) = delete;
+
+    /**
+     * @brief Take a free index and write the descriptor of it
+     * @param layout  layout of the `view` when it is sampled
+     * @return uint32_t UINT32_MAX if the heap is full
+     */
+    uint32_t allocate(VkImageView view, VkSampler sampler,
+                      VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) noexcept(false);
+    /**
+     * @brief Return the index to the free list after the next `reset` of the current frame. Ignored if not allocated
+     * @details The descriptor is left as it is until the index is allocated again
+     * @note  The index must not be recorded after this
+     */
+    void release(uint32_t index) noexcept(false);
+
+    /**
+     * @brief The indices from `release` while the `frame` was the current one become free. Call after the command
+     *        buffers of the `frame` are completed. The `frame` is current until the next `reset`
+     * @return VkResult `VK_ERROR_INITIALIZATION_FAILED` if the `frame` is out of range
+     */
+    VkResult reset(uint32_t frame) noexcept;
+
+    /// @return uint32_t number of the allocated indices
+    uint32_t size() const noexcept;
+};
+
+/**
+ * @brief Descriptor sets from a growing list of pools. Transient sets are reset per frame, persistent sets are cached
+ * @details `allocate` takes a transient set from the pools of the frame. When a pool is out of memory, a new pool
+ *          is added. `reset` puts all pools of the frame back with `vkResetDescriptorPool`, so there is no
+ *          `vkFreeDescriptorSets` or pool creation in the frame loop after the warm-up.
+ *          `get` returns a persistent set for the layout and the resources in the writes. The same contents give the
+ *          same set without `vkUpdateDescriptorSets`. `release` drops a persistent set from the cache and `get` with
+ *          the same layout reuses it after the next `reset` of the current frame (the frame of the last `reset`).
+ *          `get_layout` caches the layouts with the same bindings.
+ * @note    The sets and the layouts are owned by the allocator. Not thread-safe
+ * @note    The pools have the fixed counts of the types in the constructor. The other types
+ *          (ex. `VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT`, `VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER`) can't be allocated
+ *          and `allocate`/`get` return `VK_ERROR_OUT_OF_POOL_MEMORY` for them
+ * @see     https://vkguide.dev/docs/extra-chapter/abstracting_descriptors/
+ */
+class vulkan_descriptor_allocator_t final {
+  public:
+    using key_t = std::vector<uint64_t>;
+    struct key_hash_t final {
+        size_t operator()(const key_t& key) const noexcept;
+    };
+
+  public:
+    const VkDevice device{};
+    const uint32_t sets_per_pool{};
+
+  private:
+    std::vector<VkDescriptorPoolSize> sizes{}; // for 1 pool
+    std::vector<VkDescriptorPool> free_pools{};
+    std::vector<std::vector<VkDescriptorPool>> frames{}; // the pools in use. the last one is the current
+    std::vector<VkDescriptorPool> persistent_pools{};
+    std::unordered_map<key_t, VkDescriptorSetLayout, key_hash_t> layouts{};
+    std::unordered_map<key_t, VkDescriptorSet, key_hash_t> sets{};
+    std::unordered_map<uint64_t, std::vector<VkDescriptorSet>> released{};    // by the layout. see `release`
+    std::vector<std::vector<std::pair<uint64_t, VkDescriptorSet>>> retired{}; // (layout, set) released in each frame
+    uint32_t current = 0;                                                     // frame of the last `reset`
+
+  public:
+    /**
+     * @param num_frames     number of the frames which can be in flight. each frame has its own pools
+     * @param sets_per_pool  `maxSets` of the pools. the descriptor counts are scaled by it
+     * @throw vulkan_exception_t
+     */
+    vulkan_descriptor_allocator_t(VkDevice _device, uint32_t num_frames, uint32_t sets_per_pool = 64) noexcept(false);
+    ~vulkan_descriptor_allocator_t() noexcept;
+    vulkan_descriptor_allocator_t(const vulkan_descriptor_allocator_t&) = delete;
+    vulkan_descriptor_allocator_t(vulkan_descriptor_allocator_t&&) = delete;
+    vulkan_descriptor_allocator_t& operator=(const vulkan_descriptor_allocator_t&) = delete;
+    vulkan_descriptor_allocator_t& operator=(vulkan_descriptor_allocator_t&&) = delete;
+
+    /**
+     * @brief Transient set. Valid until the next `reset(frame)`
+     * @return VkResult `VK_ERROR_INITIALIZATION_FAILED` if the `frame` is out of range
+     */
+    VkResult allocate(uint32_t frame, VkDescriptorSetLayout layout, VkDescriptorSet& set) noexcept;
+
+    /**
+     * @brief Reset the transient pools of the `frame`. Call after its command buffers are completed
+     * @details The sets from `release` while the `frame` was the current one become reusable. The `frame` is current
+     *          until the next `reset`
+     */
+    VkResult reset(uint32_t frame) noexcept;
+
+    /**
+     * @brief Persistent set for the `layout` and the resources in the `writes`. The `dstSet` of the writes is ignored
+     * @note  The key is from `pBufferInfo` or `pImageInfo` by the `descriptorType`. The other types are rejected
+     * @return VkResult `VK_ERROR_FORMAT_NOT_SUPPORTED` for the texel buffers and the other types
+     */
+    VkResult get(VkDescriptorSetLayout layout, gsl::span<const VkWriteDescriptorSet> writes,
+                 VkDescriptorSet& set) noexcept;
+
+    /**
+     * @brief Remove the persistent set from the cache. Ignored if it is not from `get`
+     * @details The set is not freed. `get` with the same layout will write the new resources to it after the next
+     *          `reset` of the current frame, so the pending command buffers can still use it
+     * @note  Use when the resources of the set are destroyed. The set must not be recorded after this.
+     *        The other `get` with the same resources returned the same set
+     * @return VkResult `VK_ERROR_OUT_OF_HOST_MEMORY` if the set can't be kept for the reuse
+     */
+    VkResult release(VkDescriptorSet set) noexcept;
+
+    /// @brief The layouts with the same flags and bindings are the same handle. Immutable samplers are not supported
+    VkResult get_layout(const VkDescriptorSetLayoutCreateInfo& info, VkDescriptorSetLayout& layout) noexcept;
+
+    /// @return size_t number of all pools. transient and persistent
+    size_t get_pool_count() const noexcept;
+    /// @return size_t number of the persistent sets in the cache
+    size_t get_set_count() const noexcept;
+
+  private:
+    VkResult acquire_pool(VkDescriptorPool& pool) noexcept;
+    VkResult allocate(std::vector<VkDescriptorPool>& pools, VkDescriptorSetLayout layout,
+                      VkDescriptorSet& set) noexcept;
+};
+
+/**
+ * @brief `VkImage`s from many image files with 1 staging buffer and 1 command buffer
+ * @details The files are mapped with `mapped_file_t` and decoded in parallel into the mapped staging memory.
+ *          No other copy of the pixels is made in this class. All images share 1 device local `VkDeviceMemory`.
+ *          `record` puts all copies and layout transitions in 1 command buffer, so 1 submit uploads everything.
+ *          With a `block_cache_t`, the compressed blocks are copied instead of the decoded pixels
+ */
+class vulkan_texture_batch_t final {
+  public:
+    struct texture_t final {
+        VkImage image{};
+        VkExtent2D extent{};
+        VkDeviceSize offset{}; // in the staging buffer
+        uint32_t mip_levels = 1;
+        uint32_t ec = 0; // from `mapped_file_t` or `image_codec_t`. `image` is null if not 0
+    };
+
+  public:
+    const VkDevice device{};
+    const VkFormat format = VK_FORMAT_R8G8B8A8_UNORM; // or `get_vulkan_format` of the blocks
+    std::vector<texture_t> textures{};
+    VkDeviceMemory memory{}; // shared by the `textures`
+    VkBuffer staging{};
+    VkDeviceMemory staging_memory{};
+
+  private:
+    /// @brief Decode the `files` into the staging buffer and create the images
+    void create(const VkPhysicalDeviceMemoryProperties& props, gsl::span<const fs::path> files,
+                const image_codec_t& codec, uint32_t num_workers, bool mipmap) noexcept(false);
+    /// @brief Load the entries of the `files` from the `cache` into the staging buffer and create the images
+    void create(const VkPhysicalDeviceMemoryProperties& props, gsl::span<const fs::path> files,
+                const image_codec_t& codec, block_format_t blocks, block_cache_t& cache,
+                uint32_t num_workers) noexcept(false);
+    void create_staging(const VkPhysicalDeviceMemoryProperties& props, VkDeviceSize size) noexcept(false);
+    /// @brief The images of the `format` for the textures without error, bound to 1 `memory`
+    void create_images(const VkPhysicalDeviceMemoryProperties& props, bool mipmap) noexcept(false);
+    /// @brief Destroy all handles. The null handles are ignored
+    void destroy() noexcept;
+
+  public:
+    /**
+     * @param num_workers  number of the decoding threads. `std::thread::hardware_concurrency` if 0
+     * @param mipmap  allocate the full mip chain. `record` will generate the levels with `vkCmdBlitImage`.
+     *                `VK_FORMAT_R8G8B8A8_UNORM` always supports BLIT_SRC/BLIT_DST and the linear filter
+     * @throw vulkan_exception_t
+     */
+    vulkan_texture_batch_t(VkDevice _device, const VkPhysicalDeviceMemoryProperties& props, //
+                           gsl::span<const fs::path> files, const image_codec_t& codec,       //
+                           uint32_t num_workers = 0, bool mipmap = false) noexcept(false);
+    /**
+     * @brief Compressed images. `vkCmdCopyBufferToImage` copies the blocks of the `block_cache_t` entries
+     * @details The entries are loaded(or encoded and stored on a miss) one by one, because the `cache` is not
+     *          thread-safe. The workers copy them into the staging memory
+     * @param blocks  `select_block_format(VkPhysicalDevice)`. `block_format_t::rgba8` is allowed
+     * @note  No mip chain. `vkCmdBlitImage` doesn't accept the compressed formats
+     * @throw vulkan_exception_t
+     */
+    vulkan_texture_batch_t(VkDevice _device, const VkPhysicalDeviceMemoryProperties& props, //
+                           gsl::span<const fs::path> files, const image_codec_t& codec,       //
+                           block_format_t blocks, block_cache_t& cache, uint32_t num_workers = 0) noexcept(false);
+    ~vulkan_texture_batch_t() noexcept;
+    vulkan_texture_batch_t(const vulkan_texture_batch_t&) = delete;
+    vulkan_texture_batch_t(vulkan_texture_batch_t&&) = delete;
+    vulkan_texture_batch_t& operator=(const vulkan_texture_batch_t&) = delete;
+    vulkan_texture_batch_t& operator=(vulkan_texture_batch_t&&) = delete;
+
+    /**
+     * @brief UNDEFINED -> TRANSFER_DST_OPTIMAL -> (copy) -> SHADER_READ_ONLY_OPTIMAL for all textures.
+     *        Each transition is 1 `vkCmdPipelineBarrier` with the barriers of all textures
+     * @details With the mip chain, level N-1 becomes TRANSFER_SRC_OPTIMAL and is blitted to level N,
+     *          level by level. The textures share the barrier of each level
+     * @param barriers  the textures are tracked with it. They are in SHADER_READ_ONLY_OPTIMAL after the return
+     * @see   vkCmdCopyBufferToImage
+     * @see   vkCmdBlitImage
+     */
+    void record(VkCommandBuffer commands, vulkan_barrier_builder_t& barriers) const noexcept(false);
+    void record(VkCommandBuffer commands) const noexcept(false);
+
+    /// @brief Destroy the staging buffer. Use after the recorded commands are completed
+    void release_staging() noexcept;
+};
+
+/**
+ * @brief Device local vertex/index buffers of `packed_scene_t` with 1 staging buffer and 1 command buffer
+ * @details Both buffers share 1 `VkDeviceMemory`. The whole scene is drawn with 1 `vkCmdBindVertexBuffers`,
+ *          1 `vkCmdBindIndexBuffer` and `vkCmdDrawIndexed` for each range
+ * @see load_gltf
+ */
+class vulkan_mesh_batch_t final {
+  public:
+    const VkDevice device{};
+    VkBuffer vertices{};
+    VkBuffer indices{};
+    VkDeviceMemory memory{}; // shared by the `vertices` and `indices`
+    VkBuffer staging{};
+    VkDeviceMemory staging_memory{};
+    VkDeviceSize vertex_size = 0; // bytes. `indices` start at this offset in the staging buffer
+    VkDeviceSize index_size = 0;
+    VkIndexType index_type = VK_INDEX_TYPE_UINT16;
+    uint32_t stride = 0;
+    uint32_t uv_offset = 0;
+    VkFormat uv_format = VK_FORMAT_R16G16_UNORM;
+    std::vector<packed_scene_t::draw_range_t> ranges{};
+
+  private:
+    /// @brief Create the buffers for the `scene`'s layout
+    /// @return std::byte* mapped staging memory. The indices start at `align_up(vertex_size, 4)`
+    std::byte* create(const packed_scene_t& scene, const VkPhysicalDeviceMemoryProperties& props) noexcept(false);
+    /// @brief Destroy all handles. The null handles are ignored
+    void destroy() noexcept;
+
+  public:
+    /// @throw vulkan_exception_t
+    vulkan_mesh_batch_t(VkDevice _device, const VkPhysicalDeviceMemoryProperties& props,
+                        const packed_scene_t& scene) noexcept(false);
+    /**
+     * @brief `mesh_packer_t::write` directly into the staging memory. No intermediate `packed_scene_t` buffers
+     * @details With `gltf_file_t`, the source bytes are in the file mapping. So the staging buffer is the only copy
+     * @throw vulkan_exception_t
+     */
+    vulkan_mesh_batch_t(VkDevice _device, const VkPhysicalDeviceMemoryProperties& props,
+                        const mesh_packer_t& packer) noexcept(false);
+    ~vulkan_mesh_batch_t() noexcept;
+    vulkan_mesh_batch_t(const vulkan_mesh_batch_t&) = delete;
+    vulkan_mesh_batch_t(vulkan_mesh_batch_t&&) = delete;
+    vulkan_mesh_batch_t& operator=(const vulkan_mesh_batch_t&) = delete;
+    vulkan_mesh_batch_t& operator=(vulkan_mesh_batch_t&&) = delete;
+
+    /// @brief The copies and 1 barrier for the vertex input
+    /// @see vkCmdCopyBuffer
+    void record(VkCommandBuffer commands) const noexcept;
+
+    /// @brief Destroy the staging buffer. Use after the recorded commands are completed
+    void release_staging() noexcept;
+
+    /**
+     * @brief Binding 0 is per vertex. location 0: position, 1: normal, 2: uv
+     * @note  The normal is `VK_FORMAT_R16G16B16A16_SNORM`. Use `vec4` or `vec3` in the shader
+     */
+    void setup_vertex_input_state(VkVertexInputBindingDescription& binding,
+                                  VkVertexInputAttributeDescription (&attrs)[3],
+                                  VkPipelineVertexInputStateCreateInfo& info) const noexcept;
+
+    void bind(VkCommandBuffer commands) const noexcept;
+    void draw(VkCommandBuffer commands, const packed_scene_t::draw_range_t& range, uint32_t instance_count = 1,
+              uint32_t first_instance = 0) const noexcept;
+    /**
+     * @brief The visible meshlets from `meshlet_culler_t::cull`
+     * @note  `first_instance` is the index of the `packed_scene_t::instances`. Use `gl_InstanceIndex` for the transform
+     */
+    void draw(VkCommandBuffer commands, gsl::span<const draw_indexed_command_t> draws) const noexcept;
+};
+
+/**
+ * @brief GPU-driven draws. A compute shader culls the `draw_object_t`s and writes `VkDrawIndexedIndirectCommand`s
+ * @details The objects are kept in a storage buffer, so `record` and `draw` are same commands for any number of
+ *          objects. With `draw_indirect_count`, the visible commands are compacted with the atomic counter and
+ *          drawn with `vkCmdDrawIndexedIndirectCount`. Without it, each object has its own slot and the culled ones
+ *          have 0 `instanceCount`. The `counter` has the number of visible objects in both cases.
+ *          The objects are in the `num_frames` slots of a ring buffer, so `update` doesn't overwrite the slot
+ *          which the pending dispatch of the other frame reads
+ * @note    The device needs `multiDrawIndirect` and `drawIndirectFirstInstance`. See `create_device`
+ * @see     cull_draw_objects
+ * @see     https://vkguide.dev/docs/gpudriven/compute_culling/
+ */
+class vulkan_indirect_culler_t final {
+  public:
+    const VkDevice device{};
+    const bool draw_indirect_count = false;
+    const uint32_t capacity = 0;
+    uint32_t frame = 0;           // slot of the last `update`
+    uint32_t count = 0;           // objects from the last `update`
+    vulkan_ring_buffer_t objects; // draw_object_t[capacity] for each frame
+    VkBuffer draws{};             // draw_indexed_command_t[capacity]
+    VkBuffer counter{};           // uint32_t
+    VkDeviceMemory memory{};      // shared by the `draws` and `counter`
+    VkDescriptorSetLayout set_layout{};
+    VkDescriptorPool pool{};
+    VkDescriptorSet set{};
+    VkPipelineLayout layout{};
+    VkPipeline pipeline{};
+
+  private:
+    /// @brief Create the buffers, the descriptor set and the compute pipeline
+    void create(const VkPhysicalDeviceMemoryProperties& props, const fs::path& shader_dir) noexcept(false);
+    /// @brief Destroy all handles. The null handles are ignored
+    void destroy() noexcept;
+
+  public:
+    /**
+     * @param shader_dir  the directory of "cull_comp.spv". (from assets/cull.comp)
+     * @param num_frames  number of the frames which can be in flight
+     * @param _draw_indirect_count  from `create_device`. The shader is specialized with it
+     * @throw vulkan_exception_t
+     * @throw std::system_error if the SPIR-V file is missing
+     */
+    vulkan_indirect_culler_t(VkDevice _device, const VkPhysicalDeviceMemoryProperties& props,
+                             const fs::path& shader_dir, uint32_t num_frames, uint32_t _capacity,
+                             bool _draw_indirect_count) noexcept(false);
+    ~vulkan_indirect_culler_t() noexcept;
+    vulkan_indirect_culler_t(const vulkan_indirect_culler_t&) = delete;
+    vulkan_indirect_culler_t(vulkan_indirect_culler_t&&) = delete;
+    vulkan_indirect_culler_t& operator=(const vulkan_indirect_culler_t&) = delete;
+    vulkan_indirect_culler_t& operator=(vulkan_indirect_culler_t&&) = delete;
+
+    /**
+     * @brief Write the objects into the slot of the frame. `record` uses the slot of the last `update`
+     * @param frame  the caller's frame index. The slot is `frame % num_frames`
+     * @note  The previous submit of the same slot must be completed. (ex: the fence of the frame)
+     * @return VkResult `VK_ERROR_TOO_MANY_OBJECTS` if the objects are more than the `capacity`
+     */
+    VkResult update(uint32_t frame, gsl::span<const draw_object_t> objects) noexcept;
+
+    /**
+     * @brief Reset the `counter`, dispatch the culling and the barrier for the `draw`
+     * @note  must be recorded outside of the render pass
+     */
+    void record(VkCommandBuffer commands, const frustum_t& frustum) const noexcept;
+
+    /// @brief The commands from the `record`. Use after `vulkan_mesh_batch_t::bind`
+    void draw(VkCommandBuffer commands) const noexcept;
+};
+
+/**
+ * @brief Frame graph. The passes declare the images and buffers they read and write, then `compile` makes the
+ *        render passes, the barriers and the transient images for them
+ * @details `compile` does these in order.
+ *          1. Cull the passes whose outputs are never read. The imported resources and `side_effect` are the roots
+ *          2. Merge the consecutive passes with the same extent into the subpasses of 1 render pass, unless one
+ *             samples an attachment of another
+ *          3. Make 1 `vkCmdPipelineBarrier` before each render pass with `next_access_state`
+ *          4. Create the transient images. The images used only in 1 render pass are `TRANSIENT_ATTACHMENT` in the
+ *             lazily allocated memory. The others share `VkDeviceMemory` when their lifetimes don't overlap
+ * @note    The first barrier of the imported image waits `VK_PIPELINE_STAGE_ALL_COMMANDS_BIT`, so it works with any
+ *          wait stage of the semaphores. Storage images are not supported
+ * @see     https://www.gdcvault.com/play/1024612/FrameGraph-Extensible-Rendering-Architecture-in
+ */
+class vulkan_render_graph_t final {
+  public:
+    static constexpr uint32_t npos = UINT32_MAX;
+
+    struct image_t final {
+        VkFormat format{};
+        VkExtent2D extent{};
+        VkClearValue clear{};              // when the attachment is not loaded
+        VkImageUsageFlags usage{};         // from the passes
+        VkImage handle{};                  // created by `compile` if not imported
+        VkImageView view{};                //
+        bool imported = false;             //
+        VkImageLayout initial_layout{};    // imported. layout before the frame
+        VkImageLayout final_layout{};      // imported. `VK_IMAGE_LAYOUT_UNDEFINED` to keep the last layout
+        uint32_t first = npos, last = npos; // lifetime in the `steps`
+        uint32_t memory = npos;             // index of `memories`
+        uint32_t alias = npos;              // the image which used the memory before this one
+    };
+    struct buffer_use_t final {
+        uint32_t buffer = npos;
+        VkAccessFlags access{};
+        VkPipelineStageFlags stage{};
+    };
+    struct pass_t final {
+        std::string name{};
+        std::vector<uint32_t> colors{};      // color attachments. write
+        uint32_t depth = npos;               // depth/stencil attachment. write
+        std::vector<uint32_t> samples{};     // sampled images. read
+        std::vector<buffer_use_t> buffers{}; // the write access makes a hazard
+        bool side_effect = false;            // never culled
+        std::function<void(VkCommandBuffer)> record{};
+        bool culled = false;
+        uint32_t step = npos;
+        uint32_t subpass = npos;
+    };
+    /// @brief 1 barrier, then 1 render pass. No render pass if the passes have no attachments
+    struct step_t final {
+        std::vector<uint32_t> passes{};
+        VkPipelineStageFlags src_stage{}, dst_stage{};
+        std::vector<VkImageMemoryBarrier> image_barriers{};
+        std::vector<VkBufferMemoryBarrier> buffer_barriers{};
+        VkRenderPass renderpass{};
+        VkFramebuffer framebuffer{};
+        VkExtent2D extent{};
+        std::vector<VkClearValue> clears{};
+    };
+
+  public:
+    const VkDevice device{};
+    const VkPhysicalDeviceMemoryProperties props;
+    std::vector<image_t> images{};
+    std::vector<VkBuffer> buffers{};
+    std::vector<pass_t> passes{};
+    std::vector<step_t> steps{};                 // from `compile`
+    std::vector<VkDeviceMemory> memories{};      // for the transient images
+    VkDeviceSize memory_size = 0;                // sum of the `memories`
+
+  public:
+    vulkan_render_graph_t(VkDevice _device, const VkPhysicalDeviceMemoryProperties& _props) noexcept;
+    ~vulkan_render_graph_t() noexcept;
+    vulkan_render_graph_t(const vulkan_render_graph_t&) = delete;
+    vulkan_render_graph_t(vulkan_render_graph_t&&) = delete;
+    vulkan_render_graph_t& operator=(const vulkan_render_graph_t&) = delete;
+    vulkan_render_graph_t& operator=(vulkan_render_graph_t&&) = delete;
+
+    /// @return uint32_t index of the transient image. `compile` creates it if a pass uses it
+    uint32_t create_image(VkFormat format, VkExtent2D extent) noexcept(false);
+    /// @param final_layout  the layout after the frame. ex) `VK_IMAGE_LAYOUT_PRESENT_SRC_KHR`
+    uint32_t import_image(VkImage image, VkImageView view, VkFormat format, VkExtent2D extent,
+                          VkImageLayout initial_layout, VkImageLayout final_layout) noexcept(false);
+    uint32_t import_buffer(VkBuffer buffer) noexcept(false);
+    /// @return uint32_t index of the pass. The order of the passes is the order of the execution
+    uint32_t add_pass(pass_t pass) noexcept(false);
+
+    /**
+     * @brief Cull, merge and create the Vulkan objects. The previous result is destroyed
+     * @return VkResult `VK_ERROR_INITIALIZATION_FAILED` if a pass uses an unknown resource or attachments with
+     *                  different extents
+     */
+    VkResult compile() noexcept;
+
+    /// @brief Record the barriers and the render passes with the `record` of the passes
+    void execute(VkCommandBuffer command_buffer) const noexcept(false);
+
+    /**
+     * @brief The render pass and the subpass index for `vkCreateGraphicsPipelines`
+     * @return VkResult `VK_ERROR_INITIALIZATION_FAILED` if the pass is culled, not compiled or has no attachment
+     */
+    VkResult get_renderpass(uint32_t pass, VkRenderPass& renderpass, uint32_t& subpass) const noexcept;
+
+  private:
+    void release() noexcept;
+    void cull() noexcept;
+    void merge() noexcept(false);
+    void make_barriers() noexcept(false);
+    VkResult make_images() noexcept;
+    VkResult make_renderpass(uint32_t index) noexcept;
+};
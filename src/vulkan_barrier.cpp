@@ -0,0 +1,138 @@
+/**
+ * @author Park DongHa (luncliff@gmail.com)
+ * @see https://www.khronos.org/registry/vulkan/specs/1.2-extensions/html/vkspec.html#synchronization-image-memory-barriers
+ * @see https://github.com/KhronosGroup/Vulkan-Docs/wiki/Synchronization-Examples
+ */
+#include "vulkan_1.h"
+
+using namespace std;
+
+bool next_access_state(const vulkan_access_state_t& current, VkImageLayout layout, VkAccessFlags access,
+                       VkPipelineStageFlags stage, vulkan_access_state_t& next) noexcept {
+    const auto writes = access & vulkan_write_access_mask;
+    if (current.layout == layout && writes == 0 && (current.access & vulkan_write_access_mask) == 0) {
+        next = current;
+        next.access |= access;
+        next.stage |= stage;
+        // the last barrier made the write visible only to its destination
+        return current.write_stage != 0 && ((current.stage & stage) != stage || (current.access & access) != access);
+    }
+    next.layout = layout;
+    next.access = access;
+    next.stage = stage;
+    next.write_access = writes ? writes : current.write_access;
+    next.write_stage = stage;
+    return true;
+}
+
+static bool operator==(const vulkan_barrier_builder_t::state_t& lhs,
+                       const vulkan_barrier_builder_t::state_t& rhs) noexcept {
+    return lhs.layout == rhs.layout && lhs.access == rhs.access && lhs.stage == rhs.stage &&
+           lhs.write_access == rhs.write_access && lhs.write_stage == rhs.write_stage;
+}
+
+void vulkan_barrier_builder_t::track(VkImage image, VkImageAspectFlags aspect, uint32_t levels, uint32_t layers,
+                                     VkImageLayout layout) noexcept(false) {
+    auto& info = images[image];
+    info.aspect = aspect;
+    info.levels = levels;
+    info.layers = layers;
+    state_t state{};
+    state.layout = layout;
+    info.states.assign(levels * layers, state);
+    info.previous.assign(levels * layers, state);
+    info.pending.assign(levels * layers, false);
+}
+
+void vulkan_barrier_builder_t::forget(VkImage image) noexcept {
+    images.erase(image);
+}
+
+uint32_t vulkan_barrier_builder_t::transition(VkImage image, const VkImageSubresourceRange& range, //
+                                              VkImageLayout layout, VkAccessFlags access,
+                                              VkPipelineStageFlags stage) noexcept {
+    auto it = images.find(image);
+    if (it == images.end())
+        return EINVAL;
+    auto& info = it->second;
+    const auto level_count =
+        range.levelCount == VK_REMAINING_MIP_LEVELS ? info.levels - range.baseMipLevel : range.levelCount;
+    const auto layer_count =
+        range.layerCount == VK_REMAINING_ARRAY_LAYERS ? info.layers - range.baseArrayLayer : range.layerCount;
+    if (range.baseMipLevel >= info.levels || range.baseMipLevel + level_count > info.levels ||
+        range.baseArrayLayer >= info.layers || range.baseArrayLayer + layer_count > info.layers)
+        return EINVAL;
+    for (auto layer = range.baseArrayLayer; layer < range.baseArrayLayer + layer_count; ++layer)
+        for (auto level = range.baseMipLevel; level < range.baseMipLevel + level_count; ++level) {
+            const auto i = layer * info.levels + level;
+            auto& current = info.states[i];
+            if (info.pending[i] == false)
+                info.previous[i] = current;
+            // fold with the pending transition. nothing was recorded between them
+            state_t next{};
+            info.pending[i] = next_access_state(info.previous[i], layout, access, stage, next);
+            current = next;
+        }
+    return 0;
+}
+
+uint32_t vulkan_barrier_builder_t::get_state(VkImage image, uint32_t level, uint32_t layer,
+                                             state_t& state) const noexcept {
+    auto it = images.find(image);
+    if (it == images.end())
+        return EINVAL;
+    const auto& info = it->second;
+    if (level >= info.levels || layer >= info.layers)
+        return EINVAL;
+    state = info.states[layer * info.levels + level];
+    return 0;
+}
+
+uint32_t vulkan_barrier_builder_t::flush(VkCommandBuffer commands) noexcept(false) {
+    VkPipelineStageFlags src_stages = 0, dst_stages = 0;
+    barriers.clear();
+    for (auto& [image, info] : images) {
+        for (auto layer = 0u; layer < info.layers; ++layer) {
+            const auto offset = layer * info.levels;
+            for (auto level = 0u; level < info.levels;) {
+                if (info.pending[offset + level] == false) {
+                    ++level;
+                    continue;
+                }
+                const auto& previous = info.previous[offset + level];
+                const auto& current = info.states[offset + level];
+                // merge the following levels with the same transition
+                auto count = 1u;
+                while (level + count < info.levels && info.pending[offset + level + count] &&
+                       info.previous[offset + level + count] == previous &&
+                       info.states[offset + level + count] == current)
+                    ++count;
+                VkImageMemoryBarrier barrier{};
+                barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                barrier.srcQueueFamilyIndex = barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.image = image;
+                barrier.subresourceRange = {info.aspect, level, count, layer, 1};
+                barrier.oldLayout = previous.layout;
+                barrier.srcAccessMask = previous.write_access; // only the writes must be available
+                barrier.newLayout = current.layout;
+                barrier.dstAccessMask = current.access;
+                barriers.emplace_back(barrier);
+                src_stages |= previous.stage;
+                dst_stages |= current.stage;
+                for (auto i = 0u; i < count; ++i)
+                    info.pending[offset + level + i] = false;
+                level += count;
+            }
+        }
+    }
+    if (barriers.empty())
+        return 0;
+    // no stage accessed them yet. (ex: UNDEFINED layout)
+    if (src_stages == 0)
+        src_stages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    if (dst_stages == 0)
+        dst_stages = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+    vkCmdPipelineBarrier(commands, src_stages, dst_stages, 0, 0, nullptr, 0, nullptr, //
+                         static_cast<uint32_t>(barriers.size()), barriers.data());
+    return static_cast<uint32_t>(barriers.size());
+}
@@ -0,0 +1,362 @@
+/**
+ * @author Park DongHa (luncliff@gmail.com)
+ * @see https://www.khronos.org/registry/vulkan/specs/1.2-extensions/man/html/VK_EXT_descriptor_indexing.html
+ * @see https://vkguide.dev/docs/extra-chapter/abstracting_descriptors/
+ */
+#include "vulkan_1.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+vulkan_bindless_heap_t::vulkan_bindless_heap_t(VkDevice _device, uint32_t _capacity, uint32_t num_frames,
+                                               VkShaderStageFlags stages) noexcept(false)
+    : device{_device}, capacity{_capacity} {
+    TRACE_SCOPE("vulkan_bindless_heap_t");
+    if (capacity == 0 || num_frames == 0)
+        throw vulkan_exception_t{VK_ERROR_INITIALIZATION_FAILED, "vulkan_bindless_heap_t"};
+    {
+        VkDescriptorSetLayoutBinding binding{};
+        binding.binding = 0;
+        binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        binding.descriptorCount = capacity;
+        binding.stageFlags = stages;
+        // the unused slots are never written
+        const VkDescriptorBindingFlags flags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+                                               VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                                               VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+        VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags{};
+        binding_flags.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+        binding_flags.bindingCount = 1;
+        binding_flags.pBindingFlags = &flags;
+        VkDescriptorSetLayoutCreateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        info.pNext = &binding_flags;
+        info.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+        info.bindingCount = 1;
+        info.pBindings = &binding;
+        if (auto ec = vkCreateDescriptorSetLayout(device, &info, nullptr, &layout))
+            throw vulkan_exception_t{ec, "vkCreateDescriptorSetLayout"};
+    }
+    {
+        VkDescriptorPoolSize size{};
+        size.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        size.descriptorCount = capacity;
+        VkDescriptorPoolCreateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+        info.maxSets = 1;
+        info.poolSizeCount = 1;
+        info.pPoolSizes = &size;
+        if (auto ec = vkCreateDescriptorPool(device, &info, nullptr, &pool)) {
+            vkDestroyDescriptorSetLayout(device, layout, nullptr);
+            throw vulkan_exception_t{ec, "vkCreateDescriptorPool"};
+        }
+    }
+    {
+        VkDescriptorSetAllocateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        info.descriptorPool = pool;
+        info.descriptorSetCount = 1;
+        info.pSetLayouts = &layout;
+        if (auto ec = vkAllocateDescriptorSets(device, &info, &set)) {
+            vkDestroyDescriptorPool(device, pool, nullptr);
+            vkDestroyDescriptorSetLayout(device, layout, nullptr);
+            throw vulkan_exception_t{ec, "vkAllocateDescriptorSets"};
+        }
+    }
+    // pop_back gives the lower index first. the reserved memory is kept for `reset`
+    free_indices.resize(capacity);
+    for (auto i = 0u; i < capacity; ++i)
+        free_indices[i] = capacity - 1 - i;
+    used.assign(capacity, false);
+    retired.resize(num_frames);
+}
+
+vulkan_bindless_heap_t::~vulkan_bindless_heap_t() noexcept {
+    vkDestroyDescriptorPool(device, pool, nullptr);
+    vkDestroyDescriptorSetLayout(device, layout, nullptr);
+}
+
+uint32_t vulkan_bindless_heap_t::allocate(VkImageView view, VkSampler sampler,
+                                          VkImageLayout image_layout) noexcept(false) {
+    if (free_indices.empty())
+        return UINT32_MAX;
+    const auto index = free_indices.back();
+    free_indices.pop_back();
+    used[index] = true;
+    VkDescriptorImageInfo image{};
+    image.sampler = sampler;
+    image.imageView = view;
+    image.imageLayout = image_layout;
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = set;
+    write.dstBinding = 0;
+    write.dstArrayElement = index;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pImageInfo = &image;
+    vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+    return index;
+}
+
+void vulkan_bindless_heap_t::release(uint32_t index) noexcept(false) {
+    if (index >= capacity || used[index] == false)
+        return;
+    // the command buffers of the frames in flight may sample it. see `reset`
+    retired[current].emplace_back(index);
+    used[index] = false;
+}
+
+VkResult vulkan_bindless_heap_t::reset(uint32_t frame) noexcept {
+    if (frame >= retired.size())
+        return VK_ERROR_INITIALIZATION_FAILED;
+    // released while the `frame` was the current one. the frames before it are completed too
+    for (auto index : retired[frame])
+        free_indices.emplace_back(index); // no allocation. the `capacity` is reserved in the constructor
+    retired[frame].clear();
+    current = frame;
+    return VK_SUCCESS;
+}
+
+uint32_t vulkan_bindless_heap_t::size() const noexcept {
+    auto count = capacity - static_cast<uint32_t>(free_indices.size());
+    for (const auto& indices : retired)
+        count -= static_cast<uint32_t>(indices.size());
+    return count;
+}
+
+/// @brief The handles can be pointers or `uint64_t`
+template <typename T>
+static uint64_t to_word(T handle) noexcept {
+    static_assert(sizeof(T) <= sizeof(uint64_t));
+    uint64_t word = 0;
+    std::memcpy(&word, &handle, sizeof(T));
+    return word;
+}
+
+/// @see FNV-1a
+size_t vulkan_descriptor_allocator_t::key_hash_t::operator()(const key_t& key) const noexcept {
+    uint64_t h = 14695981039346656037ull;
+    for (auto word : key) {
+        h ^= word;
+        h *= 1099511628211ull;
+    }
+    return static_cast<size_t>(h);
+}
+
+vulkan_descriptor_allocator_t::vulkan_descriptor_allocator_t(VkDevice _device, uint32_t num_frames,
+                                                             uint32_t _sets_per_pool) noexcept(false)
+    : device{_device}, sets_per_pool{_sets_per_pool} {
+    if (num_frames == 0 || sets_per_pool == 0)
+        throw vulkan_exception_t{VK_ERROR_INITIALIZATION_FAILED, "vulkan_descriptor_allocator_t"};
+    frames.resize(num_frames);
+    retired.resize(num_frames);
+    // descriptors for 1 set in average
+    const pair<VkDescriptorType, uint32_t> ratios[]{
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2},         {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2},         {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4},
+        {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 2},          {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1},
+        {VK_DESCRIPTOR_TYPE_SAMPLER, 1},
+    };
+    for (auto [type, ratio] : ratios)
+        sizes.emplace_back(VkDescriptorPoolSize{type, ratio * sets_per_pool});
+}
+
+vulkan_descriptor_allocator_t::~vulkan_descriptor_allocator_t() noexcept {
+    for (auto& pools : frames)
+        for (auto pool : pools)
+            vkDestroyDescriptorPool(device, pool, nullptr);
+    for (auto pool : free_pools)
+        vkDestroyDescriptorPool(device, pool, nullptr);
+    for (auto pool : persistent_pools)
+        vkDestroyDescriptorPool(device, pool, nullptr);
+    for (auto& [key, layout] : layouts)
+        vkDestroyDescriptorSetLayout(device, layout, nullptr);
+}
+
+VkResult vulkan_descriptor_allocator_t::acquire_pool(VkDescriptorPool& pool) noexcept {
+    if (free_pools.empty() == false) {
+        pool = free_pools.back();
+        free_pools.pop_back();
+        return VK_SUCCESS;
+    }
+    VkDescriptorPoolCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    info.maxSets = sets_per_pool;
+    info.poolSizeCount = static_cast<uint32_t>(sizes.size());
+    info.pPoolSizes = sizes.data();
+    return vkCreateDescriptorPool(device, &info, nullptr, &pool);
+}
+
+VkResult vulkan_descriptor_allocator_t::allocate(vector<VkDescriptorPool>& pools, VkDescriptorSetLayout layout,
+                                                 VkDescriptorSet& set) noexcept {
+    try {
+        VkDescriptorSetAllocateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        info.descriptorSetCount = 1;
+        info.pSetLayouts = &layout;
+        if (pools.empty() == false) {
+            info.descriptorPool = pools.back();
+            const auto ec = vkAllocateDescriptorSets(device, &info, &set);
+            if (ec != VK_ERROR_OUT_OF_POOL_MEMORY && ec != VK_ERROR_FRAGMENTED_POOL)
+                return ec;
+        }
+        // the current pool is full. grow the list and retry once
+        VkDescriptorPool pool{};
+        if (auto ec = acquire_pool(pool))
+            return ec;
+        pools.emplace_back(pool);
+        info.descriptorPool = pool;
+        return vkAllocateDescriptorSets(device, &info, &set);
+    } catch (const std::bad_alloc&) {
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+}
+
+VkResult vulkan_descriptor_allocator_t::allocate(uint32_t frame, VkDescriptorSetLayout layout,
+                                                 VkDescriptorSet& set) noexcept {
+    if (frame >= frames.size())
+        return VK_ERROR_INITIALIZATION_FAILED;
+    return allocate(frames[frame], layout, set);
+}
+
+VkResult vulkan_descriptor_allocator_t::reset(uint32_t frame) noexcept {
+    if (frame >= frames.size())
+        return VK_ERROR_INITIALIZATION_FAILED;
+    auto& pools = frames[frame];
+    auto& pending = retired[frame];
+    try {
+        // the emplace_back below must not throw. a pool lost in the middle will leak
+        free_pools.reserve(free_pools.size() + pools.size());
+        // released while the `frame` was the current one. the frames before it are completed too
+        while (pending.empty() == false) {
+            const auto [layout, set] = pending.back();
+            released[layout].emplace_back(set);
+            pending.pop_back();
+        }
+    } catch (const std::bad_alloc&) {
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+    current = frame;
+    for (auto pool : pools) {
+        vkResetDescriptorPool(device, pool, 0);
+        free_pools.emplace_back(pool);
+    }
+    pools.clear();
+    return VK_SUCCESS;
+}
+
+VkResult vulkan_descriptor_allocator_t::get(VkDescriptorSetLayout layout, gsl::span<const VkWriteDescriptorSet> writes,
+                                            VkDescriptorSet& set) noexcept {
+    TRACE_SCOPE("vulkan_descriptor_allocator_t::get");
+    try {
+        key_t key{to_word(layout)};
+        for (const auto& write : writes) {
+            key.emplace_back(uint64_t{write.dstBinding} << 32 | write.dstArrayElement);
+            key.emplace_back(uint64_t{static_cast<uint32_t>(write.descriptorType)} << 32 | write.descriptorCount);
+            // the other info arrays are ignored by Vulkan. they can be dangling
+            switch (write.descriptorType) {
+            case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+            case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+            case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+            case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+                for (auto i = 0u; i < write.descriptorCount; ++i) {
+                    const auto& info = write.pBufferInfo[i];
+                    key.insert(key.end(), {to_word(info.buffer), info.offset, info.range});
+                }
+                break;
+            case VK_DESCRIPTOR_TYPE_SAMPLER:
+            case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+            case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+            case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+            case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT: {
+                // the sampler only for the samplers, the view only for the images
+                const bool sampler = write.descriptorType == VK_DESCRIPTOR_TYPE_SAMPLER ||
+                                     write.descriptorType == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                const bool view = write.descriptorType != VK_DESCRIPTOR_TYPE_SAMPLER;
+                for (auto i = 0u; i < write.descriptorCount; ++i) {
+                    const auto& info = write.pImageInfo[i];
+                    key.insert(key.end(), {sampler ? to_word(info.sampler) : 0, view ? to_word(info.imageView) : 0,
+                                           view ? static_cast<uint64_t>(info.imageLayout) : 0});
+                }
+                break;
+            }
+            default: // the texel buffers and the extensions
+                return VK_ERROR_FORMAT_NOT_SUPPORTED;
+            }
+        }
+        if (auto it = sets.find(key); it != sets.end()) {
+            set = it->second;
+            return VK_SUCCESS;
+        }
+        // the set from `release` has no cache entry
+        if (auto it = released.find(key.front()); it != released.end() && it->second.empty() == false) {
+            set = it->second.back();
+            it->second.pop_back();
+        } else if (auto ec = allocate(persistent_pools, layout, set))
+            return ec;
+        vector<VkWriteDescriptorSet> changes{writes.begin(), writes.end()};
+        for (auto& change : changes)
+            change.dstSet = set;
+        vkUpdateDescriptorSets(device, static_cast<uint32_t>(changes.size()), changes.data(), 0, nullptr);
+        sets.emplace(move(key), set);
+        return VK_SUCCESS;
+    } catch (const std::bad_alloc&) {
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+}
+
+VkResult vulkan_descriptor_allocator_t::release(VkDescriptorSet set) noexcept {
+    auto it = find_if(sets.begin(), sets.end(), [set](const auto& entry) { return entry.second == set; });
+    if (it == sets.end())
+        return VK_SUCCESS;
+    try {
+        // the command buffers of the frames in flight may use it. see `reset`
+        retired[current].emplace_back(it->first.front(), set);
+    } catch (const std::bad_alloc&) {
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+    sets.erase(it);
+    return VK_SUCCESS;
+}
+
+VkResult vulkan_descriptor_allocator_t::get_layout(const VkDescriptorSetLayoutCreateInfo& info,
+                                                   VkDescriptorSetLayout& layout) noexcept {
+    if (info.pNext)
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+    try {
+        key_t key{uint64_t{info.flags}};
+        for (auto i = 0u; i < info.bindingCount; ++i) {
+            const auto& binding = info.pBindings[i];
+            if (binding.pImmutableSamplers)
+                return VK_ERROR_FEATURE_NOT_PRESENT;
+            key.emplace_back(uint64_t{binding.binding} << 32 | static_cast<uint32_t>(binding.descriptorType));
+            key.emplace_back(uint64_t{binding.descriptorCount} << 32 | binding.stageFlags);
+        }
+        if (auto it = layouts.find(key); it != layouts.end()) {
+            layout = it->second;
+            return VK_SUCCESS;
+        }
+        if (auto ec = vkCreateDescriptorSetLayout(device, &info, nullptr, &layout))
+            return ec;
+        layouts.emplace(move(key), layout);
+        return VK_SUCCESS;
+    } catch (const std::bad_alloc&) {
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+}
+
+size_t vulkan_descriptor_allocator_t::get_pool_count() const noexcept {
+    size_t count = free_pools.size() + persistent_pools.size();
+    for (const auto& pools : frames)
+        count += pools.size();
+    return count;
+}
+
+size_t vulkan_descriptor_allocator_t::get_set_count() const noexcept {
+    return sets.size();
+}
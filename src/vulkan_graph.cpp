@@ -0,0 +1,608 @@
+/**
+ * @author Park DongHa (luncliff@gmail.com)
+ * @see https://www.gdcvault.com/play/1024612/FrameGraph-Extensible-Rendering-Architecture-in
+ * @see https://themaister.net/blog/2017/08/15/render-graphs-and-vulkan-a-deep-dive/
+ */
+#include "vulkan_1.h"
+#include "trace.h"
+
+#include <algorithm>
+
+using namespace std;
+
+constexpr VkPipelineStageFlags attachment_stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                                   VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                                                   VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+
+static bool has_stencil(VkFormat format) noexcept {
+    return format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT ||
+           format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+}
+
+static bool is_depth_format(VkFormat format) noexcept {
+    return format == VK_FORMAT_D16_UNORM || format == VK_FORMAT_X8_D24_UNORM_PACK32 ||
+           format == VK_FORMAT_D32_SFLOAT || has_stencil(format);
+}
+
+static VkImageAspectFlags get_aspect(VkFormat format) noexcept {
+    if (has_stencil(format))
+        return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    return is_depth_format(format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+}
+
+static bool has_attachment(const vulkan_render_graph_t::pass_t& pass) noexcept {
+    return pass.colors.empty() == false || pass.depth != vulkan_render_graph_t::npos;
+}
+
+/// @brief How the image/buffer is accessed in 1 step
+struct use_t final {
+    uint32_t index = vulkan_render_graph_t::npos;
+    VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED; // not for the buffers
+    VkAccessFlags access = 0;
+    VkPipelineStageFlags stage = 0;
+};
+
+/// @brief Accumulate the uses of the same resource. The passes in 1 step don't use it with different layouts
+static void add_use(vector<use_t>& uses, uint32_t index, VkImageLayout layout, VkAccessFlags access,
+                    VkPipelineStageFlags stage) noexcept(false) {
+    for (auto& use : uses) {
+        if (use.index != index)
+            continue;
+        use.access |= access;
+        use.stage |= stage;
+        return;
+    }
+    uses.emplace_back(use_t{index, layout, access, stage});
+}
+
+vulkan_render_graph_t::vulkan_render_graph_t(VkDevice _device, const VkPhysicalDeviceMemoryProperties& _props) noexcept
+    : device{_device}, props{_props} {
+}
+
+vulkan_render_graph_t::~vulkan_render_graph_t() noexcept {
+    release();
+}
+
+uint32_t vulkan_render_graph_t::create_image(VkFormat format, VkExtent2D extent) noexcept(false) {
+    auto& image = images.emplace_back();
+    image.format = format;
+    image.extent = extent;
+    if (is_depth_format(format))
+        image.clear.depthStencil = {1.0f, 0};
+    return static_cast<uint32_t>(images.size() - 1);
+}
+
+uint32_t vulkan_render_graph_t::import_image(VkImage handle, VkImageView view, VkFormat format, VkExtent2D extent,
+                                             VkImageLayout initial_layout, VkImageLayout final_layout) noexcept(false) {
+    const auto index = create_image(format, extent);
+    auto& image = images[index];
+    image.handle = handle;
+    image.view = view;
+    image.imported = true;
+    image.initial_layout = initial_layout;
+    image.final_layout = final_layout;
+    return index;
+}
+
+uint32_t vulkan_render_graph_t::import_buffer(VkBuffer buffer) noexcept(false) {
+    buffers.emplace_back(buffer);
+    return static_cast<uint32_t>(buffers.size() - 1);
+}
+
+uint32_t vulkan_render_graph_t::add_pass(pass_t pass) noexcept(false) {
+    passes.emplace_back(move(pass));
+    return static_cast<uint32_t>(passes.size() - 1);
+}
+
+void vulkan_render_graph_t::release() noexcept {
+    for (auto& step : steps) {
+        if (step.framebuffer)
+            vkDestroyFramebuffer(device, step.framebuffer, nullptr);
+        if (step.renderpass)
+            vkDestroyRenderPass(device, step.renderpass, nullptr);
+    }
+    steps.clear();
+    for (auto& image : images) {
+        if (image.imported == false) {
+            if (image.view)
+                vkDestroyImageView(device, image.view, nullptr);
+            if (image.handle)
+                vkDestroyImage(device, image.handle, nullptr);
+            image.view = VK_NULL_HANDLE;
+            image.handle = VK_NULL_HANDLE;
+            image.usage = 0;
+        }
+        image.first = image.last = image.memory = image.alias = npos;
+    }
+    for (auto memory : memories)
+        vkFreeMemory(device, memory, nullptr);
+    memories.clear();
+    memory_size = 0;
+    for (auto& pass : passes) {
+        pass.culled = false;
+        pass.step = pass.subpass = npos;
+    }
+}
+
+/// @details Walk backward from the imported resources. The attachments of the alive pass are loaded,
+///          so the previous writers of them are alive too
+void vulkan_render_graph_t::cull() noexcept {
+    vector<bool> needed(images.size());
+    for (auto i = 0u; i < images.size(); ++i)
+        needed[i] = images[i].imported;
+    for (auto i = passes.size(); i-- > 0;) {
+        auto& pass = passes[i];
+        bool alive = pass.side_effect;
+        for (auto c : pass.colors)
+            alive |= needed[c];
+        if (pass.depth != npos)
+            alive |= needed[pass.depth];
+        for (const auto& use : pass.buffers) // all buffers are imported
+            alive |= (use.access & vulkan_write_access_mask) != 0;
+        pass.culled = alive == false;
+        if (pass.culled)
+            continue;
+        for (auto c : pass.colors)
+            needed[c] = true;
+        if (pass.depth != npos)
+            needed[pass.depth] = true;
+        for (auto s : pass.samples)
+            needed[s] = true;
+    }
+}
+
+/// @details The subpass can't sample the attachment of the other subpass. The buffer hazard needs a barrier
+///          outside of the render pass. Both of them start a new step
+void vulkan_render_graph_t::merge() noexcept(false) {
+    auto conflicts = [this](const step_t& step, const pass_t& pass) {
+        for (auto p : step.passes) {
+            const auto& other = passes[p];
+            auto writes = [](const pass_t& pass, uint32_t image) {
+                return pass.depth == image || find(pass.colors.begin(), pass.colors.end(), image) != pass.colors.end();
+            };
+            for (auto s : pass.samples)
+                if (writes(other, s))
+                    return true;
+            for (auto s : other.samples)
+                if (writes(pass, s))
+                    return true;
+            for (const auto& lhs : pass.buffers)
+                for (const auto& rhs : other.buffers)
+                    if (lhs.buffer == rhs.buffer && ((lhs.access | rhs.access) & vulkan_write_access_mask))
+                        return true;
+        }
+        return false;
+    };
+    for (auto i = 0u; i < passes.size(); ++i) {
+        auto& pass = passes[i];
+        if (pass.culled)
+            continue;
+        const bool graphics = has_attachment(pass);
+        const auto extent = graphics ? images[pass.colors.empty() ? pass.depth : pass.colors[0]].extent : VkExtent2D{};
+        bool merged = false;
+        if (graphics && steps.empty() == false) {
+            const auto& last = steps.back();
+            merged = has_attachment(passes[last.passes[0]]) && last.extent.width == extent.width &&
+                     last.extent.height == extent.height && conflicts(last, pass) == false;
+        }
+        if (merged == false) {
+            auto& step = steps.emplace_back();
+            step.extent = extent;
+        }
+        const auto index = static_cast<uint32_t>(steps.size() - 1);
+        auto& step = steps.back();
+        pass.step = index;
+        pass.subpass = static_cast<uint32_t>(step.passes.size());
+        step.passes.emplace_back(i);
+        // lifetimes and usages
+        auto use = [this, index](uint32_t i, VkImageUsageFlags usage) {
+            auto& image = images[i];
+            image.first = min(image.first, index);
+            image.last = image.last == npos ? index : max(image.last, index);
+            image.usage |= usage;
+        };
+        for (auto c : pass.colors)
+            use(c, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT);
+        if (pass.depth != npos)
+            use(pass.depth, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT);
+        for (auto s : pass.samples)
+            use(s, VK_IMAGE_USAGE_SAMPLED_BIT);
+    }
+}
+
+/// @details Greedy. The larger image takes a new memory first, then the smaller ones fill the memories
+///          whose images are not alive at the same time
+VkResult vulkan_render_graph_t::make_images() noexcept {
+    struct slot_t final {
+        uint32_t type_bits = 0;
+        bool lazy = false;
+        VkDeviceSize size = 0;
+        vector<uint32_t> images{};
+    };
+    try {
+        vector<uint32_t> candidates{};
+        vector<VkMemoryRequirements> requirements(images.size());
+        vector<bool> lazy(images.size());
+        for (auto i = 0u; i < images.size(); ++i) {
+            auto& image = images[i];
+            if (image.imported || image.first == npos)
+                continue;
+            // never stored to the memory
+            lazy[i] = image.first == image.last && (image.usage & VK_IMAGE_USAGE_SAMPLED_BIT) == 0;
+            if (lazy[i])
+                image.usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+            VkImageCreateInfo info{};
+            info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            info.imageType = VK_IMAGE_TYPE_2D;
+            info.format = image.format;
+            info.extent = {image.extent.width, image.extent.height, 1};
+            info.mipLevels = 1;
+            info.arrayLayers = 1;
+            info.samples = VK_SAMPLE_COUNT_1_BIT;
+            info.tiling = VK_IMAGE_TILING_OPTIMAL;
+            info.usage = image.usage;
+            info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            if (auto ec = vkCreateImage(device, &info, nullptr, &image.handle))
+                return ec;
+            vkGetImageMemoryRequirements(device, image.handle, &requirements[i]);
+            candidates.emplace_back(i);
+        }
+        sort(candidates.begin(), candidates.end(),
+             [&requirements](uint32_t lhs, uint32_t rhs) { return requirements[lhs].size > requirements[rhs].size; });
+        vector<slot_t> slots{};
+        for (auto i : candidates) {
+            const auto& image = images[i];
+            auto overlaps = [this, &image](uint32_t other) {
+                return !(images[other].last < image.first || image.last < images[other].first);
+            };
+            auto it = find_if(slots.begin(), slots.end(), [&](const slot_t& slot) {
+                return slot.lazy == lazy[i] && (slot.type_bits & requirements[i].memoryTypeBits) &&
+                       slot.size >= requirements[i].size && none_of(slot.images.begin(), slot.images.end(), overlaps);
+            });
+            if (it == slots.end())
+                it = slots.emplace(slots.end(), slot_t{requirements[i].memoryTypeBits, lazy[i], requirements[i].size});
+            it->type_bits &= requirements[i].memoryTypeBits;
+            it->images.emplace_back(i);
+        }
+        for (auto& slot : slots) {
+            auto type = UINT32_MAX;
+            if (slot.lazy)
+                type = get_memory_type(props, slot.type_bits,
+                                       VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            if (type == UINT32_MAX)
+                type = get_memory_type(props, slot.type_bits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            if (type == UINT32_MAX)
+                type = get_memory_type(props, slot.type_bits, 0);
+            VkMemoryAllocateInfo info{};
+            info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+            info.allocationSize = slot.size;
+            info.memoryTypeIndex = type;
+            VkDeviceMemory memory{};
+            if (auto ec = vkAllocateMemory(device, &info, nullptr, &memory))
+                return ec;
+            memories.emplace_back(memory);
+            memory_size += slot.size;
+            // in the order of the lifetime. the previous one is the alias
+            sort(slot.images.begin(), slot.images.end(),
+                 [this](uint32_t lhs, uint32_t rhs) { return images[lhs].first < images[rhs].first; });
+            for (auto k = 0u; k < slot.images.size(); ++k) {
+                auto& image = images[slot.images[k]];
+                image.memory = static_cast<uint32_t>(memories.size() - 1);
+                image.alias = k ? slot.images[k - 1] : npos;
+                if (auto ec = vkBindImageMemory(device, image.handle, memory, 0))
+                    return ec;
+            }
+        }
+        for (auto i : candidates) {
+            auto& image = images[i];
+            VkImageViewCreateInfo info{};
+            info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            info.image = image.handle;
+            info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            info.format = image.format;
+            info.subresourceRange = {get_aspect(image.format), 0, 1, 0, 1};
+            if (auto ec = vkCreateImageView(device, &info, nullptr, &image.view))
+                return ec;
+        }
+        return VK_SUCCESS;
+    } catch (const std::bad_alloc&) {
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+}
+
+/// @see vulkan_barrier_builder_t
+void vulkan_render_graph_t::make_barriers() noexcept(false) {
+    vector<vulkan_access_state_t> image_states(images.size());
+    for (auto i = 0u; i < images.size(); ++i)
+        if (images[i].imported)
+            image_states[i] = {images[i].initial_layout, 0, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT};
+    vector<vulkan_access_state_t> buffer_states(buffers.size());
+
+    auto transition = [this, &image_states](step_t& step, uint32_t index, const use_t& use) {
+        auto& current = image_states[use.index];
+        const auto& image = images[use.index];
+        if (image.imported == false && image.first == index) {
+            // the content is discarded, but the previous image in the memory must be done
+            current = vulkan_access_state_t{};
+            if (image.alias != npos) {
+                current = image_states[image.alias];
+                current.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+            }
+        }
+        vulkan_access_state_t next{};
+        if (next_access_state(current, use.layout, use.access, use.stage, next) == false) {
+            current = next;
+            return;
+        }
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcQueueFamilyIndex = barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image.handle;
+        barrier.subresourceRange = {get_aspect(image.format), 0, 1, 0, 1};
+        barrier.oldLayout = current.layout;
+        barrier.srcAccessMask = current.write_access; // only the writes must be available
+        barrier.newLayout = use.layout;
+        barrier.dstAccessMask = use.access;
+        step.image_barriers.emplace_back(barrier);
+        step.src_stage |= current.stage;
+        step.dst_stage |= use.stage;
+        current = next;
+    };
+    for (auto index = 0u; index < steps.size(); ++index) {
+        auto& step = steps[index];
+        vector<use_t> image_uses{}, buffer_uses{};
+        for (auto p : step.passes) {
+            const auto& pass = passes[p];
+            const VkPipelineStageFlags sample_stage =
+                has_attachment(pass) ? VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
+                                     : VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+            for (auto c : pass.colors)
+                add_use(image_uses, c, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                        VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+            if (pass.depth != npos)
+                add_use(image_uses, pass.depth, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT);
+            for (auto s : pass.samples)
+                add_use(image_uses, s, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_SHADER_READ_BIT,
+                        sample_stage);
+            for (const auto& use : pass.buffers)
+                add_use(buffer_uses, use.buffer, VK_IMAGE_LAYOUT_UNDEFINED, use.access, use.stage);
+        }
+        for (const auto& use : image_uses)
+            transition(step, index, use);
+        for (const auto& use : buffer_uses) {
+            auto& current = buffer_states[use.index];
+            vulkan_access_state_t next{};
+            const bool hazard = next_access_state(current, VK_IMAGE_LAYOUT_UNDEFINED, use.access, use.stage, next);
+            // the first use in the frame. the previous frame is synchronized by the caller
+            if (current.stage == 0 || hazard == false) {
+                current = next;
+                continue;
+            }
+            VkBufferMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            barrier.srcQueueFamilyIndex = barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.buffer = buffers[use.index];
+            barrier.offset = 0;
+            barrier.size = VK_WHOLE_SIZE;
+            barrier.srcAccessMask = current.write_access;
+            barrier.dstAccessMask = use.access;
+            step.buffer_barriers.emplace_back(barrier);
+            step.src_stage |= current.stage;
+            step.dst_stage |= use.stage;
+            current = next;
+        }
+    }
+    // the imported images leave the frame with their final layouts
+    step_t last{};
+    for (auto i = 0u; i < images.size(); ++i) {
+        const auto& image = images[i];
+        if (image.imported == false || image.final_layout == VK_IMAGE_LAYOUT_UNDEFINED ||
+            image.final_layout == image_states[i].layout)
+            continue;
+        transition(last, static_cast<uint32_t>(steps.size()), use_t{i, image.final_layout, 0, 0});
+    }
+    if (last.image_barriers.empty() == false)
+        steps.emplace_back(move(last));
+    for (auto& step : steps) {
+        // no stage accessed them yet. (ex: UNDEFINED layout)
+        if (step.src_stage == 0)
+            step.src_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        if (step.dst_stage == 0)
+            step.dst_stage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+    }
+}
+
+/// @details The layout transitions are done by the barrier of the step. The render pass keeps the layouts
+VkResult vulkan_render_graph_t::make_renderpass(uint32_t index) noexcept {
+    auto& step = steps[index];
+    try {
+        const auto count = step.passes.size();
+        vector<uint32_t> attachments{}; // index of `images`
+        auto get_attachment = [&attachments](uint32_t image) {
+            auto it = find(attachments.begin(), attachments.end(), image);
+            if (it != attachments.end())
+                return static_cast<uint32_t>(it - attachments.begin());
+            attachments.emplace_back(image);
+            return static_cast<uint32_t>(attachments.size() - 1);
+        };
+        vector<vector<VkAttachmentReference>> colors(count);
+        vector<VkAttachmentReference> depths(count);
+        vector<VkSubpassDescription> subpasses(count);
+        for (auto k = 0u; k < count; ++k) {
+            const auto& pass = passes[step.passes[k]];
+            for (auto c : pass.colors)
+                colors[k].emplace_back(VkAttachmentReference{get_attachment(c), //
+                                                             VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL});
+            auto& subpass = subpasses[k];
+            subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+            subpass.colorAttachmentCount = static_cast<uint32_t>(colors[k].size());
+            subpass.pColorAttachments = colors[k].data();
+            if (pass.depth != npos) {
+                depths[k] = {get_attachment(pass.depth), VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+                subpass.pDepthStencilAttachment = &depths[k];
+            }
+        }
+        vector<VkAttachmentDescription> descriptions(attachments.size());
+        vector<VkImageView> views(attachments.size());
+        step.clears.resize(attachments.size());
+        for (auto a = 0u; a < attachments.size(); ++a) {
+            const auto& image = images[attachments[a]];
+            const bool loaded =
+                index > image.first || (image.imported && image.initial_layout != VK_IMAGE_LAYOUT_UNDEFINED);
+            const bool stored = image.imported || image.last > index;
+            auto& desc = descriptions[a];
+            desc.format = image.format;
+            desc.samples = VK_SAMPLE_COUNT_1_BIT;
+            desc.loadOp = loaded ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+            desc.storeOp = stored ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            desc.stencilLoadOp = has_stencil(image.format) ? desc.loadOp : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            desc.stencilStoreOp = has_stencil(image.format) ? desc.storeOp : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            desc.initialLayout = desc.finalLayout = is_depth_format(image.format)
+                                                        ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+                                                        : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            views[a] = image.view;
+            step.clears[a] = image.clear;
+        }
+        // the later subpass which uses the same attachment waits the earlier one
+        vector<VkSubpassDependency> dependencies{};
+        auto shares = [&](uint32_t lhs, uint32_t rhs) {
+            const auto& a = passes[step.passes[lhs]];
+            const auto& b = passes[step.passes[rhs]];
+            if (a.depth != npos && a.depth == b.depth)
+                return true;
+            for (auto c : a.colors)
+                if (find(b.colors.begin(), b.colors.end(), c) != b.colors.end())
+                    return true;
+            return false;
+        };
+        for (auto dst = 1u; dst < count; ++dst)
+            for (auto src = 0u; src < dst; ++src) {
+                if (shares(src, dst) == false)
+                    continue;
+                VkSubpassDependency dependency{};
+                dependency.srcSubpass = src;
+                dependency.dstSubpass = dst;
+                dependency.srcStageMask = dependency.dstStageMask = attachment_stages;
+                dependency.srcAccessMask =
+                    VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+                dependency.dstAccessMask =
+                    VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+                dependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+                dependencies.emplace_back(dependency);
+            }
+        {
+            VkRenderPassCreateInfo info{};
+            info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+            info.attachmentCount = static_cast<uint32_t>(descriptions.size());
+            info.pAttachments = descriptions.data();
+            info.subpassCount = static_cast<uint32_t>(subpasses.size());
+            info.pSubpasses = subpasses.data();
+            info.dependencyCount = static_cast<uint32_t>(dependencies.size());
+            info.pDependencies = dependencies.data();
+            if (auto ec = vkCreateRenderPass(device, &info, nullptr, &step.renderpass))
+                return ec;
+        }
+        VkFramebufferCreateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        info.renderPass = step.renderpass;
+        info.attachmentCount = static_cast<uint32_t>(views.size());
+        info.pAttachments = views.data();
+        info.width = step.extent.width;
+        info.height = step.extent.height;
+        info.layers = 1;
+        return vkCreateFramebuffer(device, &info, nullptr, &step.framebuffer);
+    } catch (const std::bad_alloc&) {
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+}
+
+VkResult vulkan_render_graph_t::compile() noexcept {
+    TRACE_SCOPE("vulkan_render_graph_t::compile");
+    release();
+    for (const auto& pass : passes) {
+        auto valid = [this](uint32_t i) { return i < images.size(); };
+        if (all_of(pass.colors.begin(), pass.colors.end(), valid) == false ||
+            all_of(pass.samples.begin(), pass.samples.end(), valid) == false ||
+            (pass.depth != npos && valid(pass.depth) == false))
+            return VK_ERROR_INITIALIZATION_FAILED;
+        for (const auto& use : pass.buffers)
+            if (use.buffer >= buffers.size())
+                return VK_ERROR_INITIALIZATION_FAILED;
+        if (has_attachment(pass) == false)
+            continue;
+        const auto extent = images[pass.colors.empty() ? pass.depth : pass.colors[0]].extent;
+        auto same = [this, extent](uint32_t i) {
+            return images[i].extent.width == extent.width && images[i].extent.height == extent.height;
+        };
+        if (all_of(pass.colors.begin(), pass.colors.end(), same) == false ||
+            (pass.depth != npos && same(pass.depth) == false))
+            return VK_ERROR_INITIALIZATION_FAILED;
+    }
+    try {
+        cull();
+        merge();
+    } catch (const std::bad_alloc&) {
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+    if (auto ec = make_images())
+        return ec;
+    try {
+        make_barriers();
+    } catch (const std::bad_alloc&) {
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+    for (auto i = 0u; i < steps.size(); ++i) {
+        if (steps[i].passes.empty() || has_attachment(passes[steps[i].passes[0]]) == false)
+            continue;
+        if (auto ec = make_renderpass(i))
+            return ec;
+    }
+    return VK_SUCCESS;
+}
+
+void vulkan_render_graph_t::execute(VkCommandBuffer command_buffer) const noexcept(false) {
+    for (const auto& step : steps) {
+        if (step.image_barriers.size() || step.buffer_barriers.size())
+            vkCmdPipelineBarrier(command_buffer, step.src_stage, step.dst_stage, 0, 0, nullptr,
+                                 static_cast<uint32_t>(step.buffer_barriers.size()), step.buffer_barriers.data(),
+                                 static_cast<uint32_t>(step.image_barriers.size()), step.image_barriers.data());
+        if (step.renderpass == VK_NULL_HANDLE) {
+            for (auto p : step.passes)
+                if (passes[p].record)
+                    passes[p].record(command_buffer);
+            continue;
+        }
+        VkRenderPassBeginInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        info.renderPass = step.renderpass;
+        info.framebuffer = step.framebuffer;
+        info.renderArea.extent = step.extent;
+        info.clearValueCount = static_cast<uint32_t>(step.clears.size());
+        info.pClearValues = step.clears.data();
+        vkCmdBeginRenderPass(command_buffer, &info, VK_SUBPASS_CONTENTS_INLINE);
+        for (auto k = 0u; k < step.passes.size(); ++k) {
+            if (k)
+                vkCmdNextSubpass(command_buffer, VK_SUBPASS_CONTENTS_INLINE);
+            if (const auto& pass = passes[step.passes[k]]; pass.record)
+                pass.record(command_buffer);
+        }
+        vkCmdEndRenderPass(command_buffer);
+    }
+}
+
+VkResult vulkan_render_graph_t::get_renderpass(uint32_t pass, VkRenderPass& renderpass,
+                                               uint32_t& subpass) const noexcept {
+    if (pass >= passes.size() || passes[pass].step == npos)
+        return VK_ERROR_INITIALIZATION_FAILED;
+    const auto& step = steps[passes[pass].step];
+    if (step.renderpass == VK_NULL_HANDLE)
+        return VK_ERROR_INITIALIZATION_FAILED;
+    renderpass = step.renderpass;
+    subpass = passes[pass].subpass;
+    return VK_SUCCESS;
+}
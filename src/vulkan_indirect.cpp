@@ -0,0 +1,228 @@
+/**
+ * @author Park DongHa (luncliff@gmail.com)
+ * @see https://www.khronos.org/registry/vulkan/specs/1.2-extensions/man/html/vkCmdDrawIndexedIndirectCount.html
+ */
+#include "vulkan_1.h"
+#include "trace.h"
+
+#include <cstring>
+
+using namespace std;
+
+static_assert(sizeof(draw_indexed_command_t) == sizeof(VkDrawIndexedIndirectCommand));
+static_assert(sizeof(draw_object_t) == 32, "std430 layout of the shader's object_t");
+
+/// @note the push constants. 100 bytes, in the guaranteed 128
+struct cull_constants_t final {
+    float planes[6][4];
+    uint32_t object_count;
+};
+
+static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment) noexcept {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+vulkan_indirect_culler_t::vulkan_indirect_culler_t(VkDevice _device, const VkPhysicalDeviceMemoryProperties& props,
+                                                   const fs::path& shader_dir, uint32_t num_frames,
+                                                   uint32_t _capacity, bool _draw_indirect_count) noexcept(false)
+    : device{_device}, draw_indirect_count{_draw_indirect_count}, capacity{_capacity},
+      // throws if the `capacity` is 0
+      objects{device, props, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, sizeof(draw_object_t) * _capacity, num_frames} {
+    TRACE_SCOPE("vulkan_indirect_culler_t");
+    try {
+        create(props, shader_dir);
+    } catch (...) {
+        destroy();
+        throw;
+    }
+}
+
+void vulkan_indirect_culler_t::create(const VkPhysicalDeviceMemoryProperties& props,
+                                      const fs::path& shader_dir) noexcept(false) {
+    // 2 buffers in 1 allocation. TRANSFER_SRC is for the readback of the results
+    VkBufferCreateInfo infos[2]{};
+    VkBuffer* buffers[2]{&draws, &counter};
+    infos[0].size = sizeof(draw_indexed_command_t) * capacity;
+    infos[1].size = sizeof(uint32_t);
+    infos[1].usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    VkDeviceSize memory_size = 0;
+    VkDeviceSize memory_offsets[2]{};
+    uint32_t type_bits = UINT32_MAX;
+    for (auto i : {0, 1}) {
+        infos[i].sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        infos[i].usage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                          VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        infos[i].sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        if (auto ec = vkCreateBuffer(device, infos + i, nullptr, buffers[i]))
+            throw vulkan_exception_t{ec, "vkCreateBuffer"};
+        VkMemoryRequirements requirements{};
+        vkGetBufferMemoryRequirements(device, *buffers[i], &requirements);
+        memory_offsets[i] = align_up(memory_size, requirements.alignment);
+        memory_size = memory_offsets[i] + requirements.size;
+        type_bits &= requirements.memoryTypeBits;
+    }
+    {
+        VkMemoryAllocateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        info.allocationSize = memory_size;
+        info.memoryTypeIndex = get_memory_type(props, type_bits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        if (info.memoryTypeIndex == UINT32_MAX)
+            throw vulkan_exception_t{VK_ERROR_FEATURE_NOT_PRESENT, "vkAllocateMemory"};
+        if (auto ec = vkAllocateMemory(device, &info, nullptr, &memory))
+            throw vulkan_exception_t{ec, "vkAllocateMemory"};
+    }
+    for (auto i : {0, 1})
+        if (auto ec = vkBindBufferMemory(device, *buffers[i], memory, memory_offsets[i]))
+            throw vulkan_exception_t{ec, "vkBindBufferMemory"};
+
+    // objects, draws, counter. the slot of the objects is the dynamic offset
+    const VkDescriptorType types[3]{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                    VK_DESCRIPTOR_TYPE_STORAGE_BUFFER};
+    VkDescriptorSetLayoutBinding bindings[3]{};
+    for (auto i = 0u; i < 3; ++i) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = types[i];
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    {
+        VkDescriptorSetLayoutCreateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        info.bindingCount = 3;
+        info.pBindings = bindings;
+        if (auto ec = vkCreateDescriptorSetLayout(device, &info, nullptr, &set_layout))
+            throw vulkan_exception_t{ec, "vkCreateDescriptorSetLayout"};
+    }
+    {
+        VkDescriptorPoolSize sizes[2]{};
+        sizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+        sizes[0].descriptorCount = 1;
+        sizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        sizes[1].descriptorCount = 2;
+        VkDescriptorPoolCreateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        info.maxSets = 1;
+        info.poolSizeCount = 2;
+        info.pPoolSizes = sizes;
+        if (auto ec = vkCreateDescriptorPool(device, &info, nullptr, &pool))
+            throw vulkan_exception_t{ec, "vkCreateDescriptorPool"};
+    }
+    {
+        VkDescriptorSetAllocateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        info.descriptorPool = pool;
+        info.descriptorSetCount = 1;
+        info.pSetLayouts = &set_layout;
+        if (auto ec = vkAllocateDescriptorSets(device, &info, &set))
+            throw vulkan_exception_t{ec, "vkAllocateDescriptorSets"};
+    }
+    // the buffers are never replaced. 1 update for the lifetime
+    VkDescriptorBufferInfo buffer_infos[3]{};
+    VkWriteDescriptorSet writes[3]{};
+    const VkBuffer targets[3]{objects.handle, draws, counter};
+    for (auto i = 0u; i < 3; ++i) {
+        buffer_infos[i].buffer = targets[i];
+        buffer_infos[i].range = VK_WHOLE_SIZE;
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = set;
+        writes[i].dstBinding = i;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = types[i];
+        writes[i].pBufferInfo = buffer_infos + i;
+    }
+    buffer_infos[0].range = objects.slot_size;
+    vkUpdateDescriptorSets(device, 3, writes, 0, nullptr);
+
+    {
+        VkPushConstantRange range{};
+        range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        range.size = sizeof(cull_constants_t);
+        VkPipelineLayoutCreateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        info.setLayoutCount = 1;
+        info.pSetLayouts = &set_layout;
+        info.pushConstantRangeCount = 1;
+        info.pPushConstantRanges = &range;
+        if (auto ec = vkCreatePipelineLayout(device, &info, nullptr, &layout))
+            throw vulkan_exception_t{ec, "vkCreatePipelineLayout"};
+    }
+    vulkan_shader_module_t shader{device, shader_dir / "cull_comp.spv"};
+    vulkan_specialization_t specialization{};
+    specialization.set(0, static_cast<uint32_t>(draw_indirect_count ? VK_TRUE : VK_FALSE));
+    VkComputePipelineCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    info.stage.module = shader.handle;
+    info.stage.pName = "main";
+    info.stage.pSpecializationInfo = specialization.get();
+    info.layout = layout;
+    if (auto ec = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &info, nullptr, &pipeline))
+        throw vulkan_exception_t{ec, "vkCreateComputePipelines"};
+}
+
+vulkan_indirect_culler_t::~vulkan_indirect_culler_t() noexcept {
+    destroy();
+}
+
+void vulkan_indirect_culler_t::destroy() noexcept {
+    vkDestroyPipeline(device, pipeline, nullptr);
+    vkDestroyPipelineLayout(device, layout, nullptr);
+    vkDestroyDescriptorPool(device, pool, nullptr); // the `set` is freed with the pool
+    vkDestroyDescriptorSetLayout(device, set_layout, nullptr);
+    vkDestroyBuffer(device, counter, nullptr);
+    vkDestroyBuffer(device, draws, nullptr);
+    vkFreeMemory(device, memory, nullptr);
+    pipeline = VK_NULL_HANDLE;
+    layout = VK_NULL_HANDLE;
+    pool = VK_NULL_HANDLE;
+    set = VK_NULL_HANDLE;
+    set_layout = VK_NULL_HANDLE;
+    counter = draws = VK_NULL_HANDLE;
+    memory = VK_NULL_HANDLE;
+}
+
+VkResult vulkan_indirect_culler_t::update(uint32_t _frame, gsl::span<const draw_object_t> items) noexcept {
+    if (items.size() > capacity)
+        return VK_ERROR_TOO_MANY_OBJECTS;
+    frame = _frame % objects.num_frames;
+    memcpy(objects.get_slot(frame).data(), items.data(), items.size_bytes());
+    count = static_cast<uint32_t>(items.size());
+    return VK_SUCCESS;
+}
+
+void vulkan_indirect_culler_t::record(VkCommandBuffer commands, const frustum_t& frustum) const noexcept {
+    // the indirect reads of the previous frame before the fill
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(commands, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1,
+                         &barrier, 0, nullptr, 0, nullptr);
+    vkCmdFillBuffer(commands, counter, 0, sizeof(uint32_t), 0);
+    // the fill, and the indirect reads of the previous frame before the shader writes
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commands, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    cull_constants_t constants{};
+    memcpy(constants.planes, frustum.planes, sizeof(constants.planes));
+    constants.object_count = count;
+    vkCmdBindPipeline(commands, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    const auto offset = static_cast<uint32_t>(objects.get_offset(frame));
+    vkCmdBindDescriptorSets(commands, VK_PIPELINE_BIND_POINT_COMPUTE, layout, 0, 1, &set, 1, &offset);
+    vkCmdPushConstants(commands, layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+    vkCmdDispatch(commands, (count + 63) / 64, 1, 1);
+
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    vkCmdPipelineBarrier(commands, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1,
+                         &barrier, 0, nullptr, 0, nullptr);
+}
+
+void vulkan_indirect_culler_t::draw(VkCommandBuffer commands) const noexcept {
+    if (draw_indirect_count)
+        return vkCmdDrawIndexedIndirectCount(commands, draws, 0, counter, 0, count, sizeof(draw_indexed_command_t));
+    // the culled ones are in the buffer with 0 instance
+    vkCmdDrawIndexedIndirect(commands, draws, 0, count, sizeof(draw_indexed_command_t));
+}
@@ -0,0 +1,217 @@
+/**
+ * @author Park DongHa (luncliff@gmail.com)
+ * @see https://vulkan-tutorial.com/Vertex_buffers/Staging_buffer
+ */
+#include "vulkan_1.h"
+#include "trace.h"
+
+#include <cstring>
+
+using namespace std;
+
+static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment) noexcept {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static VkFormat get_vulkan_format(packed_scene_t::uv_format_t format) noexcept {
+    switch (format) {
+    case packed_scene_t::uv_format_t::unorm16:
+        return VK_FORMAT_R16G16_UNORM;
+    case packed_scene_t::uv_format_t::float16:
+        return VK_FORMAT_R16G16_SFLOAT;
+    default:
+        return VK_FORMAT_R32G32_SFLOAT;
+    }
+}
+
+vulkan_mesh_batch_t::vulkan_mesh_batch_t(VkDevice _device, const VkPhysicalDeviceMemoryProperties& props,
+                                         const packed_scene_t& scene) noexcept(false)
+    : device{_device}, vertex_size{scene.vertices.size()}, index_size{scene.indices.size()} {
+    TRACE_SCOPE("vulkan_mesh_batch_t");
+    try {
+        auto mapping = create(scene, props);
+        memcpy(mapping, scene.vertices.data(), vertex_size);
+        memcpy(mapping + align_up(vertex_size, 4), scene.indices.data(), index_size);
+        vkUnmapMemory(device, staging_memory);
+    } catch (...) {
+        // the destructor won't run. `create` may have made some of them
+        destroy();
+        throw;
+    }
+}
+
+vulkan_mesh_batch_t::vulkan_mesh_batch_t(VkDevice _device, const VkPhysicalDeviceMemoryProperties& props,
+                                         const mesh_packer_t& packer) noexcept(false)
+    : device{_device} {
+    TRACE_SCOPE("vulkan_mesh_batch_t");
+    packed_scene_t scene{};
+    if (packer.layout(scene))
+        throw vulkan_exception_t{VK_ERROR_INITIALIZATION_FAILED, "mesh_packer_t::layout"};
+    vertex_size = scene.get_vertex_bytes();
+    index_size = scene.get_index_bytes();
+    try {
+        auto mapping = create(scene, props);
+        const auto ec = packer.write(scene, gsl::make_span(mapping, vertex_size),
+                                     gsl::make_span(mapping + align_up(vertex_size, 4), index_size));
+        vkUnmapMemory(device, staging_memory);
+        // ex) out of range index in the file
+        if (ec)
+            throw vulkan_exception_t{VK_ERROR_INITIALIZATION_FAILED, "mesh_packer_t::write"};
+    } catch (...) {
+        destroy();
+        throw;
+    }
+}
+
+std::byte* vulkan_mesh_batch_t::create(const packed_scene_t& scene,
+                                       const VkPhysicalDeviceMemoryProperties& props) noexcept(false) {
+    index_type = scene.index_size == 4 ? VK_INDEX_TYPE_UINT32 : VK_INDEX_TYPE_UINT16;
+    stride = scene.stride;
+    uv_offset = scene.uv_offset;
+    uv_format = get_vulkan_format(scene.uv_format);
+    ranges = scene.ranges;
+    if (vertex_size == 0 || index_size == 0)
+        throw vulkan_exception_t{VK_ERROR_INITIALIZATION_FAILED, "vulkan_mesh_batch_t"};
+    // the vertices, then the indices. copy offsets must be 4 byte aligned
+    const auto index_offset = align_up(vertex_size, 4);
+    {
+        VkBufferCreateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        info.size = index_offset + index_size;
+        info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        if (auto ec = vkCreateBuffer(device, &info, nullptr, &staging))
+            throw vulkan_exception_t{ec, "vkCreateBuffer"};
+        if (auto ec = allocate_memory(device, staging, staging_memory, info,
+                                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                      props))
+            throw vulkan_exception_t{ec, "vkAllocateMemory"};
+        if (auto ec = vkBindBufferMemory(device, staging, staging_memory, 0))
+            throw vulkan_exception_t{ec, "vkBindBufferMemory"};
+    }
+    // 2 buffers in 1 allocation
+    VkBufferCreateInfo infos[2]{};
+    VkBuffer* buffers[2]{&vertices, &indices};
+    infos[0].size = vertex_size;
+    infos[0].usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+    infos[1].size = index_size;
+    infos[1].usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+    VkDeviceSize memory_size = 0;
+    VkDeviceSize memory_offsets[2]{};
+    uint32_t type_bits = UINT32_MAX;
+    for (auto i : {0, 1}) {
+        infos[i].sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        infos[i].sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        if (auto ec = vkCreateBuffer(device, infos + i, nullptr, buffers[i]))
+            throw vulkan_exception_t{ec, "vkCreateBuffer"};
+        VkMemoryRequirements requirements{};
+        vkGetBufferMemoryRequirements(device, *buffers[i], &requirements);
+        memory_offsets[i] = align_up(memory_size, requirements.alignment);
+        memory_size = memory_offsets[i] + requirements.size;
+        type_bits &= requirements.memoryTypeBits;
+    }
+    {
+        VkMemoryAllocateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        info.allocationSize = memory_size;
+        info.memoryTypeIndex = get_memory_type(props, type_bits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        if (info.memoryTypeIndex == UINT32_MAX)
+            throw vulkan_exception_t{VK_ERROR_FEATURE_NOT_PRESENT, "vkAllocateMemory"};
+        if (auto ec = vkAllocateMemory(device, &info, nullptr, &memory))
+            throw vulkan_exception_t{ec, "vkAllocateMemory"};
+    }
+    for (auto i : {0, 1})
+        if (auto ec = vkBindBufferMemory(device, *buffers[i], memory, memory_offsets[i]))
+            throw vulkan_exception_t{ec, "vkBindBufferMemory"};
+    void* mapping = nullptr;
+    if (auto ec = vkMapMemory(device, staging_memory, 0, VK_WHOLE_SIZE, 0, &mapping))
+        throw vulkan_exception_t{ec, "vkMapMemory"};
+    return static_cast<std::byte*>(mapping);
+}
+
+vulkan_mesh_batch_t::~vulkan_mesh_batch_t() noexcept {
+    destroy();
+}
+
+void vulkan_mesh_batch_t::destroy() noexcept {
+    release_staging();
+    vkDestroyBuffer(device, indices, nullptr);
+    vkDestroyBuffer(device, vertices, nullptr);
+    vkFreeMemory(device, memory, nullptr);
+    indices = vertices = VK_NULL_HANDLE;
+    memory = VK_NULL_HANDLE;
+}
+
+void vulkan_mesh_batch_t::release_staging() noexcept {
+    vkDestroyBuffer(device, staging, nullptr);
+    vkFreeMemory(device, staging_memory, nullptr);
+    staging = VK_NULL_HANDLE;
+    staging_memory = VK_NULL_HANDLE;
+}
+
+void vulkan_mesh_batch_t::record(VkCommandBuffer commands) const noexcept {
+    VkBufferCopy regions[2]{};
+    regions[0].size = vertex_size;
+    regions[1].srcOffset = align_up(vertex_size, 4);
+    regions[1].size = index_size;
+    vkCmdCopyBuffer(commands, staging, vertices, 1, regions + 0);
+    vkCmdCopyBuffer(commands, staging, indices, 1, regions + 1);
+    VkBufferMemoryBarrier barriers[2]{};
+    for (auto& barrier : barriers) {
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.srcQueueFamilyIndex = barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.size = VK_WHOLE_SIZE;
+    }
+    barriers[0].dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+    barriers[0].buffer = vertices;
+    barriers[1].dstAccessMask = VK_ACCESS_INDEX_READ_BIT;
+    barriers[1].buffer = indices;
+    vkCmdPipelineBarrier(commands, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, //
+                         0, nullptr, 2, barriers, 0, nullptr);
+}
+
+void vulkan_mesh_batch_t::setup_vertex_input_state(VkVertexInputBindingDescription& binding,
+                                                   VkVertexInputAttributeDescription (&attrs)[3],
+                                                   VkPipelineVertexInputStateCreateInfo& info) const noexcept {
+    binding.binding = 0;
+    binding.stride = stride;
+    binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    // layout(location = 0) in vec3 i_position;
+    attrs[0].binding = 0;
+    attrs[0].location = 0;
+    attrs[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+    attrs[0].offset = 0;
+    // layout(location = 1) in vec3 i_normal;
+    attrs[1].binding = 0;
+    attrs[1].location = 1;
+    attrs[1].format = VK_FORMAT_R16G16B16A16_SNORM;
+    attrs[1].offset = 12;
+    // layout(location = 2) in vec2 i_uv;
+    attrs[2].binding = 0;
+    attrs[2].location = 2;
+    attrs[2].format = uv_format;
+    attrs[2].offset = uv_offset;
+    info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    info.vertexBindingDescriptionCount = 1;
+    info.pVertexBindingDescriptions = &binding;
+    info.vertexAttributeDescriptionCount = 3;
+    info.pVertexAttributeDescriptions = attrs;
+}
+
+void vulkan_mesh_batch_t::bind(VkCommandBuffer commands) const noexcept {
+    const VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(commands, 0, 1, &vertices, &offset);
+    vkCmdBindIndexBuffer(commands, indices, 0, index_type);
+}
+
+void vulkan_mesh_batch_t::draw(VkCommandBuffer commands, const packed_scene_t::draw_range_t& range,
+                               uint32_t instance_count, uint32_t first_instance) const noexcept {
+    vkCmdDrawIndexed(commands, range.index_count, instance_count, range.first_index, range.vertex_offset,
+                     first_instance);
+}
+
+void vulkan_mesh_batch_t::draw(VkCommandBuffer commands, gsl::span<const draw_indexed_command_t> draws) const noexcept {
+    for (const auto& d : draws)
+        vkCmdDrawIndexed(commands, d.index_count, d.instance_count, d.first_index, d.vertex_offset, d.first_instance);
+}
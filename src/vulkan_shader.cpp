@@ -0,0 +1,267 @@
+/**
+ * @author Park DongHa (luncliff@gmail.com)
+ * @see https://github.com/google/shaderc/tree/main/libshaderc
+ */
+#include "vulkan_1.h"
+#include "trace.h"
+
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <shaderc/shaderc.hpp>
+#include <spdlog/spdlog.h>
+
+using namespace std;
+
+#if !defined(SHADERC_BUILD_ID)
+#define SHADERC_BUILD_ID "unknown" // CMakeLists.txt defines the SHA1 of the linked shaderc library
+#endif
+
+static shaderc_shader_kind get_shader_kind(VkShaderStageFlagBits stage) noexcept {
+    switch (stage) {
+    case VK_SHADER_STAGE_VERTEX_BIT:
+        return shaderc_glsl_vertex_shader;
+    case VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT:
+        return shaderc_glsl_tess_control_shader;
+    case VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT:
+        return shaderc_glsl_tess_evaluation_shader;
+    case VK_SHADER_STAGE_GEOMETRY_BIT:
+        return shaderc_glsl_geometry_shader;
+    case VK_SHADER_STAGE_FRAGMENT_BIT:
+        return shaderc_glsl_fragment_shader;
+    case VK_SHADER_STAGE_COMPUTE_BIT:
+        return shaderc_glsl_compute_shader;
+    default:
+        // let the compiler find `#pragma shader_stage(...)` in the source
+        return shaderc_glsl_infer_from_source;
+    }
+}
+
+// the SPIR-V from the other target or the other shaderc build must not be loaded from the cache
+constexpr auto target_env = shaderc_target_env_vulkan;
+constexpr auto target_env_version = shaderc_env_version_vulkan_1_2;
+
+static uint64_t hash_string(std::string_view text, uint64_t seed) noexcept {
+    // the length separates "ab"+"c" from "a"+"bc"
+    const uint64_t length = text.length();
+    seed = hash_content(gsl::as_bytes(gsl::make_span(&length, 1)), seed);
+    return hash_content(gsl::as_bytes(gsl::make_span(text.data(), text.size())), seed);
+}
+
+static fs::path get_spv_path(const fs::path& directory, uint64_t key) noexcept(false) {
+    char name[32]{};
+    snprintf(name, sizeof(name), "%016llx.spv", static_cast<unsigned long long>(key));
+    return directory / name;
+}
+
+struct vulkan_shader_compiler_t::impl_t final {
+    struct entry_t final {
+        bool done = false;
+        uint32_t status = 0;
+        vector<uint32_t> code{};
+        string message{};
+    };
+    struct job_t final {
+        uint64_t key;
+        request_t request;
+    };
+
+    const fs::path directory;
+    mutex mtx{};
+    condition_variable jobs_cv{};
+    condition_variable done_cv{};
+    deque<job_t> jobs{};
+    unordered_map<uint64_t, entry_t> entries{};
+    vector<thread> workers{};
+    bool stop = false;
+
+  public:
+    explicit impl_t(const fs::path& _directory) noexcept(false) : directory{_directory} {
+    }
+
+    void compile(const job_t& job, shaderc::Compiler& compiler, entry_t& result) noexcept(false) {
+        const auto& request = job.request;
+        shaderc::CompileOptions options{};
+        options.SetTargetEnvironment(target_env, target_env_version);
+        options.SetOptimizationLevel(request.optimize ? shaderc_optimization_level_performance
+                                                      : shaderc_optimization_level_zero);
+        for (const auto& [name, value] : request.defines)
+            options.AddMacroDefinition(name, value);
+        const auto output = compiler.CompileGlslToSpv(request.source, get_shader_kind(request.stage), //
+                                                      request.name.c_str(), options);
+        if (output.GetCompilationStatus() != shaderc_compilation_status_success) {
+            result.status = EINVAL;
+            result.message = output.GetErrorMessage();
+            return;
+        }
+        result.code.assign(output.cbegin(), output.cend());
+        if (directory.empty())
+            return;
+        // `load` must not see the partial file. one job for each key, so there is no other writer of the .tmp
+        const auto fpath = get_spv_path(directory, job.key);
+        if (auto ec = write_and_rename(fpath, {gsl::as_bytes(gsl::make_span(result.code))}))
+            spdlog::warn("{}: {} {}", "write_and_rename", fpath.string(), ec);
+    }
+
+    /// @brief Compile until `stop`. The remaining jobs are done before the return
+    void run() noexcept {
+        shaderc::Compiler compiler{};
+        for (;;) {
+            job_t job{};
+            {
+                unique_lock lck{mtx};
+                jobs_cv.wait(lck, [this]() { return stop || jobs.empty() == false; });
+                if (jobs.empty())
+                    break;
+                job = move(jobs.front());
+                jobs.pop_front();
+            }
+            entry_t result{};
+            try {
+                TRACE_SCOPE("compile_glsl");
+                compile(job, compiler, result);
+            } catch (const system_error& ex) {
+                result.status = ex.code().value();
+                result.message = ex.what();
+            } catch (const bad_alloc&) {
+                result.status = ENOMEM;
+            }
+            result.done = true;
+            {
+                lock_guard lck{mtx};
+                entries[job.key] = move(result);
+            }
+            done_cv.notify_all();
+        }
+    }
+
+    /// @brief Load `{key}.spv` written by the previous run
+    bool load(uint64_t key, entry_t& entry) noexcept {
+        if (directory.empty())
+            return false;
+        const auto fpath = get_spv_path(directory, key);
+        std::error_code ec{};
+        if (fs::exists(fpath, ec) == false)
+            return false;
+        try {
+            size_t length = 0;
+            const auto blob = read_all(fpath, length);
+            // SPIR-V magic number. (ex: truncated file)
+            if (length < 5 * sizeof(uint32_t) || length % sizeof(uint32_t) ||
+                reinterpret_cast<const uint32_t*>(blob.get())[0] != 0x07230203)
+                return false;
+            entry.code.resize(length / sizeof(uint32_t));
+            memcpy(entry.code.data(), blob.get(), length);
+        } catch (const system_error&) {
+            return false;
+        }
+        entry.done = true;
+        return true;
+    }
+};
+
+vulkan_shader_compiler_t::vulkan_shader_compiler_t(const fs::path& _directory, uint32_t num_workers) noexcept(false)
+    : impl{make_unique<impl_t>(_directory)}, directory{_directory} {
+    if (directory.empty() == false)
+        fs::create_directories(directory);
+    if (num_workers == 0)
+        num_workers = max(thread::hardware_concurrency(), 1u);
+    try {
+        for (auto i = 0u; i < num_workers; ++i)
+            impl->workers.emplace_back(&impl_t::run, impl.get());
+    } catch (const system_error&) {
+        // the started workers must be joined before the `impl` is destroyed
+        {
+            lock_guard lck{impl->mtx};
+            impl->stop = true;
+        }
+        impl->jobs_cv.notify_all();
+        for (auto& worker : impl->workers)
+            worker.join();
+        throw;
+    }
+}
+
+vulkan_shader_compiler_t::~vulkan_shader_compiler_t() noexcept {
+    {
+        lock_guard lck{impl->mtx};
+        impl->stop = true;
+    }
+    impl->jobs_cv.notify_all();
+    for (auto& worker : impl->workers)
+        worker.join();
+}
+
+uint64_t vulkan_shader_compiler_t::make_key(const request_t& request) noexcept {
+    const uint32_t options[4]{static_cast<uint32_t>(request.stage), request.optimize,
+                              static_cast<uint32_t>(target_env), static_cast<uint32_t>(target_env_version)};
+    auto key = hash_string(SHADERC_BUILD_ID, hash_content(gsl::as_bytes(gsl::make_span(options, 4))));
+    for (const auto& [name, value] : request.defines)
+        key = hash_string(value, hash_string(name, key));
+    return hash_string(request.source, key);
+}
+
+fs::path vulkan_shader_compiler_t::get_path(uint64_t key) const noexcept(false) {
+    return get_spv_path(directory, key);
+}
+
+void vulkan_shader_compiler_t::submit(const request_t& request, uint64_t& key) noexcept(false) {
+    key = make_key(request);
+    {
+        lock_guard lck{impl->mtx};
+        if (impl->entries.find(key) != impl->entries.end()) {
+            ++hit;
+            return;
+        }
+        // the other `submit` of the key will wait for this one
+        impl->entries.emplace(key, impl_t::entry_t{});
+    }
+    impl_t::entry_t entry{};
+    const auto loaded = impl->load(key, entry);
+    {
+        lock_guard lck{impl->mtx};
+        if (loaded) {
+            ++hit;
+            impl->entries[key] = move(entry);
+        } else {
+            try {
+                impl->jobs.emplace_back(impl_t::job_t{key, request});
+            } catch (...) {
+                impl->entries.erase(key);
+                throw;
+            }
+            ++miss;
+        }
+    }
+    if (loaded)
+        return impl->done_cv.notify_all();
+    impl->jobs_cv.notify_one();
+}
+
+bool vulkan_shader_compiler_t::is_completed(uint64_t key) const noexcept {
+    lock_guard lck{impl->mtx};
+    auto it = impl->entries.find(key);
+    return it != impl->entries.end() && it->second.done;
+}
+
+uint32_t vulkan_shader_compiler_t::get(uint64_t key, std::vector<uint32_t>& code,
+                                       std::string& message) noexcept(false) {
+    unique_lock lck{impl->mtx};
+    auto it = impl->entries.find(key);
+    if (it == impl->entries.end())
+        return ENOENT;
+    // the entries are never erased. the reference is stable while waiting
+    const auto& entry = it->second;
+    impl->done_cv.wait(lck, [&entry]() { return entry.done; });
+    code = entry.code;
+    message = entry.message;
+    return entry.status;
+}
+
+uint32_t vulkan_shader_compiler_t::compile(const request_t& request, std::vector<uint32_t>& code,
+                                           std::string& message) noexcept(false) {
+    uint64_t key = 0;
+    submit(request, key);
+    return get(key, code, message);
+}
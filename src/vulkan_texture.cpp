@@ -0,0 +1,341 @@
+/**
+ * @author Park DongHa (luncliff@gmail.com)
+ * @see https://www.khronos.org/registry/vulkan/specs/1.2-extensions/html/vkspec.html#copies-buffers-images
+ */
+#include "vulkan_1.h"
+#include "trace.h"
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @brief Run `fn(i)` for [0, count) with `num_workers` threads including the caller
+ * @details If a thread can't be started, the started ones and the caller do the rest.
+ *          The first exception from `fn` stops the others and is thrown after they are joined
+ */
+template <typename Fn>
+static void parallel_for(size_t count, uint32_t num_workers, Fn&& fn) noexcept(false) {
+    atomic<size_t> next{0};
+    mutex mtx{};
+    exception_ptr failure{};
+    auto run = [&next, &fn, &mtx, &failure, count]() noexcept {
+        try {
+            for (auto i = next++; i < count; i = next++)
+                fn(i);
+        } catch (...) {
+            next = count;
+            lock_guard lck{mtx};
+            if (failure == nullptr)
+                failure = current_exception();
+        }
+    };
+    vector<thread> workers{};
+    try {
+        for (auto w = 1u; w < num_workers && w < count; ++w)
+            workers.emplace_back(run);
+    } catch (const system_error&) {
+        // continue with the threads already started
+    }
+    run();
+    for (auto& w : workers)
+        w.join();
+    if (failure)
+        rethrow_exception(failure);
+}
+
+uint32_t get_memory_type(const VkPhysicalDeviceMemoryProperties& props, uint32_t type_bits,
+                         VkMemoryPropertyFlags desired) noexcept {
+    for (auto i = 0u; i < props.memoryTypeCount; ++i)
+        if ((type_bits & (1u << i)) && (props.memoryTypes[i].propertyFlags & desired) == desired)
+            return i;
+    return UINT32_MAX;
+}
+
+static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment) noexcept {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+VkFormat get_vulkan_format(block_format_t format) noexcept {
+    switch (format) {
+    case block_format_t::etc2_rgba8:
+        return VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK;
+    case block_format_t::bc3:
+        return VK_FORMAT_BC3_UNORM_BLOCK;
+    default:
+        return VK_FORMAT_R8G8B8A8_UNORM;
+    }
+}
+
+block_format_t select_block_format(VkPhysicalDevice physical_device) noexcept {
+    // `vulkan_texture_batch_t` images are always TRANSFER_SRC too
+    constexpr VkFormatFeatureFlags required =
+        VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT | VK_FORMAT_FEATURE_TRANSFER_SRC_BIT;
+    for (auto format : {block_format_t::bc3, block_format_t::etc2_rgba8}) {
+        VkFormatProperties props{};
+        vkGetPhysicalDeviceFormatProperties(physical_device, get_vulkan_format(format), &props);
+        if ((props.optimalTilingFeatures & required) == required)
+            return format;
+    }
+    return block_format_t::rgba8;
+}
+
+vulkan_texture_batch_t::vulkan_texture_batch_t(VkDevice _device, const VkPhysicalDeviceMemoryProperties& props,
+                                               gsl::span<const fs::path> files, const image_codec_t& codec,
+                                               uint32_t num_workers, bool mipmap) noexcept(false)
+    : device{_device}, textures(files.size()) {
+    TRACE_SCOPE("vulkan_texture_batch_t");
+    if (num_workers == 0)
+        num_workers = max(thread::hardware_concurrency(), 1u);
+    try {
+        create(props, files, codec, num_workers, mipmap);
+    } catch (...) {
+        destroy();
+        throw;
+    }
+}
+
+vulkan_texture_batch_t::vulkan_texture_batch_t(VkDevice _device, const VkPhysicalDeviceMemoryProperties& props,
+                                               gsl::span<const fs::path> files, const image_codec_t& codec,
+                                               block_format_t blocks, block_cache_t& cache,
+                                               uint32_t num_workers) noexcept(false)
+    : device{_device}, format{get_vulkan_format(blocks)}, textures(files.size()) {
+    TRACE_SCOPE("vulkan_texture_batch_t");
+    if (num_workers == 0)
+        num_workers = max(thread::hardware_concurrency(), 1u);
+    try {
+        create(props, files, codec, blocks, cache, num_workers);
+    } catch (...) {
+        destroy();
+        throw;
+    }
+}
+
+void vulkan_texture_batch_t::create(const VkPhysicalDeviceMemoryProperties& props, gsl::span<const fs::path> files,
+                                    const image_codec_t& codec, uint32_t num_workers, bool mipmap) noexcept(false) {
+    // the views are kept until the decoding is done
+    vector<unique_ptr<mapped_file_t>> encoded(files.size());
+    parallel_for(files.size(), num_workers, [&](size_t i) {
+        auto& tex = textures[i];
+        encoded[i] = make_unique<mapped_file_t>(files[i]);
+        if (tex.ec = encoded[i]->is_valid(); tex.ec)
+            return;
+        tex.ec = codec.get_info(encoded[i]->bytes(), tex.extent.width, tex.extent.height);
+    });
+
+    // staging offsets. 16 is enough for the texel(4) and the optimal copy alignment of the most devices
+    VkDeviceSize staging_size = 0;
+    for (auto& tex : textures) {
+        if (tex.ec)
+            continue;
+        tex.offset = staging_size;
+        staging_size = align_up(staging_size + VkDeviceSize{tex.extent.width} * tex.extent.height * 4, 16);
+    }
+    if (staging_size == 0)
+        return;
+    create_staging(props, staging_size);
+    void* mapping = nullptr;
+    if (auto ec = vkMapMemory(device, staging_memory, 0, VK_WHOLE_SIZE, 0, &mapping))
+        throw vulkan_exception_t{ec, "vkMapMemory"};
+    {
+        TRACE_SCOPE("vulkan_texture_batch_t::decode");
+        parallel_for(textures.size(), num_workers, [&](size_t i) {
+            auto& tex = textures[i];
+            if (tex.ec)
+                return;
+            auto pixels = static_cast<std::byte*>(mapping) + tex.offset;
+            tex.ec = codec.decode(encoded[i]->bytes(), {pixels, size_t{tex.extent.width} * tex.extent.height * 4});
+            encoded[i].reset();
+        });
+    }
+    vkUnmapMemory(device, staging_memory);
+    create_images(props, mipmap);
+}
+
+void vulkan_texture_batch_t::create(const VkPhysicalDeviceMemoryProperties& props, gsl::span<const fs::path> files,
+                                    const image_codec_t& codec, block_format_t blocks, block_cache_t& cache,
+                                    uint32_t num_workers) noexcept(false) {
+    // one by one. the cache is not thread-safe. the entries are mapped until they are copied
+    vector<unique_ptr<mapped_file_t>> entries(files.size());
+    for (auto i = 0u; i < files.size(); ++i) {
+        auto& tex = textures[i];
+        block_cache_t::header_t header{};
+        if (tex.ec = cache.load_or_encode(files[i], blocks, codec, header, entries[i]); tex.ec)
+            continue;
+        tex.extent = {header.width, header.height};
+    }
+    // the block size(16) is a multiple of the texel block size that `bufferOffset` requires
+    VkDeviceSize staging_size = 0;
+    for (auto& tex : textures) {
+        if (tex.ec)
+            continue;
+        tex.offset = staging_size;
+        staging_size = align_up(staging_size + get_block_size(blocks, tex.extent.width, tex.extent.height), 16);
+    }
+    if (staging_size == 0)
+        return;
+    create_staging(props, staging_size);
+    void* mapping = nullptr;
+    if (auto ec = vkMapMemory(device, staging_memory, 0, VK_WHOLE_SIZE, 0, &mapping))
+        throw vulkan_exception_t{ec, "vkMapMemory"};
+    parallel_for(textures.size(), num_workers, [&](size_t i) {
+        const auto& tex = textures[i];
+        if (tex.ec)
+            return;
+        const auto bytes = entries[i]->bytes().subspan(sizeof(block_cache_t::header_t));
+        memcpy(static_cast<std::byte*>(mapping) + tex.offset, bytes.data(), bytes.size());
+        entries[i].reset();
+    });
+    vkUnmapMemory(device, staging_memory);
+    create_images(props, false);
+}
+
+void vulkan_texture_batch_t::create_staging(const VkPhysicalDeviceMemoryProperties& props,
+                                            VkDeviceSize size) noexcept(false) {
+    VkBufferCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    info.size = size;
+    info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (auto ec = vkCreateBuffer(device, &info, nullptr, &staging))
+        throw vulkan_exception_t{ec, "vkCreateBuffer"};
+    if (auto ec = allocate_memory(device, staging, staging_memory, info,
+                                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, props))
+        throw vulkan_exception_t{ec, "vkAllocateMemory"};
+    if (auto ec = vkBindBufferMemory(device, staging, staging_memory, 0))
+        throw vulkan_exception_t{ec, "vkBindBufferMemory"};
+}
+
+void vulkan_texture_batch_t::create_images(const VkPhysicalDeviceMemoryProperties& props,
+                                           bool mipmap) noexcept(false) {
+    // images in 1 allocation. use the memory type which is acceptable for all of them
+    VkDeviceSize memory_size = 0;
+    uint32_t type_bits = UINT32_MAX;
+    vector<VkDeviceSize> memory_offsets(textures.size());
+    for (auto i = 0u; i < textures.size(); ++i) {
+        auto& tex = textures[i];
+        if (tex.ec)
+            continue;
+        VkImageCreateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        info.imageType = VK_IMAGE_TYPE_2D;
+        info.extent = {tex.extent.width, tex.extent.height, 1};
+        if (mipmap)
+            tex.mip_levels = count_mip_levels(tex.extent.width, tex.extent.height);
+        info.mipLevels = tex.mip_levels;
+        info.arrayLayers = 1;
+        info.format = format;
+        info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        // TRANSFER_SRC for the blits of the mip chain and the readback
+        info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        info.samples = VK_SAMPLE_COUNT_1_BIT;
+        info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        if (auto ec = vkCreateImage(device, &info, nullptr, &tex.image))
+            throw vulkan_exception_t{ec, "vkCreateImage"};
+        VkMemoryRequirements requirements{};
+        vkGetImageMemoryRequirements(device, tex.image, &requirements);
+        memory_offsets[i] = align_up(memory_size, requirements.alignment);
+        memory_size = memory_offsets[i] + requirements.size;
+        type_bits &= requirements.memoryTypeBits;
+    }
+    {
+        VkMemoryAllocateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        info.allocationSize = memory_size;
+        info.memoryTypeIndex = get_memory_type(props, type_bits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        if (info.memoryTypeIndex == UINT32_MAX)
+            throw vulkan_exception_t{VK_ERROR_FEATURE_NOT_PRESENT, "vkAllocateMemory"};
+        if (auto ec = vkAllocateMemory(device, &info, nullptr, &memory))
+            throw vulkan_exception_t{ec, "vkAllocateMemory"};
+    }
+    for (auto i = 0u; i < textures.size(); ++i)
+        if (textures[i].image)
+            if (auto ec = vkBindImageMemory(device, textures[i].image, memory, memory_offsets[i]))
+                throw vulkan_exception_t{ec, "vkBindImageMemory"};
+}
+
+vulkan_texture_batch_t::~vulkan_texture_batch_t() noexcept {
+    destroy();
+}
+
+void vulkan_texture_batch_t::destroy() noexcept {
+    release_staging();
+    for (auto& tex : textures) {
+        vkDestroyImage(device, tex.image, nullptr);
+        tex.image = VK_NULL_HANDLE;
+    }
+    vkFreeMemory(device, memory, nullptr); // implicitly unmapped
+    memory = VK_NULL_HANDLE;
+}
+
+void vulkan_texture_batch_t::record(VkCommandBuffer commands) const noexcept(false) {
+    vulkan_barrier_builder_t barriers{};
+    record(commands, barriers);
+}
+
+void vulkan_texture_batch_t::record(VkCommandBuffer commands, vulkan_barrier_builder_t& barriers) const
+    noexcept(false) {
+    uint32_t max_levels = 0;
+    for (const auto& tex : textures) {
+        if (tex.image == VK_NULL_HANDLE)
+            continue;
+        barriers.track(tex.image, VK_IMAGE_ASPECT_COLOR_BIT, tex.mip_levels);
+        barriers.transition(tex.image, {VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, 1},
+                            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT,
+                            VK_PIPELINE_STAGE_TRANSFER_BIT);
+        max_levels = max(max_levels, tex.mip_levels);
+    }
+    if (barriers.flush(commands) == 0)
+        return;
+    for (const auto& tex : textures) {
+        if (tex.image == VK_NULL_HANDLE)
+            continue;
+        VkBufferImageCopy region{};
+        region.bufferOffset = tex.offset;
+        region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+        region.imageExtent = {tex.extent.width, tex.extent.height, 1};
+        vkCmdCopyBufferToImage(commands, staging, tex.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+    }
+    // level-1 is written by the previous copy/blit. make it the source of the level
+    for (auto level = 1u; level < max_levels; ++level) {
+        for (const auto& tex : textures)
+            if (tex.image && level < tex.mip_levels)
+                barriers.transition(tex.image, {VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 1, 0, 1},
+                                    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT,
+                                    VK_PIPELINE_STAGE_TRANSFER_BIT);
+        barriers.flush(commands);
+        for (const auto& tex : textures) {
+            if (tex.image == VK_NULL_HANDLE || level >= tex.mip_levels)
+                continue;
+            const auto src_width = static_cast<int32_t>(max(tex.extent.width >> (level - 1), 1u));
+            const auto src_height = static_cast<int32_t>(max(tex.extent.height >> (level - 1), 1u));
+            VkImageBlit blit{};
+            blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1};
+            blit.srcOffsets[1] = {src_width, src_height, 1};
+            blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1};
+            blit.dstOffsets[1] = {max(src_width / 2, 1), max(src_height / 2, 1), 1};
+            vkCmdBlitImage(commands, tex.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, //
+                           tex.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+        }
+    }
+    // the last level remains in TRANSFER_DST_OPTIMAL. the others are TRANSFER_SRC_OPTIMAL
+    for (const auto& tex : textures)
+        if (tex.image)
+            barriers.transition(tex.image, {VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, 1},
+                                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_SHADER_READ_BIT,
+                                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    barriers.flush(commands);
+}
+
+void vulkan_texture_batch_t::release_staging() noexcept {
+    vkDestroyBuffer(device, staging, nullptr);
+    vkFreeMemory(device, staging_memory, nullptr);
+    staging = VK_NULL_HANDLE;
+    staging_memory = VK_NULL_HANDLE;
+}
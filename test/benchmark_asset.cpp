@@ -0,0 +1,153 @@
+/**
+ * @author Park DongHa (luncliff@gmail.com)
+ * @note   Both paths read from the page cache after the first run. 
+ *         The difference is the copy into the caller's buffer(`fill`) and the page faults(`mapped_file_t`)
+ * @note   "cold" cases drop the page cache of the files with `posix_fadvise(POSIX_FADV_DONTNEED)` in each run.
+ *         The time of the drop is included in both the synchronous and the asynchronous cases
+ */
+#include <catch2/catch.hpp>
+#include <spdlog/spdlog.h>
+
+#include <graphics.h>
+
+#include <atomic>
+#include <random>
+#include <string>
+#if __has_include(<fcntl.h>) && !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+auto open(const fs::path& p) -> std::unique_ptr<FILE, int (*)(FILE*)>;
+auto create(const fs::path& p) -> std::unique_ptr<FILE, int (*)(FILE*)>;
+uint32_t get_size(FILE* stream, size_t& sz) noexcept;
+uint32_t fill(FILE* stream, size_t& rsz, std::byte* buf, size_t buflen) noexcept;
+auto read(FILE* stream, size_t& rsz) -> std::unique_ptr<std::byte[]>;
+
+/// @brief touch every page like the consumer(decoder, vkCreateShaderModule, ...) does
+uint64_t make_checksum(gsl::span<const std::byte> bytes) noexcept {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < bytes.size(); i += 512)
+        sum += static_cast<uint64_t>(bytes[i]);
+    return sum;
+}
+
+/// @brief random bytes in the temp directory. removed in the destructor
+class temp_asset_t final {
+  public:
+    fs::path fpath;
+
+  public:
+    explicit temp_asset_t(size_t length, uint32_t id = 0)
+        : fpath{fs::temp_directory_path() / ("graphics_bench_" + std::to_string(length) + '_' + std::to_string(id))} {
+        std::vector<uint32_t> words(length / sizeof(uint32_t));
+        std::mt19937 engine{};
+        for (auto& w : words)
+            w = engine();
+        auto stream = create(fpath);
+        REQUIRE(fwrite(words.data(), sizeof(uint32_t), words.size(), stream.get()) == words.size());
+    }
+    ~temp_asset_t() {
+        std::error_code ec{};
+        fs::remove(fpath, ec);
+    }
+};
+
+TEST_CASE("asset: fill vs mapped_file_t", "[asset][!benchmark]") {
+    const auto length = GENERATE(size_t{4} << 20, size_t{64} << 20, size_t{256} << 20);
+    temp_asset_t asset{length};
+    const auto suffix = ' ' + std::to_string(length >> 20) + "MB";
+
+    BENCHMARK(std::string{"fill"} + suffix) {
+        auto stream = open(asset.fpath);
+        size_t buflen = 0;
+        if (get_size(stream.get(), buflen))
+            FAIL("get_size");
+        auto buf = std::make_unique<std::byte[]>(buflen);
+        size_t rsz = 0;
+        if (fill(stream.get(), rsz, buf.get(), buflen))
+            FAIL("fill");
+        return make_checksum({buf.get(), rsz});
+    };
+    BENCHMARK(std::string{"mapped_file_t"} + suffix) {
+        mapped_file_t file{asset.fpath};
+        if (file.is_valid())
+            FAIL("mapped_file_t");
+        return make_checksum(file.bytes());
+    };
+    BENCHMARK(std::string{"mapped_file_t(willneed)"} + suffix) {
+        mapped_file_t file{asset.fpath, mapped_file_t::access_hint_t::willneed};
+        if (file.is_valid())
+            FAIL("mapped_file_t");
+        return make_checksum(file.bytes());
+    };
+}
+
+/// @return false if the page cache can't be dropped in this platform
+bool drop_page_cache(const fs::path& fpath) noexcept {
+#if defined(POSIX_FADV_DONTNEED)
+    const int fd = ::open(fpath.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    const auto ec = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+    return ec == 0;
+#else
+    return false;
+#endif
+}
+
+/// @note the worker threads invoke the callbacks concurrently
+void checksum_file(void* user_data, gsl::span<const std::byte> bytes, uint32_t) {
+    reinterpret_cast<std::atomic<uint64_t>*>(user_data)->fetch_add(make_checksum(bytes));
+}
+
+TEST_CASE("asset: synchronous vs file_loader_t", "[asset][!benchmark]") {
+    // many small files like the textures and buffers of a scene
+    constexpr auto count = 256u;
+    constexpr auto length = size_t{256} << 10;
+    std::vector<std::unique_ptr<temp_asset_t>> assets{};
+    for (auto i = 0u; i < count; ++i)
+        assets.emplace_back(std::make_unique<temp_asset_t>(length, i));
+
+    const bool cold = GENERATE(false, true);
+    if (cold && drop_page_cache(assets.front()->fpath) == false) {
+        WARN("can't drop the page cache");
+        return;
+    }
+    const auto suffix = std::string{cold ? " cold" : " warm"};
+    auto prepare = [&assets, cold]() {
+        if (cold)
+            for (auto& asset : assets)
+                drop_page_cache(asset->fpath);
+    };
+
+    BENCHMARK(std::string{"open/fill"} + suffix) {
+        prepare();
+        uint64_t sum = 0;
+        for (auto& asset : assets) {
+            auto stream = open(asset->fpath);
+            size_t rsz = 0;
+            const auto buf = read(stream.get(), rsz);
+            sum += make_checksum({buf.get(), rsz});
+        }
+        return sum;
+    };
+    for (const bool use_io_uring : {true, false}) {
+        file_loader_t loader{64, use_io_uring};
+        REQUIRE(loader.is_valid() == 0);
+        if (use_io_uring && loader.is_async_io() == false)
+            continue; // same with the worker threads
+        const auto name = std::string{use_io_uring ? "file_loader_t(io_uring)" : "file_loader_t(threads)"};
+        BENCHMARK(name + suffix) {
+            prepare();
+            std::atomic<uint64_t> sum{};
+            for (auto& asset : assets)
+                loader.submit(asset->fpath, checksum_file, &sum);
+            loader.wait();
+            return sum.load();
+        };
+    }
+}
@@ -0,0 +1,31 @@
+/**
+ * @author Park DongHa (luncliff@gmail.com)
+ * @note   Use the reporters for the machine-readable results. For example, `graphics_bench -r xml -o result.xml`
+ */
+#define CATCH_CONFIG_RUNNER
+#include <catch2/catch.hpp>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+fs::path get_asset_dir() noexcept {
+#if defined(ASSET_DIR)
+    if (fs::exists(ASSET_DIR))
+        return {ASSET_DIR};
+#endif
+    return fs::current_path();
+}
+
+int main(int argc, char* argv[]) {
+    // the reporter may use stdout. keep the logs in stderr
+    auto stream = spdlog::stderr_color_st("bench");
+    stream->set_pattern("[%^%l%$] %v");
+    stream->set_level(spdlog::level::level_enum::warn);
+    spdlog::set_default_logger(stream);
+
+    Catch::Session session{};
+    return session.run(argc, argv);
+}
@@ -0,0 +1,171 @@
+/**
+ * @author Park DongHa (luncliff@gmail.com)
+ * @note   The vertex shader has some work, so the cache misses are visible in the draw time
+ */
+#include <catch2/catch.hpp>
+#include <spdlog/spdlog.h>
+
+#include <graphics.h>
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+GLuint create_compile_attach(GLuint program, GLenum shader_type, std::string_view code) noexcept(false);
+bool get_program_info(std::string& message, GLuint program, GLenum status_name) noexcept;
+
+/// @brief `n` x `n` quads. The triangles are shuffled
+static void make_shuffled_grid(uint32_t n, std::vector<float>& positions, std::vector<uint32_t>& indices) {
+    for (auto y = 0u; y <= n; ++y)
+        for (auto x = 0u; x <= n; ++x)
+            positions.insert(positions.end(), {x * 2.0f / n - 1, y * 2.0f / n - 1, 0.0f});
+    std::vector<uint32_t> quads(n * n);
+    std::iota(quads.begin(), quads.end(), 0u);
+    std::shuffle(quads.begin(), quads.end(), std::mt19937{7});
+    for (auto q : quads) {
+        const auto v = q / n * (n + 1) + q % n;
+        indices.insert(indices.end(), {v, v + 1, v + n + 2, v + n + 2, v + n + 1, v});
+    }
+}
+
+TEST_CASE("vertex cache optimization", "[mesh][!benchmark]") {
+    std::vector<float> positions{};
+    std::vector<uint32_t> input{};
+    make_shuffled_grid(256, positions, input);
+    const auto vertex_count = static_cast<uint32_t>(positions.size() / 3);
+    accessor_view_t view{reinterpret_cast<const std::byte*>(positions.data()), vertex_count, 0, GL_FLOAT, 3};
+
+    auto optimized = input;
+    BENCHMARK("optimize_vertex_cache") {
+        optimized = input;
+        return optimize_vertex_cache(optimized, vertex_count);
+    };
+    auto sorted = optimized;
+    BENCHMARK("optimize_overdraw") {
+        sorted = optimized;
+        return optimize_overdraw(sorted, view);
+    };
+    const auto before = get_vertex_cache_stats(input, vertex_count);
+    const auto after = get_vertex_cache_stats(sorted, vertex_count);
+    spdlog::warn("ACMR {:.3f} -> {:.3f}, simulated cache misses {} -> {}", before.acmr, after.acmr,
+                 before.transformed, after.transformed);
+}
+
+TEST_CASE("vertex cache optimization: draw time", "[opengl][mesh][!benchmark]") {
+    EGLDisplay es_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    egl_context_t context{es_display, EGL_NO_CONTEXT};
+    REQUIRE_FALSE(context.handle() == EGL_NO_CONTEXT);
+    auto on_return_0 = gsl::finally([&context, es_display]() {
+        context.destroy();
+        eglTerminate(es_display);
+    });
+    EGLint attrs[]{EGL_WIDTH, 64, EGL_HEIGHT, 64, EGL_NONE};
+    EGLSurface es_surface = eglCreatePbufferSurface(es_display, context.config(), attrs);
+    REQUIRE(eglGetError() == EGL_SUCCESS);
+    REQUIRE(context.resume(es_surface, context.config()) == 0);
+
+    constexpr auto vs = "#version 300 es\n"
+                        "layout(location = 0) in vec3 i_position;\n"
+                        "out vec4 v_color;\n"
+                        "void main() {\n"
+                        "    vec4 sum = vec4(i_position, 1.0);\n"
+                        "    for (int i = 0; i < 32; ++i)\n"
+                        "        sum = sin(sum) * 0.5 + cos(sum.yzwx) * 0.5;\n"
+                        "    v_color = sum;\n"
+                        "    gl_Position = vec4(i_position, 1.0);\n"
+                        "}\n";
+    constexpr auto fs = "#version 300 es\n"
+                        "precision mediump float;\n"
+                        "in vec4 v_color;\n"
+                        "out vec4 color;\n"
+                        "void main() {\n"
+                        "    color = v_color;\n"
+                        "}\n";
+    const auto program = glCreateProgram();
+    auto on_return = gsl::finally([program]() { glDeleteProgram(program); });
+    const auto vert = create_compile_attach(program, GL_VERTEX_SHADER, vs);
+    const auto frag = create_compile_attach(program, GL_FRAGMENT_SHADER, fs);
+    glLinkProgram(program);
+    glDeleteShader(vert);
+    glDeleteShader(frag);
+    std::string message{};
+    if (get_program_info(message, program, GL_LINK_STATUS) == false)
+        FAIL(message);
+    glUseProgram(program);
+
+    std::vector<float> positions{};
+    std::vector<uint32_t> input{};
+    make_shuffled_grid(256, positions, input);
+    const auto vertex_count = static_cast<uint32_t>(positions.size() / 3);
+    auto optimized = input;
+    REQUIRE(optimize_vertex_cache(optimized, vertex_count) == 0);
+
+    GLuint buffers[3]{};
+    glGenBuffers(3, buffers);
+    auto on_return_2 = gsl::finally([&buffers]() { glDeleteBuffers(3, buffers); });
+    glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+    glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(float), positions.data(), GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+    for (auto i : {1, 2}) {
+        const auto& indices = i == 1 ? input : optimized;
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[i]);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+    }
+    REQUIRE(glGetError() == GL_NO_ERROR);
+    const auto count = static_cast<GLsizei>(input.size());
+    BENCHMARK("input order") {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+        glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, nullptr);
+        glFinish();
+    };
+    BENCHMARK("optimize_vertex_cache") {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[2]);
+        glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, nullptr);
+        glFinish();
+    };
+    REQUIRE(glGetError() == GL_NO_ERROR);
+}
+
+TEST_CASE("meshlet_culler_t", "[mesh][!benchmark]") {
+    std::vector<float> positions{};
+    std::vector<uint32_t> indices{};
+    make_shuffled_grid(64, positions, indices);
+    mesh_packer_t packer{};
+    accessor_view_t position_view{reinterpret_cast<const std::byte*>(positions.data()),
+                                  static_cast<uint32_t>(positions.size() / 3), 0, GL_FLOAT, 3};
+    accessor_view_t index_view{reinterpret_cast<const std::byte*>(indices.data()),
+                               static_cast<uint32_t>(indices.size()), 0, GL_UNSIGNED_INT, 1};
+    REQUIRE(packer.add(0, -1, position_view, {}, {}, index_view) == 0);
+    packed_scene_t scene{};
+    REQUIRE(packer.pack(scene) == 0);
+    vertex_cache_stats_t before{}, after{};
+    REQUIRE(optimize_scene(scene, before, after) == 0);
+    std::vector<meshlet_t> meshlets{};
+    REQUIRE(build_meshlets(scene, meshlets) == 0);
+    // 100 x 100 instances in [-1, 1] x [-1, 1] x 0. the box sees 30% of them
+    for (auto i = 0u; i < 100 * 100; ++i) {
+        auto& instance = scene.instances.emplace_back();
+        const float scale = 0.01f;
+        const float transform[16]{scale, 0, 0, 0, 0, scale, 0, 0, 0, 0, scale, 0,
+                                  (i % 100) * 0.02f - 1, (i / 100) * 0.02f - 1, 0, 1};
+        std::copy(transform, transform + 16, instance.transform);
+    }
+    const float view_projection[16]{1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 1.4f, 0, 0, 1};
+    frustum_t frustum{};
+    make_frustum(view_projection, {0, 0, 1}, frustum);
+
+    std::vector<draw_indexed_command_t> commands{};
+    meshlet_culler_t single{1};
+    BENCHMARK("1 thread") {
+        return single.cull(scene, meshlets, frustum, commands);
+    };
+    meshlet_culler_t culler{};
+    BENCHMARK("all threads") {
+        return culler.cull(scene, meshlets, frustum, commands);
+    };
+    spdlog::warn("meshlet_culler_t: {} meshlets, visible {}/{}, {} commands", meshlets.size(), culler.visible,
+                 culler.tested, commands.size());
+}
@@ -0,0 +1,53 @@
+/**
+ * @author Park DongHa (luncliff@gmail.com)
+ * @note   The library's logs are compiled only when they are above the `GRAPHICS_LOG_LEVEL`.
+ *         The runtime level can't remove them, so compare the "runtime: trace" results of 2 builds.
+ *         (ex: `-DGRAPHICS_LOG_LEVEL=TRACE` and the default `INFO`)
+ *         "runtime: off" is the cost of the level checks which are left in the build
+ */
+#include <catch2/catch.hpp>
+#include <spdlog/sinks/null_sink.h>
+#include <spdlog/spdlog.h>
+
+#include <graphics.h>
+
+void consume_mapping(void*, const void*, size_t) {
+}
+
+TEST_CASE("pbo_reader_t logging overhead", "[opengl][!benchmark]") {
+    EGLDisplay es_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    egl_context_t context{es_display, EGL_NO_CONTEXT};
+    REQUIRE_FALSE(context.handle() == EGL_NO_CONTEXT);
+    const GLint frame[4]{0, 0, 1080, 608};
+    EGLint attrs[]{EGL_WIDTH, frame[2], EGL_HEIGHT, frame[3], EGL_NONE};
+    EGLSurface es_surface = eglCreatePbufferSurface(es_display, context.config(), attrs);
+    REQUIRE(eglGetError() == EGL_SUCCESS);
+    REQUIRE(context.resume(es_surface, context.config()) == 0);
+
+    pbo_reader_t reader{static_cast<GLuint>(frame[2] * frame[3] * 4)};
+    REQUIRE(reader.is_valid() == GL_NO_ERROR);
+
+    // measure the formatting, not the console
+    auto logger = spdlog::default_logger();
+    auto on_return = gsl::finally([logger, level = spdlog::get_level()]() {
+        spdlog::set_default_logger(logger);
+        spdlog::set_level(level);
+    });
+    spdlog::set_default_logger(std::make_shared<spdlog::logger>("null", std::make_shared<spdlog::sinks::null_sink_mt>()));
+
+    uint16_t idx = 0;
+    auto readback = [&reader, &frame, &idx]() {
+        reader.pack(idx, 0, frame);
+        const auto ec = reader.map_and_invoke(idx, consume_mapping, nullptr);
+        idx = (idx + 1) % 2;
+        return ec;
+    };
+    spdlog::set_level(spdlog::level::off);
+    BENCHMARK("pack + map_and_invoke (build: " GRAPHICS_LOG_LEVEL ", runtime: off)") {
+        return readback();
+    };
+    spdlog::set_level(spdlog::level::trace);
+    BENCHMARK("pack + map_and_invoke (build: " GRAPHICS_LOG_LEVEL ", runtime: trace)") {
+        return readback();
+    };
+}
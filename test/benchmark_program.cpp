@@ -0,0 +1,144 @@
+/**
+ * @author Park DongHa (luncliff@gmail.com)
+ * @note   "cold" is the first start with an empty cache directory. "warm" loads the binary from the previous run
+ */
+#include <catch2/catch.hpp>
+#include <spdlog/spdlog.h>
+
+#include <graphics.h>
+
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+GLuint create_compile_attach(GLuint program, GLenum shader_type, std::string_view code) noexcept(false);
+bool get_program_info(std::string& message, GLuint program, GLenum status_name) noexcept;
+
+/// @brief fragment shader with some work to make the compile time visible
+std::string make_heavy_fs(uint32_t taps) {
+    std::string code = "#version 300 es\n"
+                       "precision highp float;\n"
+                       "uniform sampler2D tex;\n"
+                       "uniform vec2 texel;\n"
+                       "out vec4 color;\n"
+                       "void main() {\n"
+                       "    vec2 uv = gl_FragCoord.xy * texel;\n"
+                       "    vec4 sum = vec4(0.0);\n";
+    for (auto i = 0u; i < taps; ++i) {
+        const auto x = std::to_string(static_cast<int>(i % 7) - 3);
+        const auto y = std::to_string(static_cast<int>(i / 7 % 7) - 3);
+        code += "    sum += texture(tex, uv + vec2(" + x + ".0, " + y + ".0) * texel) * " +
+                std::to_string(i + 1) + ".0;\n";
+        code += "    sum = sin(sum) * 0.5 + cos(sum.yzwx) * 0.5;\n";
+    }
+    code += "    color = sum;\n"
+            "}\n";
+    return code;
+}
+
+TEST_CASE("program_cache_t: cold/warm start", "[opengl][!benchmark]") {
+    EGLDisplay es_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    egl_context_t context{es_display, EGL_NO_CONTEXT};
+    REQUIRE_FALSE(context.handle() == EGL_NO_CONTEXT);
+    EGLint attrs[]{EGL_WIDTH, 16, EGL_HEIGHT, 16, EGL_NONE};
+    EGLSurface es_surface = eglCreatePbufferSurface(es_display, context.config(), attrs);
+    REQUIRE(eglGetError() == EGL_SUCCESS);
+    REQUIRE(context.resume(es_surface, context.config()) == 0);
+
+    constexpr auto vs = "#version 300 es\n"
+                        "void main() {\n"
+                        "    vec2 p = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);\n"
+                        "    gl_Position = vec4(p * 2.0 - 1.0, 0.0, 1.0);\n"
+                        "}\n";
+    const auto fs = make_heavy_fs(64);
+    const auto directory = fs::temp_directory_path() / "graphics_program_bench";
+    auto on_return = gsl::finally([&directory]() {
+        std::error_code ec{};
+        fs::remove_all(directory, ec);
+    });
+    program_cache_t cache{directory};
+    if (cache.is_valid() == ENOTSUP)
+        FAIL("no program binary format");
+
+    std::string message{};
+    BENCHMARK("cold: compile + link + store") {
+        fs::remove_all(directory);
+        fs::create_directories(directory);
+        const auto program = glCreateProgram();
+        const auto ec = cache.load_or_build(program, vs, fs, message);
+        glDeleteProgram(program);
+        return ec;
+    };
+    BENCHMARK("warm: glProgramBinary") {
+        const auto program = glCreateProgram();
+        const auto ec = cache.load_or_build(program, vs, fs, message);
+        glDeleteProgram(program);
+        return ec;
+    };
+    spdlog::warn("program_cache_t: hit {} miss {}", cache.hit, cache.miss);
+}
+
+/// @note Each run uses new sources, so the driver's own shader cache doesn't hide the compile
+TEST_CASE("program_builder_t: 32 programs", "[opengl][!benchmark]") {
+    EGLDisplay es_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    egl_context_t context{es_display, EGL_NO_CONTEXT};
+    REQUIRE_FALSE(context.handle() == EGL_NO_CONTEXT);
+    EGLint attrs[]{EGL_WIDTH, 16, EGL_HEIGHT, 16, EGL_NONE};
+    EGLSurface es_surface = eglCreatePbufferSurface(es_display, context.config(), attrs);
+    REQUIRE(eglGetError() == EGL_SUCCESS);
+    REQUIRE(context.resume(es_surface, context.config()) == 0);
+
+    constexpr auto vs = "#version 300 es\n"
+                        "void main() {\n"
+                        "    vec2 p = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);\n"
+                        "    gl_Position = vec4(p * 2.0 - 1.0, 0.0, 1.0);\n"
+                        "}\n";
+    const auto fs = make_heavy_fs(16);
+    uint32_t run = 0;
+    auto make_sources = [&fs, &run]() {
+        std::vector<std::string> sources{};
+        for (auto i = 0u; i < 32; ++i)
+            sources.emplace_back(fs + "// " + std::to_string(run) + '.' + std::to_string(i) + '\n');
+        ++run;
+        return sources;
+    };
+    std::string message{};
+    BENCHMARK_ADVANCED("compile + status, one by one")(Catch::Benchmark::Chronometer meter) {
+        const auto sources = make_sources();
+        meter.measure([&]() {
+            uint32_t failed = 0;
+            for (const auto& source : sources) {
+                const auto program = glCreateProgram();
+                const GLuint shaders[2]{create_compile_attach(program, GL_VERTEX_SHADER, vs),
+                                        create_compile_attach(program, GL_FRAGMENT_SHADER, source)};
+                glLinkProgram(program);
+                failed += get_program_info(message, program, GL_LINK_STATUS) == false;
+                for (auto shader : shaders)
+                    glDeleteShader(shader);
+                glDeleteProgram(program);
+            }
+            return failed;
+        });
+    };
+    for (const bool use_extension : {true, false}) {
+        program_builder_t builder{es_display, 0, use_extension};
+        REQUIRE(builder.is_valid() == 0);
+        const auto name = builder.is_parallel_compile() ? "program_builder_t(GL_KHR_parallel_shader_compile)"
+                                                         : "program_builder_t(shared contexts)";
+        BENCHMARK_ADVANCED(name)(Catch::Benchmark::Chronometer meter) {
+            const auto sources = make_sources();
+            meter.measure([&]() {
+                std::vector<GLuint> programs(sources.size());
+                for (auto i = 0u; i < sources.size(); ++i)
+                    builder.submit(vs, sources[i], programs[i]);
+                uint32_t failed = 0;
+                for (auto program : programs) {
+                    failed += builder.get_status(program, message) != 0;
+                    glDeleteProgram(program);
+                }
+                return failed;
+            });
+        };
+    }
+}
@@ -0,0 +1,58 @@
+/**
+ * @author Park DongHa (luncliff@gmail.com)
+ * @note   The images are synthetic(gradient + noise) because the benchmark doesn't have the image decoder.
+ *         The quality is reported as PSNR of RGBA with `decode_blocks`
+ */
+#include <catch2/catch.hpp>
+#include <spdlog/spdlog.h>
+
+#include <graphics.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+
+static std::vector<std::byte> make_noisy_gradient(uint32_t width, uint32_t height) {
+    std::vector<std::byte> pixels(size_t{width} * height * 4);
+    std::mt19937 engine{};
+    std::uniform_int_distribution<int> noise{-12, 12};
+    for (auto y = 0u; y < height; ++y)
+        for (auto x = 0u; x < width; ++x) {
+            auto texel = &pixels[(size_t{y} * width + x) * 4];
+            texel[0] = static_cast<std::byte>(std::clamp<int>(x * 255 / width + noise(engine), 0, 255));
+            texel[1] = static_cast<std::byte>(std::clamp<int>(y * 255 / height + noise(engine), 0, 255));
+            texel[2] = static_cast<std::byte>(std::clamp<int>((x ^ y) & 0xFF, 0, 255));
+            texel[3] = static_cast<std::byte>(x < width / 2 ? 255 : (x + y) & 0xFF);
+        }
+    return pixels;
+}
+
+static double get_rgba_psnr(gsl::span<const std::byte> lhs, gsl::span<const std::byte> rhs) {
+    double sum = 0;
+    for (auto i = 0u; i < lhs.size(); ++i) {
+        const auto d = static_cast<double>(lhs[i]) - static_cast<double>(rhs[i]);
+        sum += d * d;
+    }
+    return 10 * std::log10(255.0 * 255.0 * lhs.size() / std::max(sum, 1.0));
+}
+
+TEST_CASE("texture: encode_blocks", "[!benchmark]") {
+    const auto format = GENERATE(block_format_t::etc2_rgba8, block_format_t::bc3);
+    const auto [width, height] = GENERATE(std::make_pair(400u, 337u), std::make_pair(1080u, 608u));
+    const auto pixels = make_noisy_gradient(width, height);
+    std::vector<std::byte> blocks(get_block_size(format, width, height));
+    std::vector<std::byte> decoded(pixels.size());
+    REQUIRE(encode_blocks(format, pixels, width, height, blocks) == 0);
+    REQUIRE(decode_blocks(format, blocks, width, height, decoded) == 0);
+
+    const auto name = std::string{format == block_format_t::bc3 ? "bc3" : "etc2_rgba8"} + ' ' +
+                      std::to_string(width) + 'x' + std::to_string(height);
+    spdlog::warn("{}: {:.2f} dB, {} -> {} bytes", name, get_rgba_psnr(pixels, decoded), pixels.size(), blocks.size());
+    BENCHMARK("encode " + name) {
+        return encode_blocks(format, pixels, width, height, blocks);
+    };
+    BENCHMARK("decode " + name) {
+        return decode_blocks(format, blocks, width, height, decoded);
+    };
+}
@@ -0,0 +1,191 @@
+/**
+ * @author Park DongHa (luncliff@gmail.com)
+ * @note   The resolutions are from the image assets
+ */
+#include <catch2/catch.hpp>
+#include <spdlog/spdlog.h>
+
+#include <graphics.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+struct resolution_t final {
+    GLint width;
+    GLint height;
+};
+
+std::string make_benchmark_name(gsl::czstring<> prefix, const resolution_t& r) {
+    return std::string{prefix} + ' ' + std::to_string(r.width) + 'x' + std::to_string(r.height);
+}
+
+/// @brief EGLContext with a small pbuffer. The benchmarks use their own framebuffer
+class offscreen_test_case {
+  protected:
+    EGLDisplay es_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    egl_context_t context{es_display, EGL_NO_CONTEXT};
+
+  public:
+    offscreen_test_case() {
+        REQUIRE_FALSE(context.handle() == EGL_NO_CONTEXT);
+        EGLint attrs[]{EGL_WIDTH, 16, EGL_HEIGHT, 16, EGL_NONE};
+        EGLSurface es_surface = eglCreatePbufferSurface(es_display, context.config(), attrs);
+        REQUIRE(eglGetError() == EGL_SUCCESS);
+        REQUIRE(context.resume(es_surface, context.config()) == 0);
+    }
+};
+
+/// @brief GL_TEXTURE_2D(GL_RGBA8) + GL_FRAMEBUFFER
+class offscreen_target_t final {
+  public:
+    GLuint tex = 0;
+    GLuint fbo = 0;
+
+  public:
+    explicit offscreen_target_t(const resolution_t& r) {
+        glGenTextures(1, &tex);
+        glBindTexture(GL_TEXTURE_2D, tex);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, r.width, r.height);
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex, 0);
+        REQUIRE(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+        glClearColor(0.1f, 0.2f, 0.3f, 1);
+        glClear(GL_COLOR_BUFFER_BIT);
+        REQUIRE(glGetError() == GL_NO_ERROR);
+    }
+    ~offscreen_target_t() {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &fbo);
+        glDeleteTextures(1, &tex);
+    }
+};
+
+void copy_from_mapping(void* user_data, const void* mapping, size_t length) {
+    memcpy(user_data, mapping, length);
+}
+
+void copy_to_mapping(void* user_data, void* mapping, size_t length) {
+    memcpy(mapping, user_data, length);
+}
+
+TEST_CASE_METHOD(offscreen_test_case, "transfer: pbo_reader_t", "[opengl][!benchmark]") {
+    const auto r = GENERATE(resolution_t{400, 337}, resolution_t{1080, 608}, resolution_t{2160, 3840});
+    offscreen_target_t target{r};
+    const GLint frame[4]{0, 0, r.width, r.height};
+    std::vector<std::byte> dst(r.width * r.height * 4);
+    pbo_reader_t reader{static_cast<GLuint>(dst.size())};
+    REQUIRE(reader.is_valid() == GL_NO_ERROR);
+
+    uint16_t idx = 0;
+    BENCHMARK(make_benchmark_name("pack + map_and_invoke", r)) {
+        reader.pack(idx, target.fbo, frame);
+        const auto ec = reader.map_and_invoke(idx, copy_from_mapping, dst.data());
+        idx = (idx + 1) % 2;
+        return ec;
+    };
+    // read the previous frame's buffer. the latency of 1 frame hides the transfer
+    BENCHMARK(make_benchmark_name("pack + map_and_invoke(previous)", r)) {
+        reader.pack(idx, target.fbo, frame);
+        idx = (idx + 1) % 2;
+        return reader.map_and_invoke(idx, copy_from_mapping, dst.data());
+    };
+    BENCHMARK(make_benchmark_name("glReadPixels", r)) {
+        glReadPixels(0, 0, r.width, r.height, GL_RGBA, GL_UNSIGNED_BYTE, dst.data());
+        return glGetError();
+    };
+}
+
+TEST_CASE_METHOD(offscreen_test_case, "transfer: pbo_writer_t", "[opengl][!benchmark]") {
+    const auto r = GENERATE(resolution_t{400, 337}, resolution_t{1080, 608}, resolution_t{2160, 3840});
+    offscreen_target_t target{r};
+    const GLint frame[4]{0, 0, r.width, r.height};
+    std::vector<std::byte> src(r.width * r.height * 4, std::byte{0x7F});
+    pbo_writer_t writer{static_cast<GLuint>(src.size())};
+    REQUIRE(writer.is_valid() == GL_NO_ERROR);
+
+    uint16_t idx = 0;
+    BENCHMARK(make_benchmark_name("map_and_invoke + unpack", r)) {
+        writer.map_and_invoke(idx, copy_to_mapping, src.data());
+        const auto ec = writer.unpack(idx, target.tex, frame);
+        idx = (idx + 1) % 2;
+        return ec;
+    };
+    BENCHMARK(make_benchmark_name("glTexSubImage2D", r)) {
+        glBindTexture(GL_TEXTURE_2D, target.tex);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, r.width, r.height, GL_RGBA, GL_UNSIGNED_BYTE, src.data());
+        return glGetError();
+    };
+}
+
+TEST_CASE("transfer: memcpy", "[!benchmark]") {
+    const auto r = GENERATE(resolution_t{400, 337}, resolution_t{1080, 608}, resolution_t{2160, 3840});
+    const size_t length = r.width * r.height * 4;
+    std::vector<std::byte> src(length, std::byte{0x7F});
+    std::vector<std::byte> dst(length);
+    BENCHMARK(make_benchmark_name("memcpy", r)) {
+        return memcpy(dst.data(), src.data(), length);
+    };
+}
+
+GLuint make_texture_program() {
+    constexpr auto vs = "#version 300 es\n"
+                        "out vec2 uv;\n"
+                        "void main() {\n"
+                        "    uv = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);\n"
+                        "    gl_Position = vec4(uv * 2.0 - 1.0, 0.0, 1.0);\n"
+                        "}\n";
+    constexpr auto fs = "#version 300 es\n"
+                        "precision mediump float;\n"
+                        "uniform sampler2D tex;\n"
+                        "in vec2 uv;\n"
+                        "out vec4 color;\n"
+                        "void main() {\n"
+                        "    color = texture(tex, uv);\n"
+                        "}\n";
+    const auto program = glCreateProgram();
+    for (auto [type, code] : {std::make_pair(GL_VERTEX_SHADER, vs), std::make_pair(GL_FRAGMENT_SHADER, fs)}) {
+        const auto shader = glCreateShader(type);
+        glShaderSource(shader, 1, &code, nullptr);
+        glCompileShader(shader);
+        glAttachShader(program, shader);
+        glDeleteShader(shader);
+    }
+    glLinkProgram(program);
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    REQUIRE(linked == GL_TRUE);
+    return program;
+}
+
+/// @note The source is noise, so the texels are not reused without the mip chain
+TEST_CASE_METHOD(offscreen_test_case, "texture: draw 2160x3840 as thumbnail", "[opengl][!benchmark]") {
+    const resolution_t source{2160, 3840};
+    const resolution_t r{108, 192};
+    offscreen_target_t target{r};
+    std::vector<uint32_t> pixels(source.width * source.height);
+    uint32_t seed = 0x1234'5678;
+    for (auto& pixel : pixels)
+        pixel = seed = seed * 1'664'525 + 1'013'904'223;
+
+    const auto program = make_texture_program();
+    auto on_return = gsl::finally([program]() { glDeleteProgram(program); });
+    glUseProgram(program);
+    glViewport(0, 0, r.width, r.height);
+    for (const bool mipmap : {false, true}) {
+        GLuint tex = 0;
+        glGenTextures(1, &tex);
+        auto on_return_1 = gsl::finally([&tex]() { glDeleteTextures(1, &tex); });
+        REQUIRE(make_texture_storage(tex, GL_RGBA8, source.width, source.height, mipmap) == GL_NO_ERROR);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, source.width, source.height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        if (mipmap)
+            REQUIRE(generate_mipmap(tex) == GL_NO_ERROR);
+        glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+        BENCHMARK(make_benchmark_name(mipmap ? "glDrawArrays(mipmap)" : "glDrawArrays", r)) {
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            glFinish();
+            return glGetError();
+        };
+    }
+}
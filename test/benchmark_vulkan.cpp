@@ -0,0 +1,178 @@
+/**
+ * @author Park DongHa (luncliff@gmail.com)
+ */
+#include <catch2/catch.hpp>
+#include <spdlog/spdlog.h>
+
+#include "vulkan_1.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+fs::path get_asset_dir() noexcept;
+
+TEST_CASE("transfer: update_memory", "[vulkan][!benchmark]") {
+    vulkan_instance_t instance{"app0", {}, {}};
+    VkPhysicalDevice physical_device{};
+    REQUIRE(get_physical_device(instance.handle, physical_device) == VK_SUCCESS);
+    VkPhysicalDeviceMemoryProperties meminfo{};
+    vkGetPhysicalDeviceMemoryProperties(physical_device, &meminfo);
+    VkDevice device{};
+    VkDeviceQueueCreateInfo queue_info{};
+    REQUIRE(create_device(physical_device, device, queue_info) == VK_SUCCESS);
+    auto on_return = gsl::finally([device]() { vkDestroyDevice(device, nullptr); });
+
+    const auto [width, height] = GENERATE(std::pair{400, 337}, std::pair{1080, 608}, std::pair{2160, 3840});
+    const auto length = static_cast<VkDeviceSize>(width * height * 4);
+    std::vector<std::byte> src(length, std::byte{0x7F});
+
+    // the staging buffer
+    VkBuffer buffer{};
+    VkBufferCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    info.size = length;
+    info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    REQUIRE(vkCreateBuffer(device, &info, nullptr, &buffer) == VK_SUCCESS);
+    auto on_return_1 = gsl::finally([device, buffer]() { vkDestroyBuffer(device, buffer, nullptr); });
+    VkDeviceMemory memory{};
+    REQUIRE(allocate_memory(device, buffer, memory, info, //
+                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                            meminfo) == VK_SUCCESS);
+    auto on_return_2 = gsl::finally([device, memory]() { vkFreeMemory(device, memory, nullptr); });
+    REQUIRE(vkBindBufferMemory(device, buffer, memory, 0) == VK_SUCCESS);
+    VkMemoryRequirements requirements{};
+    vkGetBufferMemoryRequirements(device, buffer, &requirements);
+    requirements.size = length; // the rest is padding
+
+    const auto name = std::to_string(width) + 'x' + std::to_string(height);
+    BENCHMARK("update_memory " + name) {
+        return update_memory(device, memory, requirements, src.data());
+    };
+    // keep the mapping. the difference is the cost of vkMapMemory/vkUnmapMemory
+    void* mapping = nullptr;
+    REQUIRE(vkMapMemory(device, memory, 0, length, 0, &mapping) == VK_SUCCESS);
+    BENCHMARK("persistent mapping + memcpy " + name) {
+        return memcpy(mapping, src.data(), length);
+    };
+    vkUnmapMemory(device, memory);
+}
+
+TEST_CASE("instanced draw", "[vulkan][headless][!benchmark]") {
+    vulkan_instance_t instance{"app0", {}, {}};
+    VkPhysicalDevice physical_device{};
+    REQUIRE(get_physical_device(instance.handle, physical_device) == VK_SUCCESS);
+    VkPhysicalDeviceMemoryProperties meminfo{};
+    vkGetPhysicalDeviceMemoryProperties(physical_device, &meminfo);
+    VkDevice device{};
+    VkDeviceQueueCreateInfo queue_info{};
+    REQUIRE(create_device(physical_device, device, queue_info) == VK_SUCCESS);
+    auto on_return = gsl::finally([device]() { vkDestroyDevice(device, nullptr); });
+    VkQueue queue{};
+    vkGetDeviceQueue(device, queue_info.queueFamilyIndex, 0, &queue);
+
+    // 10k quads in the 100 x 100 grid
+    constexpr auto count = 100u * 100u;
+    constexpr auto num_frames = 2u;
+    auto input = make_pipeline_input_5(device, meminfo, get_asset_dir(), num_frames, count);
+    std::vector<vulkan_instanced_input_t::instance_t> instances(count);
+    for (auto i = 0u; i < count; ++i) {
+        auto& item = instances[i];
+        const float transform[16]{1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, (i % 100) * 0.02f - 0.99f,
+                                  (i / 100) * 0.02f - 0.99f, 0, 1};
+        std::copy(transform, transform + 16, item.transform);
+        const float color[4]{(i % 100) / 100.0f, (i / 100) / 100.0f, 1, 1};
+        std::copy(color, color + 4, item.color);
+    }
+
+    // the render target
+    constexpr auto format = VK_FORMAT_B8G8R8A8_UNORM;
+    VkExtent2D extent{512, 512};
+    vulkan_renderpass_t renderpass{device, format};
+    vulkan_pipeline_t pipeline{device, renderpass.handle, extent, *input};
+    VkImage image{};
+    VkDeviceMemory image_memory{};
+    VkImageView image_view{};
+    VkFramebuffer framebuffer{};
+    auto on_return_1 = gsl::finally([&]() {
+        vkDestroyFramebuffer(device, framebuffer, nullptr);
+        vkDestroyImageView(device, image_view, nullptr);
+        vkDestroyImage(device, image, nullptr);
+        vkFreeMemory(device, image_memory, nullptr);
+    });
+    {
+        VkImageCreateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        info.imageType = VK_IMAGE_TYPE_2D;
+        info.extent = {extent.width, extent.height, 1};
+        info.mipLevels = 1;
+        info.arrayLayers = 1;
+        info.format = format;
+        info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        info.samples = VK_SAMPLE_COUNT_1_BIT;
+        info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        REQUIRE(vkCreateImage(device, &info, nullptr, &image) == VK_SUCCESS);
+        VkMemoryRequirements requirements{};
+        vkGetImageMemoryRequirements(device, image, &requirements);
+        VkMemoryAllocateInfo allocate{};
+        allocate.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocate.allocationSize = requirements.size;
+        allocate.memoryTypeIndex =
+            get_memory_type(meminfo, requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        REQUIRE(vkAllocateMemory(device, &allocate, nullptr, &image_memory) == VK_SUCCESS);
+        REQUIRE(vkBindImageMemory(device, image, image_memory, 0) == VK_SUCCESS);
+    }
+    {
+        VkImageViewCreateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        info.image = image;
+        info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        info.format = format;
+        info.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        REQUIRE(vkCreateImageView(device, &info, nullptr, &image_view) == VK_SUCCESS);
+    }
+    {
+        VkFramebufferCreateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        info.renderPass = renderpass.handle;
+        info.attachmentCount = 1;
+        info.pAttachments = &image_view;
+        info.width = extent.width;
+        info.height = extent.height;
+        info.layers = 1;
+        REQUIRE(vkCreateFramebuffer(device, &info, nullptr, &framebuffer) == VK_SUCCESS);
+    }
+
+    vulkan_command_pool_t command_pool{device, queue_info.queueFamilyIndex, 1};
+    vulkan_fence_t fence{device};
+    uint32_t frame = 0;
+    auto render = [&](bool instanced) {
+        // the fence is waited, so the slot of the ring buffer is free
+        if (auto ec = input->update(frame++ % num_frames, instances))
+            return ec;
+        {
+            vulkan_command_recorder_t recorder{command_pool.buffers[0], renderpass.handle, framebuffer, extent};
+            if (instanced)
+                input->record(recorder.commands, pipeline.handle, pipeline.layout);
+            else
+                input->record_each(recorder.commands, pipeline.handle, pipeline.layout);
+        }
+        if (auto ec = render_submit(queue, gsl::make_span(command_pool.buffers.get(), 1), fence.handle,
+                                    VK_NULL_HANDLE, VK_NULL_HANDLE))
+            return ec;
+        if (auto ec = vkWaitForFences(device, 1, &fence.handle, VK_TRUE, UINT64_MAX))
+            return ec;
+        return vkResetFences(device, 1, &fence.handle);
+    };
+    REQUIRE(render(true) == VK_SUCCESS);
+    BENCHMARK("10000 draws") {
+        return render(false);
+    };
+    BENCHMARK("1 instanced draw") {
+        return render(true);
+    };
+    REQUIRE(vkDeviceWaitIdle(device) == VK_SUCCESS);
+}
@@ -0,0 +1,96 @@
+/**
+ * @author Park DongHa (luncliff@gmail.com)
+ */
+#include <catch2/catch.hpp>
+#include <spdlog/spdlog.h>
+
+#include <graphics.h>
+
+#include <cstring>
+
+namespace fs = std::filesystem;
+
+fs::path get_asset_dir() noexcept;
+auto read_all(const fs::path& p, size_t& fsize) -> std::unique_ptr<std::byte[]>;
+
+TEST_CASE("mapped_file_t", "[asset]") {
+    const auto fpath = get_asset_dir() / "image_1080_608.png";
+    REQUIRE(fs::exists(fpath));
+    size_t fsize = 0;
+    const auto expected = read_all(fpath, fsize);
+    REQUIRE(fsize == fs::file_size(fpath));
+
+    using access_hint_t = mapped_file_t::access_hint_t;
+    const auto hint = GENERATE(access_hint_t::sequential, access_hint_t::random, access_hint_t::willneed);
+    mapped_file_t file{fpath, hint};
+    REQUIRE(file.is_valid() == 0);
+    REQUIRE(file.is_mapped());
+    const auto bytes = file.bytes();
+    REQUIRE(bytes.size() == fsize);
+    REQUIRE(memcmp(bytes.data(), expected.get(), fsize) == 0);
+}
+
+TEST_CASE("mapped_file_t with empty file", "[asset]") {
+    const auto fpath = fs::temp_directory_path() / "graphics_empty.bin";
+    {
+        auto stream = std::unique_ptr<FILE, int (*)(FILE*)>{fopen(fpath.string().c_str(), "wb"), &fclose};
+        REQUIRE(stream);
+    }
+    auto on_return = gsl::finally([&fpath]() { fs::remove(fpath); });
+    mapped_file_t file{fpath};
+    REQUIRE(file.is_valid() == 0);
+    REQUIRE(file.bytes().empty());
+}
+
+TEST_CASE("mapped_file_t with missing file", "[asset]") {
+    mapped_file_t file{get_asset_dir() / "missing.bin"};
+    REQUIRE(file.is_valid() != 0);
+    REQUIRE_FALSE(file.is_mapped());
+    REQUIRE(file.bytes().empty());
+}
+
+struct loaded_file_t final {
+    std::vector<std::byte> bytes{};
+    uint32_t ec = UINT32_MAX;
+};
+
+void on_file_loaded(void* user_data, gsl::span<const std::byte> bytes, uint32_t ec) {
+    auto& file = *reinterpret_cast<loaded_file_t*>(user_data);
+    file.bytes.assign(bytes.begin(), bytes.end());
+    file.ec = ec;
+}
+
+TEST_CASE("file_loader_t", "[asset]") {
+    const auto use_io_uring = GENERATE(true, false);
+    file_loader_t loader{4, use_io_uring};
+    REQUIRE(loader.is_valid() == 0);
+    if (use_io_uring == false)
+        REQUIRE_FALSE(loader.is_async_io());
+    spdlog::info("file_loader_t: io_uring {}", loader.is_async_io());
+
+    const fs::path fpaths[]{
+        get_asset_dir() / "image_400_337.jpg", get_asset_dir() / "image_1080_608.png",
+        get_asset_dir() / "image_2160_3840.png", get_asset_dir() / "revolver.png",
+        get_asset_dir() / "sample.vert", get_asset_dir() / "bypass.frag",
+    };
+    // more requests than the queue depth
+    std::vector<loaded_file_t> files(3 * std::size(fpaths));
+    for (auto i = 0u; i < files.size(); ++i)
+        REQUIRE(loader.submit(fpaths[i % std::size(fpaths)], on_file_loaded, &files[i]) == 0);
+    loader.wait();
+    for (auto i = 0u; i < files.size(); ++i) {
+        const mapped_file_t expected{fpaths[i % std::size(fpaths)]};
+        const auto bytes = expected.bytes();
+        REQUIRE(files[i].ec == 0);
+        REQUIRE(files[i].bytes.size() == bytes.size());
+        REQUIRE(memcmp(files[i].bytes.data(), bytes.data(), bytes.size()) == 0);
+    }
+
+    SECTION("missing file") {
+        loaded_file_t file{};
+        REQUIRE(loader.submit(get_asset_dir() / "missing.bin", on_file_loaded, &file) == 0);
+        loader.wait();
+        REQUIRE(file.ec == ENOENT);
+        REQUIRE(file.bytes.empty());
+    }
+}
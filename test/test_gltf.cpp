@@ -6,6 +6,7 @@
 
 #include <filesystem>
 
+#include <graphics.h>
 #include <nlohmann/json.hpp>
 #define TINYGLTF_IMPLEMENTATION
 #define STB_IMAGE_IMPLEMENTATION
@@ -23,7 +24,13 @@ TEST_CASE("Load GLB", "[gltf]") {
     REQUIRE(fs::exists(fpath));
     tinygltf::TinyGLTF loader{};
     tinygltf::Model model{};
-    if (std::string e, w; loader.LoadBinaryFromFile(&model, &e, &w, fpath.generic_u8string()) == false) {
+    const mapped_file_t fin{fpath, mapped_file_t::access_hint_t::random};
+    REQUIRE(fin.is_valid() == 0);
+    const auto blob = fin.bytes();
+    if (std::string e, w; loader.LoadBinaryFromMemory(&model, &e, &w, //
+                                                      reinterpret_cast<const unsigned char*>(blob.data()),
+                                                      static_cast<unsigned int>(blob.size()),
+                                                      fpath.parent_path().generic_u8string()) == false) {
         spdlog::warn(w);
         FAIL(e);
     }
@@ -0,0 +1,123 @@
+/**
+ * @author Park DongHa (luncliff@gmail.com)
+ * @note   `gltf_file_t` and `load_gltf` only. Built with src/gltf.cpp, so tinygltf is not required
+ */
+#include <catch2/catch.hpp>
+
+#include <cstring>
+#include <filesystem>
+
+#include <graphics.h>
+#include <nlohmann/json.hpp>
+
+namespace fs = std::filesystem;
+
+auto create(const fs::path& p) -> std::unique_ptr<FILE, int (*)(FILE*)>;
+
+TEST_CASE("load_gltf", "[gltf]") {
+    const auto directory = fs::temp_directory_path() / "graphics_gltf";
+    fs::create_directories(directory);
+    auto on_return = gsl::finally([&directory]() {
+        std::error_code ec{};
+        fs::remove_all(directory, ec);
+    });
+    // 1 quad. positions(48) + uvs(32) + indices(12)
+    const float positions[12]{0, 0, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0};
+    const float uvs[8]{0, 0, 1, 0, 1, 1, 0, 1};
+    const uint16_t indices[6]{0, 1, 2, 2, 3, 0};
+    {
+        auto stream = create(directory / "quad.bin");
+        REQUIRE(fwrite(positions, sizeof(positions), 1, stream.get()) == 1);
+        REQUIRE(fwrite(uvs, sizeof(uvs), 1, stream.get()) == 1);
+        REQUIRE(fwrite(indices, sizeof(indices), 1, stream.get()) == 1);
+    }
+    const auto document = nlohmann::json::parse(R"({
+        "asset": {"version": "2.0"},
+        "scene": 0,
+        "scenes": [{"nodes": [0]}],
+        "nodes": [{"translation": [1, 2, 3], "children": [1]}, {"mesh": 0, "scale": [2, 2, 2]}],
+        "meshes": [{"primitives": [{"attributes": {"POSITION": 0, "TEXCOORD_0": 1}, "indices": 2}]}],
+        "buffers": [{"uri": "quad.bin", "byteLength": 92}],
+        "bufferViews": [
+            {"buffer": 0, "byteOffset": 0, "byteLength": 48},
+            {"buffer": 0, "byteOffset": 48, "byteLength": 32},
+            {"buffer": 0, "byteOffset": 80, "byteLength": 12}
+        ],
+        "accessors": [
+            {"bufferView": 0, "componentType": 5126, "count": 4, "type": "VEC3",
+             "min": [0, 0, 0], "max": [1, 1, 0]},
+            {"bufferView": 1, "componentType": 5126, "count": 4, "type": "VEC2"},
+            {"bufferView": 2, "componentType": 5123, "count": 6, "type": "SCALAR"}
+        ]
+    })");
+    {
+        const auto text = document.dump();
+        auto stream = create(directory / "quad.gltf");
+        REQUIRE(fwrite(text.data(), text.size(), 1, stream.get()) == 1);
+    }
+    packed_scene_t scene{};
+    std::string message{};
+    REQUIRE(load_gltf(directory / "missing.gltf", scene, message) == ENOENT);
+    REQUIRE(load_gltf(directory / "quad.gltf", scene, message) == 0);
+    REQUIRE(scene.ranges.size() == 1);
+    REQUIRE(scene.ranges[0].index_count == 6);
+    REQUIRE(scene.uv_format == packed_scene_t::uv_format_t::unorm16);
+    REQUIRE(scene.vertices.size() == 4 * scene.stride);
+    REQUIRE(scene.instances.size() == 1);
+    const auto& transform = scene.instances[0].transform;
+    REQUIRE(transform[0] == 2.0f);
+    REQUIRE(transform[12] == 1.0f);
+    REQUIRE(transform[14] == 3.0f);
+
+    SECTION("GLB") {
+        // the same document with the BIN chunk. both chunks are 4 byte aligned
+        auto binary = document;
+        binary["buffers"][0].erase("uri");
+        auto text = binary.dump();
+        text.resize((text.size() + 3) / 4 * 4, ' ');
+        const uint32_t bin_length = 92; // 4 byte aligned
+        const uint32_t header[3]{0x46546C67, 2, static_cast<uint32_t>(12 + 8 + text.size() + 8 + bin_length)};
+        const uint32_t json_chunk[2]{static_cast<uint32_t>(text.size()), 0x4E4F534A};
+        const uint32_t bin_chunk[2]{bin_length, 0x004E4942};
+        {
+            auto stream = create(directory / "quad.glb");
+            REQUIRE(fwrite(header, sizeof(header), 1, stream.get()) == 1);
+            REQUIRE(fwrite(json_chunk, sizeof(json_chunk), 1, stream.get()) == 1);
+            REQUIRE(fwrite(text.data(), text.size(), 1, stream.get()) == 1);
+            REQUIRE(fwrite(bin_chunk, sizeof(bin_chunk), 1, stream.get()) == 1);
+            REQUIRE(fwrite(positions, sizeof(positions), 1, stream.get()) == 1);
+            REQUIRE(fwrite(uvs, sizeof(uvs), 1, stream.get()) == 1);
+            REQUIRE(fwrite(indices, sizeof(indices), 1, stream.get()) == 1);
+        }
+        packed_scene_t scene2{};
+        REQUIRE(load_gltf(directory / "quad.glb", scene2, message) == 0);
+        REQUIRE(scene2.vertices == scene.vertices);
+        REQUIRE(scene2.indices == scene.indices);
+
+        // the views are in the mapping of the file. no copy
+        const gltf_file_t file{directory / "quad.glb"};
+        REQUIRE(file.is_valid() == 0);
+        gsl::span<const std::byte> buffer{}, view{};
+        REQUIRE(file.get_buffer(0, buffer) == 0);
+        REQUIRE(buffer.size() == bin_length);
+        REQUIRE(file.get_buffer_view(2, view) == 0);
+        REQUIRE(view.data() == buffer.data() + 80);
+        REQUIRE(std::memcmp(view.data(), indices, sizeof(indices)) == 0);
+        accessor_view_t accessor{};
+        REQUIRE(file.get_accessor(0, accessor) == 0);
+        REQUIRE(accessor.data == buffer.data());
+        REQUIRE(accessor.get(2, 1) == 1.0f);
+        REQUIRE(file.get_accessor(3, accessor) == EINVAL);
+        REQUIRE(file.get_buffer(1, buffer) == EINVAL);
+    }
+    SECTION("broken GLB") {
+        {
+            auto stream = create(directory / "broken.glb");
+            const uint32_t header[3]{0x46546C67, 1, 12};
+            REQUIRE(fwrite(header, sizeof(header), 1, stream.get()) == 1);
+        }
+        const gltf_file_t file{directory / "broken.glb"};
+        REQUIRE(file.is_valid() == EBADMSG);
+        REQUIRE(load_gltf(directory / "broken.glb", scene, message) == EBADMSG);
+    }
+}
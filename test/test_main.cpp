@@ -13,13 +13,16 @@
 #include <filesystem>
 #include <gsl/gsl>
 
+#if defined(_WIN32)
 #include <pplawait.h>
 #include <ppltasks.h>
 #include <winrt/Windows.Foundation.h> // namespace winrt::Windows::Foundation
 #include <winrt/Windows.System.h>     // namespace winrt::Windows::System
 
-namespace fs = std::filesystem;
 using winrt::com_ptr;
+#endif
+
+namespace fs = std::filesystem;
 
 fs::path get_asset_dir() noexcept {
 #if defined(ASSET_DIR)
@@ -29,16 +32,21 @@ fs::path get_asset_dir() noexcept {
     return fs::current_path();
 }
 
-int main(int argc, char* argv[]) {
-    setlocale(LC_ALL, ".65001");
+auto get_current_stream() noexcept -> std::shared_ptr<spdlog::logger> {
+    return spdlog::default_logger();
+}
 
+int main(int argc, char* argv[]) {
     auto stream = spdlog::stdout_color_st("test");
     stream->set_pattern("[%^%l%$] %v");
     stream->set_level(spdlog::level::level_enum::trace);
     spdlog::set_default_logger(stream);
 
+#if defined(_WIN32)
+    setlocale(LC_ALL, ".65001");
     winrt::init_apartment();
     auto on_exit = gsl::finally(&winrt::uninit_apartment);
+#endif
     Catch::Session session{};
     return session.run(argc, argv);
 }
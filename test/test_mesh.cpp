@@ -0,0 +1,397 @@
+/**
+ * @author Park DongHa (luncliff@gmail.com)
+ */
+#include <catch2/catch.hpp>
+
+#include <graphics.h>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <numeric>
+#include <random>
+
+namespace fs = std::filesystem;
+
+template <typename T>
+accessor_view_t make_view(const std::vector<T>& values, GLenum type, uint32_t components) {
+    accessor_view_t view{};
+    view.data = reinterpret_cast<const std::byte*>(values.data());
+    view.count = static_cast<uint32_t>(values.size() / components);
+    view.component_type = type;
+    view.components = components;
+    return view;
+}
+
+template <typename T>
+T read_vertex(const packed_scene_t& scene, uint32_t vertex, uint32_t offset) {
+    T value{};
+    std::memcpy(&value, scene.vertices.data() + size_t{vertex} * scene.stride + offset, sizeof(T));
+    return value;
+}
+
+TEST_CASE("mesh_packer_t", "[asset][mesh]") {
+    // quad
+    const std::vector<float> positions{0, 0, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0};
+    const std::vector<float> normals{0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, -1};
+    const std::vector<uint8_t> indices{0, 1, 2, 2, 3, 0};
+    mesh_packer_t packer{};
+    packed_scene_t scene{};
+
+    SECTION("unit UVs") {
+        const std::vector<float> uvs{0, 0, 1, 0, 1, 1, 0, 0.5f};
+        REQUIRE(packer.add(0, 3, make_view(positions, GL_FLOAT, 3), make_view(normals, GL_FLOAT, 3),
+                           make_view(uvs, GL_FLOAT, 2), make_view(indices, GL_UNSIGNED_BYTE, 1)) == 0);
+        // 2nd primitive without normals, UVs, indices
+        REQUIRE(packer.add(1, -1, make_view(positions, GL_FLOAT, 3), {}, {}, {}) == 0);
+        REQUIRE(packer.pack(scene) == 0);
+        REQUIRE(scene.uv_format == packed_scene_t::uv_format_t::unorm16);
+        REQUIRE(scene.stride == 24);
+        REQUIRE(scene.index_size == 2);
+        REQUIRE(scene.vertices.size() == 8 * 24);
+        REQUIRE(scene.indices.size() == (6 + 4) * 2);
+        REQUIRE(scene.ranges.size() == 2);
+        REQUIRE(scene.ranges[0].material == 3);
+        REQUIRE(scene.ranges[1].first_index == 6);
+        REQUIRE(scene.ranges[1].index_count == 4);
+        REQUIRE(scene.ranges[1].vertex_offset == 4);
+        REQUIRE(scene.ranges[1].material == -1);
+
+        REQUIRE(read_vertex<float>(scene, 2, 4) == 1.0f);
+        REQUIRE(read_vertex<int16_t>(scene, 3, 12 + 4) == -32767);
+        REQUIRE(read_vertex<uint16_t>(scene, 3, scene.uv_offset + 2) == 32768);
+        REQUIRE(read_vertex<int16_t>(scene, 5, 12 + 4) == 32767); // (0, 0, 1) for missing normals
+        uint16_t last = 0;
+        std::memcpy(&last, scene.indices.data() + scene.indices.size() - 2, 2);
+        REQUIRE(last == 3); // relative to the vertex_offset
+    }
+    SECTION("tiled UVs") {
+        const std::vector<float> uvs{0, 0, 4, 0, 4, 4, -2, 0.5f};
+        REQUIRE(packer.add(0, 0, make_view(positions, GL_FLOAT, 3), make_view(normals, GL_FLOAT, 3),
+                           make_view(uvs, GL_FLOAT, 2), make_view(indices, GL_UNSIGNED_BYTE, 1)) == 0);
+        REQUIRE(packer.pack(scene) == 0);
+        REQUIRE(scene.uv_format == packed_scene_t::uv_format_t::float16);
+        REQUIRE(scene.stride == 24);
+        REQUIRE(read_vertex<uint16_t>(scene, 1, scene.uv_offset) == 0x4400); // 4.0
+        REQUIRE(read_vertex<uint16_t>(scene, 3, scene.uv_offset) == 0xC000); // -2.0
+    }
+    SECTION("UVs out of half precision") {
+        const std::vector<float> uvs{0, 0, 1000.3f, 0, 1, 1, 0, 1};
+        REQUIRE(packer.add(0, 0, make_view(positions, GL_FLOAT, 3), make_view(normals, GL_FLOAT, 3),
+                           make_view(uvs, GL_FLOAT, 2), make_view(indices, GL_UNSIGNED_BYTE, 1)) == 0);
+        REQUIRE(packer.pack(scene) == 0);
+        REQUIRE(scene.uv_format == packed_scene_t::uv_format_t::float32);
+        REQUIRE(scene.stride == 28);
+        REQUIRE(read_vertex<float>(scene, 1, scene.uv_offset) == 1000.3f);
+    }
+    SECTION("32 bit indices") {
+        std::vector<float> many(3 * 70'000, 0.0f);
+        std::vector<uint32_t> many_indices(69'999 * 3);
+        std::iota(many_indices.begin(), many_indices.end(), 0u);
+        for (auto& index : many_indices)
+            index /= 3;
+        REQUIRE(packer.add(0, 0, make_view(many, GL_FLOAT, 3), {}, {}, make_view(many_indices, GL_UNSIGNED_INT, 1)) ==
+                0);
+        REQUIRE(packer.pack(scene) == 0);
+        REQUIRE(scene.index_size == 4);
+        REQUIRE(scene.indices.size() == many_indices.size() * 4);
+    }
+    SECTION("invalid") {
+        const std::vector<uint16_t> broken{0, 1, 9};
+        REQUIRE(packer.add(0, 0, make_view(positions, GL_FLOAT, 2), {}, {}, {}) == EINVAL);
+        REQUIRE(packer.add(0, 0, make_view(positions, GL_FLOAT, 3), make_view(indices, GL_UNSIGNED_BYTE, 3), {},
+                           {}) == EINVAL);
+        REQUIRE(packer.add(0, 0, make_view(positions, GL_FLOAT, 3), {}, {},
+                           make_view(broken, GL_UNSIGNED_SHORT, 1)) == 0);
+        REQUIRE(packer.pack(scene) == EINVAL);
+    }
+}
+
+TEST_CASE("accessor_view_t", "[asset][mesh]") {
+    // interleaved. normalized unsigned short + padding
+    const std::vector<uint16_t> values{0, 65535, 7, 32768, 0, 9};
+    accessor_view_t view = make_view(values, GL_UNSIGNED_SHORT, 2);
+    view.stride = 6;
+    view.count = 2;
+    view.normalized = true;
+    REQUIRE(view.get(0, 0) == 0.0f);
+    REQUIRE(view.get(0, 1) == 1.0f);
+    REQUIRE(view.get(1, 0) == Approx(0.5f).margin(1e-4));
+    view.normalized = false;
+    REQUIRE(view.get(1, 0) == 32768.0f);
+    REQUIRE(view.get_index(1) == 32768);
+}
+
+/// @brief `n` x `n` quads on z = 0. The triangles are shuffled like the meshes from the DCC tools
+static void make_grid(uint32_t n, std::vector<float>& positions, std::vector<uint32_t>& indices) {
+    positions.clear();
+    indices.clear();
+    for (auto y = 0u; y <= n; ++y)
+        for (auto x = 0u; x <= n; ++x)
+            positions.insert(positions.end(), {static_cast<float>(x), static_cast<float>(y), 0.0f});
+    for (auto y = 0u; y < n; ++y)
+        for (auto x = 0u; x < n; ++x) {
+            const auto v = y * (n + 1) + x;
+            indices.insert(indices.end(), {v, v + 1, v + n + 2, v + n + 2, v + n + 1, v});
+        }
+    std::vector<uint32_t> order(indices.size() / 3);
+    std::iota(order.begin(), order.end(), 0u);
+    std::shuffle(order.begin(), order.end(), std::mt19937{7});
+    std::vector<uint32_t> shuffled{};
+    for (auto t : order)
+        shuffled.insert(shuffled.end(), indices.begin() + t * 3, indices.begin() + t * 3 + 3);
+    indices.swap(shuffled);
+}
+
+/// @brief the triangles with their winding. The order of the triangles is ignored
+static std::vector<std::array<uint32_t, 3>> get_triangles(const std::vector<uint32_t>& indices) {
+    std::vector<std::array<uint32_t, 3>> triangles{};
+    for (auto i = 0u; i < indices.size(); i += 3) {
+        std::array<uint32_t, 3> t{indices[i], indices[i + 1], indices[i + 2]};
+        std::rotate(t.begin(), std::min_element(t.begin(), t.end()), t.end());
+        triangles.emplace_back(t);
+    }
+    std::sort(triangles.begin(), triangles.end());
+    return triangles;
+}
+
+TEST_CASE("vertex cache optimization", "[asset][mesh]") {
+    std::vector<float> positions{};
+    std::vector<uint32_t> indices{};
+    make_grid(32, positions, indices);
+    const auto vertex_count = static_cast<uint32_t>(positions.size() / 3);
+    const auto triangles = get_triangles(indices);
+    const auto before = get_vertex_cache_stats(indices, vertex_count);
+    REQUIRE(before.triangles == 32 * 32 * 2);
+    REQUIRE(before.vertices == vertex_count);
+    REQUIRE(before.acmr > 2.0f);
+
+    SECTION("optimize_vertex_cache") {
+        REQUIRE(optimize_vertex_cache(indices, vertex_count) == 0);
+        REQUIRE(get_triangles(indices) == triangles);
+        const auto after = get_vertex_cache_stats(indices, vertex_count);
+        REQUIRE(after.acmr < 0.8f);
+        REQUIRE(after.transformed < before.transformed / 2);
+    }
+    SECTION("optimize_overdraw") {
+        REQUIRE(optimize_vertex_cache(indices, vertex_count) == 0);
+        const auto tipsify = get_vertex_cache_stats(indices, vertex_count);
+        REQUIRE(optimize_overdraw(indices, make_view(positions, GL_FLOAT, 3)) == 0);
+        REQUIRE(get_triangles(indices) == triangles);
+        // the split doesn't cost much of the cache
+        REQUIRE(get_vertex_cache_stats(indices, vertex_count).acmr < tipsify.acmr * 1.2f);
+    }
+    SECTION("optimize_vertex_fetch") {
+        std::vector<uint32_t> remap{};
+        uint32_t used = 0;
+        indices.resize(indices.size() - 6); // the last vertices may be unused
+        REQUIRE(optimize_vertex_fetch(indices, vertex_count, remap, used) == 0);
+        REQUIRE(used <= vertex_count);
+        // the first use is in the increasing order
+        uint32_t next = 0;
+        for (auto index : indices) {
+            REQUIRE(index <= next);
+            if (index == next)
+                ++next;
+        }
+        REQUIRE(next == used);
+    }
+    SECTION("invalid") {
+        indices[4] = vertex_count;
+        REQUIRE(optimize_vertex_cache(indices, vertex_count) == EINVAL);
+        REQUIRE(optimize_overdraw(indices, make_view(positions, GL_FLOAT, 3)) == EINVAL);
+        indices.pop_back();
+        std::vector<uint32_t> remap{};
+        uint32_t used = 0;
+        REQUIRE(optimize_vertex_fetch(indices, vertex_count, remap, used) == EINVAL);
+    }
+}
+
+TEST_CASE("mesh_cache_t", "[asset][mesh]") {
+    const auto directory = fs::temp_directory_path() / "graphics_mesh_cache";
+    fs::remove_all(directory);
+    auto on_return = gsl::finally([&directory]() {
+        std::error_code ec{};
+        fs::remove_all(directory, ec);
+    });
+    std::vector<float> positions{};
+    std::vector<uint32_t> indices{};
+    make_grid(16, positions, indices);
+    mesh_packer_t packer{};
+    REQUIRE(packer.add(0, -1, make_view(positions, GL_FLOAT, 3), {}, {}, make_view(indices, GL_UNSIGNED_INT, 1)) == 0);
+    REQUIRE(packer.add(1, -1, make_view(positions, GL_FLOAT, 3), {}, {}, make_view(indices, GL_UNSIGNED_INT, 1)) == 0);
+    packed_scene_t input{};
+    REQUIRE(packer.pack(input) == 0);
+
+    mesh_cache_t cache{directory};
+    REQUIRE(cache.is_valid() == 0);
+    auto scene = input;
+    mesh_cache_t::header_t header{};
+    REQUIRE(cache.load_or_optimize(scene, header) == 0);
+    REQUIRE(cache.miss == 1);
+    REQUIRE(header.after.acmr < header.before.acmr);
+    REQUIRE(header.before.triangles == 2 * 16 * 16 * 2);
+    REQUIRE(scene.ranges.size() == input.ranges.size());
+    REQUIRE(scene.vertices.size() == input.vertices.size());
+    REQUIRE(scene.vertices != input.vertices); // moved in the ranges
+    // the positions of the triangles are same
+    for (auto i = 0u; i < scene.ranges[1].index_count; i += 3) {
+        uint16_t index = 0;
+        std::memcpy(&index, scene.indices.data() + (scene.ranges[1].first_index + i) * 2, 2);
+        const auto v = static_cast<uint32_t>(scene.ranges[1].vertex_offset) + index;
+        REQUIRE(read_vertex<float>(scene, v, 0) >= 0.0f);
+        REQUIRE(read_vertex<float>(scene, v, 0) <= 16.0f);
+    }
+
+    auto reloaded = input;
+    mesh_cache_t::header_t header2{};
+    REQUIRE(cache.load_or_optimize(reloaded, header2) == 0);
+    REQUIRE(cache.hit == 1);
+    REQUIRE(header2.after.acmr == header.after.acmr);
+    REQUIRE(reloaded.vertices == scene.vertices);
+    REQUIRE(reloaded.indices == scene.indices);
+}
+
+TEST_CASE("build_meshlets", "[asset][mesh]") {
+    std::vector<float> positions{};
+    std::vector<uint32_t> indices{};
+    make_grid(32, positions, indices);
+    mesh_packer_t packer{};
+    REQUIRE(packer.add(0, -1, make_view(positions, GL_FLOAT, 3), {}, {}, make_view(indices, GL_UNSIGNED_INT, 1)) == 0);
+    packed_scene_t scene{};
+    REQUIRE(packer.pack(scene) == 0);
+    vertex_cache_stats_t before{}, after{};
+    REQUIRE(optimize_scene(scene, before, after) == 0);
+
+    std::vector<meshlet_t> meshlets{};
+    REQUIRE(build_meshlets(scene, meshlets) == 0);
+    REQUIRE(meshlets.size() >= 32 * 32 * 2 / 124);
+    uint32_t next = 0;
+    for (const auto& meshlet : meshlets) {
+        REQUIRE(meshlet.first_index == next); // covers the range without a gap
+        next += meshlet.index_count;
+        REQUIRE(meshlet.index_count / 3 <= 124);
+        std::vector<uint16_t> unique(meshlet.index_count);
+        std::memcpy(unique.data(), scene.indices.data() + meshlet.first_index * 2, meshlet.index_count * 2);
+        std::sort(unique.begin(), unique.end());
+        unique.erase(std::unique(unique.begin(), unique.end()), unique.end());
+        REQUIRE(unique.size() <= 64);
+        for (auto v : unique) {
+            const float p[3]{read_vertex<float>(scene, v, 0), read_vertex<float>(scene, v, 4), 0};
+            const auto d = std::hypot(p[0] - meshlet.center[0], p[1] - meshlet.center[1], p[2] - meshlet.center[2]);
+            REQUIRE(d <= meshlet.radius + 1e-4f);
+        }
+        // flat grid. all normals are +Z
+        REQUIRE(meshlet.cone_axis[2] == Approx(1.0f));
+        REQUIRE(meshlet.cone_cutoff == Approx(0.0f).margin(1e-3));
+    }
+    REQUIRE(next == scene.ranges[0].index_count);
+    REQUIRE(build_meshlets(scene, meshlets, 2) == EINVAL);
+}
+
+TEST_CASE("meshlet_culler_t", "[asset][mesh]") {
+    std::vector<float> positions{};
+    std::vector<uint32_t> indices{};
+    make_grid(16, positions, indices); // [0, 16] x [0, 16] on z = 0, facing +Z
+    mesh_packer_t packer{};
+    REQUIRE(packer.add(0, -1, make_view(positions, GL_FLOAT, 3), {}, {}, make_view(indices, GL_UNSIGNED_INT, 1)) == 0);
+    packed_scene_t scene{};
+    REQUIRE(packer.pack(scene) == 0);
+    vertex_cache_stats_t before{}, after{};
+    REQUIRE(optimize_scene(scene, before, after) == 0);
+    std::vector<meshlet_t> meshlets{};
+    REQUIRE(build_meshlets(scene, meshlets) == 0);
+    // 200 instances in a row, 1/16 scale. x in [0, 200)
+    for (auto i = 0u; i < 200; ++i) {
+        auto& instance = scene.instances.emplace_back();
+        instance.mesh = 0;
+        const float transform[16]{1.0f / 16, 0, 0, 0, 0, 1.0f / 16, 0, 0, 0, 0, 1.0f / 16, 0, float(i), 0, 0, 1};
+        std::copy(transform, transform + 16, instance.transform);
+    }
+    // box of x in [-1, 1]. The camera is in front of the grids
+    const float view_projection[16]{1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+    frustum_t frustum{};
+    make_frustum(view_projection, {0.5f, 0.5f, 0.5f}, frustum);
+
+    std::vector<draw_indexed_command_t> commands{};
+    meshlet_culler_t culler{1};
+    REQUIRE(culler.is_valid() == 0);
+    REQUIRE(culler.cull(scene, meshlets, frustum, commands) == 0);
+    REQUIRE(culler.tested == meshlets.size() * 200);
+    REQUIRE(culler.visible > 0);
+    REQUIRE(culler.visible < culler.tested / 50);
+    for (const auto& command : commands) {
+        REQUIRE(command.instance_count == 1);
+        REQUIRE(command.first_instance <= 1); // instance 0 and the edge of 1
+    }
+    // the adjacent meshlets are merged. instance 0 is in the box
+    REQUIRE(commands[0].first_instance == 0);
+    REQUIRE(commands[0].index_count == scene.ranges[0].index_count);
+    REQUIRE(commands.size() < culler.visible);
+
+    SECTION("same result with more workers") {
+        meshlet_culler_t culler2{4};
+        std::vector<draw_indexed_command_t> commands2{};
+        REQUIRE(culler2.cull(scene, meshlets, frustum, commands2) == 0);
+        REQUIRE(culler2.visible == culler.visible);
+        REQUIRE(commands2.size() == commands.size());
+        REQUIRE(std::memcmp(commands2.data(), commands.data(), commands.size() * sizeof(draw_indexed_command_t)) == 0);
+    }
+    SECTION("backface") {
+        make_frustum(view_projection, {0.5f, 0.5f, -4.0f}, frustum); // behind the grids
+        REQUIRE(culler.cull(scene, meshlets, frustum, commands) == 0);
+        REQUIRE(culler.visible == 0);
+        REQUIRE(commands.empty());
+    }
+}
+
+TEST_CASE("make_draw_objects", "[asset][mesh]") {
+    std::vector<float> positions{};
+    std::vector<uint32_t> indices{};
+    make_grid(4, positions, indices); // [0, 4] x [0, 4] on z = 0
+    mesh_packer_t packer{};
+    const auto position_view = make_view(positions, GL_FLOAT, 3);
+    const auto index_view = make_view(indices, GL_UNSIGNED_INT, 1);
+    REQUIRE(packer.add(0, -1, position_view, {}, {}, index_view) == 0);
+    REQUIRE(packer.add(1, -1, position_view, {}, {}, index_view) == 0);
+    packed_scene_t scene{};
+    REQUIRE(packer.pack(scene) == 0);
+    // 20 instances in a row, 1/4 scale. x in [2i - 20, 2i - 19]. The odd ones use the mesh 1
+    for (auto i = 0u; i < 20; ++i) {
+        auto& instance = scene.instances.emplace_back();
+        instance.mesh = i % 2;
+        const float transform[16]{0.25f, 0, 0, 0, 0, 0.25f, 0, 0, 0, 0, 0.25f, 0, 2.0f * i - 20, 0, 0, 1};
+        std::copy(transform, transform + 16, instance.transform);
+    }
+    std::vector<draw_object_t> objects{};
+    REQUIRE(make_draw_objects(scene, objects) == 0);
+    REQUIRE(objects.size() == 20);
+    for (auto i = 0u; i < 20; ++i) {
+        const auto& object = objects[i];
+        const auto& range = scene.ranges[i % 2];
+        REQUIRE(object.instance == i);
+        REQUIRE(object.first_index == range.first_index);
+        REQUIRE(object.vertex_offset == range.vertex_offset);
+        REQUIRE(object.center[0] == Approx(2.0f * i - 19.5f));
+        REQUIRE(object.center[1] == Approx(0.5f));
+        REQUIRE(object.radius == Approx(std::sqrt(0.5f)));
+    }
+
+    // box of x in [-1, 1]. The sphere of instance 9 touches the left plane
+    const float view_projection[16]{1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+    frustum_t frustum{};
+    make_frustum(view_projection, {0, 0, 1}, frustum);
+    std::vector<draw_indexed_command_t> commands{};
+    cull_draw_objects(objects, frustum, commands);
+    REQUIRE(commands.size() == 2);
+    REQUIRE(commands[0].first_instance == 9);
+    REQUIRE(commands[1].first_instance == 10);
+    REQUIRE(commands[1].first_index == scene.ranges[0].first_index);
+    REQUIRE(commands[1].instance_count == 1);
+
+    SECTION("broken scene") {
+        scene.stride = 4;
+        REQUIRE(make_draw_objects(scene, objects) == EINVAL);
+        REQUIRE(objects.empty());
+    }
+}
@@ -10,25 +10,32 @@
 // clang-format off
 #include <graphics.h>
 #include <EGL/eglext_angle.h>
-#define GLFW_EXPOSE_NATIVE_WIN32
-#define GLFW_EXPOSE_NATIVE_EGL
-#define GLFW_INCLUDE_ES3
-#define GLFW_INCLUDE_GLEXT
-#include <GLFW/glfw3.h>
-#include <GLFW/glfw3native.h>
+#if __has_include(<GLFW/glfw3.h>)
+#  if defined(_WIN32)
+#    define GLFW_EXPOSE_NATIVE_WIN32
+#  endif
+#  define GLFW_EXPOSE_NATIVE_EGL
+#  define GLFW_INCLUDE_ES3
+#  define GLFW_INCLUDE_GLEXT
+#  include <GLFW/glfw3.h>
+#  include <GLFW/glfw3native.h>
+#endif
 // clang-format on
 
+#if defined(_WIN32)
 #include <pplawait.h>
 #include <ppltasks.h>
 #include <winrt/Windows.Foundation.h> // namespace winrt::Windows::Foundation
 #include <winrt/Windows.System.h>     // namespace winrt::Windows::System
 
 using winrt::com_ptr;
+#endif
 
 #if !defined(EGL_NO_CONFIG_KHR)
 #define EGL_NO_CONFIG_KHR NULL
 #endif
 
+#if defined(_WIN32)
 TEST_CASE("eglGetProcAddress != GetProcAddress", "[egl]") {
     auto hmodule = LoadLibraryW(L"libEGL");
     REQUIRE(hmodule);
@@ -64,6 +71,7 @@ TEST_CASE("GetProcAddress", "[opengl]") {
         REQUIRE(symbol);
     }
 }
+#endif
 
 void print_info(EGLDisplay display) {
     spdlog::info("EGL:");
@@ -82,7 +90,7 @@ void print_info(EGLDisplay display) {
         spdlog::info("   - {}", name);
 }
 
-TEST_CASE("EGLContext setup/teardown", "[egl]") {
+TEST_CASE("EGLContext setup/teardown", "[egl][headless]") {
     EGLDisplay es_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
     EGLint major = 0, minor = 0;
     REQUIRE(eglInitialize(es_display, &major, &minor));
@@ -106,7 +114,7 @@ TEST_CASE("EGLContext setup/teardown", "[egl]") {
     REQUIRE(eglGetError() == EGL_SUCCESS);
 }
 
-TEST_CASE("GL_FRAMEBUFFER_UNDEFINED", "[egl]") {
+TEST_CASE("GL_FRAMEBUFFER_UNDEFINED", "[egl][headless]") {
     EGLDisplay es_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
     EGLint es_minor = 0;
     REQUIRE(eglInitialize(es_display, nullptr, &es_minor));
@@ -155,7 +163,7 @@ TEST_CASE("EGL_EXTENSIONS", "[egl][!mayfail]") {
     }
 }
 
-TEST_CASE("EGL_KHR_fence_sync/EGL_KHR_wait_sync", "[egl][!mayfail]") {
+TEST_CASE("EGL_KHR_fence_sync/EGL_KHR_wait_sync", "[egl][headless][!mayfail]") {
     EGLDisplay es_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
     egl_context_t context{es_display, EGL_NO_CONTEXT};
     REQUIRE_FALSE(context.handle() == EGL_NO_CONTEXT);
@@ -203,7 +211,7 @@ void setup_egl_config(EGLDisplay display, EGLConfig& config, EGLint& minor) {
         FAIL(eglGetError());
 }
 
-TEST_CASE("PixelBuffer Surface", "[egl]") {
+TEST_CASE("PixelBuffer Surface", "[egl][headless]") {
     EGLDisplay es_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
     EGLConfig es_config{};
     EGLint es_minor = 0;
@@ -238,7 +246,7 @@ TEST_CASE("PixelBuffer Surface", "[egl]") {
     }
 }
 
-TEST_CASE("EGLContext - PixelBuffer Surface", "[egl]") {
+TEST_CASE("EGLContext - PixelBuffer Surface", "[egl][headless]") {
     EGLDisplay es_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
     egl_context_t context{es_display, EGL_NO_CONTEXT};
     REQUIRE_FALSE(context.handle() == EGL_NO_CONTEXT);
@@ -275,7 +283,7 @@ bool has_extension(std::string_view name) noexcept {
 
 /// @see https://www.khronos.org/opengl/wiki/Synchronization
 /// @see http://docs.gl/es3/glFenceSync
-TEST_CASE("OpenGL Sync - Fence", "[opengl][synchronization][!mayfail]") {
+TEST_CASE("OpenGL Sync - Fence", "[opengl][synchronization][headless][!mayfail]") {
     EGLDisplay es_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
     egl_context_t context{es_display, EGL_NO_CONTEXT};
     REQUIRE_FALSE(context.handle() == EGL_NO_CONTEXT);
@@ -361,6 +369,55 @@ TEST_CASE("OpenGL Sync - Fence", "[opengl][synchronization][!mayfail]") {
     }
 }
 
+/// @see http://docs.gl/es3/glGenerateMipmap
+TEST_CASE("GL_TEXTURE_2D mipmap", "[opengl][headless]") {
+    EGLDisplay es_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    egl_context_t context{es_display, EGL_NO_CONTEXT};
+    REQUIRE_FALSE(context.handle() == EGL_NO_CONTEXT);
+    auto on_return = gsl::finally([&context, es_display]() {
+        context.destroy();
+        eglTerminate(es_display);
+    });
+    EGLint attrs[]{EGL_WIDTH, 16, EGL_HEIGHT, 16, EGL_NONE};
+    EGLSurface es_surface = eglCreatePbufferSurface(es_display, context.config(), attrs);
+    REQUIRE(eglGetError() == EGL_SUCCESS);
+    REQUIRE(context.resume(es_surface, EGL_NO_CONFIG_KHR) == 0);
+
+    GLuint tex = 0;
+    glGenTextures(1, &tex);
+    auto on_return_1 = gsl::finally([&tex]() { glDeleteTextures(1, &tex); });
+    constexpr GLsizei width = 64, height = 32;
+    REQUIRE(make_texture_storage(tex, GL_RGBA8, width, height, true) == GL_NO_ERROR);
+    GLint levels = 0;
+    glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_IMMUTABLE_LEVELS, &levels);
+    REQUIRE(levels == 7);
+
+    // left half is red, right half is blue. the last level must be their average
+    std::vector<uint32_t> pixels(width * height);
+    for (auto y = 0; y < height; ++y)
+        for (auto x = 0; x < width; ++x)
+            pixels[y * width + x] = x < width / 2 ? 0xFF'00'00'FF : 0xFF'FF'00'00;
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    REQUIRE(glGetError() == GL_NO_ERROR);
+    REQUIRE(generate_mipmap(tex) == GL_NO_ERROR);
+
+    GLuint fbo = 0;
+    glGenFramebuffers(1, &fbo);
+    auto on_return_2 = gsl::finally([&fbo]() { glDeleteFramebuffers(1, &fbo); });
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex, levels - 1);
+    REQUIRE(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+    uint8_t texel[4]{};
+    glReadPixels(0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, texel);
+    REQUIRE(glGetError() == GL_NO_ERROR);
+    REQUIRE(texel[0] == Approx(127).margin(2));
+    REQUIRE(texel[1] == 0);
+    REQUIRE(texel[2] == Approx(127).margin(2));
+    REQUIRE(texel[3] == 255);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+#if defined(_WIN32)
 /// @see https://support.microsoft.com/en-us/help/124103/how-to-obtain-a-console-window-handle-hwnd
 HWND get_hwnd_for_console() noexcept {
     constexpr auto max_length = 800;
@@ -521,7 +578,9 @@ TEST_CASE("GL_PIXEL_UNPACK_BUFFER 1", "[egl][windows][!mayfail]") {
     pbo_writer_t writer{length};
     REQUIRE(writer.is_valid() == GL_NO_ERROR);
 }
+#endif
 
+#if __has_include(<GLFW/glfw3.h>)
 auto start_opengl_test() -> gsl::final_action<void (*)()>;
 auto create_opengl_window(gsl::czstring<> window_name, GLint width, GLint height) noexcept
     -> std::unique_ptr<GLFWwindow, void (*)(GLFWwindow*)>;
@@ -567,6 +626,7 @@ TEST_CASE_METHOD(glfw_test_case, "GLFW + OpenGL ES", "[opengl][glfw]") {
     }
 }
 
+#if defined(_WIN32)
 TEST_CASE_METHOD(glfw_test_case, "EGLContext helper with GLFW", "[egl][glfw][!mayfail]") {
     glfwMakeContextCurrent(window.get());
     REQUIRE(glfwGetWin32Window(window.get()));
@@ -594,6 +654,7 @@ TEST_CASE_METHOD(glfw_test_case, "EGLContext helper with GLFW", "[egl][glfw][!ma
         }
     }
 }
+#endif
 
 /// @see https://docs.gl/
 TEST_CASE_METHOD(glfw_test_case, "GLFW info", "[glfw]") {
@@ -808,7 +869,7 @@ auto create_opengl_window(gsl::czstring<> window_name, GLint width, GLint height
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3); // 3.2 Core
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
-#elif defined(_WIN32)
+#else
 #if defined(GLFW_INCLUDE_ES2) || defined(GLFW_INCLUDE_ES3)
     glfwWindowHint(GLFW_CLIENT_API, GLFW_OPENGL_ES_API); // OpenGL ES
     glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
@@ -821,8 +882,9 @@ auto create_opengl_window(gsl::czstring<> window_name, GLint width, GLint height
     glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE); // ANGLE supports EGL_KHR_debug
 #endif
 #endif // defined(GLFW_INCLUDE_ES2) || defined(GLFW_INCLUDE_ES3)
-#endif // __APPLE__ || _WIN32
+#endif // __APPLE__
     glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
     return std::unique_ptr<GLFWwindow, void (*)(GLFWwindow*)>{glfwCreateWindow(width, height, window_name, NULL, NULL),
                                                               &glfwDestroyWindow};
 }
+#endif // __has_include(<GLFW/glfw3.h>)
@@ -0,0 +1,108 @@
+/**
+ * @author Park DongHa (luncliff@gmail.com)
+ */
+#include <catch2/catch.hpp>
+#include <spdlog/spdlog.h>
+
+#include <graphics.h>
+
+#include <cstring>
+#include <string>
+
+std::string read_text(FILE* stream) {
+    std::string txt{};
+    rewind(stream);
+    char buf[256]{};
+    while (auto len = fread(buf, 1, sizeof(buf), stream))
+        txt.append(buf, len);
+    return txt;
+}
+
+TEST_CASE("GPU time JSON", "[profiler]") {
+    const gpu_time_region_t regions[]{
+        {"frame", 1'000'000, 3'500'000},
+        {"\"quoted\"", 1'500'000, 2'000'000},
+    };
+    auto stream = std::unique_ptr<FILE, int (*)(FILE*)>{tmpfile(), &fclose};
+    REQUIRE(stream);
+    SECTION("regions") {
+        REQUIRE(write_gpu_time_json(stream.get(), regions) == 0);
+        const auto txt = read_text(stream.get());
+        REQUIRE(txt.find("{\"regions\":[") == 0);
+        REQUIRE(txt.find("\"name\":\"frame\"") != std::string::npos);
+        REQUIRE(txt.find("\"ms\":2.500000") != std::string::npos);
+        REQUIRE(txt.find("\"name\":\"\\\"quoted\\\"\"") != std::string::npos);
+    }
+    SECTION("chrome trace") {
+        REQUIRE(write_gpu_time_chrome_trace(stream.get(), regions, 7) == 0);
+        const auto txt = read_text(stream.get());
+        REQUIRE(txt.find("\"traceEvents\":[") != std::string::npos);
+        REQUIRE(txt.find("\"ph\":\"X\"") != std::string::npos);
+        REQUIRE(txt.find("\"tid\":7") != std::string::npos);
+        // microseconds
+        REQUIRE(txt.find("\"ts\":1000.000,\"dur\":2500.000") != std::string::npos);
+    }
+    SECTION("empty") {
+        REQUIRE(write_gpu_time_chrome_trace(stream.get(), {}) == 0);
+        REQUIRE(read_text(stream.get()).find("\"traceEvents\":[\n]") != std::string::npos);
+    }
+}
+
+TEST_CASE("GL_EXT_disjoint_timer_query", "[opengl][profiler][headless]") {
+    EGLDisplay es_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    egl_context_t context{es_display, EGL_NO_CONTEXT};
+    REQUIRE_FALSE(context.handle() == EGL_NO_CONTEXT);
+    EGLint attrs[]{EGL_WIDTH, 256, EGL_HEIGHT, 256, EGL_NONE};
+    EGLSurface es_surface = eglCreatePbufferSurface(es_display, context.config(), attrs);
+    REQUIRE(eglGetError() == EGL_SUCCESS);
+    REQUIRE(context.resume(es_surface, context.config()) == 0);
+
+    timer_query_t timer{};
+    if (auto ec = timer.is_valid()) {
+        WARN("GL_EXT_disjoint_timer_query is not available");
+        return;
+    }
+    std::vector<gpu_time_region_t> regions{};
+    for (auto i = 0u; i < 8; ++i) {
+        const auto region = timer.begin("clear");
+        REQUIRE(region != UINT16_MAX);
+        glClearColor(0, 0, 0, 1);
+        glClear(GL_COLOR_BUFFER_BIT);
+        timer.end(region);
+        timer.next_frame();
+        REQUIRE(timer.collect(regions) == GL_NO_ERROR);
+    }
+    glFinish();
+    timer.next_frame(); // move the last frame out of recording
+    REQUIRE(timer.collect(regions) == GL_NO_ERROR);
+    REQUIRE(regions.size() + timer.get_dropped() == 8);
+    for (const auto& region : regions) {
+        REQUIRE(strcmp(region.name, "clear") == 0);
+        REQUIRE(region.begin <= region.end);
+    }
+}
+
+TEST_CASE("flush_trace", "[profiler][headless]") {
+    EGLDisplay es_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    egl_context_t context{es_display, EGL_NO_CONTEXT};
+    REQUIRE_FALSE(context.handle() == EGL_NO_CONTEXT);
+    EGLint attrs[]{EGL_WIDTH, 64, EGL_HEIGHT, 64, EGL_NONE};
+    EGLSurface es_surface = eglCreatePbufferSurface(es_display, context.config(), attrs);
+    REQUIRE(eglGetError() == EGL_SUCCESS);
+    REQUIRE(context.resume(es_surface, context.config()) == 0);
+
+    auto stream = std::unique_ptr<FILE, int (*)(FILE*)>{tmpfile(), &fclose};
+    REQUIRE(stream);
+    REQUIRE(flush_trace(stream.get()) == 0);
+    const auto txt = read_text(stream.get());
+    REQUIRE(txt.find("\"traceEvents\":[") != std::string::npos);
+#if defined(GRAPHICS_USE_TRACE)
+    REQUIRE(txt.find("\"name\":\"egl_context_t::resume\"") != std::string::npos);
+#else
+    REQUIRE(txt.find("\"ph\":") == std::string::npos);
+#endif
+    SECTION("consumed") {
+        REQUIRE(flush_trace(stream.get()) == 0);
+        REQUIRE(read_text(stream.get()).find("egl_context_t::resume\"", txt.size()) == std::string::npos);
+    }
+}
@@ -0,0 +1,175 @@
+/**
+ * @author Park DongHa (luncliff@gmail.com)
+ */
+#include <catch2/catch.hpp>
+#include <spdlog/spdlog.h>
+
+#include <graphics.h>
+
+#include <string>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+auto open(const fs::path& p) -> std::unique_ptr<FILE, int (*)(FILE*)>;
+auto create(const fs::path& p) -> std::unique_ptr<FILE, int (*)(FILE*)>;
+
+constexpr auto vs_code = "#version 300 es\n"
+                         "void main() {\n"
+                         "    vec2 p = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);\n"
+                         "    gl_Position = vec4(p * 2.0 - 1.0, 0.0, 1.0);\n"
+                         "}\n";
+constexpr auto fs_code = "#version 300 es\n"
+                         "precision mediump float;\n"
+                         "out vec4 color;\n"
+                         "void main() {\n"
+                         "    color = vec4(1.0, 0.5, 0.0, 1.0);\n"
+                         "}\n";
+
+TEST_CASE("program_cache_t", "[opengl][headless]") {
+    EGLDisplay es_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    egl_context_t context{es_display, EGL_NO_CONTEXT};
+    REQUIRE_FALSE(context.handle() == EGL_NO_CONTEXT);
+    auto on_return = gsl::finally([&context, es_display]() {
+        context.destroy();
+        eglTerminate(es_display);
+    });
+    EGLint attrs[]{EGL_WIDTH, 16, EGL_HEIGHT, 16, EGL_NONE};
+    EGLSurface es_surface = eglCreatePbufferSurface(es_display, context.config(), attrs);
+    REQUIRE(eglGetError() == EGL_SUCCESS);
+    REQUIRE(context.resume(es_surface, context.config()) == 0);
+
+    const auto directory = fs::temp_directory_path() / "graphics_program_cache";
+    auto on_return_1 = gsl::finally([&directory]() {
+        std::error_code ec{};
+        fs::remove_all(directory, ec);
+    });
+    fs::remove_all(directory);
+    program_cache_t cache{directory};
+    if (cache.is_valid() == ENOTSUP)
+        return; // no program binary format
+    REQUIRE(cache.is_valid() == 0);
+    REQUIRE(cache.make_key(vs_code, fs_code) != cache.make_key(fs_code, vs_code));
+
+    std::string message{};
+    const auto program = glCreateProgram();
+    auto on_return_2 = gsl::finally([program]() { glDeleteProgram(program); });
+    REQUIRE(cache.load_or_build(program, vs_code, fs_code, message) == 0);
+    REQUIRE(cache.miss == 1);
+    REQUIRE(cache.hit == 0);
+    const auto key = cache.make_key(vs_code, fs_code);
+    REQUIRE(fs::exists(cache.get_path(key)));
+
+    SECTION("hit") {
+        const auto program2 = glCreateProgram();
+        auto on_return_3 = gsl::finally([program2]() { glDeleteProgram(program2); });
+        REQUIRE(cache.load_or_build(program2, vs_code, fs_code, message) == 0);
+        REQUIRE(cache.hit == 1);
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program2, GL_LINK_STATUS, &linked);
+        REQUIRE(linked == GL_TRUE);
+        glUseProgram(program2);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        REQUIRE(glGetError() == GL_NO_ERROR);
+        glUseProgram(0);
+    }
+    SECTION("other driver binary") {
+        // keep the header, break the binary. the driver rejects it and the entry is replaced
+        const auto fpath = cache.get_path(key);
+        program_cache_t::header_t header{};
+        {
+            auto stream = open(fpath);
+            REQUIRE(fread(&header, sizeof(header), 1, stream.get()) == 1);
+        }
+        {
+            auto stream = create(fpath);
+            const char garbage[64]{"not a program binary"};
+            REQUIRE(fwrite(&header, sizeof(header), 1, stream.get()) == 1);
+            REQUIRE(fwrite(garbage, sizeof(garbage), 1, stream.get()) == 1);
+        }
+        const auto program2 = glCreateProgram();
+        auto on_return_3 = gsl::finally([program2]() { glDeleteProgram(program2); });
+        REQUIRE(cache.load(key, program2) == EINVAL);
+        REQUIRE(cache.load_or_build(program2, vs_code, fs_code, message) == 0);
+        REQUIRE(cache.miss == 3);
+        REQUIRE(glGetError() == GL_NO_ERROR);
+        REQUIRE(cache.load(key, program2) == 0);
+    }
+    SECTION("broken entry") {
+        {
+            auto stream = create(cache.get_path(key));
+            REQUIRE(fwrite("abc", 3, 1, stream.get()) == 1);
+        }
+        const auto program2 = glCreateProgram();
+        auto on_return_3 = gsl::finally([program2]() { glDeleteProgram(program2); });
+        REQUIRE(cache.load(key, program2) == EBADMSG);
+    }
+    SECTION("compile error") {
+        const auto program2 = glCreateProgram();
+        auto on_return_3 = gsl::finally([program2]() { glDeleteProgram(program2); });
+        REQUIRE(cache.load_or_build(program2, vs_code, "#version 300 es\nvoid main() { error }\n", message) == EINVAL);
+        REQUIRE_FALSE(message.empty());
+    }
+}
+
+/// @brief same program with different constant, so the driver can't reuse the result
+std::string make_color_fs(uint32_t i) {
+    return std::string{"#version 300 es\n"
+                       "precision mediump float;\n"
+                       "out vec4 color;\n"
+                       "void main() {\n"
+                       "    color = vec4("} +
+           std::to_string(i % 256) + ".0 / 255.0, 0.5, 0.0, 1.0);\n}\n";
+}
+
+TEST_CASE("program_builder_t", "[opengl][headless]") {
+    EGLDisplay es_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    egl_context_t context{es_display, EGL_NO_CONTEXT};
+    REQUIRE_FALSE(context.handle() == EGL_NO_CONTEXT);
+    auto on_return = gsl::finally([&context, es_display]() {
+        context.destroy();
+        eglTerminate(es_display);
+    });
+    EGLint attrs[]{EGL_WIDTH, 16, EGL_HEIGHT, 16, EGL_NONE};
+    EGLSurface es_surface = eglCreatePbufferSurface(es_display, context.config(), attrs);
+    REQUIRE(eglGetError() == EGL_SUCCESS);
+    REQUIRE(context.resume(es_surface, context.config()) == 0);
+
+    const bool use_extension = GENERATE(true, false);
+    CAPTURE(use_extension);
+    std::vector<GLuint> programs(16);
+    auto on_return_1 = gsl::finally([&programs]() {
+        for (auto program : programs)
+            glDeleteProgram(program);
+    });
+    program_builder_t builder{es_display, 4, use_extension};
+    REQUIRE(builder.is_valid() == 0);
+    if (use_extension == false)
+        REQUIRE_FALSE(builder.is_parallel_compile());
+
+    for (auto i = 0u; i < programs.size(); ++i)
+        REQUIRE(builder.submit(vs_code, make_color_fs(i), programs[i]) == 0);
+    GLuint broken = 0;
+    REQUIRE(builder.submit(vs_code, "#version 300 es\nvoid main() { error }\n", broken) == 0);
+    programs.emplace_back(broken);
+
+    std::string message{};
+    REQUIRE(builder.get_status(0, message) == ENOENT);
+    // poll without blocking. the status is queried only for the programs in use
+    for (auto completed = 0u; completed < programs.size();) {
+        completed = 0;
+        for (auto program : programs)
+            completed += builder.is_completed(program);
+        std::this_thread::yield();
+    }
+    REQUIRE(builder.get_status(programs[3], message) == 0);
+    glUseProgram(programs[3]);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    REQUIRE(glGetError() == GL_NO_ERROR);
+    glUseProgram(0);
+    REQUIRE(builder.get_status(broken, message) == EINVAL);
+    REQUIRE_FALSE(message.empty());
+    // cached
+    REQUIRE(builder.get_status(broken, message) == EINVAL);
+    REQUIRE(builder.is_completed(broken));
+}
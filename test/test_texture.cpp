@@ -0,0 +1,259 @@
+/**
+ * @author Park DongHa (luncliff@gmail.com)
+ */
+#include <catch2/catch.hpp>
+#include <spdlog/spdlog.h>
+
+#include <graphics.h>
+
+#include <cmath>
+#include <cstring>
+
+namespace fs = std::filesystem;
+
+auto create(const fs::path& p) -> std::unique_ptr<FILE, int (*)(FILE*)>;
+
+/// @brief smooth gradient with a little noise. the alpha is a diagonal ramp
+std::vector<std::byte> make_test_image(uint32_t width, uint32_t height, uint32_t seed = 7) {
+    std::vector<std::byte> pixels(size_t{width} * height * 4);
+    for (auto y = 0u; y < height; ++y)
+        for (auto x = 0u; x < width; ++x) {
+            seed = seed * 1'664'525 + 1'013'904'223;
+            const auto noise = static_cast<int>(seed >> 29);
+            auto texel = &pixels[(size_t{y} * width + x) * 4];
+            texel[0] = static_cast<std::byte>(std::min<int>(x * 255 / width + noise, 255));
+            texel[1] = static_cast<std::byte>(std::min<int>(y * 255 / height + noise, 255));
+            texel[2] = static_cast<std::byte>((x + y) * 127 / (width + height) + 64);
+            texel[3] = static_cast<std::byte>((x + y) * 255 / (width + height));
+        }
+    return pixels;
+}
+
+/// @return double peak signal-to-noise ratio in dB. RGBA channels are equally weighted
+double get_psnr(gsl::span<const std::byte> lhs, gsl::span<const std::byte> rhs) {
+    double sum = 0;
+    for (auto i = 0u; i < lhs.size(); ++i) {
+        const auto d = static_cast<double>(lhs[i]) - static_cast<double>(rhs[i]);
+        sum += d * d;
+    }
+    if (sum == 0)
+        return INFINITY;
+    return 10 * std::log10(255.0 * 255.0 * lhs.size() / sum);
+}
+
+TEST_CASE("count_mip_levels", "[texture]") {
+    REQUIRE(count_mip_levels(1, 1) == 1);
+    REQUIRE(count_mip_levels(2, 1) == 2);
+    REQUIRE(count_mip_levels(400, 337) == 9);
+    REQUIRE(count_mip_levels(2160, 3840) == 12);
+}
+
+TEST_CASE("get_block_size", "[texture]") {
+    REQUIRE(get_block_size(block_format_t::rgba8, 5, 3) == 60);
+    REQUIRE(get_block_size(block_format_t::etc2_rgba8, 4, 4) == 16);
+    REQUIRE(get_block_size(block_format_t::etc2_rgba8, 5, 3) == 32);
+    REQUIRE(get_block_size(block_format_t::bc3, 1080, 608) == 270 * 152 * 16);
+}
+
+TEST_CASE("encode_blocks/decode_blocks", "[texture]") {
+    const auto format = GENERATE(block_format_t::etc2_rgba8, block_format_t::bc3);
+    CAPTURE(format);
+
+    SECTION("solid color") {
+        std::vector<std::byte> pixels(8 * 8 * 4);
+        for (auto i = 0u; i < pixels.size(); i += 4) {
+            pixels[i + 0] = std::byte{200}, pixels[i + 1] = std::byte{100};
+            pixels[i + 2] = std::byte{50}, pixels[i + 3] = std::byte{255};
+        }
+        std::vector<std::byte> blocks(get_block_size(format, 8, 8));
+        REQUIRE(encode_blocks(format, pixels, 8, 8, blocks) == 0);
+        std::vector<std::byte> decoded(pixels.size());
+        REQUIRE(decode_blocks(format, blocks, 8, 8, decoded) == 0);
+        for (auto i = 0u; i < pixels.size(); ++i)
+            REQUIRE(std::abs(static_cast<int>(pixels[i]) - static_cast<int>(decoded[i])) <= 8);
+        REQUIRE(decoded[3] == std::byte{255}); // alpha must be exact
+    }
+    SECTION("partial blocks") {
+        constexpr uint32_t width = 37, height = 21;
+        const auto pixels = make_test_image(width, height);
+        std::vector<std::byte> blocks(get_block_size(format, width, height));
+        REQUIRE(encode_blocks(format, pixels, width, height, blocks) == 0);
+        std::vector<std::byte> decoded(pixels.size());
+        REQUIRE(decode_blocks(format, blocks, width, height, decoded) == 0);
+        REQUIRE(get_psnr(pixels, decoded) > 32);
+    }
+    SECTION("small spans") {
+        std::vector<std::byte> pixels(16 * 4);
+        std::vector<std::byte> blocks(8);
+        REQUIRE(encode_blocks(format, pixels, 4, 4, blocks) == EINVAL);
+        REQUIRE(decode_blocks(format, blocks, 4, 4, pixels) == EINVAL);
+    }
+}
+
+/// @brief "width height" in 2 uint32_t, then RGBA pixels
+uint32_t get_raw_info(gsl::span<const std::byte> encoded, uint32_t& width, uint32_t& height) {
+    if (encoded.size() < 8)
+        return EINVAL;
+    memcpy(&width, encoded.data(), 4);
+    memcpy(&height, encoded.data() + 4, 4);
+    return encoded.size() == 8 + size_t{width} * height * 4 ? 0 : EINVAL;
+}
+
+uint32_t decode_raw(gsl::span<const std::byte> encoded, gsl::span<std::byte> pixels) {
+    memcpy(pixels.data(), encoded.data() + 8, pixels.size());
+    return 0;
+}
+
+void write_raw_image(const fs::path& fpath, uint32_t width, uint32_t height, uint32_t seed) {
+    const auto pixels = make_test_image(width, height, seed);
+    auto stream = create(fpath);
+    REQUIRE(fwrite(&width, 4, 1, stream.get()) == 1);
+    REQUIRE(fwrite(&height, 4, 1, stream.get()) == 1);
+    REQUIRE(fwrite(pixels.data(), 1, pixels.size(), stream.get()) == pixels.size());
+}
+
+TEST_CASE("block_cache_t", "[texture]") {
+    const auto directory = fs::temp_directory_path() / "graphics_block_cache";
+    const auto fpath = fs::temp_directory_path() / "graphics_block_cache.raw";
+    auto on_return = gsl::finally([&]() {
+        std::error_code ec{};
+        fs::remove_all(directory, ec);
+        fs::remove(fpath, ec);
+    });
+    fs::remove_all(directory);
+    write_raw_image(fpath, 64, 32, 1);
+
+    block_cache_t cache{directory};
+    REQUIRE(cache.is_valid() == 0);
+    const image_codec_t codec{&get_raw_info, &decode_raw};
+    block_cache_t::header_t header{};
+    std::unique_ptr<mapped_file_t> entry{};
+    REQUIRE(cache.load_or_encode(fpath, block_format_t::bc3, codec, header, entry) == 0);
+    REQUIRE(cache.miss == 1);
+    REQUIRE(cache.hit == 0);
+    REQUIRE(header.width == 64);
+    REQUIRE(header.height == 32);
+    REQUIRE(entry->bytes().size() == sizeof(header) + get_block_size(block_format_t::bc3, 64, 32));
+    const std::vector<std::byte> expected(entry->bytes().begin(), entry->bytes().end());
+
+    SECTION("hit") {
+        std::unique_ptr<mapped_file_t> entry2{};
+        REQUIRE(cache.load_or_encode(fpath, block_format_t::bc3, codec, header, entry2) == 0);
+        REQUIRE(cache.hit == 1);
+        REQUIRE(entry2->bytes().size() == expected.size());
+        REQUIRE(memcmp(entry2->bytes().data(), expected.data(), expected.size()) == 0);
+    }
+    SECTION("other format") {
+        std::unique_ptr<mapped_file_t> entry2{};
+        REQUIRE(cache.load_or_encode(fpath, block_format_t::etc2_rgba8, codec, header, entry2) == 0);
+        REQUIRE(cache.miss == 2);
+        REQUIRE(header.format == block_format_t::etc2_rgba8);
+    }
+    SECTION("content change") {
+        entry.reset();
+        write_raw_image(fpath, 64, 32, 2);
+        REQUIRE(cache.load_or_encode(fpath, block_format_t::bc3, codec, header, entry) == 0);
+        REQUIRE(cache.miss == 2);
+        REQUIRE(memcmp(entry->bytes().data(), expected.data(), expected.size()) != 0);
+    }
+    SECTION("broken entry") {
+        entry.reset();
+        mapped_file_t raw{fpath};
+        const auto key = hash_content(raw.bytes());
+        fs::resize_file(cache.get_path(key, block_format_t::bc3), 100);
+        REQUIRE(cache.load(key, block_format_t::bc3, header, entry) == EBADMSG);
+        REQUIRE(cache.load_or_encode(fpath, block_format_t::bc3, codec, header, entry) == 0);
+        REQUIRE(entry->bytes().size() == expected.size());
+    }
+}
+
+/// @brief copy the texels to the same size framebuffer with `texelFetch` and read it
+void read_texture(GLuint tex, GLsizei width, GLsizei height, std::vector<std::byte>& pixels) {
+    constexpr auto vs_code = "#version 300 es\n"
+                        "void main() {\n"
+                        "    vec2 p = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);\n"
+                        "    gl_Position = vec4(p * 2.0 - 1.0, 0.0, 1.0);\n"
+                        "}\n";
+    constexpr auto fs_code = "#version 300 es\n"
+                        "precision mediump float;\n"
+                        "uniform sampler2D tex;\n"
+                        "out vec4 color;\n"
+                        "void main() {\n"
+                        "    color = texelFetch(tex, ivec2(gl_FragCoord.xy), 0);\n"
+                        "}\n";
+    const auto program = glCreateProgram();
+    auto on_return_1 = gsl::finally([program]() { glDeleteProgram(program); });
+    for (auto [type, code] : {std::make_pair(GL_VERTEX_SHADER, vs_code), //
+                              std::make_pair(GL_FRAGMENT_SHADER, fs_code)}) {
+        const auto shader = glCreateShader(type);
+        glShaderSource(shader, 1, &code, nullptr);
+        glCompileShader(shader);
+        glAttachShader(program, shader);
+        glDeleteShader(shader);
+    }
+    glLinkProgram(program);
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    REQUIRE(linked == GL_TRUE);
+
+    GLuint target = 0, fbo = 0;
+    glGenTextures(1, &target);
+    auto on_return_2 = gsl::finally([&target]() { glDeleteTextures(1, &target); });
+    REQUIRE(make_texture_storage(target, GL_RGBA8, width, height, false) == GL_NO_ERROR);
+    glGenFramebuffers(1, &fbo);
+    auto on_return_3 = gsl::finally([&fbo]() {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &fbo);
+    });
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target, 0);
+    REQUIRE(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+
+    glUseProgram(program);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glViewport(0, 0, width, height);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    pixels.resize(static_cast<size_t>(width) * height * 4);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    REQUIRE(glGetError() == GL_NO_ERROR);
+}
+
+TEST_CASE("upload_blocks", "[opengl][headless]") {
+    EGLDisplay es_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    egl_context_t context{es_display, EGL_NO_CONTEXT};
+    REQUIRE_FALSE(context.handle() == EGL_NO_CONTEXT);
+    auto on_return = gsl::finally([&context, es_display]() {
+        context.destroy();
+        eglTerminate(es_display);
+    });
+    EGLint attrs[]{EGL_WIDTH, 16, EGL_HEIGHT, 16, EGL_NONE};
+    EGLSurface es_surface = eglCreatePbufferSurface(es_display, context.config(), attrs);
+    REQUIRE(eglGetError() == EGL_SUCCESS);
+    REQUIRE(context.resume(es_surface, context.config()) == 0);
+
+    // ETC2 is required by OpenGL ES 3.0. BC3 is optional
+    const auto format = GENERATE(block_format_t::etc2_rgba8, block_format_t::bc3, block_format_t::rgba8);
+    CAPTURE(format);
+    if (format == block_format_t::bc3 && select_block_format() != block_format_t::bc3)
+        return;
+    constexpr uint32_t width = 64, height = 40;
+    const auto pixels = make_test_image(width, height);
+    std::vector<std::byte> blocks(get_block_size(format, width, height));
+    REQUIRE(encode_blocks(format, pixels, width, height, blocks) == 0);
+    std::vector<std::byte> expected(pixels.size());
+    REQUIRE(decode_blocks(format, blocks, width, height, expected) == 0);
+
+    GLuint tex = 0;
+    glGenTextures(1, &tex);
+    auto on_return_1 = gsl::finally([&tex]() { glDeleteTextures(1, &tex); });
+    REQUIRE(make_texture_storage(tex, get_gl_format(format), width, height, false) == GL_NO_ERROR);
+    REQUIRE(upload_blocks(tex, format, width, height, blocks) == GL_NO_ERROR);
+    std::vector<std::byte> actual{};
+    read_texture(tex, width, height, actual);
+    // the decoders may round the interpolation differently
+    for (auto i = 0u; i < actual.size(); ++i) {
+        CAPTURE(i);
+        REQUIRE(std::abs(static_cast<int>(actual[i]) - static_cast<int>(expected[i])) <= 3);
+    }
+}
@@ -6,14 +6,15 @@
 #include <spdlog/spdlog.h>
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
-#define STB_IMAGE_IMPLEMENTATION
-#define STB_IMAGE_WRITE_IMPLEMENTATION
+// the implementation is in test_gltf.cpp
 #include <stb_image.h>
 #include <stb_image_write.h>
 // #include <tiny_gltf.h>
 
 #include "vulkan_1.h"
 
+#include <cstring>
+
 using namespace std;
 
 fs::path get_asset_dir() noexcept;
@@ -141,12 +142,16 @@ VkResult read_image_data(VkDevice device, const VkPhysicalDeviceMemoryProperties
                          VkBuffer& buffer, VkDeviceMemory& memory,                         //
                          const fs::path& fpath) {
     auto stream = get_current_stream();
-    auto fin = open(fpath);
+    const mapped_file_t fin{fpath};
+    if (auto ec = fin.is_valid())
+        throw std::system_error{static_cast<int>(ec), std::system_category(), "mapped_file_t"};
+    const auto encoded = fin.bytes();
     int width = 0, height = 0;
     component = STBI_rgb_alpha;
-    auto blob = std::unique_ptr<void, void (*)(void*)>{stbi_load_from_file(fin.get(), //
-                                                                           &width, &height, &component, component),
-                                                       &stbi_image_free};
+    auto blob = std::unique_ptr<void, void (*)(void*)>{
+        stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(encoded.data()), static_cast<int>(encoded.size()), //
+                              &width, &height, &component, component),
+        &stbi_image_free};
     if (blob == nullptr)
         throw std::runtime_error{stbi_failure_reason()};
     extent.width = width;
@@ -296,178 +301,38 @@ TEST_CASE("create VkImage from image file", "[image]") {
     REQUIRE(make_image(device, meminfo, image_extent, image_format, //
                        images[0], memories[1]) == VK_SUCCESS);
 
-    SECTION("transfer multiple VkCommandBuffer 1 by 1") {
-        vulkan_command_pool_t command_pool{device, qinfo.queueFamilyIndex, 3};
-        // when using multiple command buffer and they are submitted at once,
-        // theire execution may in out of order. submit 1 by 1
-        VkSubmitInfo submit{};
-        submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        {
-            // image layout transition before copy ( UNDEFINED -> TRANSFER_DST_OPTIMAL )
-            auto command_buffer = command_pool.buffers[0];
-            submit.commandBufferCount = 1;
-            submit.pCommandBuffers = &command_buffer;
-            VkCommandBufferBeginInfo begin{};
-            begin.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-            begin.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-            REQUIRE(vkBeginCommandBuffer(command_buffer, &begin) == VK_SUCCESS);
-            {
-                VkImageMemoryBarrier barrier{};
-                barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-                barrier.srcQueueFamilyIndex = barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-                barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED; // image's current layout
-                barrier.srcAccessMask = 0;
-                barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL; // destination
-                barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;     //  of copy(write access)
-                barrier.image = images[0];
-                barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-                barrier.subresourceRange.baseMipLevel = 0, barrier.subresourceRange.levelCount = 1;
-                barrier.subresourceRange.baseArrayLayer = 0, barrier.subresourceRange.layerCount = 1;
-                vkCmdPipelineBarrier(command_buffer, //
-                                     VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
-                                     //
-                                     0, nullptr, // memory
-                                     0, nullptr, // buffer
-                                     1, &barrier // image
-                );
-            }
-            REQUIRE(vkEndCommandBuffer(command_buffer) == VK_SUCCESS);
-            REQUIRE(vkQueueSubmit(queue, 1, &submit, VK_NULL_HANDLE) == VK_SUCCESS);
-        }
-        {
-            // copy buffer to image: ( BUFFER_TRANSFER_SRC -> IMAGE_LAYOUT_TRANSFER_DST )
-            auto command_buffer = command_pool.buffers[1];
-            submit.commandBufferCount = 1;
-            submit.pCommandBuffers = &command_buffer;
-            VkCommandBufferBeginInfo begin{};
-            begin.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-            begin.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-            REQUIRE(vkBeginCommandBuffer(command_buffer, &begin) == VK_SUCCESS);
-            {
-                VkBufferImageCopy regions[1]{};
-                regions[0].bufferOffset = 0; // from VkBuffer
-                regions[0].bufferRowLength = 0;
-                regions[0].bufferImageHeight = 0;
-                regions[0].imageOffset = {0, 0, 0}; // to VkImage
-                regions[0].imageExtent = {image_extent.width, image_extent.height, 1};
-                regions[0].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-                regions[0].imageSubresource.mipLevel = 0;
-                regions[0].imageSubresource.baseArrayLayer = 0;
-                regions[0].imageSubresource.layerCount = 1;
-                vkCmdCopyBufferToImage(command_buffer, //
-                                       buffers[0], images[0],
-                                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, // see above layout
-                                       1, regions);
-            }
-            REQUIRE(vkEndCommandBuffer(command_buffer) == VK_SUCCESS);
-            REQUIRE(vkQueueSubmit(queue, 1, &submit, VK_NULL_HANDLE) == VK_SUCCESS);
-        }
-        {
-            // image layout transition after copy ( TRANSFER_DST_OPTIMAL -> SHADER_READ_ONLY_OPTIMAL )
-            auto command_buffer = command_pool.buffers[2];
-            submit.commandBufferCount = 1;
-            submit.pCommandBuffers = &command_buffer;
-            VkCommandBufferBeginInfo begin{};
-            begin.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-            begin.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-            REQUIRE(vkBeginCommandBuffer(command_buffer, &begin) == VK_SUCCESS);
-            {
-                VkImageMemoryBarrier barrier{};
-                barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-                barrier.srcQueueFamilyIndex = barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-                barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL; // was copy destination
-                barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-                barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL; // shader can read
-                barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-                barrier.image = images[0];
-                barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-                barrier.subresourceRange.baseMipLevel = 0, barrier.subresourceRange.levelCount = 1;
-                barrier.subresourceRange.baseArrayLayer = 0, barrier.subresourceRange.layerCount = 1;
-                vkCmdPipelineBarrier(command_buffer, //
-                                     VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-                                     //
-                                     0, nullptr, // memory
-                                     0, nullptr, // buffer
-                                     1, &barrier // image
-                );
-            }
-            REQUIRE(vkEndCommandBuffer(command_buffer) == VK_SUCCESS);
-            REQUIRE(vkQueueSubmit(queue, 1, &submit, VK_NULL_HANDLE) == VK_SUCCESS);
-        }
-        REQUIRE(vkQueueWaitIdle(queue) == VK_SUCCESS);
-    }
-    SECTION("transfer in 1 VkCommandBuffer") {
-        // combine to 1 command buffer in order and submit once
-        vulkan_command_pool_t command_pool{device, qinfo.queueFamilyIndex, 3};
-        VkSubmitInfo submit{};
-        submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    // 1 command buffer, 1 submit. the barrier builder tracks the layout of the image
+    {
+        vulkan_command_pool_t command_pool{device, qinfo.queueFamilyIndex, 1};
         auto command_buffer = command_pool.buffers[0];
-        submit.commandBufferCount = 1;
-        submit.pCommandBuffers = &command_buffer;
         VkCommandBufferBeginInfo begin{};
         begin.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
         begin.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
         REQUIRE(vkBeginCommandBuffer(command_buffer, &begin) == VK_SUCCESS);
-        {
-            // image layout transition before copy ( UNDEFINED -> TRANSFER_DST_OPTIMAL )
-            VkImageMemoryBarrier barrier{};
-            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-            barrier.srcQueueFamilyIndex = barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-            barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED; // image's current layout
-            barrier.srcAccessMask = 0;
-            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL; // destination
-            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;     //  of copy(write access)
-            barrier.image = images[0];
-            barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            barrier.subresourceRange.baseMipLevel = 0, barrier.subresourceRange.levelCount = 1;
-            barrier.subresourceRange.baseArrayLayer = 0, barrier.subresourceRange.layerCount = 1;
-            vkCmdPipelineBarrier(command_buffer, //
-                                 VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
-                                 //
-                                 0, nullptr, // memory
-                                 0, nullptr, // buffer
-                                 1, &barrier // image
-            );
-        }
+        const VkImageSubresourceRange range{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        vulkan_barrier_builder_t barriers{};
+        barriers.track(images[0], VK_IMAGE_ASPECT_COLOR_BIT, 1);
+        // image layout transition before copy ( UNDEFINED -> TRANSFER_DST_OPTIMAL )
+        REQUIRE(barriers.transition(images[0], range, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, //
+                                    VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT) == 0);
+        REQUIRE(barriers.flush(command_buffer) == 1);
         {
             // copy buffer to image: ( BUFFER_TRANSFER_SRC -> IMAGE_LAYOUT_TRANSFER_DST )
             VkBufferImageCopy regions[1]{};
-            regions[0].bufferOffset = 0; // from VkBuffer
-            regions[0].bufferRowLength = 0;
-            regions[0].bufferImageHeight = 0;
-            regions[0].imageOffset = {0, 0, 0}; // to VkImage
             regions[0].imageExtent = {image_extent.width, image_extent.height, 1};
-            regions[0].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            regions[0].imageSubresource.mipLevel = 0;
-            regions[0].imageSubresource.baseArrayLayer = 0;
-            regions[0].imageSubresource.layerCount = 1;
-            vkCmdCopyBufferToImage(command_buffer, //
-                                   buffers[0], images[0],
-                                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, // see above layout
+            regions[0].imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+            vkCmdCopyBufferToImage(command_buffer, buffers[0], images[0], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, //
                                    1, regions);
         }
-        {
-            // image layout transition after copy ( TRANSFER_DST_OPTIMAL -> SHADER_READ_ONLY_OPTIMAL )
-            VkImageMemoryBarrier barrier{};
-            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-            barrier.srcQueueFamilyIndex = barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL; // was copy destination
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL; // shader can read
-            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-            barrier.image = images[0];
-            barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            barrier.subresourceRange.baseMipLevel = 0, barrier.subresourceRange.levelCount = 1;
-            barrier.subresourceRange.baseArrayLayer = 0, barrier.subresourceRange.layerCount = 1;
-            vkCmdPipelineBarrier(command_buffer, //
-                                 VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-                                 //
-                                 0, nullptr, // memory
-                                 0, nullptr, // buffer
-                                 1, &barrier // image
-            );
-        }
+        // image layout transition after copy ( TRANSFER_DST_OPTIMAL -> SHADER_READ_ONLY_OPTIMAL )
+        REQUIRE(barriers.transition(images[0], range, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, //
+                                    VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT) == 0);
+        REQUIRE(barriers.flush(command_buffer) == 1);
         REQUIRE(vkEndCommandBuffer(command_buffer) == VK_SUCCESS);
+        VkSubmitInfo submit{};
+        submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit.commandBufferCount = 1;
+        submit.pCommandBuffers = &command_buffer;
         REQUIRE(vkQueueSubmit(queue, 1, &submit, VK_NULL_HANDLE) == VK_SUCCESS);
         REQUIRE(vkQueueWaitIdle(queue) == VK_SUCCESS);
     }
@@ -505,9 +370,695 @@ TEST_CASE("create VkImage from image file", "[image]") {
         info.unnormalizedCoordinates = VK_FALSE; // [0, 1)
         info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
         info.mipLodBias = 0;
-        info.minLod = info.maxLod = 0;
+        info.minLod = 0;
+        info.maxLod = VK_LOD_CLAMP_NONE; // all generated levels
         REQUIRE(vkCreateSampler(device, &info, nullptr, &sampler) == VK_SUCCESS);
     }
     auto on_return_3 = gsl::finally([device, sampler]() { vkDestroySampler(device, sampler, nullptr); });
     // ...
 }
+
+uint32_t get_image_info(gsl::span<const std::byte> encoded, uint32_t& width, uint32_t& height) {
+    int w = 0, h = 0, c = 0;
+    if (stbi_info_from_memory(reinterpret_cast<const stbi_uc*>(encoded.data()), static_cast<int>(encoded.size()), //
+                              &w, &h, &c) == 0)
+        return EINVAL;
+    width = static_cast<uint32_t>(w);
+    height = static_cast<uint32_t>(h);
+    return 0;
+}
+
+/// @note stb_image has its own allocation for the result. Copy it to the staging memory and free right away
+uint32_t decode_image(gsl::span<const std::byte> encoded, gsl::span<std::byte> pixels) {
+    int w = 0, h = 0, c = 0;
+    auto blob = std::unique_ptr<void, void (*)(void*)>{
+        stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(encoded.data()), static_cast<int>(encoded.size()), //
+                              &w, &h, &c, STBI_rgb_alpha),
+        &stbi_image_free};
+    if (blob == nullptr)
+        return EINVAL;
+    if (static_cast<size_t>(w) * h * 4 != pixels.size())
+        return ERANGE;
+    memcpy(pixels.data(), blob.get(), pixels.size());
+    return 0;
+}
+
+TEST_CASE("vulkan_barrier_builder_t", "[vulkan][image]") {
+    vulkan_instance_t instance{"app1", {}, {}};
+    VkPhysicalDevice physical_device{};
+    REQUIRE(get_physical_device(instance.handle, physical_device) == VK_SUCCESS);
+    VkDevice device{};
+    VkDeviceQueueCreateInfo qinfo{};
+    REQUIRE(create_device(physical_device, device, qinfo) == VK_SUCCESS);
+    auto on_return_0 = gsl::finally([device]() {
+        vkDestroyDevice(device, nullptr); //
+    });
+    vulkan_command_pool_t command_pool{device, qinfo.queueFamilyIndex, 1};
+    auto command_buffer = command_pool.buffers[0];
+    VkCommandBufferBeginInfo begin{};
+    begin.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    REQUIRE(vkBeginCommandBuffer(command_buffer, &begin) == VK_SUCCESS);
+    auto on_return_1 = gsl::finally([command_buffer]() { vkEndCommandBuffer(command_buffer); });
+
+    VkImage image{};
+    VkDeviceMemory memory{};
+    {
+        VkImageCreateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        info.imageType = VK_IMAGE_TYPE_2D;
+        info.format = VK_FORMAT_R8G8B8A8_UNORM;
+        info.extent = {64, 64, 1};
+        info.mipLevels = 4;
+        info.arrayLayers = 1;
+        info.samples = VK_SAMPLE_COUNT_1_BIT;
+        info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        info.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT |
+                     VK_IMAGE_USAGE_STORAGE_BIT;
+        info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        REQUIRE(vkCreateImage(device, &info, nullptr, &image) == VK_SUCCESS);
+    }
+    auto on_return_2 = gsl::finally([device, image, &memory]() {
+        vkDestroyImage(device, image, nullptr);
+        vkFreeMemory(device, memory, nullptr);
+    });
+    {
+        VkPhysicalDeviceMemoryProperties props{};
+        vkGetPhysicalDeviceMemoryProperties(physical_device, &props);
+        VkMemoryRequirements requirements{};
+        vkGetImageMemoryRequirements(device, image, &requirements);
+        VkMemoryAllocateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        info.allocationSize = requirements.size;
+        info.memoryTypeIndex = get_memory_type(props, requirements.memoryTypeBits, 0);
+        REQUIRE(vkAllocateMemory(device, &info, nullptr, &memory) == VK_SUCCESS);
+        REQUIRE(vkBindImageMemory(device, image, memory, 0) == VK_SUCCESS);
+    }
+    vulkan_barrier_builder_t barriers{};
+    const VkImageSubresourceRange all{VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, 1};
+    REQUIRE(barriers.transition(image, all, VK_IMAGE_LAYOUT_GENERAL, 0, 0) == EINVAL);
+    barriers.track(image, VK_IMAGE_ASPECT_COLOR_BIT, 4);
+    REQUIRE(barriers.transition(image, {VK_IMAGE_ASPECT_COLOR_BIT, 3, 2, 0, 1}, VK_IMAGE_LAYOUT_GENERAL, 0, 0) ==
+            EINVAL);
+    REQUIRE(barriers.flush(VK_NULL_HANDLE) == 0);
+
+    SECTION("fold the transitions before flush") {
+        barriers.transition(image, all, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, //
+                            VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+        barriers.transition(image, all, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, //
+                            VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+        vulkan_barrier_builder_t::state_t state{};
+        REQUIRE(barriers.get_state(image, 3, 0, state) == 0);
+        REQUIRE(state.layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        REQUIRE(barriers.get_state(image, 4, 0, state) == EINVAL);
+        // 4 levels in 1 barrier
+        REQUIRE(barriers.flush(command_buffer) == 1);
+        REQUIRE(barriers.flush(command_buffer) == 0);
+    }
+    SECTION("skip read after read") {
+        // never written since `track`
+        barriers.track(image, VK_IMAGE_ASPECT_COLOR_BIT, 4, 1, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        barriers.transition(image, all, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, //
+                            VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+        REQUIRE(barriers.flush(command_buffer) == 0);
+        barriers.transition(image, all, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, //
+                            VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
+        REQUIRE(barriers.flush(command_buffer) == 0);
+        vulkan_barrier_builder_t::state_t state{};
+        REQUIRE(barriers.get_state(image, 0, 0, state) == 0);
+        REQUIRE(state.stage == (VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT));
+    }
+    SECTION("read after write in the other stage") {
+        barriers.transition(image, all, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, //
+                            VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+        REQUIRE(barriers.flush(command_buffer) == 1);
+        barriers.transition(image, all, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, //
+                            VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+        REQUIRE(barriers.flush(command_buffer) == 1);
+        // the write is already visible to the fragment shader
+        barriers.transition(image, all, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, //
+                            VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+        REQUIRE(barriers.flush(command_buffer) == 0);
+        // but not to the compute shader
+        barriers.transition(image, all, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, //
+                            VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+        REQUIRE(barriers.flush(command_buffer) == 1);
+        vulkan_barrier_builder_t::state_t state{};
+        REQUIRE(barriers.get_state(image, 0, 0, state) == 0);
+        REQUIRE(state.layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        REQUIRE(state.stage == (VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT));
+        REQUIRE(state.write_access == VK_ACCESS_TRANSFER_WRITE_BIT);
+    }
+    SECTION("split the levels with different states") {
+        barriers.transition(image, all, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, //
+                            VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+        REQUIRE(barriers.flush(command_buffer) == 1);
+        barriers.transition(image, {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                            VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+        REQUIRE(barriers.flush(command_buffer) == 1);
+        // level 0 from TRANSFER_SRC, level 1-3 from TRANSFER_DST
+        barriers.transition(image, all, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, //
+                            VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+        REQUIRE(barriers.flush(command_buffer) == 2);
+    }
+    SECTION("forget") {
+        barriers.transition(image, all, VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_WRITE_BIT,
+                            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+        barriers.forget(image);
+        REQUIRE(barriers.flush(command_buffer) == 0);
+    }
+}
+
+TEST_CASE("vulkan_texture_batch_t", "[vulkan][image]") {
+    const char* layers[1]{"VK_LAYER_KHRONOS_validation"};
+    vulkan_instance_t instance{"app1", gsl::make_span(layers, 1), {}};
+    VkPhysicalDevice physical_device{};
+    REQUIRE(get_physical_device(instance.handle, physical_device) == VK_SUCCESS);
+    VkPhysicalDeviceMemoryProperties meminfo{};
+    vkGetPhysicalDeviceMemoryProperties(physical_device, &meminfo);
+    VkDevice device{};
+    VkDeviceQueueCreateInfo qinfo{};
+    REQUIRE(create_device(physical_device, device, qinfo) == VK_SUCCESS);
+    auto on_return_0 = gsl::finally([device]() {
+        vkDestroyDevice(device, nullptr); //
+    });
+    VkQueue queue = VK_NULL_HANDLE;
+    vkGetDeviceQueue(device, qinfo.queueFamilyIndex, 0, &queue);
+
+    const fs::path files[]{
+        get_asset_dir() / "image_400_337.jpg",
+        get_asset_dir() / "image_1080_608.png",
+        get_asset_dir() / "image_2160_3840.png",
+        get_asset_dir() / "missing.png",
+    };
+    const image_codec_t codec{&get_image_info, &decode_image};
+    const bool mipmap = GENERATE(false, true);
+    vulkan_texture_batch_t batch{device, meminfo, files, codec, 0, mipmap};
+    REQUIRE(batch.textures.size() == 4);
+    REQUIRE(batch.textures[0].ec == 0);
+    REQUIRE(batch.textures[1].extent.width == 1080);
+    REQUIRE(batch.textures[1].extent.height == 608);
+    REQUIRE(batch.textures[1].mip_levels == (mipmap ? 11 : 1));
+    REQUIRE(batch.textures[2].image != VK_NULL_HANDLE);
+    REQUIRE(batch.textures[2].mip_levels == (mipmap ? 12 : 1));
+    REQUIRE(batch.textures[3].ec != 0);
+    REQUIRE(batch.textures[3].image == VK_NULL_HANDLE);
+
+    // the readback of the level 0 of the first image
+    const auto& source = batch.textures[0];
+    const VkDeviceSize readback_size = VkDeviceSize{source.extent.width} * source.extent.height * 4;
+    VkBufferCreateInfo readback_info{};
+    readback_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    readback_info.size = readback_size;
+    readback_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    readback_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VkBuffer readback{};
+    REQUIRE(vkCreateBuffer(device, &readback_info, nullptr, &readback) == VK_SUCCESS);
+    VkDeviceMemory readback_memory{};
+    auto on_return_1 = gsl::finally([device, readback, &readback_memory]() {
+        vkDestroyBuffer(device, readback, nullptr);
+        vkFreeMemory(device, readback_memory, nullptr);
+    });
+    REQUIRE(allocate_memory(device, readback, readback_memory, readback_info,
+                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                            meminfo) == VK_SUCCESS);
+    REQUIRE(vkBindBufferMemory(device, readback, readback_memory, 0) == VK_SUCCESS);
+
+    // 1 command buffer, 1 submit for all images
+    vulkan_command_pool_t command_pool{device, qinfo.queueFamilyIndex, 1};
+    auto command_buffer = command_pool.buffers[0];
+    VkCommandBufferBeginInfo begin{};
+    begin.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    REQUIRE(vkBeginCommandBuffer(command_buffer, &begin) == VK_SUCCESS);
+    vulkan_barrier_builder_t barriers{};
+    batch.record(command_buffer, barriers);
+    {
+        REQUIRE(barriers.transition(source.image, {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+                                    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT,
+                                    VK_PIPELINE_STAGE_TRANSFER_BIT) == 0);
+        REQUIRE(barriers.flush(command_buffer) == 1);
+        VkBufferImageCopy region{};
+        region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+        region.imageExtent = {source.extent.width, source.extent.height, 1};
+        vkCmdCopyImageToBuffer(command_buffer, source.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback, 1,
+                               &region);
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1,
+                             &barrier, 0, nullptr, 0, nullptr);
+    }
+    REQUIRE(vkEndCommandBuffer(command_buffer) == VK_SUCCESS);
+    VkSubmitInfo submit{};
+    submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit.commandBufferCount = 1;
+    submit.pCommandBuffers = &command_buffer;
+    REQUIRE(vkQueueSubmit(queue, 1, &submit, VK_NULL_HANDLE) == VK_SUCCESS);
+    REQUIRE(vkQueueWaitIdle(queue) == VK_SUCCESS);
+    batch.release_staging();
+    REQUIRE(batch.staging == VK_NULL_HANDLE);
+
+    // same pixels with the CPU decoding of the file
+    mapped_file_t file{files[0]};
+    REQUIRE(file.is_valid() == 0);
+    vector<std::byte> expected(readback_size);
+    REQUIRE(decode_image(file.bytes(), expected) == 0);
+    void* mapping = nullptr;
+    REQUIRE(vkMapMemory(device, readback_memory, 0, VK_WHOLE_SIZE, 0, &mapping) == VK_SUCCESS);
+    const auto equal = std::memcmp(mapping, expected.data(), expected.size()) == 0;
+    vkUnmapMemory(device, readback_memory);
+    REQUIRE(equal);
+}
+
+TEST_CASE("vulkan_texture_batch_t with blocks", "[vulkan][image]") {
+    const char* layers[1]{"VK_LAYER_KHRONOS_validation"};
+    vulkan_instance_t instance{"app1", gsl::make_span(layers, 1), {}};
+    VkPhysicalDevice physical_device{};
+    REQUIRE(get_physical_device(instance.handle, physical_device) == VK_SUCCESS);
+    VkPhysicalDeviceMemoryProperties meminfo{};
+    vkGetPhysicalDeviceMemoryProperties(physical_device, &meminfo);
+    const auto blocks = select_block_format(physical_device);
+    if (blocks == block_format_t::rgba8)
+        return spdlog::warn("no block format for the device");
+    VkDevice device{};
+    VkDeviceQueueCreateInfo qinfo{};
+    REQUIRE(create_device(physical_device, device, qinfo) == VK_SUCCESS);
+    auto on_return_0 = gsl::finally([device]() {
+        vkDestroyDevice(device, nullptr); //
+    });
+    VkQueue queue = VK_NULL_HANDLE;
+    vkGetDeviceQueue(device, qinfo.queueFamilyIndex, 0, &queue);
+
+    const auto directory = fs::temp_directory_path() / "graphics_vulkan_blocks";
+    fs::remove_all(directory);
+    auto on_return_1 = gsl::finally([&directory]() {
+        std::error_code ec{};
+        fs::remove_all(directory, ec);
+    });
+    block_cache_t cache{directory};
+    REQUIRE(cache.is_valid() == 0);
+    const fs::path files[]{
+        get_asset_dir() / "image_400_337.jpg",
+        get_asset_dir() / "missing.png",
+    };
+    const image_codec_t codec{&get_image_info, &decode_image};
+    vulkan_texture_batch_t batch{device, meminfo, files, codec, blocks, cache};
+    REQUIRE(batch.format == get_vulkan_format(blocks));
+    REQUIRE(batch.textures[0].ec == 0);
+    REQUIRE(batch.textures[0].mip_levels == 1);
+    REQUIRE(batch.textures[1].ec != 0);
+    REQUIRE(batch.textures[1].image == VK_NULL_HANDLE);
+    REQUIRE(cache.miss == 1); // encoded and stored
+
+    // the entry which was copied. `decode_blocks` of it is the expected pixels
+    const auto& source = batch.textures[0];
+    const auto width = source.extent.width, height = source.extent.height;
+    block_cache_t::header_t header{};
+    unique_ptr<mapped_file_t> entry{};
+    REQUIRE(cache.load_or_encode(files[0], blocks, codec, header, entry) == 0);
+    REQUIRE(cache.hit == 1);
+    const auto encoded = entry->bytes().subspan(sizeof(block_cache_t::header_t));
+    vector<std::byte> expected(size_t{width} * height * 4);
+    REQUIRE(decode_blocks(blocks, encoded, width, height, expected) == 0);
+
+    // the driver decodes the blocks when it blits them into the RGBA8 image
+    VkFormatProperties properties{};
+    vkGetPhysicalDeviceFormatProperties(physical_device, batch.format, &properties);
+    const bool blit = properties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT;
+    VkImage decoded{};
+    VkDeviceMemory decoded_memory{};
+    auto on_return_2 = gsl::finally([device, &decoded, &decoded_memory]() {
+        vkDestroyImage(device, decoded, nullptr);
+        vkFreeMemory(device, decoded_memory, nullptr);
+    });
+    if (blit) {
+        VkImageCreateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        info.imageType = VK_IMAGE_TYPE_2D;
+        info.format = VK_FORMAT_R8G8B8A8_UNORM;
+        info.extent = {width, height, 1};
+        info.mipLevels = 1;
+        info.arrayLayers = 1;
+        info.samples = VK_SAMPLE_COUNT_1_BIT;
+        info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        REQUIRE(vkCreateImage(device, &info, nullptr, &decoded) == VK_SUCCESS);
+        VkMemoryRequirements requirements{};
+        vkGetImageMemoryRequirements(device, decoded, &requirements);
+        VkMemoryAllocateInfo allocate{};
+        allocate.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocate.allocationSize = requirements.size;
+        allocate.memoryTypeIndex =
+            get_memory_type(meminfo, requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        REQUIRE(vkAllocateMemory(device, &allocate, nullptr, &decoded_memory) == VK_SUCCESS);
+        REQUIRE(vkBindImageMemory(device, decoded, decoded_memory, 0) == VK_SUCCESS);
+    } else {
+        spdlog::warn("{}: the format can't be the blit source", "vulkan_texture_batch_t");
+    }
+
+    // the readback of the blocks, then the decoded pixels
+    const VkDeviceSize pixels_offset = (encoded.size() + 15) / 16 * 16;
+    VkBufferCreateInfo readback_info{};
+    readback_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    readback_info.size = pixels_offset + expected.size();
+    readback_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    readback_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VkBuffer readback{};
+    REQUIRE(vkCreateBuffer(device, &readback_info, nullptr, &readback) == VK_SUCCESS);
+    VkDeviceMemory readback_memory{};
+    auto on_return_3 = gsl::finally([device, readback, &readback_memory]() {
+        vkDestroyBuffer(device, readback, nullptr);
+        vkFreeMemory(device, readback_memory, nullptr);
+    });
+    REQUIRE(allocate_memory(device, readback, readback_memory, readback_info,
+                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                            meminfo) == VK_SUCCESS);
+    REQUIRE(vkBindBufferMemory(device, readback, readback_memory, 0) == VK_SUCCESS);
+
+    vulkan_command_pool_t command_pool{device, qinfo.queueFamilyIndex, 1};
+    auto command_buffer = command_pool.buffers[0];
+    VkCommandBufferBeginInfo begin{};
+    begin.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    REQUIRE(vkBeginCommandBuffer(command_buffer, &begin) == VK_SUCCESS);
+    vulkan_barrier_builder_t barriers{};
+    batch.record(command_buffer, barriers);
+    {
+        const VkImageSubresourceRange range{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        REQUIRE(barriers.transition(source.image, range, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                    VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT) == 0);
+        if (blit) {
+            barriers.track(decoded, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+            REQUIRE(barriers.transition(decoded, range, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                        VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT) == 0);
+        }
+        barriers.flush(command_buffer);
+        VkBufferImageCopy region{};
+        region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+        region.imageExtent = {width, height, 1};
+        vkCmdCopyImageToBuffer(command_buffer, source.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback, 1,
+                               &region);
+        if (blit) {
+            // same extent. no filtering
+            VkImageBlit area{};
+            area.srcSubresource = area.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+            area.srcOffsets[1] = area.dstOffsets[1] = {static_cast<int32_t>(width), static_cast<int32_t>(height), 1};
+            vkCmdBlitImage(command_buffer, source.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, //
+                           decoded, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &area, VK_FILTER_NEAREST);
+            REQUIRE(barriers.transition(decoded, range, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                        VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT) == 0);
+            barriers.flush(command_buffer);
+            region.bufferOffset = pixels_offset;
+            vkCmdCopyImageToBuffer(command_buffer, decoded, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback, 1,
+                                   &region);
+        }
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1,
+                             &barrier, 0, nullptr, 0, nullptr);
+    }
+    REQUIRE(vkEndCommandBuffer(command_buffer) == VK_SUCCESS);
+    VkSubmitInfo submit{};
+    submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit.commandBufferCount = 1;
+    submit.pCommandBuffers = &command_buffer;
+    REQUIRE(vkQueueSubmit(queue, 1, &submit, VK_NULL_HANDLE) == VK_SUCCESS);
+    REQUIRE(vkQueueWaitIdle(queue) == VK_SUCCESS);
+
+    void* mapping = nullptr;
+    REQUIRE(vkMapMemory(device, readback_memory, 0, VK_WHOLE_SIZE, 0, &mapping) == VK_SUCCESS);
+    auto on_return_4 = gsl::finally([device, readback_memory]() { vkUnmapMemory(device, readback_memory); });
+    // the blocks are copied as they are
+    REQUIRE(std::memcmp(mapping, encoded.data(), encoded.size()) == 0);
+    if (blit == false)
+        return;
+    // the decoders may round the interpolation differently
+    const auto actual = static_cast<const uint8_t*>(mapping) + pixels_offset;
+    uint32_t over = 0;
+    for (auto i = 0u; i < expected.size(); ++i)
+        if (std::abs(static_cast<int>(actual[i]) - static_cast<int>(expected[i])) > 3)
+            ++over;
+    REQUIRE(over == 0);
+}
+
+TEST_CASE("vulkan_bindless_heap_t", "[vulkan][image]") {
+    vulkan_instance_t instance{"app1", {}, {}};
+    VkPhysicalDevice physical_device{};
+    REQUIRE(get_physical_device(instance.handle, physical_device) == VK_SUCCESS);
+    VkPhysicalDeviceMemoryProperties meminfo{};
+    vkGetPhysicalDeviceMemoryProperties(physical_device, &meminfo);
+    VkDevice device{};
+    VkDeviceQueueCreateInfo qinfo{};
+    VkPhysicalDeviceDescriptorIndexingFeatures features{};
+    if (auto ec = create_device(physical_device, device, qinfo, features); ec == VK_ERROR_FEATURE_NOT_PRESENT)
+        return spdlog::warn("descriptor indexing is not supported");
+    else
+        REQUIRE(ec == VK_SUCCESS);
+    auto on_return_0 = gsl::finally([device]() {
+        vkDestroyDevice(device, nullptr); //
+    });
+
+    VkImage image{};
+    VkDeviceMemory memory{};
+    {
+        VkImageCreateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        info.imageType = VK_IMAGE_TYPE_2D;
+        info.format = VK_FORMAT_R8G8B8A8_UNORM;
+        info.extent = {4, 4, 1};
+        info.mipLevels = 1;
+        info.arrayLayers = 1;
+        info.samples = VK_SAMPLE_COUNT_1_BIT;
+        info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        info.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
+        info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        REQUIRE(vkCreateImage(device, &info, nullptr, &image) == VK_SUCCESS);
+    }
+    auto on_return_1 = gsl::finally([device, image, &memory]() {
+        vkDestroyImage(device, image, nullptr);
+        vkFreeMemory(device, memory, nullptr);
+    });
+    {
+        VkMemoryRequirements requirements{};
+        vkGetImageMemoryRequirements(device, image, &requirements);
+        VkMemoryAllocateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        info.allocationSize = requirements.size;
+        info.memoryTypeIndex = get_memory_type(meminfo, requirements.memoryTypeBits, 0);
+        REQUIRE(vkAllocateMemory(device, &info, nullptr, &memory) == VK_SUCCESS);
+        REQUIRE(vkBindImageMemory(device, image, memory, 0) == VK_SUCCESS);
+    }
+    VkImageView view{};
+    {
+        VkImageViewCreateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        info.image = image;
+        info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        info.format = VK_FORMAT_R8G8B8A8_UNORM;
+        info.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        REQUIRE(vkCreateImageView(device, &info, nullptr, &view) == VK_SUCCESS);
+    }
+    VkSampler sampler{};
+    {
+        VkSamplerCreateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        info.magFilter = info.minFilter = VK_FILTER_LINEAR;
+        info.addressModeU = info.addressModeV = info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        REQUIRE(vkCreateSampler(device, &info, nullptr, &sampler) == VK_SUCCESS);
+    }
+    auto on_return_2 = gsl::finally([device, view, sampler]() {
+        vkDestroySampler(device, sampler, nullptr);
+        vkDestroyImageView(device, view, nullptr);
+    });
+
+    SECTION("free list") {
+        vulkan_bindless_heap_t heap{device, 4, 2};
+        REQUIRE(heap.set != VK_NULL_HANDLE);
+        for (auto i = 0u; i < 4; ++i)
+            REQUIRE(heap.allocate(view, sampler) == i);
+        REQUIRE(heap.size() == 4);
+        REQUIRE(heap.allocate(view, sampler) == UINT32_MAX);
+        heap.release(2);
+        heap.release(2); // not allocated. ignored
+        REQUIRE(heap.size() == 3);
+        // the frames in flight may sample it until the reset of the current frame
+        REQUIRE(heap.allocate(view, sampler) == UINT32_MAX);
+        REQUIRE(heap.reset(1) == VK_SUCCESS);
+        REQUIRE(heap.allocate(view, sampler) == UINT32_MAX);
+        REQUIRE(heap.reset(0) == VK_SUCCESS);
+        REQUIRE(heap.allocate(view, sampler) == 2);
+        REQUIRE(heap.size() == 4);
+        REQUIRE(heap.reset(2) == VK_ERROR_INITIALIZATION_FAILED);
+    }
+    SECTION("make_pipeline_input_4") {
+        auto input = make_pipeline_input_4(device, meminfo, get_asset_dir());
+        REQUIRE(input);
+        // same texture, different indices. no descriptor set per texture
+        for (auto i = 0; i < 1000; ++i)
+            REQUIRE(input->update(view, sampler) == VK_SUCCESS);
+        VkPipelineLayout layout{};
+        REQUIRE(input->make_pipeline_layout(device, layout) == VK_SUCCESS);
+        vkDestroyPipelineLayout(device, layout, nullptr);
+    }
+}
+
+TEST_CASE("vulkan_descriptor_allocator_t", "[vulkan]") {
+    vulkan_instance_t instance{"app1", {}, {}};
+    VkPhysicalDevice physical_device{};
+    REQUIRE(get_physical_device(instance.handle, physical_device) == VK_SUCCESS);
+    VkPhysicalDeviceMemoryProperties meminfo{};
+    vkGetPhysicalDeviceMemoryProperties(physical_device, &meminfo);
+    VkDevice device{};
+    VkDeviceQueueCreateInfo qinfo{};
+    REQUIRE(create_device(physical_device, device, qinfo) == VK_SUCCESS);
+    auto on_return_0 = gsl::finally([device]() {
+        vkDestroyDevice(device, nullptr); //
+    });
+
+    vulkan_descriptor_allocator_t descriptors{device, 2, 4};
+    VkDescriptorSetLayout layout{};
+    {
+        VkDescriptorSetLayoutBinding binding{};
+        binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        binding.descriptorCount = 1;
+        binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        VkDescriptorSetLayoutCreateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        info.bindingCount = 1;
+        info.pBindings = &binding;
+        REQUIRE(descriptors.get_layout(info, layout) == VK_SUCCESS);
+        VkDescriptorSetLayout same{};
+        REQUIRE(descriptors.get_layout(info, same) == VK_SUCCESS);
+        REQUIRE(same == layout);
+    }
+
+    SECTION("transient") {
+        // 4 sets per pool. 10 sets need 3 pools
+        for (auto i = 0; i < 10; ++i) {
+            VkDescriptorSet set{};
+            REQUIRE(descriptors.allocate(0, layout, set) == VK_SUCCESS);
+        }
+        REQUIRE(descriptors.get_pool_count() == 3);
+        VkDescriptorSet set{};
+        REQUIRE(descriptors.allocate(2, layout, set) == VK_ERROR_INITIALIZATION_FAILED);
+        // the pools of the frame 0 are reused by the frame 1
+        REQUIRE(descriptors.reset(0) == VK_SUCCESS);
+        for (auto i = 0; i < 10; ++i)
+            REQUIRE(descriptors.allocate(1, layout, set) == VK_SUCCESS);
+        REQUIRE(descriptors.get_pool_count() == 3);
+    }
+    SECTION("persistent") {
+        VkBuffer buffer{};
+        VkDeviceMemory memory{};
+        VkBufferCreateInfo buffer_info{};
+        REQUIRE(create_uniform_buffer(device, buffer, buffer_info, 256) == VK_SUCCESS);
+        auto on_return_1 = gsl::finally([device, buffer, &memory]() {
+            vkDestroyBuffer(device, buffer, nullptr);
+            vkFreeMemory(device, memory, nullptr);
+        });
+        REQUIRE(allocate_memory(device, buffer, memory, buffer_info, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, meminfo) ==
+                VK_SUCCESS);
+        REQUIRE(vkBindBufferMemory(device, buffer, memory, 0) == VK_SUCCESS);
+
+        VkDescriptorBufferInfo change{buffer, 0, 64};
+        VkWriteDescriptorSet write{};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        write.descriptorCount = 1;
+        write.pBufferInfo = &change;
+        VkDescriptorSet sets[3]{};
+        REQUIRE(descriptors.get(layout, {&write, 1}, sets[0]) == VK_SUCCESS);
+        REQUIRE(descriptors.get(layout, {&write, 1}, sets[1]) == VK_SUCCESS);
+        REQUIRE(sets[0] == sets[1]);
+        change.range = 128;
+        REQUIRE(descriptors.get(layout, {&write, 1}, sets[2]) == VK_SUCCESS);
+        REQUIRE(sets[0] != sets[2]);
+        REQUIRE(descriptors.get_pool_count() == 1);
+        REQUIRE(descriptors.get_set_count() == 2);
+        // the image info is ignored for the buffer type
+        const auto dangling = reinterpret_cast<const VkDescriptorImageInfo*>(uintptr_t{0xDEAD});
+        write.pImageInfo = dangling;
+        REQUIRE(descriptors.get(layout, {&write, 1}, sets[1]) == VK_SUCCESS);
+        REQUIRE(sets[1] == sets[2]);
+        write.pImageInfo = nullptr;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+        REQUIRE(descriptors.get(layout, {&write, 1}, sets[1]) == VK_ERROR_FORMAT_NOT_SUPPORTED);
+        write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        // the released set is reused for the other resources after the reset of the frame
+        REQUIRE(descriptors.release(sets[2]) == VK_SUCCESS);
+        REQUIRE(descriptors.get_set_count() == 1);
+        REQUIRE(descriptors.release(sets[2]) == VK_SUCCESS);
+        change.range = 192;
+        VkDescriptorSet reused{};
+        REQUIRE(descriptors.get(layout, {&write, 1}, reused) == VK_SUCCESS);
+        REQUIRE(reused != sets[2]); // the pending command buffers may use it
+        REQUIRE(descriptors.reset(1) == VK_SUCCESS);
+        change.range = 224;
+        REQUIRE(descriptors.get(layout, {&write, 1}, reused) == VK_SUCCESS);
+        REQUIRE(reused != sets[2]);
+        REQUIRE(descriptors.reset(0) == VK_SUCCESS);
+        change.range = 256;
+        REQUIRE(descriptors.get(layout, {&write, 1}, reused) == VK_SUCCESS);
+        REQUIRE(reused == sets[2]);
+        REQUIRE(descriptors.get_set_count() == 4);
+    }
+    SECTION("make_pipeline_input_3") {
+        auto input1 = make_pipeline_input_3(device, meminfo, get_asset_dir(), descriptors);
+        auto input2 = make_pipeline_input_3(device, meminfo, get_asset_dir(), descriptors);
+        // 2 sets in 1 pool
+        REQUIRE(descriptors.get_pool_count() == 1);
+        REQUIRE(input1->update() == VK_SUCCESS);
+        // the set for the frame, the push constant for the model
+        VkPipelineLayout pipeline_layout{};
+        REQUIRE(input2->make_pipeline_layout(device, pipeline_layout) == VK_SUCCESS);
+        vkDestroyPipelineLayout(device, pipeline_layout, nullptr);
+        // the set of the destroyed uniform buffer is not in the cache
+        REQUIRE(descriptors.get_set_count() == 2);
+        input1.reset();
+        REQUIRE(descriptors.get_set_count() == 1);
+    }
+}
+
+TEST_CASE("select_block_format(VkPhysicalDevice)", "[vulkan][image]") {
+    vulkan_instance_t instance{"app1", {}, {}};
+    VkPhysicalDevice physical_device{};
+    REQUIRE(get_physical_device(instance.handle, physical_device) == VK_SUCCESS);
+    // lavapipe supports both BC and ETC2
+    const auto format = select_block_format(physical_device);
+    REQUIRE(format != block_format_t::rgba8);
+    VkFormatProperties props{};
+    vkGetPhysicalDeviceFormatProperties(physical_device, get_vulkan_format(format), &props);
+    REQUIRE(props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+}
+
+TEST_CASE("vulkan_texture_batch_t with workers", "[vulkan][image][!benchmark]") {
+    const char* layers[1]{"VK_LAYER_KHRONOS_validation"};
+    vulkan_instance_t instance{"app1", gsl::make_span(layers, 1), {}};
+    VkPhysicalDevice physical_device{};
+    REQUIRE(get_physical_device(instance.handle, physical_device) == VK_SUCCESS);
+    VkPhysicalDeviceMemoryProperties meminfo{};
+    vkGetPhysicalDeviceMemoryProperties(physical_device, &meminfo);
+    VkDevice device{};
+    VkDeviceQueueCreateInfo qinfo{};
+    REQUIRE(create_device(physical_device, device, qinfo) == VK_SUCCESS);
+    auto on_return_0 = gsl::finally([device]() {
+        vkDestroyDevice(device, nullptr); //
+    });
+
+    std::vector<fs::path> files{};
+    for (auto i = 0; i < 64; ++i)
+        files.emplace_back(get_asset_dir() / (i % 2 ? "image_400_337.jpg" : "image_1080_608.png"));
+    const image_codec_t codec{&get_image_info, &decode_image};
+    const auto concurrency = std::thread::hardware_concurrency();
+    for (const uint32_t num_workers : {1u, concurrency}) {
+        BENCHMARK("decode 64 images: workers " + std::to_string(num_workers)) {
+            vulkan_texture_batch_t batch{device, meminfo, files, codec, num_workers};
+            return batch.textures.size();
+        };
+    }
+}
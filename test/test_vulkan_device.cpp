@@ -288,4 +288,108 @@ TEST_CASE("VkDevice", "[vulkan]") {
         vkGetDeviceQueue(device, queues[2].queueFamilyIndex, 0, handles + 2);
         REQUIRE(handles[2] != VK_NULL_HANDLE);
     }
-}
\ No newline at end of file
+}
+TEST_CASE("vulkan_transfer_queue_t", "[vulkan]") {
+    vulkan_instance_t instance{"app1", {}, {}};
+    VkPhysicalDevice physical_device{};
+    REQUIRE(get_physical_device(instance.handle, physical_device) == VK_SUCCESS);
+    VkPhysicalDeviceMemoryProperties meminfo{};
+    vkGetPhysicalDeviceMemoryProperties(physical_device, &meminfo);
+    VkDevice device{};
+    VkDeviceQueueCreateInfo queues[2]{};
+    REQUIRE(create_device(physical_device, device, queues) == VK_SUCCESS);
+    auto on_return_0 = gsl::finally([device]() {
+        vkDestroyDevice(device, nullptr); //
+    });
+    VkQueue graphics_queue{};
+    vkGetDeviceQueue(device, queues[0].queueFamilyIndex, 0, &graphics_queue);
+    const uint32_t families[2]{queues[0].queueFamilyIndex, queues[1].queueFamilyIndex};
+
+    // 0: host staging, 1: device local, 2: host readback
+    constexpr VkDeviceSize length = 1 << 20;
+    VkBuffer buffers[3]{};
+    VkDeviceMemory memories[3]{};
+    auto on_return_1 = gsl::finally([device, &buffers, &memories]() {
+        for (auto i : {0, 1, 2}) {
+            vkDestroyBuffer(device, buffers[i], nullptr);
+            vkFreeMemory(device, memories[i], nullptr);
+        }
+    });
+    const VkMemoryPropertyFlags host_flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    const VkMemoryPropertyFlags memory_flags[3]{host_flags, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, host_flags};
+    for (auto i : {0, 1, 2}) {
+        VkBufferCreateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        info.size = length;
+        info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        // used by both queues
+        if (i == 1 && families[0] != families[1]) {
+            info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+            info.queueFamilyIndexCount = 2;
+            info.pQueueFamilyIndices = families;
+        }
+        REQUIRE(vkCreateBuffer(device, &info, nullptr, buffers + i) == VK_SUCCESS);
+        VkMemoryRequirements requirements{};
+        vkGetBufferMemoryRequirements(device, buffers[i], &requirements);
+        VkMemoryAllocateInfo alloc{};
+        alloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        alloc.allocationSize = requirements.size;
+        alloc.memoryTypeIndex = get_memory_type(meminfo, requirements.memoryTypeBits, memory_flags[i]);
+        REQUIRE(alloc.memoryTypeIndex != UINT32_MAX);
+        REQUIRE(vkAllocateMemory(device, &alloc, nullptr, memories + i) == VK_SUCCESS);
+        REQUIRE(vkBindBufferMemory(device, buffers[i], memories[i], 0) == VK_SUCCESS);
+    }
+    {
+        void* ptr = nullptr;
+        REQUIRE(vkMapMemory(device, memories[0], 0, length, 0, &ptr) == VK_SUCCESS);
+        auto values = reinterpret_cast<uint32_t*>(ptr);
+        for (auto i = 0u; i < length / 4; ++i)
+            values[i] = i;
+        vkUnmapMemory(device, memories[0]);
+    }
+
+    vulkan_transfer_queue_t transfer{device, queues[1]};
+    REQUIRE(transfer.family_index == families[1]);
+    VkCommandBuffer upload{};
+    REQUIRE(transfer.begin(upload) == VK_SUCCESS);
+    const VkBufferCopy region{0, 0, length};
+    vkCmdCopyBuffer(upload, buffers[0], buffers[1], 1, &region);
+    uint64_t value = 0;
+    REQUIRE(transfer.submit(upload, value) == VK_SUCCESS);
+    REQUIRE(value == 1);
+    REQUIRE(transfer.submit(upload, value) == VK_ERROR_UNKNOWN); // not in recording
+
+    // the graphics queue waits for the timeline. no idle wait for the transfer queue
+    vulkan_command_pool_t command_pool{device, families[0], 1};
+    auto command_buffer = command_pool.buffers[0];
+    VkCommandBufferBeginInfo begin{};
+    begin.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    REQUIRE(vkBeginCommandBuffer(command_buffer, &begin) == VK_SUCCESS);
+    vkCmdCopyBuffer(command_buffer, buffers[1], buffers[2], 1, &region);
+    REQUIRE(vkEndCommandBuffer(command_buffer) == VK_SUCCESS);
+    vulkan_fence_t fence{device};
+    REQUIRE(render_submit(graphics_queue, gsl::make_span(&command_buffer, 1), fence.handle, //
+                          transfer.timeline, value, VK_PIPELINE_STAGE_TRANSFER_BIT) == VK_SUCCESS);
+    REQUIRE(vkWaitForFences(device, 1, &fence.handle, VK_TRUE, UINT64_MAX) == VK_SUCCESS);
+
+    uint64_t completed = 0;
+    REQUIRE(transfer.get_completed(completed) == VK_SUCCESS);
+    REQUIRE(completed >= value);
+    {
+        void* ptr = nullptr;
+        REQUIRE(vkMapMemory(device, memories[2], 0, length, 0, &ptr) == VK_SUCCESS);
+        const auto values = reinterpret_cast<const uint32_t*>(ptr);
+        REQUIRE(values[0] == 0);
+        REQUIRE(values[length / 4 - 1] == length / 4 - 1);
+        vkUnmapMemory(device, memories[2]);
+    }
+    // the completed command buffer is reused
+    VkCommandBuffer next{};
+    REQUIRE(transfer.begin(next) == VK_SUCCESS);
+    REQUIRE(next == upload);
+    REQUIRE(transfer.submit(next, value) == VK_SUCCESS);
+    REQUIRE(value == 2);
+    REQUIRE(transfer.wait(value) == VK_SUCCESS);
+}
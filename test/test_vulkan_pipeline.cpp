@@ -2,6 +2,9 @@
 #include <spdlog/spdlog.h>
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
+#include <algorithm>
+#include <array>
+#include <cstring>
 #include <initializer_list>
 #include <thread>
 
@@ -15,7 +18,125 @@ auto open_glfw() -> gsl::final_action<void (*)()>;
 auto create_window_glfw(gsl::czstring<> name) noexcept -> std::unique_ptr<GLFWwindow, void (*)(GLFWwindow*)>;
 auto make_vulkan_instance_glfw(gsl::czstring<> name) -> vulkan_instance_t;
 
-TEST_CASE("RenderPass + Pipeline", "[vulkan]") {
+/// @brief Color attachment + VkFramebuffer for the `vulkan_renderpass_t`, and a host visible buffer to read it back
+class readback_target_t final {
+  public:
+    const VkDevice device;
+    const VkExtent2D extent;
+    VkImage image{};
+    VkDeviceMemory image_memory{};
+    VkImageView view{};
+    VkFramebuffer framebuffer{};
+    VkBuffer buffer{};
+    VkDeviceMemory buffer_memory{};
+
+  public:
+    readback_target_t(VkDevice _device, const VkPhysicalDeviceMemoryProperties& props, VkRenderPass renderpass,
+                      VkFormat format, VkExtent2D _extent)
+        : device{_device}, extent{_extent} {
+        {
+            VkImageCreateInfo info{};
+            info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            info.imageType = VK_IMAGE_TYPE_2D;
+            info.extent = {extent.width, extent.height, 1};
+            info.mipLevels = 1;
+            info.arrayLayers = 1;
+            info.format = format;
+            info.tiling = VK_IMAGE_TILING_OPTIMAL;
+            info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+            info.samples = VK_SAMPLE_COUNT_1_BIT;
+            info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            REQUIRE(vkCreateImage(device, &info, nullptr, &image) == VK_SUCCESS);
+            VkMemoryRequirements requirements{};
+            vkGetImageMemoryRequirements(device, image, &requirements);
+            VkMemoryAllocateInfo allocate{};
+            allocate.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+            allocate.allocationSize = requirements.size;
+            allocate.memoryTypeIndex =
+                get_memory_type(props, requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            REQUIRE(vkAllocateMemory(device, &allocate, nullptr, &image_memory) == VK_SUCCESS);
+            REQUIRE(vkBindImageMemory(device, image, image_memory, 0) == VK_SUCCESS);
+        }
+        {
+            VkImageViewCreateInfo info{};
+            info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            info.image = image;
+            info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            info.format = format;
+            info.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+            REQUIRE(vkCreateImageView(device, &info, nullptr, &view) == VK_SUCCESS);
+        }
+        {
+            VkFramebufferCreateInfo info{};
+            info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+            info.renderPass = renderpass;
+            info.attachmentCount = 1;
+            info.pAttachments = &view;
+            info.width = extent.width;
+            info.height = extent.height;
+            info.layers = 1;
+            REQUIRE(vkCreateFramebuffer(device, &info, nullptr, &framebuffer) == VK_SUCCESS);
+        }
+        {
+            VkBufferCreateInfo info{};
+            info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+            info.size = VkDeviceSize{extent.width} * extent.height * 4;
+            info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+            info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            REQUIRE(vkCreateBuffer(device, &info, nullptr, &buffer) == VK_SUCCESS);
+            REQUIRE(allocate_memory(device, buffer, buffer_memory, info,
+                                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                    props) == VK_SUCCESS);
+            REQUIRE(vkBindBufferMemory(device, buffer, buffer_memory, 0) == VK_SUCCESS);
+        }
+    }
+    ~readback_target_t() {
+        vkDestroyBuffer(device, buffer, nullptr);
+        vkFreeMemory(device, buffer_memory, nullptr);
+        vkDestroyFramebuffer(device, framebuffer, nullptr);
+        vkDestroyImageView(device, view, nullptr);
+        vkDestroyImage(device, image, nullptr);
+        vkFreeMemory(device, image_memory, nullptr);
+    }
+
+    /// @brief Copy the attachment into the `buffer`. The render pass leaves it in `VK_IMAGE_LAYOUT_PRESENT_SRC_KHR`
+    void record(VkCommandBuffer commands) noexcept {
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.srcQueueFamilyIndex = barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        vkCmdPipelineBarrier(commands, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0, 0, nullptr, 0, nullptr, 1, &barrier);
+        VkBufferImageCopy region{};
+        region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+        region.imageExtent = {extent.width, extent.height, 1};
+        vkCmdCopyImageToBuffer(commands, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer, 1, &region);
+        VkMemoryBarrier host{};
+        host.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        host.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        host.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(commands, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &host, 0,
+                             nullptr, 0, nullptr);
+    }
+
+    /// @brief 4 bytes of the pixel in the attachment's format. Call after the `record` is completed
+    auto read(uint32_t x, uint32_t y) const -> std::array<uint8_t, 4> {
+        void* mapping = nullptr;
+        REQUIRE(vkMapMemory(device, buffer_memory, 0, VK_WHOLE_SIZE, 0, &mapping) == VK_SUCCESS);
+        std::array<uint8_t, 4> pixel{};
+        std::memcpy(pixel.data(), static_cast<const uint8_t*>(mapping) + (size_t{y} * extent.width + x) * 4, 4);
+        vkUnmapMemory(device, buffer_memory);
+        return pixel;
+    }
+};
+
+TEST_CASE("RenderPass + Pipeline", "[vulkan][headless]") {
     const char* layers[1]{"VK_LAYER_KHRONOS_validation"};
     const char* extensions[1]{"VK_KHR_surface"};
     vulkan_instance_t instance{"RenderPass + Pipeline", //
@@ -50,7 +171,7 @@ TEST_CASE("RenderPass + Pipeline", "[vulkan]") {
     REQUIRE(pipeline.handle);
 }
 
-TEST_CASE("Render Offscreen", "[vulkan]") {
+TEST_CASE("Render Offscreen", "[vulkan][headless]") {
     // instance / physical device
     const char* layers[1]{"VK_LAYER_KHRONOS_validation"};
     vulkan_instance_t instance{"Render Offscreen", gsl::make_span(layers, 1), {}};
@@ -178,6 +299,289 @@ TEST_CASE("Render Offscreen", "[vulkan]") {
         REQUIRE(vkResetFences(fence.device, 1, &fence.handle) == VK_SUCCESS);
     }
     REQUIRE(vkDeviceWaitIdle(device) == VK_SUCCESS);
+
+    // record again with timestamps. 1 for render pass, 1 for draw
+    vulkan_timestamp_pool_t timestamps{device, physical_device, index, num_images, 2};
+    for (auto i = 0u; i < num_images; ++i) {
+        vulkan_command_recorder_t recorder{command_pool.buffers[i], renderpass.handle, framebuffers[i], image_extent,
+                                           timestamps, i};
+        vulkan_timestamp_scope_t scope{recorder, "draw"};
+        vkCmdBindPipeline(recorder.commands, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.handle);
+        input->record(recorder.commands, pipeline.handle, pipeline.layout);
+    }
+    std::vector<gpu_time_region_t> regions{};
+    for (auto i = 0u; i < num_images; ++i) {
+        REQUIRE(render_submit(queues[0],                                         //
+                              gsl::make_span(command_pool.buffers.get() + i, 1), //
+                              fence.handle, VK_NULL_HANDLE, VK_NULL_HANDLE) == VK_SUCCESS);
+        REQUIRE(vkWaitForFences(fence.device, 1, &fence.handle, VK_TRUE, 1'000'000'000) == VK_SUCCESS);
+        REQUIRE(vkResetFences(fence.device, 1, &fence.handle) == VK_SUCCESS);
+        REQUIRE(timestamps.collect(i, regions) == VK_SUCCESS);
+    }
+    REQUIRE(regions.size() == num_images * 2);
+    for (const auto& region : regions)
+        REQUIRE(region.begin <= region.end);
+    REQUIRE(timestamps.dropped == 0);
+    REQUIRE(vkDeviceWaitIdle(device) == VK_SUCCESS);
+}
+
+TEST_CASE("Render Offscreen with push constants", "[vulkan][headless]") {
+    const char* layers[1]{"VK_LAYER_KHRONOS_validation"};
+    vulkan_instance_t instance{"Render Offscreen with push constants", gsl::make_span(layers, 1), {}};
+    VkPhysicalDevice physical_device{};
+    REQUIRE(get_physical_device(instance.handle, physical_device) == VK_SUCCESS);
+    VkPhysicalDeviceMemoryProperties meminfo{};
+    vkGetPhysicalDeviceMemoryProperties(physical_device, &meminfo);
+    VkDevice device{};
+    VkDeviceQueueCreateInfo queue_info{};
+    REQUIRE(create_device(physical_device, device, queue_info) == VK_SUCCESS);
+    auto on_return_2 = gsl::finally([&device]() { //
+        vkDestroyDevice(device, nullptr);
+    });
+    VkQueue queue{};
+    vkGetDeviceQueue(device, queue_info.queueFamilyIndex, 0, &queue);
+
+    // the uniform is not updated. the view is identity and the projection flips y (GL -> Vulkan)
+    auto input = make_pipeline_input_3(device, meminfo, get_asset_dir());
+    constexpr auto format = VK_FORMAT_B8G8R8A8_UNORM;
+    VkExtent2D extent{256, 256};
+    vulkan_renderpass_t renderpass{device, format};
+    vulkan_pipeline_t pipeline{device, renderpass.handle, extent, *input};
+    readback_target_t target{device, meminfo, renderpass.handle, format, extent};
+
+    // 2 objects with 1 bind. only the model matrix is different: the quarter sized quad at x = -0.5 and x = +0.5.
+    // the model flips y again to keep the winding of the front face
+    vulkan_push_constant_input_t::push_constant_t objects[2]{};
+    for (auto i = 0u; i < 2; ++i) {
+        const float model[16]{0.25f, 0, 0, 0, 0, -0.25f, 0, 0, 0, 0, 1, 0, i ? 0.5f : -0.5f, 0, 0, 1};
+        std::copy(model, model + 16, objects[i].model);
+    }
+    vulkan_command_pool_t command_pool{device, queue_info.queueFamilyIndex, 2};
+    {
+        vulkan_command_recorder_t recorder{command_pool.buffers[0], renderpass.handle, target.framebuffer, extent};
+        input->record_each(recorder.commands, pipeline.handle, pipeline.layout, objects);
+    }
+    {
+        VkCommandBufferBeginInfo begin{};
+        begin.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        REQUIRE(vkBeginCommandBuffer(command_pool.buffers[1], &begin) == VK_SUCCESS);
+        target.record(command_pool.buffers[1]);
+        REQUIRE(vkEndCommandBuffer(command_pool.buffers[1]) == VK_SUCCESS);
+    }
+    vulkan_fence_t fence{device};
+    REQUIRE(render_submit(queue, gsl::make_span(command_pool.buffers.get(), 2), //
+                          fence.handle, VK_NULL_HANDLE, VK_NULL_HANDLE) == VK_SUCCESS);
+    REQUIRE(vkWaitForFences(device, 1, &fence.handle, VK_TRUE, 1'000'000'000) == VK_SUCCESS);
+
+    // the quads cover x in [-0.7, -0.3] and [0.3, 0.7], y in [-0.225, 0.225]. the rest is the clear color
+    const std::array<uint8_t, 4> clear{0, 0, 0, 255};
+    const auto left = target.read(64, 128);
+    const auto right = target.read(192, 128);
+    REQUIRE(left != clear);
+    REQUIRE(right != clear);
+    REQUIRE(target.read(128, 128) == clear); // between the quads. the untranslated quad would cover here
+    REQUIRE(target.read(64, 32) == clear);   // above the left quad. the unscaled quad would cover here
+    REQUIRE(vkDeviceWaitIdle(device) == VK_SUCCESS);
+}
+
+TEST_CASE("Render Offscreen with instances", "[vulkan][headless]") {
+    const char* layers[1]{"VK_LAYER_KHRONOS_validation"};
+    vulkan_instance_t instance{"Render Offscreen with instances", gsl::make_span(layers, 1), {}};
+    VkPhysicalDevice physical_device{};
+    REQUIRE(get_physical_device(instance.handle, physical_device) == VK_SUCCESS);
+    VkPhysicalDeviceMemoryProperties meminfo{};
+    vkGetPhysicalDeviceMemoryProperties(physical_device, &meminfo);
+    VkDevice device{};
+    VkDeviceQueueCreateInfo queue_info{};
+    REQUIRE(create_device(physical_device, device, queue_info) == VK_SUCCESS);
+    auto on_return_2 = gsl::finally([&device]() { //
+        vkDestroyDevice(device, nullptr);
+    });
+    VkQueue queue{};
+    vkGetDeviceQueue(device, queue_info.queueFamilyIndex, 0, &queue);
+
+    auto input = make_pipeline_input_5(device, meminfo, get_asset_dir(), 2, 16);
+    constexpr auto format = VK_FORMAT_B8G8R8A8_UNORM;
+    VkExtent2D extent{256, 256};
+    vulkan_renderpass_t renderpass{device, format};
+    vulkan_pipeline_t pipeline{device, renderpass.handle, extent, *input};
+    readback_target_t target{device, meminfo, renderpass.handle, format, extent};
+
+    // 3 instances of the small quad, scaled to x/y in [-0.2, 0.2]. red at (-0.5, -0.5), blue at (0.5, -0.5) and
+    // white at (0, 0.5). The center of the quad has the half of red + blue from the vertices, times the instance color
+    const float positions[3][2]{{-0.5f, -0.5f}, {0.5f, -0.5f}, {0, 0.5f}};
+    const float colors[3][4]{{1, 0, 0, 1}, {0, 0, 1, 1}, {1, 1, 1, 1}};
+    vulkan_instanced_input_t::instance_t instances[3]{};
+    for (auto i = 0u; i < 3; ++i) {
+        const float transform[16]{20, 0, 0, 0, 0, 20, 0, 0, 0, 0, 1, 0, positions[i][0], positions[i][1], 0, 1};
+        std::copy(transform, transform + 16, instances[i].transform);
+        std::copy(colors[i], colors[i] + 4, instances[i].color);
+    }
+    // the 2nd slot of the ring buffer. the binding offset is not 0
+    REQUIRE(input->update(1, instances) == VK_SUCCESS);
+    vulkan_command_pool_t command_pool{device, queue_info.queueFamilyIndex, 2};
+    {
+        vulkan_command_recorder_t recorder{command_pool.buffers[0], renderpass.handle, target.framebuffer, extent};
+        input->record(recorder.commands, pipeline.handle, pipeline.layout);
+    }
+    {
+        VkCommandBufferBeginInfo begin{};
+        begin.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        REQUIRE(vkBeginCommandBuffer(command_pool.buffers[1], &begin) == VK_SUCCESS);
+        target.record(command_pool.buffers[1]);
+        REQUIRE(vkEndCommandBuffer(command_pool.buffers[1]) == VK_SUCCESS);
+    }
+    vulkan_fence_t fence{device};
+    REQUIRE(render_submit(queue, gsl::make_span(command_pool.buffers.get(), 2), //
+                          fence.handle, VK_NULL_HANDLE, VK_NULL_HANDLE) == VK_SUCCESS);
+    REQUIRE(vkWaitForFences(device, 1, &fence.handle, VK_TRUE, 1'000'000'000) == VK_SUCCESS);
+
+    // BGRA. about 128 in the channels of the instance color, 0 in the others
+    const auto red = target.read(64, 64);
+    REQUIRE(red[2] > 64);
+    REQUIRE(red[0] < 16);
+    const auto blue = target.read(192, 64);
+    REQUIRE(blue[0] > 64);
+    REQUIRE(blue[2] < 16);
+    const auto white = target.read(128, 192);
+    REQUIRE(white[0] > 64);
+    REQUIRE(white[2] > 64);
+    // the rest is the clear color. the untransformed quad would be at the center
+    const std::array<uint8_t, 4> clear{0, 0, 0, 255};
+    REQUIRE(target.read(128, 128) == clear);
+    REQUIRE(target.read(128, 64) == clear);
+    REQUIRE(target.read(64, 192) == clear);
+    REQUIRE(vkDeviceWaitIdle(device) == VK_SUCCESS);
+}
+
+TEST_CASE("Render Offscreen with bindless textures", "[vulkan][headless]") {
+    const char* layers[1]{"VK_LAYER_KHRONOS_validation"};
+    vulkan_instance_t instance{"Render Offscreen with bindless textures", gsl::make_span(layers, 1), {}};
+    VkPhysicalDevice physical_device{};
+    REQUIRE(get_physical_device(instance.handle, physical_device) == VK_SUCCESS);
+    VkPhysicalDeviceMemoryProperties meminfo{};
+    vkGetPhysicalDeviceMemoryProperties(physical_device, &meminfo);
+    VkDevice device{};
+    VkDeviceQueueCreateInfo queue_info{};
+    VkPhysicalDeviceDescriptorIndexingFeatures features{};
+    if (auto ec = create_device(physical_device, device, queue_info, features); ec == VK_ERROR_FEATURE_NOT_PRESENT)
+        return spdlog::warn("descriptor indexing is not supported");
+    else
+        REQUIRE(ec == VK_SUCCESS);
+    auto on_return_2 = gsl::finally([&device]() { //
+        vkDestroyDevice(device, nullptr);
+    });
+    VkQueue queue{};
+    vkGetDeviceQueue(device, queue_info.queueFamilyIndex, 0, &queue);
+
+    // 2 small textures of the solid colors. red and blue
+    constexpr auto num_textures = 2u;
+    const VkClearColorValue colors[num_textures]{{{1, 0, 0, 1}}, {{0, 0, 1, 1}}};
+    VkImage images[num_textures]{};
+    VkDeviceMemory memories[num_textures]{};
+    VkImageView views[num_textures]{};
+    VkSampler sampler{};
+    auto on_return_3 = gsl::finally([&]() {
+        vkDestroySampler(device, sampler, nullptr);
+        for (auto i = 0u; i < num_textures; ++i) {
+            vkDestroyImageView(device, views[i], nullptr);
+            vkDestroyImage(device, images[i], nullptr);
+            vkFreeMemory(device, memories[i], nullptr);
+        }
+    });
+    for (auto i = 0u; i < num_textures; ++i) {
+        VkImageCreateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        info.imageType = VK_IMAGE_TYPE_2D;
+        info.format = VK_FORMAT_R8G8B8A8_UNORM;
+        info.extent = {4, 4, 1};
+        info.mipLevels = 1;
+        info.arrayLayers = 1;
+        info.samples = VK_SAMPLE_COUNT_1_BIT;
+        info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        REQUIRE(vkCreateImage(device, &info, nullptr, &images[i]) == VK_SUCCESS);
+        VkMemoryRequirements requirements{};
+        vkGetImageMemoryRequirements(device, images[i], &requirements);
+        VkMemoryAllocateInfo allocate{};
+        allocate.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocate.allocationSize = requirements.size;
+        allocate.memoryTypeIndex =
+            get_memory_type(meminfo, requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        REQUIRE(vkAllocateMemory(device, &allocate, nullptr, &memories[i]) == VK_SUCCESS);
+        REQUIRE(vkBindImageMemory(device, images[i], memories[i], 0) == VK_SUCCESS);
+        VkImageViewCreateInfo view_info{};
+        view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        view_info.image = images[i];
+        view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        view_info.format = VK_FORMAT_R8G8B8A8_UNORM;
+        view_info.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        REQUIRE(vkCreateImageView(device, &view_info, nullptr, &views[i]) == VK_SUCCESS);
+    }
+    {
+        VkSamplerCreateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        info.magFilter = info.minFilter = VK_FILTER_LINEAR;
+        info.addressModeU = info.addressModeV = info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        REQUIRE(vkCreateSampler(device, &info, nullptr, &sampler) == VK_SUCCESS);
+    }
+
+    // each texture has its own index in the heap. `record` draws them in the 2 x 2 grid
+    auto input = make_pipeline_input_4(device, meminfo, get_asset_dir());
+    for (auto i = 0u; i < num_textures; ++i)
+        REQUIRE(input->update(views[i], sampler) == VK_SUCCESS);
+    constexpr auto format = VK_FORMAT_B8G8R8A8_UNORM;
+    VkExtent2D extent{256, 256};
+    vulkan_renderpass_t renderpass{device, format};
+    vulkan_pipeline_t pipeline{device, renderpass.handle, extent, *input};
+    readback_target_t target{device, meminfo, renderpass.handle, format, extent};
+
+    // clear the textures -> render -> readback in 1 submit
+    vulkan_command_pool_t command_pool{device, queue_info.queueFamilyIndex, 3};
+    {
+        VkCommandBufferBeginInfo begin{};
+        begin.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        REQUIRE(vkBeginCommandBuffer(command_pool.buffers[0], &begin) == VK_SUCCESS);
+        const VkImageSubresourceRange range{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        vulkan_barrier_builder_t barriers{};
+        for (auto image : images) {
+            barriers.track(image, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+            REQUIRE(barriers.transition(image, range, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                        VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT) == 0);
+        }
+        REQUIRE(barriers.flush(command_pool.buffers[0]) == num_textures);
+        for (auto i = 0u; i < num_textures; ++i) {
+            vkCmdClearColorImage(command_pool.buffers[0], images[i], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, colors + i,
+                                 1, &range);
+            REQUIRE(barriers.transition(images[i], range, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                        VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT) == 0);
+        }
+        REQUIRE(barriers.flush(command_pool.buffers[0]) == num_textures);
+        REQUIRE(vkEndCommandBuffer(command_pool.buffers[0]) == VK_SUCCESS);
+    }
+    {
+        vulkan_command_recorder_t recorder{command_pool.buffers[1], renderpass.handle, target.framebuffer, extent};
+        input->record(recorder.commands, pipeline.handle, pipeline.layout);
+    }
+    {
+        VkCommandBufferBeginInfo begin{};
+        begin.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        REQUIRE(vkBeginCommandBuffer(command_pool.buffers[2], &begin) == VK_SUCCESS);
+        target.record(command_pool.buffers[2]);
+        REQUIRE(vkEndCommandBuffer(command_pool.buffers[2]) == VK_SUCCESS);
+    }
+    vulkan_fence_t fence{device};
+    REQUIRE(render_submit(queue, gsl::make_span(command_pool.buffers.get(), 3), //
+                          fence.handle, VK_NULL_HANDLE, VK_NULL_HANDLE) == VK_SUCCESS);
+    REQUIRE(vkWaitForFences(device, 1, &fence.handle, VK_TRUE, 1'000'000'000) == VK_SUCCESS);
+
+    // texture 0 in the top-left cell, texture 1 in the top-right cell. the bottom row is empty. BGRA
+    const std::array<uint8_t, 4> red{0, 0, 255, 255}, blue{255, 0, 0, 255}, clear{0, 0, 0, 255};
+    REQUIRE(target.read(64, 64) == red);
+    REQUIRE(target.read(192, 64) == blue);
+    REQUIRE(target.read(128, 192) == clear);
+    REQUIRE(vkDeviceWaitIdle(device) == VK_SUCCESS);
 }
 
 TEST_CASE("render single surface", "[vulkan][glfw]") {
@@ -454,3 +858,323 @@ TEST_CASE("render multiple surface", "[vulkan][glfw]") {
         }
     }
 }
+
+TEST_CASE("vulkan_mesh_batch_t", "[vulkan][headless]") {
+    const char* layers[1]{"VK_LAYER_KHRONOS_validation"};
+    vulkan_instance_t instance{"app1", gsl::make_span(layers, 1), {}};
+    VkPhysicalDevice physical_device{};
+    REQUIRE(get_physical_device(instance.handle, physical_device) == VK_SUCCESS);
+    VkPhysicalDeviceMemoryProperties meminfo{};
+    vkGetPhysicalDeviceMemoryProperties(physical_device, &meminfo);
+    VkDevice device{};
+    VkDeviceQueueCreateInfo qinfo{};
+    REQUIRE(create_device(physical_device, device, qinfo) == VK_SUCCESS);
+    auto on_return_0 = gsl::finally([device]() {
+        vkDestroyDevice(device, nullptr); //
+    });
+    VkQueue queue = VK_NULL_HANDLE;
+    vkGetDeviceQueue(device, qinfo.queueFamilyIndex, 0, &queue);
+
+    // 2 meshes of the same quad
+    const float positions[12]{0, 0, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0};
+    const uint16_t indices[6]{0, 1, 2, 2, 3, 0};
+    accessor_view_t position_view{reinterpret_cast<const std::byte*>(positions), 4, 0, GL_FLOAT, 3};
+    accessor_view_t index_view{reinterpret_cast<const std::byte*>(indices), 6, 0, GL_UNSIGNED_SHORT, 1};
+    mesh_packer_t packer{};
+    REQUIRE(packer.add(0, -1, position_view, {}, {}, index_view) == 0);
+    REQUIRE(packer.add(1, -1, position_view, {}, {}, index_view) == 0);
+    packed_scene_t scene{};
+    REQUIRE(packer.pack(scene) == 0);
+
+    vulkan_mesh_batch_t batch{device, meminfo, scene};
+    REQUIRE(batch.index_type == VK_INDEX_TYPE_UINT16);
+    REQUIRE(batch.ranges.size() == 2);
+    VkVertexInputBindingDescription binding{};
+    VkVertexInputAttributeDescription attrs[3]{};
+    VkPipelineVertexInputStateCreateInfo info{};
+    batch.setup_vertex_input_state(binding, attrs, info);
+    REQUIRE(binding.stride == scene.stride);
+    REQUIRE(attrs[2].format == VK_FORMAT_R16G16_UNORM);
+
+    // 1 command buffer, 1 submit for all meshes
+    vulkan_command_pool_t command_pool{device, qinfo.queueFamilyIndex, 1};
+    auto command_buffer = command_pool.buffers[0];
+    VkCommandBufferBeginInfo begin{};
+    begin.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    REQUIRE(vkBeginCommandBuffer(command_buffer, &begin) == VK_SUCCESS);
+    batch.record(command_buffer);
+    REQUIRE(vkEndCommandBuffer(command_buffer) == VK_SUCCESS);
+    VkSubmitInfo submit{};
+    submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit.commandBufferCount = 1;
+    submit.pCommandBuffers = &command_buffer;
+    REQUIRE(vkQueueSubmit(queue, 1, &submit, VK_NULL_HANDLE) == VK_SUCCESS);
+    REQUIRE(vkQueueWaitIdle(queue) == VK_SUCCESS);
+    batch.release_staging();
+    REQUIRE(batch.staging == VK_NULL_HANDLE);
+
+    // written directly into the staging memory. same bytes with the `packed_scene_t`
+    vulkan_mesh_batch_t direct{device, meminfo, packer};
+    REQUIRE(direct.vertex_size == scene.vertices.size());
+    REQUIRE(direct.index_size == scene.indices.size());
+    void* mapping = nullptr;
+    REQUIRE(vkMapMemory(device, direct.staging_memory, 0, VK_WHOLE_SIZE, 0, &mapping) == VK_SUCCESS);
+    REQUIRE(std::memcmp(mapping, scene.vertices.data(), scene.vertices.size()) == 0);
+    vkUnmapMemory(device, direct.staging_memory);
+}
+
+TEST_CASE("vulkan_render_graph_t", "[vulkan][headless]") {
+    const char* layers[1]{"VK_LAYER_KHRONOS_validation"};
+    vulkan_instance_t instance{"app1", gsl::make_span(layers, 1), {}};
+    VkPhysicalDevice physical_device{};
+    REQUIRE(get_physical_device(instance.handle, physical_device) == VK_SUCCESS);
+    VkPhysicalDeviceMemoryProperties meminfo{};
+    vkGetPhysicalDeviceMemoryProperties(physical_device, &meminfo);
+    VkDevice device{};
+    VkDeviceQueueCreateInfo qinfo{};
+    REQUIRE(create_device(physical_device, device, qinfo) == VK_SUCCESS);
+    auto on_return_0 = gsl::finally([device]() {
+        vkDestroyDevice(device, nullptr); //
+    });
+    VkQueue queue = VK_NULL_HANDLE;
+    vkGetDeviceQueue(device, qinfo.queueFamilyIndex, 0, &queue);
+
+    // the output of the frame
+    const VkExtent2D extent{256, 256}, half{128, 128};
+    VkImage image{};
+    VkDeviceMemory memory{};
+    VkImageView view{};
+    {
+        VkImageCreateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        info.imageType = VK_IMAGE_TYPE_2D;
+        info.format = VK_FORMAT_R8G8B8A8_UNORM;
+        info.extent = {extent.width, extent.height, 1};
+        info.mipLevels = 1;
+        info.arrayLayers = 1;
+        info.samples = VK_SAMPLE_COUNT_1_BIT;
+        info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        REQUIRE(vkCreateImage(device, &info, nullptr, &image) == VK_SUCCESS);
+    }
+    auto on_return_1 = gsl::finally([device, image, &memory, &view]() {
+        vkDestroyImageView(device, view, nullptr);
+        vkDestroyImage(device, image, nullptr);
+        vkFreeMemory(device, memory, nullptr);
+    });
+    {
+        VkMemoryRequirements requirements{};
+        vkGetImageMemoryRequirements(device, image, &requirements);
+        VkMemoryAllocateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        info.allocationSize = requirements.size;
+        info.memoryTypeIndex = get_memory_type(meminfo, requirements.memoryTypeBits, 0);
+        REQUIRE(vkAllocateMemory(device, &info, nullptr, &memory) == VK_SUCCESS);
+        REQUIRE(vkBindImageMemory(device, image, memory, 0) == VK_SUCCESS);
+        VkImageViewCreateInfo view_info{};
+        view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        view_info.image = image;
+        view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        view_info.format = VK_FORMAT_R8G8B8A8_UNORM;
+        view_info.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        REQUIRE(vkCreateImageView(device, &view_info, nullptr, &view) == VK_SUCCESS);
+    }
+
+    vulkan_render_graph_t graph{device, meminfo};
+    const auto output = graph.import_image(image, view, VK_FORMAT_R8G8B8A8_UNORM, extent, //
+                                           VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+    const auto hdr = graph.create_image(VK_FORMAT_R16G16B16A16_SFLOAT, extent);
+    const auto depth = graph.create_image(VK_FORMAT_D32_SFLOAT, extent);
+    const auto debug = graph.create_image(VK_FORMAT_R8G8B8A8_UNORM, extent);
+    const auto blur0 = graph.create_image(VK_FORMAT_R8G8B8A8_UNORM, half);
+    const auto blur1 = graph.create_image(VK_FORMAT_R8G8B8A8_UNORM, half);
+    const auto blur2 = graph.create_image(VK_FORMAT_R8G8B8A8_UNORM, half);
+    uint32_t count = 0;
+    auto record = [&count](VkCommandBuffer) { ++count; };
+    vulkan_render_graph_t::pass_t scene{"scene", {hdr}, depth, {}, {}, false, record};
+    vulkan_render_graph_t::pass_t overlay{"overlay", {hdr}, depth, {}, {}, false, record};
+    vulkan_render_graph_t::pass_t unused{"debug", {debug}, vulkan_render_graph_t::npos, {hdr}, {}, false, record};
+    const auto p0 = graph.add_pass(scene);
+    const auto p1 = graph.add_pass(overlay);
+    const auto p2 = graph.add_pass(unused);
+    graph.add_pass({"bright", {blur0}, vulkan_render_graph_t::npos, {hdr}, {}, false, record});
+    graph.add_pass({"blur", {blur1}, vulkan_render_graph_t::npos, {blur0}, {}, false, record});
+    graph.add_pass({"blur", {blur2}, vulkan_render_graph_t::npos, {blur1}, {}, false, record});
+    graph.add_pass({"composite", {output}, vulkan_render_graph_t::npos, {hdr, blur2}, {}, false, record});
+    REQUIRE(graph.compile() == VK_SUCCESS);
+
+    // culled. no image for it
+    REQUIRE(graph.passes[p2].culled);
+    REQUIRE(graph.images[debug].handle == VK_NULL_HANDLE);
+    VkRenderPass renderpass{};
+    uint32_t subpass = 0;
+    REQUIRE(graph.get_renderpass(p2, renderpass, subpass) == VK_ERROR_INITIALIZATION_FAILED);
+    // same attachments, 1 render pass
+    REQUIRE(graph.get_renderpass(p1, renderpass, subpass) == VK_SUCCESS);
+    REQUIRE(subpass == 1);
+    REQUIRE(graph.passes[p0].step == graph.passes[p1].step);
+    // 5 render passes + the transition of the output
+    REQUIRE(graph.steps.size() == 6);
+    // the depth is never stored
+    REQUIRE(graph.images[depth].usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT);
+    // blur0 is dead before blur2. they share the memory
+    REQUIRE(graph.images[blur2].memory == graph.images[blur0].memory);
+    REQUIRE(graph.images[blur2].alias == blur0);
+    REQUIRE(graph.memories.size() == 4);
+    // the hdr is already in SHADER_READ_ONLY_OPTIMAL. only blur2 and the output
+    REQUIRE(graph.steps[4].image_barriers.size() == 2);
+
+    vulkan_command_pool_t command_pool{device, qinfo.queueFamilyIndex, 1};
+    auto command_buffer = command_pool.buffers[0];
+    VkCommandBufferBeginInfo begin{};
+    begin.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    REQUIRE(vkBeginCommandBuffer(command_buffer, &begin) == VK_SUCCESS);
+    graph.execute(command_buffer);
+    REQUIRE(vkEndCommandBuffer(command_buffer) == VK_SUCCESS);
+    REQUIRE(count == 6);
+    VkSubmitInfo submit{};
+    submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit.commandBufferCount = 1;
+    submit.pCommandBuffers = &command_buffer;
+    REQUIRE(vkQueueSubmit(queue, 1, &submit, VK_NULL_HANDLE) == VK_SUCCESS);
+    REQUIRE(vkQueueWaitIdle(queue) == VK_SUCCESS);
+}
+
+TEST_CASE("vulkan_indirect_culler_t", "[vulkan][headless]") {
+    vulkan_instance_t instance{"app1", {}, {}};
+    VkPhysicalDevice physical_device{};
+    REQUIRE(get_physical_device(instance.handle, physical_device) == VK_SUCCESS);
+    VkPhysicalDeviceMemoryProperties meminfo{};
+    vkGetPhysicalDeviceMemoryProperties(physical_device, &meminfo);
+    VkDevice device{};
+    VkDeviceQueueCreateInfo queue_info{};
+    bool draw_indirect_count = false;
+    REQUIRE(create_device(physical_device, device, queue_info, draw_indirect_count) == VK_SUCCESS);
+    auto on_return_0 = gsl::finally([device]() {
+        vkDestroyDevice(device, nullptr); //
+    });
+    VkQueue queue = VK_NULL_HANDLE;
+    vkGetDeviceQueue(device, queue_info.queueFamilyIndex, 0, &queue);
+
+    // 64 x 64 quads in [-2, 2] x [-2, 2]. The box of [-1, 1] sees about 1/4 of them
+    const float positions[12]{0, 0, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0};
+    const uint16_t indices[6]{0, 1, 2, 2, 3, 0};
+    accessor_view_t position_view{reinterpret_cast<const std::byte*>(positions), 4, 0, GL_FLOAT, 3};
+    accessor_view_t index_view{reinterpret_cast<const std::byte*>(indices), 6, 0, GL_UNSIGNED_SHORT, 1};
+    mesh_packer_t packer{};
+    REQUIRE(packer.add(0, -1, position_view, {}, {}, index_view) == 0);
+    packed_scene_t scene{};
+    REQUIRE(packer.pack(scene) == 0);
+    for (auto i = 0u; i < 64 * 64; ++i) {
+        auto& item = scene.instances.emplace_back();
+        const float transform[16]{0.05f, 0, 0, 0, 0, 0.05f, 0, 0, 0, 0, 0.05f, 0,
+                                  (i % 64) * 0.0625f - 2, (i / 64) * 0.0625f - 2, 0, 1};
+        std::copy(transform, transform + 16, item.transform);
+    }
+    vector<draw_object_t> objects{};
+    REQUIRE(make_draw_objects(scene, objects) == 0);
+    const float view_projection[16]{1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+    frustum_t frustum{};
+    make_frustum(view_projection, {0, 0, 1}, frustum);
+    vector<draw_indexed_command_t> expected{};
+    cull_draw_objects(objects, frustum, expected);
+    REQUIRE(expected.size() > 0);
+    REQUIRE(expected.size() < objects.size() / 2);
+
+    // the readback of the `draws` and the `counter`
+    const auto capacity = static_cast<uint32_t>(objects.size());
+    const VkDeviceSize draws_size = sizeof(draw_indexed_command_t) * capacity;
+    VkBufferCreateInfo readback_info{};
+    readback_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    readback_info.size = draws_size + sizeof(uint32_t);
+    readback_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    readback_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VkBuffer readback{};
+    REQUIRE(vkCreateBuffer(device, &readback_info, nullptr, &readback) == VK_SUCCESS);
+    VkDeviceMemory readback_memory{};
+    auto on_return_1 = gsl::finally([device, readback, &readback_memory]() {
+        vkDestroyBuffer(device, readback, nullptr);
+        vkFreeMemory(device, readback_memory, nullptr);
+    });
+    REQUIRE(allocate_memory(device, readback, readback_memory, readback_info,
+                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                            meminfo) == VK_SUCCESS);
+    REQUIRE(vkBindBufferMemory(device, readback, readback_memory, 0) == VK_SUCCESS);
+
+    vulkan_command_pool_t command_pool{device, queue_info.queueFamilyIndex, 1};
+    auto run = [&](vulkan_indirect_culler_t& culler, vector<draw_indexed_command_t>& draws, uint32_t& visible) {
+        auto command_buffer = command_pool.buffers[0];
+        VkCommandBufferBeginInfo begin{};
+        begin.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        begin.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        REQUIRE(vkBeginCommandBuffer(command_buffer, &begin) == VK_SUCCESS);
+        culler.record(command_buffer, frustum);
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                             1, &barrier, 0, nullptr, 0, nullptr);
+        VkBufferCopy regions[2]{};
+        regions[0].size = draws_size;
+        regions[1].dstOffset = draws_size;
+        regions[1].size = sizeof(uint32_t);
+        vkCmdCopyBuffer(command_buffer, culler.draws, readback, 1, regions + 0);
+        vkCmdCopyBuffer(command_buffer, culler.counter, readback, 1, regions + 1);
+        REQUIRE(vkEndCommandBuffer(command_buffer) == VK_SUCCESS);
+        VkSubmitInfo submit{};
+        submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit.commandBufferCount = 1;
+        submit.pCommandBuffers = &command_buffer;
+        REQUIRE(vkQueueSubmit(queue, 1, &submit, VK_NULL_HANDLE) == VK_SUCCESS);
+        REQUIRE(vkQueueWaitIdle(queue) == VK_SUCCESS);
+        void* mapping = nullptr;
+        REQUIRE(vkMapMemory(device, readback_memory, 0, VK_WHOLE_SIZE, 0, &mapping) == VK_SUCCESS);
+        draws.resize(capacity);
+        std::memcpy(draws.data(), mapping, draws_size);
+        std::memcpy(&visible, static_cast<std::byte*>(mapping) + draws_size, sizeof(uint32_t));
+        vkUnmapMemory(device, readback_memory);
+    };
+    // the order of the atomic counter is not fixed
+    auto sort = [](vector<draw_indexed_command_t>& draws) {
+        std::sort(draws.begin(), draws.end(), [](const auto& lhs, const auto& rhs) {
+            return lhs.first_instance < rhs.first_instance;
+        });
+    };
+
+    SECTION("compact with the counter") {
+        vulkan_indirect_culler_t culler{device, meminfo, get_asset_dir(), 2, capacity, true};
+        // the 2nd slot. the dynamic offset is not 0
+        REQUIRE(culler.update(3, objects) == VK_SUCCESS);
+        REQUIRE(culler.frame == 1);
+        vector<draw_indexed_command_t> draws{};
+        uint32_t visible = 0;
+        run(culler, draws, visible);
+        REQUIRE(visible == expected.size());
+        draws.resize(visible);
+        sort(draws);
+        REQUIRE(std::memcmp(draws.data(), expected.data(), visible * sizeof(draw_indexed_command_t)) == 0);
+    }
+    SECTION("fixed count") {
+        vulkan_indirect_culler_t culler{device, meminfo, get_asset_dir(), 2, capacity, false};
+        REQUIRE(culler.update(0, objects) == VK_SUCCESS);
+        vector<draw_indexed_command_t> draws{};
+        uint32_t visible = 0;
+        run(culler, draws, visible);
+        REQUIRE(visible == expected.size());
+        // 1 slot for each object. the culled ones have 0 instance
+        for (auto i = 0u; i < capacity; ++i)
+            REQUIRE(draws[i].first_instance == objects[i].instance);
+        draws.erase(std::remove_if(draws.begin(), draws.end(), [](const auto& d) { return d.instance_count == 0; }),
+                    draws.end());
+        REQUIRE(std::memcmp(draws.data(), expected.data(), visible * sizeof(draw_indexed_command_t)) == 0);
+    }
+    SECTION("over the capacity") {
+        vulkan_indirect_culler_t culler{device, meminfo, get_asset_dir(), 2, 16, draw_indirect_count};
+        REQUIRE(culler.update(0, objects) == VK_ERROR_TOO_MANY_OBJECTS);
+        REQUIRE(culler.count == 0);
+    }
+}
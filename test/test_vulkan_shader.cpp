@@ -0,0 +1,176 @@
+#include <catch2/catch.hpp>
+#include <spdlog/spdlog.h>
+
+#include "vulkan_1.h"
+
+using namespace std;
+
+constexpr auto vert_code = "#version 450\n"
+                           "layout(location = 0) in vec2 i_position;\n"
+                           "void main() {\n"
+                           "    gl_Position = vec4(i_position * SCALE, 0.0, 1.0);\n"
+                           "}\n";
+constexpr auto comp_code = "#version 450\n"
+                           "layout(local_size_x = 64) in;\n"
+                           "layout(constant_id = 0) const uint count = 1;\n"
+                           "layout(constant_id = 1) const float weight = 1.0;\n"
+                           "layout(std430, binding = 0) buffer values_t { float values[]; };\n"
+                           "void main() {\n"
+                           "    if (gl_GlobalInvocationID.x < count)\n"
+                           "        values[gl_GlobalInvocationID.x] *= weight;\n"
+                           "}\n";
+
+TEST_CASE("vulkan_shader_compiler_t", "[vulkan][shader]") {
+    const auto directory = fs::temp_directory_path() / "graphics_spirv_cache";
+    fs::remove_all(directory);
+    auto on_return = gsl::finally([&directory]() {
+        std::error_code ec{};
+        fs::remove_all(directory, ec);
+    });
+    vulkan_shader_compiler_t::request_t request{};
+    request.stage = VK_SHADER_STAGE_VERTEX_BIT;
+    request.source = vert_code;
+    request.defines.emplace_back("SCALE", "0.5");
+
+    vector<uint32_t> code{};
+    string message{};
+    {
+        vulkan_shader_compiler_t compiler{directory, 2};
+        REQUIRE(compiler.compile(request, code, message) == 0);
+        REQUIRE(code.size() > 5);
+        REQUIRE(code[0] == 0x07230203); // SPIR-V magic
+        REQUIRE(compiler.miss == 1);
+        const auto key = vulkan_shader_compiler_t::make_key(request);
+        REQUIRE(fs::exists(compiler.get_path(key)));
+
+        SECTION("same source") {
+            vector<uint32_t> code2{};
+            REQUIRE(compiler.compile(request, code2, message) == 0);
+            REQUIRE(compiler.hit == 1);
+            REQUIRE(code2 == code);
+        }
+        SECTION("other defines") {
+            auto request2 = request;
+            request2.defines[0].second = "2.0";
+            REQUIRE(vulkan_shader_compiler_t::make_key(request2) != key);
+            uint64_t key2 = 0;
+            compiler.submit(request2, key2);
+            REQUIRE(compiler.miss == 2);
+            vector<uint32_t> code2{};
+            REQUIRE(compiler.get(key2, code2, message) == 0);
+            REQUIRE(code2 != code);
+        }
+        SECTION("compile error") {
+            auto request2 = request;
+            request2.defines.clear(); // SCALE is undefined
+            REQUIRE(compiler.compile(request2, code, message) == EINVAL);
+            REQUIRE_FALSE(message.empty());
+        }
+        SECTION("not submitted") {
+            REQUIRE(compiler.get(key + 1, code, message) == ENOENT);
+        }
+    }
+    // the next process finds the result in the directory
+    vulkan_shader_compiler_t compiler{directory, 1};
+    vector<uint32_t> code2{};
+    REQUIRE(compiler.compile(request, code2, message) == 0);
+    REQUIRE(compiler.hit == 1);
+    REQUIRE(compiler.miss == 0);
+    REQUIRE(code2.size() > 5);
+}
+
+TEST_CASE("vulkan_shader_compiler_t: many sources", "[vulkan][shader]") {
+    vulkan_shader_compiler_t compiler{};
+    vector<uint64_t> keys(32);
+    for (auto i = 0u; i < keys.size(); ++i) {
+        vulkan_shader_compiler_t::request_t request{};
+        request.stage = VK_SHADER_STAGE_VERTEX_BIT;
+        request.source = vert_code;
+        request.defines.emplace_back("SCALE", to_string(i + 1));
+        compiler.submit(request, keys[i]);
+    }
+    REQUIRE(compiler.miss == keys.size());
+    vector<uint32_t> code{};
+    string message{};
+    for (auto key : keys) {
+        REQUIRE(compiler.get(key, code, message) == 0);
+        REQUIRE(compiler.is_completed(key));
+    }
+}
+
+TEST_CASE("vulkan_shader_module_t from memory", "[vulkan][shader]") {
+    vulkan_instance_t instance{"app1", {}, {}};
+    VkPhysicalDevice physical_device{};
+    REQUIRE(get_physical_device(instance.handle, physical_device) == VK_SUCCESS);
+    VkDevice device{};
+    VkDeviceQueueCreateInfo queue_info{};
+    REQUIRE(create_device(physical_device, device, queue_info) == VK_SUCCESS);
+    auto on_return_0 = gsl::finally([device]() {
+        vkDestroyDevice(device, nullptr); //
+    });
+
+    vulkan_shader_compiler_t compiler{};
+    vulkan_shader_compiler_t::request_t request{};
+    request.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    request.source = comp_code;
+    request.optimize = true;
+    vector<uint32_t> code{};
+    string message{};
+    REQUIRE(compiler.compile(request, code, message) == 0);
+    vulkan_shader_module_t shader{device, gsl::make_span(code.data(), code.size())};
+    REQUIRE(shader.handle);
+
+    VkDescriptorSetLayoutBinding binding{};
+    binding.binding = 0;
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    binding.descriptorCount = 1;
+    binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    VkDescriptorSetLayoutCreateInfo set_info{};
+    set_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    set_info.bindingCount = 1;
+    set_info.pBindings = &binding;
+    VkDescriptorSetLayout set_layout{};
+    REQUIRE(vkCreateDescriptorSetLayout(device, &set_info, nullptr, &set_layout) == VK_SUCCESS);
+    auto on_return_1 = gsl::finally([device, set_layout]() {
+        vkDestroyDescriptorSetLayout(device, set_layout, nullptr); //
+    });
+    VkPipelineLayoutCreateInfo layout_info{};
+    layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layout_info.setLayoutCount = 1;
+    layout_info.pSetLayouts = &set_layout;
+    VkPipelineLayout layout{};
+    REQUIRE(vkCreatePipelineLayout(device, &layout_info, nullptr, &layout) == VK_SUCCESS);
+    auto on_return_2 = gsl::finally([device, layout]() {
+        vkDestroyPipelineLayout(device, layout, nullptr); //
+    });
+
+    // variants from the one module
+    vulkan_specialization_t variants[2]{};
+    REQUIRE(variants[0].get() == nullptr);
+    variants[0].set(0, 128u);
+    variants[1].set(0, 128u);
+    variants[1].set(1, 0.5f);
+    variants[1].set(1, 0.25f); // replace
+    REQUIRE(variants[0].make_key(0) != variants[1].make_key(0));
+    REQUIRE(variants[1].get()->mapEntryCount == 2);
+    REQUIRE(variants[1].get()->dataSize == 2 * sizeof(uint32_t));
+
+    VkPipeline pipelines[2]{};
+    auto on_return_3 = gsl::finally([device, &pipelines]() {
+        for (auto pipeline : pipelines)
+            vkDestroyPipeline(device, pipeline, nullptr);
+    });
+    VkComputePipelineCreateInfo infos[2]{};
+    for (auto i : {0, 1}) {
+        auto& info = infos[i];
+        info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        info.stage.module = shader.handle;
+        info.stage.pName = "main";
+        info.stage.pSpecializationInfo = variants[i].get();
+        info.layout = layout;
+    }
+    REQUIRE(vkCreateComputePipelines(device, VK_NULL_HANDLE, 2, infos, nullptr, pipelines) == VK_SUCCESS);
+    REQUIRE(pipelines[0] != pipelines[1]);
+}